@@ -1,13 +1,28 @@
 #ifndef AUDIO_PLAYOUT_LOG_H
 #define AUDIO_PLAYOUT_LOG_H
 
-#include <android/log.h>
 #define TAG "av_native_record"
 
-#define AV_LOGD(...) __android_log_print(ANDROID_LOG_DEBUG,TAG,__VA_ARGS__)
-#define AV_LOGI(...) __android_log_print(ANDROID_LOG_INFO,TAG,__VA_ARGS__)
-#define AV_LOGW(...) __android_log_print(ANDROID_LOG_WARN,TAG,__VA_ARGS__)
-#define AV_LOGE(...) __android_log_print(ANDROID_LOG_ERROR,TAG,__VA_ARGS__)
-#define AV_LOGF(...) __android_log_print(ANDROID_LOG_FATAL,TAG,__VA_ARGS__)
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+#include "sv_rt_log.h"
+
+// Logs to logcat, or to stderr in host builds (virtual device, CLI tools).
+// Inside a render callback a call only records its arguments and returns,
+// the line is written later by a background thread and each call site logs
+// at most once a second, see SVRtLog.
+#define AV_LOG_AT(level, format, ...) \
+  do { \
+    static ::sv_render::SVRtLogSite sv_log_site(level, format); \
+    if (false) ::sv_render::SVCheckLogFormat(format, ##__VA_ARGS__); \
+    ::sv_render::SVRtLog::Log(&sv_log_site, ##__VA_ARGS__); \
+  } while (0)
+
+#define AV_LOGD(...) AV_LOG_AT(::sv_render::SV_LOG_DEBUG, __VA_ARGS__)
+#define AV_LOGI(...) AV_LOG_AT(::sv_render::SV_LOG_INFO, __VA_ARGS__)
+#define AV_LOGW(...) AV_LOG_AT(::sv_render::SV_LOG_WARN, __VA_ARGS__)
+#define AV_LOGE(...) AV_LOG_AT(::sv_render::SV_LOG_ERROR, __VA_ARGS__)
+#define AV_LOGF(...) AV_LOG_AT(::sv_render::SV_LOG_FATAL, __VA_ARGS__)
 
 #endif //AUDIO_PLAYOUT_LOG_H
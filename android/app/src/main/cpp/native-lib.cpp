@@ -1,69 +1,451 @@
 #include <jni.h>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "sv_common.h"
 #include "log.h"
+#include "sv_handle_registry.h"
+#include "sv_mixer.h"
+#include "sv_opensl_engine.h"
 #include "sv_opensl_render.h"
+#include "sv_playlist_source.h"
+#include "sv_push_source.h"
 #include "sv_aaudio_render.h"
 #include "sv_oboe_render.h"
+#include "sv_virtual_render.h"
+#include "sv_wav_file.h"
 
 using namespace sv_render;
 
-SV_RENDER_TYPE g_render_type = UNDEFINED;
-INativeAudioRender::Ptr g_audio_render = nullptr;
+// One stream and everything that belongs to it. Every stream plays through
+// its own mixer, whose first voice is a playlist that starts with the file
+// given to nativeCreate; nativeEnqueue appends to it so a whole sequence
+// plays through one device stream. Without a file the stream plays until
+// stopped, fed by push streams or voices added later.
+struct SVRenderSession {
+  ~SVRenderSession() {
+    // Wakes writers blocked on a stream that no longer plays.
+    for (auto& push_source : push_sources) {
+      push_source->Close();
+    }
+  }
 
-void NativeSetRecordType(JNIEnv *env, jobject obj, jint type, jstring file_path) {
-  if (g_render_type != UNDEFINED && g_audio_render) {
-    AV_LOGW("please release previous g_audio_render.");
-    return;
+  SV_RENDER_TYPE render_type = UNDEFINED;
+  INativeAudioRender::Ptr audio_render;
+  std::shared_ptr<SVMixer> mixer;
+  std::shared_ptr<SVPlaylistSource> playlist;
+  // Set when that file is a WAV: its header overrides the layout passed to
+  // nativeInitRender.
+  int content_sample_rate = 0;
+  int content_channels = 0;
+  // Serializes the control calls (init, start, stop, settings) on one
+  // stream, and the voice calls: the mixer takes them from one thread at a
+  // time. The playlist, gain and stats calls don't take it, the playlist and
+  // the gain stage are safe to call from any thread.
+  std::mutex control_mutex;
+  // Buffer queue of the OpenSL backend, set by nativeSetOpenslBuffers.
+  SVOpenslBufferConfig opensl_buffer_config;
+  // Buffer sizing of the AAudio and Oboe streams, set by nativeSetLatencyPolicy.
+  SV_LATENCY_POLICY latency_policy = SV_LATENCY_POLICY_BALANCED;
+  // Push streams mixed into this stream, under control_mutex.
+  std::vector<std::shared_ptr<SVPushSource>> push_sources;
+};
+
+// PCM the app writes with nativeWrite, playing as one voice of a stream.
+struct SVPushStream {
+  std::shared_ptr<SVPushSource> source;
+  // The voice it plays as, converting it to the stream's layout.
+  std::shared_ptr<SVConvertingPcmSource> voice;
+};
+
+// Streams by handle. Each one lives until nativeRelease, independently of
+// the others; looking one up takes no lock.
+SVHandleRegistry<SVRenderSession> g_sessions;
+// Push streams by handle, separate from their stream's so nativeWrite
+// finds its ring in one lookup.
+SVHandleRegistry<SVPushStream> g_push_streams;
+
+// Opens what the backend's cold start costs ahead of the first stream, see
+// SVWarmPool: the OpenSL engine and output mix, or a parked AAudio/Oboe
+// stream in the float format those renders open with.
+jboolean NativePrewarm(JNIEnv *env, jclass clazz, jint type) {
+  bool result = false;
+  if (type == OPENSL) {
+    result = SVOpenslEngine::Prewarm();
+  } else if (type == AAUDIO) {
+    result = SVAAudioRender::Prewarm(SV_SAMPLE_FORMAT_FLOAT);
+  } else if (type == OBOE) {
+    result = SVOboeRender::Prewarm(SV_SAMPLE_FORMAT_FLOAT);
+  } else {
+    AV_LOGW("Nothing to prewarm for render type %d.", type);
   }
+  return result ? JNI_TRUE : JNI_FALSE;
+}
+
+// Returns the handle of a new stream, 0 on failure.
+jlong NativeCreate(JNIEnv *env, jobject obj, jint type, jstring file_path) {
+  std::unique_ptr<SVRenderSession> session(new SVRenderSession());
   const char* c_path = env->GetStringUTFChars(file_path, nullptr);
   std::string path(c_path);
+  env->ReleaseStringUTFChars(file_path, c_path);
+  SVWavFormat wav_format;
+  const bool is_wav = SVWavFile::IsWavFile(path) && SVWavFile::Probe(path, &wav_format);
+  session->content_sample_rate = is_wav ? wav_format.sample_rate : 0;
+  session->content_channels = is_wav ? wav_format.channels : 0;
+  session->mixer = std::make_shared<SVMixer>();
+  session->playlist = std::make_shared<SVPlaylistSource>();
+  // With a file the stream stops once the last voice ends, like a single
+  // file did. Without one it waits for pushed PCM until stopped.
+  session->mixer->SetEndWhenIdle(!path.empty());
+  session->playlist->SetEndWhenEmpty(!path.empty());
+  if (session->mixer->AddVoice(session->playlist) < 0 || (!path.empty() && session->playlist->Enqueue(path) < 0)) {
+    AV_LOGW("Add voice failed: %s", path.c_str());
+  }
   if (type == OPENSL) {
-    g_audio_render = std::make_shared<SVOpenslRender>(path);
+    session->audio_render = std::make_shared<SVOpenslRender>(session->mixer);
   } else if (type == AAUDIO) {
-    g_audio_render = std::make_shared<SVAAudioRender>(path);
+    session->audio_render = std::make_shared<SVAAudioRender>(session->mixer);
   } else if (type == OBOE) {
-    g_audio_render = std::make_shared<SVOboeRender>(path);
+    session->audio_render = std::make_shared<SVOboeRender>(session->mixer);
+  } else if (type == VIRTUAL_DEVICE) {
+    session->audio_render = std::make_shared<SVVirtualRender>(session->mixer);
+  } else {
+    AV_LOGE("Unknown render type %d.", type);
+    return 0;
+  }
+  session->render_type = static_cast<SV_RENDER_TYPE>(type);
+  const jlong handle = g_sessions.Add(std::move(session));
+  if (handle == 0) {
+    AV_LOGE("Create render failed, %d streams already.", g_sessions.capacity());
+    return 0;
+  }
+  AV_LOGI("Create render type %d, handle %lld, streams: %d", type, (long long) handle, g_sessions.size());
+  return handle;
+}
+
+// Destroys the stream, stopping it if it still plays. The handle is invalid
+// afterwards, calls with it fail.
+void NativeRelease(JNIEnv *env, jobject obj, jlong handle) {
+  if (!g_sessions.Remove(handle)) {
+    AV_LOGW("Release render failed, unknown handle %lld.", (long long) handle);
+  }
+}
+
+jint NativeInitRecording(JNIEnv *env, jobject obj, jlong handle, jint sample_rate, jint channels) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return JNI_ERR;
+  }
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  if (session->content_sample_rate > 0) {
+    AV_LOGI("Render configured from WAV header: %d Hz, %d channels.", session->content_sample_rate,
+            session->content_channels);
+    sample_rate = session->content_sample_rate;
+    channels = session->content_channels;
+  }
+  session->audio_render->SetLatencyPolicy(session->latency_policy);
+  auto result = session->render_type == OPENSL
+                ? std::static_pointer_cast<SVOpenslRender>(session->audio_render)->InitAudioRender(
+                        sample_rate, channels, session->opensl_buffer_config)
+                : session->audio_render->InitAudioRender(sample_rate, channels);
+  return result == SV_NO_ERROR ? JNI_OK : JNI_ERR;
+}
+
+// Before nativeInitRender. 0 buffers picks the count at run time, the fewest
+// that keep the queue from running dry.
+void NativeSetOpenslBuffers(JNIEnv *env, jobject obj, jlong handle, jint num_buffers, jint buffer_ms) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  session->opensl_buffer_config.num_buffers = num_buffers;
+  session->opensl_buffer_config.buffer_ms = buffer_ms;
+}
+
+// Before nativeInitRender, see SV_LATENCY_POLICY.
+void NativeSetLatencyPolicy(JNIEnv *env, jobject obj, jlong handle, jint policy) {
+  if (policy < SV_LATENCY_POLICY_OFF || policy > SV_LATENCY_POLICY_ROBUST) {
+    AV_LOGW("Unknown latency policy %d.", policy);
+    return;
+  }
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  session->latency_policy = static_cast<SV_LATENCY_POLICY>(policy);
+}
+
+jint NativeStartRecording(JNIEnv *env, jobject obj, jlong handle) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return JNI_ERR;
+  }
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  return session->audio_render->StartPlayout() == SV_NO_ERROR ? JNI_OK : JNI_ERR;
+}
+
+jint NativeStopRecording(JNIEnv *env, jobject obj, jlong handle) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return JNI_ERR;
+  }
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  return session->audio_render->StopPlayout() == SV_NO_ERROR ? JNI_OK : JNI_ERR;
+}
+
+// The stream keeps running silent, the source holds its position.
+jint NativePausePlayout(JNIEnv *env, jobject obj, jlong handle) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return JNI_ERR;
   }
-  g_render_type = static_cast<SV_RENDER_TYPE>(type);
-  AV_LOGI("Reset render type %d", g_render_type);
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  return session->audio_render->PausePlayout() == SV_NO_ERROR ? JNI_OK : JNI_ERR;
+}
+
+jint NativeResumePlayout(JNIEnv *env, jobject obj, jlong handle) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return JNI_ERR;
+  }
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  return session->audio_render->ResumePlayout() == SV_NO_ERROR ? JNI_OK : JNI_ERR;
+}
+
+// Stream gain, no lock: the gain stage takes changes from any thread.
+jboolean NativeSetGain(JNIEnv *env, jobject obj, jlong handle, jfloat gain, jint ramp_ms, jboolean exponential) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return JNI_FALSE;
+  }
+  const SVGainCurve curve = exponential ? SVGainCurve::kExponential : SVGainCurve::kLinear;
+  return session->audio_render->SetGain(gain, ramp_ms, curve) == SV_NO_ERROR ? JNI_TRUE : JNI_FALSE;
+}
+
+// Voices are raw PCM files in the layout the render was initialized with, or
+// WAV files in any layout.
+jint NativeAddVoice(JNIEnv *env, jobject obj, jlong handle, jstring file_path, jfloat gain) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return -1;
+  }
+  const char* c_path = env->GetStringUTFChars(file_path, nullptr);
+  auto source = CreateFilePcmSource(c_path);
   env->ReleaseStringUTFChars(file_path, c_path);
+  if (!source) {
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  return session->mixer->AddVoice(source, gain);
 }
 
-jint NativeInitRecording(JNIEnv *env, jobject obj, jint sample_rate, jint channels) {
-  if (g_audio_render) {
-    auto result = g_audio_render->InitAudioRender(sample_rate, channels);
-    if (result != SV_NO_ERROR)
-      return JNI_ERR;
+jboolean NativeRemoveVoice(JNIEnv *env, jobject obj, jlong handle, jint voice_id) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return JNI_FALSE;
   }
-  return JNI_OK;
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  return session->mixer->RemoveVoice(voice_id) ? JNI_TRUE : JNI_FALSE;
 }
 
-jint NativeStartRecording(JNIEnv *env, jobject obj) {
-  if (g_audio_render) {
-    auto result = g_audio_render->StartPlayout();
-    if (result != SV_NO_ERROR)
-      return JNI_ERR;
+jboolean NativeSetVoiceGain(JNIEnv *env, jobject obj, jlong handle, jint voice_id, jfloat gain) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return JNI_FALSE;
   }
-  return JNI_OK;
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  return session->mixer->SetVoiceGain(voice_id, gain) ? JNI_TRUE : JNI_FALSE;
 }
 
-jint NativeStopRecording(JNIEnv *env, jobject obj) {
-  if (g_audio_render) {
-    auto result = g_audio_render->StopPlayout();
-    if (result != SV_NO_ERROR)
-      return JNI_ERR;
+// Appends a file to the playlist, it starts on the frame the previous one
+// ends. Same formats as voices.
+jint NativeEnqueue(JNIEnv *env, jobject obj, jlong handle, jstring file_path) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return -1;
+  }
+  const char* c_path = env->GetStringUTFChars(file_path, nullptr);
+  const int item_id = session->playlist->Enqueue(c_path);
+  env->ReleaseStringUTFChars(file_path, c_path);
+  return item_id;
+}
+
+jint NativeGetCurrentItem(JNIEnv *env, jobject obj, jlong handle) {
+  auto session = g_sessions.Get(handle);
+  return session ? session->playlist->current_item() : 0;
+}
+
+// Seeks inside the current playlist item, frame in the file's own rate.
+// Returns at once, the render thread crossfades to the new position.
+jboolean NativeSeek(JNIEnv *env, jobject obj, jlong handle, jlong frame) {
+  auto session = g_sessions.Get(handle);
+  return session && session->playlist->Seek(frame) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Adds a voice the app feeds with nativeWrite, PCM16 in the given layout,
+// converted to the stream's. buffer_ms sizes its ring, 0 for the default.
+// A live producer, one paced by its own clock, passes the latency to hold
+// against clock drift in latency_ms; 0 plays the frames at their nominal rate.
+// Returns the push stream's handle, 0 on failure. Frames can be written
+// before the stream starts.
+jlong NativeCreatePushStream(JNIEnv *env, jobject obj, jlong handle, jint sample_rate, jint channels,
+                             jint buffer_ms, jfloat gain, jint latency_ms) {
+  if (sample_rate <= 0 || channels <= 0 || buffer_ms < 0 || latency_ms < 0) {
+    AV_LOGE("Invalid push stream: %d Hz, %d channels, %d ms.", sample_rate, channels, buffer_ms);
+    return 0;
+  }
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return 0;
+  }
+  std::unique_ptr<SVPushStream> push_stream(new SVPushStream());
+  push_stream->source = std::make_shared<SVPushSource>(sample_rate, channels,
+                                                      buffer_ms > 0 ? buffer_ms : SVPushSource::kDefaultBufferMs);
+  auto voice = std::make_shared<SVConvertingPcmSource>(push_stream->source);
+  voice->SetSourceSampleRate(sample_rate);
+  voice->SetSourceChannels(channels);
+  voice->SetDriftCorrection(latency_ms);
+  push_stream->voice = voice;
+  std::lock_guard<std::mutex> lock(session->control_mutex);
+  auto push_source = push_stream->source;
+  const jlong push_handle = g_push_streams.Add(std::move(push_stream));
+  if (push_handle == 0) {
+    AV_LOGE("Create push stream failed, %d push streams already.", g_push_streams.capacity());
+    return 0;
+  }
+  if (session->mixer->AddVoice(voice, gain) < 0) {
+    g_push_streams.Remove(push_handle);
+    return 0;
+  }
+  session->push_sources.push_back(push_source);
+  return push_handle;
+}
+
+// Queues frames of interleaved PCM16 from a direct ByteBuffer in native
+// byte order, copied straight into the push stream's ring. Blocking waits
+// for room, otherwise only what fits is queued. Returns the frames queued,
+// -1 on error.
+jint NativeWrite(JNIEnv *env, jobject obj, jlong push_handle, jobject buffer, jint frames, jboolean blocking) {
+  std::shared_ptr<SVPushSource> source;
+  {
+    // A blocked write must not hold the handle, nativeEndPushStream would
+    // wait for it.
+    auto push_stream = g_push_streams.Get(push_handle);
+    if (!push_stream) {
+      return -1;
+    }
+    source = push_stream->source;
+  }
+  auto data = static_cast<const int16_t*>(env->GetDirectBufferAddress(buffer));
+  const jlong capacity = env->GetDirectBufferCapacity(buffer);
+  if (!data || frames < 0 || capacity < static_cast<jlong>(frames) * source->channels() * static_cast<jlong>(sizeof(int16_t))) {
+    AV_LOGE("Write needs a direct buffer of %d frames, capacity %lld.", frames, (long long) capacity);
+    return -1;
+  }
+  return source->Write(data, frames, blocking == JNI_TRUE);
+}
+
+// Frames nativeWrite can queue right now without blocking, -1 if the handle
+// is unknown.
+jint NativeGetPushAvailable(JNIEnv *env, jobject obj, jlong push_handle) {
+  auto push_stream = g_push_streams.Get(push_handle);
+  return push_stream ? push_stream->source->available_to_write() : -1;
+}
+
+// No more writes: what is queued still plays, then the voice ends. The push
+// handle is invalid afterwards.
+void NativeEndPushStream(JNIEnv *env, jobject obj, jlong push_handle) {
+  {
+    auto push_stream = g_push_streams.Get(push_handle);
+    if (!push_stream) {
+      AV_LOGW("End push stream failed, unknown handle %lld.", (long long) push_handle);
+      return;
+    }
+    push_stream->source->EndOfStream();
+  }
+  g_push_streams.Remove(push_handle);
+}
+
+// Latency from the producer to the speaker and the rate correction holding
+// it, of a push stream created with a latency. Layout shared with
+// SVNativeAudioRender.PushDrift, keep them in sync.
+jdoubleArray NativeGetPushDrift(JNIEnv *env, jobject obj, jlong push_handle) {
+  auto push_stream = g_push_streams.Get(push_handle);
+  if (!push_stream) {
+    return nullptr;
+  }
+  const SVDriftEstimator& drift = push_stream->voice->drift_estimator();
+  const jdouble values[] = {
+          drift.latency_s() * 1000.0,  // ms, negative until the voice played.
+          drift.correction_ppm(),
+          drift.drift_ppm(),
+  };
+  jdoubleArray result = env->NewDoubleArray(arraysize(values));
+  if (result) {
+    env->SetDoubleArrayRegion(result, 0, arraysize(values), values);
+  }
+  return result;
+}
+
+// Layout shared with SVNativeAudioRender.RenderStats, keep them in sync.
+jlongArray NativeGetStats(JNIEnv *env, jobject obj, jlong handle) {
+  auto session = g_sessions.Get(handle);
+  if (!session) {
+    return nullptr;
+  }
+  SVRenderStatsSnapshot stats;
+  if (session->audio_render->GetStats(&stats) != SV_NO_ERROR) {
+    return nullptr;
+  }
+  const jlong values[] = {
+          stats.callback_count,
+          stats.frames_rendered,
+          stats.underrun_count,
+          stats.xrun_count,
+          stats.jitter_avg_ns,
+          stats.jitter_max_ns,
+          stats.render_avg_ns,
+          stats.render_max_ns,
+          static_cast<jlong>(stats.output_latency_ms * 1000.0),  // microseconds, negative if unknown.
+          stats.start_latency_ns,  // -1 before the first callback.
+          stats.disconnect_count,
+          stats.recovery_count,
+          stats.recovery_last_ns,  // -1 before the first recovery.
+          stats.recovery_max_ns,
+  };
+  jlongArray result = env->NewLongArray(arraysize(values));
+  if (result) {
+    env->SetLongArrayRegion(result, 0, arraysize(values), values);
   }
-  g_audio_render = nullptr;
-  g_render_type = UNDEFINED;
-  return JNI_OK;
+  return result;
 }
 
 static JNINativeMethod gMethods[] = {
-        {"nativeSetRenderType", "(ILjava/lang/String;)V", (void*) NativeSetRecordType},
-        {"nativeInitRender", "(II)I", (void*) NativeInitRecording},
-        {"nativeStartPlayout", "()I", (void*) NativeStartRecording},
-        {"nativeStopPlayout", "()I", (void*) NativeStopRecording},
+        {"nativePrewarm", "(I)Z", (void*) NativePrewarm},
+        {"nativeCreate", "(ILjava/lang/String;)J", (void*) NativeCreate},
+        {"nativeRelease", "(J)V", (void*) NativeRelease},
+        {"nativeInitRender", "(JII)I", (void*) NativeInitRecording},
+        {"nativeSetOpenslBuffers", "(JII)V", (void*) NativeSetOpenslBuffers},
+        {"nativeSetLatencyPolicy", "(JI)V", (void*) NativeSetLatencyPolicy},
+        {"nativeStartPlayout", "(J)I", (void*) NativeStartRecording},
+        {"nativeStopPlayout", "(J)I", (void*) NativeStopRecording},
+        {"nativePausePlayout", "(J)I", (void*) NativePausePlayout},
+        {"nativeResumePlayout", "(J)I", (void*) NativeResumePlayout},
+        {"nativeGetStats", "(J)[J", (void*) NativeGetStats},
+        {"nativeSetGain", "(JFIZ)Z", (void*) NativeSetGain},
+        {"nativeAddVoice", "(JLjava/lang/String;F)I", (void*) NativeAddVoice},
+        {"nativeRemoveVoice", "(JI)Z", (void*) NativeRemoveVoice},
+        {"nativeSetVoiceGain", "(JIF)Z", (void*) NativeSetVoiceGain},
+        {"nativeEnqueue", "(JLjava/lang/String;)I", (void*) NativeEnqueue},
+        {"nativeGetCurrentItem", "(J)I", (void*) NativeGetCurrentItem},
+        {"nativeSeek", "(JJ)Z", (void*) NativeSeek},
+        {"nativeCreatePushStream", "(JIIIFI)J", (void*) NativeCreatePushStream},
+        {"nativeWrite", "(JLjava/nio/ByteBuffer;IZ)I", (void*) NativeWrite},
+        {"nativeGetPushAvailable", "(J)I", (void*) NativeGetPushAvailable},
+        {"nativeEndPushStream", "(J)V", (void*) NativeEndPushStream},
+        {"nativeGetPushDrift", "(J)[D", (void*) NativeGetPushDrift},
 };
 
 static const char* className = "com/soundvision/audio_playout/SVNativeAudioRender";
@@ -1,101 +1,290 @@
 #include "sv_aaudio_render.h"
 #include "log.h"
-#include <cassert>
+#include "sv_rt_audit.h"
+#include <cstring>
+#include <ctime>
 
 namespace sv_render {
 
 SVAAudioRender::SVAAudioRender(const std::string& file_path)
-  : builder_(nullptr),
-  stream_(nullptr),
-  file_(nullptr),
-  initialized_(false) {
+  : SVAAudioRender(CreateFilePcmSource(file_path)) {
+}
+
+SVAAudioRender::SVAAudioRender(IPcmSource::Ptr source)
+  : stream_(nullptr),
+  source_(std::make_shared<SVConvertingPcmSource>(std::move(source))),
+  channels_(0),
+  recovery_(&control_, &stats_, [this] { return ReopenStream(); }) {
   AV_LOGI("SVAAudioRender Construct");
-  file_ = fopen(file_path.c_str(), "rb");
-  assert(file_);
-  AV_LOGI("open file address: %p", file_);
-  auto result = AAudio_createStreamBuilder(&builder_);
+}
+
+SVAAudioRender::~SVAAudioRender() {
+  AV_LOGI("SVAAudioRender Destruct");
+  if (control_.state() != SVStreamState::kClosed) {
+    StopPlayout();
+  }
+  ParkStream();
+  source_->Release();
+}
+
+SVAAudioRender::PooledStream::~PooledStream() {
+  if (stream) {
+    AAudioStream_close(stream);
+  }
+}
+
+bool SVAAudioRender::PooledStream::Usable() const {
+  if (dead.load(std::memory_order_acquire)) {
+    return false;
+  }
+  const aaudio_stream_state_t state = AAudioStream_getState(stream);
+  return state == AAUDIO_STREAM_STATE_OPEN || state == AAUDIO_STREAM_STATE_STOPPED;
+}
+
+void SVAAudioRender::PooledStream::Bind(SVAAudioRender* owner) {
+  std::lock_guard<std::mutex> lock(error_mutex);
+  render.store(owner, std::memory_order_release);
+}
+
+SVWarmPool<int, SVAAudioRender::PooledStream>& SVAAudioRender::stream_pool() {
+  static SVWarmPool<int, PooledStream> pool;
+  return pool;
+}
+
+bool SVAAudioRender::Prewarm(SV_SAMPLE_FORMAT format) {
+  auto pooled = OpenStream(format);
+  if (!pooled) {
+    return false;
+  }
+  stream_pool().Put(format, std::move(pooled));
+  return true;
+}
+
+std::unique_ptr<SVAAudioRender::PooledStream> SVAAudioRender::OpenStream(SV_SAMPLE_FORMAT format, int32_t channels) {
+  AAudioStreamBuilder* builder = nullptr;
+  auto result = AAudio_createStreamBuilder(&builder);
   if (result != AAUDIO_OK) {
     AV_LOGE("createStreamBuilder failed, reason:%s", AAudio_convertResultToText(result));
+    return nullptr;
   }
-  assert(builder_);
+  std::unique_ptr<PooledStream> pooled(new PooledStream());
+  AAudioStreamBuilder_setDeviceId(builder, AAUDIO_UNSPECIFIED);
+  // Open at the native rate to stay on the fast mixer path, the content is
+  // resampled in the callback.
+  AAudioStreamBuilder_setSampleRate(builder, AAUDIO_UNSPECIFIED);
+  // Likewise the device picks its preferred layout, the content is remapped.
+  AAudioStreamBuilder_setChannelCount(builder, channels);
+  AAudioStreamBuilder_setFormat(builder, format == SV_SAMPLE_FORMAT_FLOAT ? AAUDIO_FORMAT_PCM_FLOAT
+                                                                          : AAUDIO_FORMAT_PCM_I16);
+  AAudioStreamBuilder_setSharingMode(builder, AAUDIO_SHARING_MODE_SHARED);
+  AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
+  AAudioStreamBuilder_setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+  AAudioStreamBuilder_setDataCallback(builder, DataCallback, pooled.get());
+  AAudioStreamBuilder_setErrorCallback(builder, ErrorCallback, pooled.get());
+  result = AAudioStreamBuilder_openStream(builder, &pooled->stream);
+  AAudioStreamBuilder_delete(builder);
+  if (result != AAUDIO_OK) {
+    AV_LOGE("AAudio open stream failed, reason:%s", AAudio_convertResultToText(result));
+    return nullptr;
+  }
+  return pooled;
 }
 
-SVAAudioRender::~SVAAudioRender() {
-  AV_LOGI("SVAAudioRender Destruct");
-  if (file_) {
-    fclose(file_);
-    file_ = nullptr;
+void SVAAudioRender::ParkStream() {
+  std::lock_guard<std::mutex> lock(stream_mutex_);
+  if (!pooled_stream_) {
+    return;
   }
-  AAudioStream_close(stream_);
-  stream_ = nullptr;
-  builder_ = nullptr;
-  audio_buffers_ = nullptr;
-  initialized_ = false;
-}
-
-bool SVAAudioRender::ReadPlayoutData(int num_frames) {
-  const size_t per_size = sizeof(int16_t);
-  int channels = AAudioStream_getChannelCount(stream_);
-  const size_t buf_size = num_frames * channels;
-  auto len = fread(audio_buffers_.get(), per_size, buf_size, file_);
-  if (len < buf_size) {
-    if (ferror(file_)) {
-      AV_LOGW("read file error.");
+  // Callbacks still running may hold this render, the stop waits them out;
+  // an error callback using it is waited for here.
+  pooled_stream_->Bind(nullptr);
+  AAudioStream* stream = pooled_stream_->stream;
+  aaudio_stream_state_t state = AAudioStream_getState(stream);
+  if (state == AAUDIO_STREAM_STATE_STARTING || state == AAUDIO_STREAM_STATE_STARTED) {
+    auto result = AAudioStream_requestStop(stream);
+    if (result != AAUDIO_OK) {
+      AV_LOGE("AAudio request stop failed, reason: %s", AAudio_convertResultToText(result));
     }
-    if (feof(file_)) {
-      AV_LOGW("read file end.");
+    state = AAudioStream_getState(stream);
+  }
+  while (state == AAUDIO_STREAM_STATE_STARTING || state == AAUDIO_STREAM_STATE_STARTED ||
+         state == AAUDIO_STREAM_STATE_STOPPING) {
+    if (AAudioStream_waitForStateChange(stream, state, &state, kStopTimeoutNanos) != AAUDIO_OK) {
+      break;
     }
-    fclose(file_);
-    return false;
   }
-  return true;
+  if (pooled_stream_->Usable()) {
+    stream_pool().Put(pool_format_, std::move(pooled_stream_));
+  } else {
+    // Disconnected or stuck, closed instead of reused.
+    AV_LOGW("AAudio stream not parked, state: %d", state);
+    pooled_stream_.reset();
+  }
+  stream_ = nullptr;
 }
 
 aaudio_data_callback_result_t
 SVAAudioRender::DataCallback(AAudioStream* stream, void* user_data, void* audio_data, int32_t num_frames) {
-
-  auto* render = reinterpret_cast<SVAAudioRender*>(user_data);
+  SVRtAuditScope audit_scope;
+  auto* pooled = reinterpret_cast<PooledStream*>(user_data);
+  auto* render = pooled ? pooled->render.load(std::memory_order_acquire) : nullptr;
   if (render == nullptr) {
-    AV_LOGW("Get SVAAudioRender failed, so stop audio data render.");
-    return AAUDIO_CALLBACK_RESULT_STOP;
+    // Parked while it still ran, it is being stopped.
+    const size_t sample_size = AAudioStream_getFormat(stream) == AAUDIO_FORMAT_PCM_FLOAT ? sizeof(float)
+                                                                                        : sizeof(int16_t);
+    memset(audio_data, 0, num_frames * AAudioStream_getChannelCount(stream) * sample_size);
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
   }
+  SVStreamControl::CallbackScope control_scope(&render->control_);
+  if (!control_scope.render()) {
+    // Paused, or being stopped, the stream plays silence.
+    const size_t sample_size = render->sample_format_ == SV_SAMPLE_FORMAT_FLOAT ? sizeof(float) : sizeof(int16_t);
+    memset(audio_data, 0, num_frames * render->channels_ * sample_size);
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+  }
+  render->stats_.MarkDeviceCallback();
+  render->UpdateDeviceLatency(stream);
 
-  int channels = AAudioStream_getChannelCount(stream);
-  size_t num_bytes = sizeof(int16_t) * channels * num_frames;
-  memset(audio_data, 0, num_bytes);
-
-  if (!render->ReadPlayoutData(num_frames)) {
+  // The source renders straight into the device buffer.
+  const bool keep_going = render->sample_format_ == SV_SAMPLE_FORMAT_FLOAT
+          ? RenderPcmSource(render->source_.get(), static_cast<float*>(audio_data), num_frames, render->channels_,
+                            &render->stats_, &render->gain_)
+          : RenderPcmSource(render->source_.get(), static_cast<int16_t*>(audio_data), num_frames, render->channels_,
+                            &render->stats_, &render->gain_);
+  if (!keep_going) {
+    render->control_.MarkDrained();
     AV_LOGW("Read playout data failed.");
     return AAUDIO_CALLBACK_RESULT_STOP;
   }
-
-  memcpy(audio_data, render->audio_buffers_.get(), num_bytes);
+  const int buffer_size = render->latency_tuner_.Update(AAudioStream_getXRunCount(stream),
+                                                        SVRenderStats::NowNanos());
+  if (buffer_size > 0) {
+    AAudioStream_setBufferSizeInFrames(stream, buffer_size);
+  }
   return AAUDIO_CALLBACK_RESULT_CONTINUE;
 }
 
+void SVAAudioRender::UpdateDeviceLatency(AAudioStream* stream) {
+  const int64_t now_ns = SVRenderStats::NowNanos();
+  if (device_timestamp_.Due(stream, now_ns)) {
+    int64_t frame_position = 0;
+    int64_t frame_time_ns = 0;
+    const bool ok = AAudioStream_getTimestamp(stream, CLOCK_MONOTONIC, &frame_position, &frame_time_ns) == AAUDIO_OK;
+    device_timestamp_.Update(stream, now_ns, ok, frame_position, frame_time_ns);
+  }
+  source_->SetDeviceLatency(device_timestamp_.Latency(AAudioStream_getFramesWritten(stream),
+                                                      AAudioStream_getSampleRate(stream), now_ns));
+}
+
+bool SVAAudioRender::ReopenStream() {
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    if (stream_) {
+      xrun_carry_ += AAudioStream_getXRunCount(stream_) - xrun_base_;
+    }
+  }
+  // A disconnected stream isn't parked, it is closed.
+  ParkStream();
+  auto pooled = OpenStream(pool_format_, channels_);
+  if (!pooled) {
+    return false;
+  }
+  AAudioStream* stream = pooled->stream;
+  const SV_SAMPLE_FORMAT format = AAudioStream_getFormat(stream) == AAUDIO_FORMAT_PCM_FLOAT ? SV_SAMPLE_FORMAT_FLOAT
+                                                                                            : SV_SAMPLE_FORMAT_I16;
+  if (format != sample_format_ || AAudioStream_getChannelCount(stream) != channels_) {
+    AV_LOGE("AAudio reopened stream has another format, %d channels.", AAudioStream_getChannelCount(stream));
+    return false;
+  }
+  const int32_t device_rate = AAudioStream_getSampleRate(stream);
+  AV_LOGI("AAudio stream reopened at %d Hz.", device_rate);
+  if (!source_->SetStreamSampleRate(device_rate)) {
+    return false;
+  }
+  stats_.Restart(device_rate);
+  gain_.Restart(device_rate);
+  const int tuned_size = latency_tuner_.Reset(latency_policy_, AAudioStream_getFramesPerBurst(stream),
+                                              AAudioStream_getBufferCapacityInFrames(stream));
+  if (tuned_size > 0) {
+    AAudioStream_setBufferSizeInFrames(stream, tuned_size);
+  }
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    pooled_stream_ = std::move(pooled);
+    stream_ = stream;
+    xrun_base_ = AAudioStream_getXRunCount(stream_);
+  }
+  // Silent until the recovery hands the stream back.
+  pooled_stream_->Bind(this);
+  auto result = AAudioStream_requestStart(stream);
+  if (result != AAUDIO_OK) {
+    AV_LOGE("AAudio restart error, reason:%s", AAudio_convertResultToText(result));
+    ParkStream();
+    return false;
+  }
+  return true;
+}
+
 void SVAAudioRender::ErrorCallback(AAudioStream* stream, void* user_data, aaudio_result_t error) {
-  // handle error.
   AV_LOGE("ErrorCallback error: %s", AAudio_convertResultToText(error));
+  // AAudio calls this on a thread of its own, but the stream can't be closed
+  // from here; the recovery thread does it and reopens.
+  auto* pooled = reinterpret_cast<PooledStream*>(user_data);
+  if (!pooled) {
+    return;
+  }
+  // Whether it plays or is parked, the stream is done for; a parked one is
+  // closed by the next Take() that comes across it.
+  pooled->dead.store(true, std::memory_order_release);
+  // The render can't go away while this holds the lock, Bind(nullptr) in its
+  // ParkStream() waits for it.
+  std::lock_guard<std::mutex> lock(pooled->error_mutex);
+  auto* render = pooled->render.load(std::memory_order_acquire);
+  if (render) {
+    render->recovery_.OnDisconnect();
+  }
+}
+
+int SVAAudioRender::SetSampleFormat(SV_SAMPLE_FORMAT format) {
+  if (!control_.SetWhileClosed([&] { sample_format_ = format; })) {
+    AV_LOGW("AAudio set sample format failed, already initialized.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  return SV_NO_ERROR;
+}
+
+int SVAAudioRender::SetLatencyPolicy(SV_LATENCY_POLICY policy) {
+  if (!control_.SetWhileClosed([&] { latency_policy_ = policy; })) {
+    AV_LOGW("AAudio set latency policy failed, already initialized.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  return SV_NO_ERROR;
 }
 
 int SVAAudioRender::InitAudioRender(int sample_rate, int channels) {
   AV_LOGI("InitAudioRender");
-  // step1: AAudio configuration.
-  AAudioStreamBuilder_setDeviceId(builder_, AAUDIO_UNSPECIFIED);
-  AAudioStreamBuilder_setSampleRate(builder_, sample_rate);
-  AAudioStreamBuilder_setChannelCount(builder_, channels);
-  AAudioStreamBuilder_setFormat(builder_, AAUDIO_FORMAT_PCM_I16);
-  AAudioStreamBuilder_setSharingMode(builder_, AAUDIO_SHARING_MODE_SHARED);
-  AAudioStreamBuilder_setDirection(builder_, AAUDIO_DIRECTION_OUTPUT);
-  AAudioStreamBuilder_setPerformanceMode(builder_, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
-  AAudioStreamBuilder_setDataCallback(builder_, DataCallback, this);
-  AAudioStreamBuilder_setErrorCallback(builder_, ErrorCallback, this);
-
-  // step2: open stream.
-  auto result = AAudioStreamBuilder_openStream(builder_, &stream_);
-  if (result != AAUDIO_OK) {
-    AV_LOGE("AAudio open stream failed, reason:%s", AAudio_convertResultToText(result));
-    return SV_PLAY_INIT_ERROR;
+  if (!control_.Transition(SVStreamState::kClosed, SVStreamState::kOpening)) {
+    AV_LOGW("AAudio init failed, stream %s.", SVStreamControl::StateName(control_.state()));
+    return SV_PLAY_STATE_ERROR;
+  }
+  // step1: a parked stream in this format, or a newly opened one.
+  pool_format_ = sample_format_;
+  pooled_stream_ = stream_pool().Take(pool_format_, [](const PooledStream& pooled) { return pooled.Usable(); });
+  if (pooled_stream_) {
+    AV_LOGI("AAudio reusing a parked stream.");
+  } else {
+    // step2: open stream.
+    pooled_stream_ = OpenStream(sample_format_);
+    if (!pooled_stream_) {
+      control_.Transition(SVStreamState::kOpening, SVStreamState::kClosed);
+      return SV_PLAY_INIT_ERROR;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    stream_ = pooled_stream_->stream;
+    xrun_base_ = AAudioStream_getXRunCount(stream_);
+    xrun_carry_ = 0;
   }
 
   // step3: set buffer.
@@ -103,58 +292,136 @@ int SVAAudioRender::InitAudioRender(int sample_rate, int channels) {
   int32_t frames_per_burst = AAudioStream_getFramesPerBurst(stream_);
   AV_LOGI("max buffer capacity: %d, framesPerBurst:%d", capacity, frames_per_burst);
 
+  // 不设置的话 buffer size 等于 capacity，延迟最大。按策略从几个 burst 起步，
+  // 回调里再根据 XRun 调整。
+  const int tuned_size = latency_tuner_.Reset(latency_policy_, frames_per_burst, capacity);
+  if (tuned_size > 0) {
+    AAudioStream_setBufferSizeInFrames(stream_, tuned_size);
+  }
   int32_t buffer_size = AAudioStream_getBufferSizeInFrames(stream_);
   AV_LOGI("buffer_size: %d", buffer_size);
 
-  //根据自己需求，来决定是否要设置缓冲区大小。如果不设置 buffer size 等于 capacity.
-//  AAudioStream_setBufferSizeInFrames()
-
-  //step4: allocate buffer.
-  const size_t buffer_size_in_samples = sample_rate / 100 * channels;
-  audio_buffers_.reset(new int16_t[buffer_size_in_samples]);
+  //step4: prepare the source off the audio thread.
+  // The callback writes whatever format the stream really got.
+  sample_format_ = AAudioStream_getFormat(stream_) == AAUDIO_FORMAT_PCM_FLOAT ? SV_SAMPLE_FORMAT_FLOAT
+                                                                              : SV_SAMPLE_FORMAT_I16;
+  const int32_t device_rate = AAudioStream_getSampleRate(stream_);
+  channels_ = AAudioStream_getChannelCount(stream_);
+  AV_LOGI("AAudio stream opened at %d Hz %d channels, content %d Hz %d channels.", device_rate, channels_,
+          sample_rate, channels);
+  stats_.Reset(device_rate);
+  gain_.Prepare(device_rate);
+  source_->SetSourceSampleRate(sample_rate);
+  source_->SetSourceChannels(channels);
+  if (!source_->Prepare(device_rate, channels_)) {
+    AV_LOGE("AAudio prepare pcm source failed.");
+    ParkStream();
+    control_.Transition(SVStreamState::kOpening, SVStreamState::kClosed);
+    return SV_PLAY_INIT_ERROR;
+  }
 
-  initialized_ = true;
+  control_.Transition(SVStreamState::kOpening, SVStreamState::kOpen);
   AV_LOGI("AAudio init done.");
   return SV_NO_ERROR;
 }
 
 int SVAAudioRender::StartPlayout() {
   AV_LOGI("AAudio start playout.");
-  if (!initialized_) {
-    AV_LOGE("AAudio state error, not init.");
+  if (!control_.Transition(SVStreamState::kOpen, SVStreamState::kStarting)) {
+    AV_LOGW("AAudio start failed, stream %s.", SVStreamControl::StateName(control_.state()));
     return SV_PLAY_STATE_ERROR;
   }
 
+  // A parked stream comes back stopped.
   auto state = AAudioStream_getState(stream_);
-  if (state != AAUDIO_STREAM_STATE_OPEN) {
+  if (state != AAUDIO_STREAM_STATE_OPEN && state != AAUDIO_STREAM_STATE_STOPPED) {
     AV_LOGE("Invalid state, please open stream first.");
+    control_.Transition(SVStreamState::kStarting, SVStreamState::kOpen);
     return SV_START_PLAY_ERROR;
   }
 
+  stats_.MarkStartRequested();
+  gain_.FadeIn();
+  pooled_stream_->Bind(this);
   auto result = AAudioStream_requestStart(stream_);
   if (result != AAUDIO_OK) {
     AV_LOGE("AAudio request start error, reason:%s", AAudio_convertResultToText(result));
+    pooled_stream_->Bind(nullptr);
+    control_.Transition(SVStreamState::kStarting, SVStreamState::kOpen);
     return SV_START_PLAY_ERROR;
   }
+  control_.FinishStart();
   AV_LOGI("AAudio start playout end.");
   return SV_NO_ERROR;
 }
 
 int SVAAudioRender::StopPlayout() {
   AV_LOGI("AAudio stop playout start.");
-  if (!initialized_) {
-    AV_LOGE("AAudio state error, not init.");
+  SVStreamState previous;
+  if (!recovery_.BeginStop(&previous)) {
+    AV_LOGW("AAudio stop failed, stream %s.", SVStreamControl::StateName(control_.state()));
     return SV_PLAY_STATE_ERROR;
   }
 
-  auto result = AAudioStream_requestStop(stream_);
-  if (result != AAUDIO_OK) {
-    AV_LOGE("AAudio request stop failed, reason: %s", AAudio_convertResultToText(result));
-    return SV_STOP_PLAYER_ERROR;
+  // A stop plays out what is buffered, the fade-out included.
+  if (previous == SVStreamState::kRunning && AAudioStream_getState(stream_) == AAUDIO_STREAM_STATE_STARTED &&
+      !gain_.FadeOut()) {
+    AV_LOGW("AAudio fade-out not rendered, stopping anyway.");
+  }
+  // Callbacks go silent before the stream is stopped and parked.
+  control_.Quiesce();
+  // No stream left after a recovery that gave up.
+  const int64_t xruns = xrun_carry_ + (stream_ ? AAudioStream_getXRunCount(stream_) - xrun_base_ : 0);
+  ParkStream();
+  source_->Release();
+  if (latency_tuner_.enabled()) {
+    AV_LOGI("AAudio buffer size: %d frames, grown %lld times, shrunk %lld times, xruns: %lld.",
+            latency_tuner_.buffer_size(), (long long) latency_tuner_.grow_count(),
+            (long long) latency_tuner_.shrink_count(), (long long) xruns);
   }
   AV_LOGI("AAudio stop playout end.");
-  initialized_ = false;
+  control_.FinishStop();
+  return SV_NO_ERROR;
+}
+
+int SVAAudioRender::PausePlayout() {
+  AV_LOGI("AAudio pause playout.");
+  return control_.Pause(&gain_);
+}
+
+int SVAAudioRender::ResumePlayout() {
+  AV_LOGI("AAudio resume playout.");
+  return control_.Resume(&gain_);
+}
+
+int SVAAudioRender::SetGain(float gain, int ramp_ms, SVGainCurve curve) {
+  gain_.SetGain(gain, ramp_ms, curve);
+  return SV_NO_ERROR;
+}
+
+int SVAAudioRender::GetStats(SVRenderStatsSnapshot* stats) {
+  std::lock_guard<std::mutex> lock(stream_mutex_);
+  if (!stream_) {
+    AV_LOGW("AAudio get stats failed, stream not open.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  *stats = stats_.Snapshot();
+  stats->xrun_count = xrun_carry_ + AAudioStream_getXRunCount(stream_) - xrun_base_;
+
+  // Latency of a frame written now: when the last written frame will be
+  // presented, extrapolated from the latest presentation timestamp.
+  int64_t frame_position = 0;
+  int64_t frame_time_ns = 0;
+  if (AAudioStream_getTimestamp(stream_, CLOCK_MONOTONIC, &frame_position, &frame_time_ns) == AAUDIO_OK) {
+    const int64_t frames_written = AAudioStream_getFramesWritten(stream_);
+    const int32_t sample_rate = AAudioStream_getSampleRate(stream_);
+    timespec now {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t now_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+    const int64_t presentation_ns = frame_time_ns + (frames_written - frame_position) * 1000000000LL / sample_rate;
+    stats->output_latency_ms = (presentation_ns - now_ns) / 1000000.0;
+  }
   return SV_NO_ERROR;
 }
 
-} // sv_render
\ No newline at end of file
+} // sv_render
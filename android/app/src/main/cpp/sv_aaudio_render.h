@@ -2,31 +2,109 @@
 #define AUDIO_PLAYOUT_SV_AAUDIO_RENDER_H
 
 #include "sv_common.h"
+#include "sv_pcm_source.h"
+#include "sv_converting_pcm_source.h"
+#include "sv_drift_estimator.h"
+#include "sv_latency_tuner.h"
+#include "sv_stream_recovery.h"
+#include "sv_warm_pool.h"
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <aaudio/AAudio.h>
 
 namespace sv_render {
 
+// Opening an AAudio stream is the slow part of a cold start, so streams are
+// pooled: StopPlayout() parks the stopped stream, and the next render in the
+// same sample format reuses it instead of opening one. Prewarm() opens one
+// ahead of the first render. A stream whose device went away is closed and
+// reopened on the new default device by an SVStreamRecovery, playback
+// carries on where it stopped.
 class SVAAudioRender  : public INativeAudioRender {
 
 public:
   explicit SVAAudioRender(const std::string& file_path);
+  explicit SVAAudioRender(IPcmSource::Ptr source);
   ~SVAAudioRender() override;
+  int SetSampleFormat(SV_SAMPLE_FORMAT format) override;
+  int SetLatencyPolicy(SV_LATENCY_POLICY policy) override;
   int InitAudioRender(int sample_rate, int channels) override;
   int StartPlayout() override;
   int StopPlayout() override;
+  int PausePlayout() override;
+  int ResumePlayout() override;
+  int SetGain(float gain, int ramp_ms, SVGainCurve curve) override;
+  int GetStats(SVRenderStatsSnapshot* stats) override;
+
+  // Opens a stream in this format and parks it for the next render.
+  static bool Prewarm(SV_SAMPLE_FORMAT format);
 
 private:
+  // An open stream plus the render it currently plays for. The stream's
+  // callbacks are bound to this when it is opened, so it can move between
+  // renders; without one it plays silence.
+  struct PooledStream {
+    ~PooledStream();
+    // Whether a render can start it: not disconnected, also not while it
+    // was parked, and open or stopped.
+    bool Usable() const;
+    // Control side. Hands the callbacks to render, nullptr takes them back;
+    // an error callback still using the old one is waited for.
+    void Bind(SVAAudioRender* owner);
+    AAudioStream* stream = nullptr;
+    std::atomic<SVAAudioRender*> render { nullptr };
+    // Set by the error callback, the stream is never started again.
+    std::atomic<bool> dead { false };
+    // Held by Bind() and by the error callback while it uses render.
+    std::mutex error_mutex;
+  };
+  static SVWarmPool<int, PooledStream>& stream_pool();
+  // channels 0 lets the device pick its layout.
+  static std::unique_ptr<PooledStream> OpenStream(SV_SAMPLE_FORMAT format, int32_t channels = AAUDIO_UNSPECIFIED);
+  // Stops the stream and parks it, waiting until no callback runs any more.
+  void ParkStream();
+  // SVStreamRecovery's reopen: the same format and layout on the current
+  // default device, at whatever rate it runs.
+  bool ReopenStream();
+
+  // Audio thread. Tells the source how long a frame written now waits in
+  // the device, for live sources holding their latency against drift.
+  void UpdateDeviceLatency(AAudioStream* stream);
+
   static aaudio_data_callback_result_t DataCallback(AAudioStream* stream, void* user_data, void* audio_data, int32_t num_frames);
   static void ErrorCallback(AAudioStream* stream, void* user_data, aaudio_result_t error);
-  bool ReadPlayoutData(int num_frames);
 
 private:
-  AAudioStreamBuilder *builder_;
+  // Bounds the wait for a stopping stream before it is parked.
+  static constexpr int64_t kStopTimeoutNanos = 500000000;
+
+  std::unique_ptr<PooledStream> pooled_stream_;
+  // Format the stream was taken from the pool for, it goes back under it.
+  SV_SAMPLE_FORMAT pool_format_ = SV_SAMPLE_FORMAT_FLOAT;
+  // pooled_stream_->stream while this render holds one. Swapped by a
+  // recovery, so GetStats() reads it under stream_mutex_.
   AAudioStream* stream_;
-  FILE *file_;
-  bool initialized_;
-  std::unique_ptr<int16_t[]> audio_buffers_;
+  std::mutex stream_mutex_;
+  // Xruns the stream had counted before this render got it, and those of
+  // streams lost to a disconnect.
+  int64_t xrun_base_ = 0;
+  int64_t xrun_carry_ = 0;
+  // Converts the content to the rate the device opened at.
+  std::shared_ptr<SVConvertingPcmSource> source_;
+  SVRenderStats stats_;
+  SVGainStage gain_;
+  SVStreamControl control_;
+  int channels_;
+  // Float by default, it is what the mixer runs in.
+  SV_SAMPLE_FORMAT sample_format_ = SV_SAMPLE_FORMAT_FLOAT;
+  // Resizes the stream buffer from the callback as xruns come and go.
+  SV_LATENCY_POLICY latency_policy_ = SV_LATENCY_POLICY_BALANCED;
+  SVLatencyTuner latency_tuner_;
+  // Audio thread.
+  SVDeviceTimestamp device_timestamp_;
+  // Last, its thread reopens with everything above.
+  SVStreamRecovery recovery_;
 };
 
 } // sv_render
@@ -0,0 +1,35 @@
+#include "sv_buffer_count_tuner.h"
+#include <algorithm>
+
+namespace sv_render {
+
+void SVBufferCountTuner::Configure(int min_count, int max_count, double max_underrun_rate, int window_buffers) {
+  max_count_ = std::max(max_count, min_count);
+  window_buffers_ = std::max(window_buffers, 1);
+  allowed_underruns_ = static_cast<int>(std::max(max_underrun_rate, 0.0) * window_buffers_);
+  count_.store(min_count, std::memory_order_relaxed);
+  underruns_.store(0, std::memory_order_relaxed);
+  window_position_ = 0;
+  window_underruns_ = 0;
+}
+
+int SVBufferCountTuner::OnBufferConsumed(bool underrun) {
+  int count = count_.load(std::memory_order_relaxed);
+  if (underrun) {
+    underruns_.fetch_add(1, std::memory_order_relaxed);
+    // No need to wait out the window once it is over budget.
+    if (++window_underruns_ > allowed_underruns_ && count < max_count_) {
+      count_.store(++count, std::memory_order_relaxed);
+      window_position_ = 0;
+      window_underruns_ = 0;
+      return count;
+    }
+  }
+  if (++window_position_ >= window_buffers_) {
+    window_position_ = 0;
+    window_underruns_ = 0;
+  }
+  return count;
+}
+
+} // sv_render
@@ -0,0 +1,44 @@
+#ifndef AUDIO_PLAYOUT_SV_BUFFER_COUNT_TUNER_H
+#define AUDIO_PLAYOUT_SV_BUFFER_COUNT_TUNER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace sv_render {
+
+// Picks how many buffers a queue keeps in flight. Starts at the minimum and
+// adds one as soon as the underruns of the current window exceed the target
+// rate, so it settles on the smallest count the device and the scheduler
+// sustain. It never shrinks again: probing a smaller count would cost the
+// very glitches it is there to avoid.
+class SVBufferCountTuner {
+
+public:
+  // Control thread. max_underrun_rate is underruns per consumed buffer,
+  // judged over windows of window_buffers buffers.
+  void Configure(int min_count, int max_count, double max_underrun_rate, int window_buffers);
+
+  // Audio thread, once per buffer the device consumed. Returns the number
+  // of buffers to keep queued.
+  int OnBufferConsumed(bool underrun);
+
+  // Any thread.
+  int count() const { return count_.load(std::memory_order_relaxed); }
+  int64_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+private:
+  int max_count_ = 0;
+  // Underruns a window may have before the count grows.
+  int allowed_underruns_ = 0;
+  int window_buffers_ = 0;
+  std::atomic<int> count_ { 0 };
+  std::atomic<int64_t> underruns_ { 0 };
+
+  // Audio thread.
+  int window_position_ = 0;
+  int window_underruns_ = 0;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_BUFFER_COUNT_TUNER_H
@@ -0,0 +1,265 @@
+#include "sv_channel_converter.h"
+#include "sv_mix_kernels.h"
+#include "sv_simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace sv_render {
+
+namespace {
+
+constexpr float k3dB = SVChannelConverter::kMinus3dB;
+
+void MonoToStereoScalar(const float* in, float* out, int num_frames) {
+  for (int i = 0; i < num_frames; ++i) {
+    out[2 * i] = in[i];
+    out[2 * i + 1] = in[i];
+  }
+}
+
+void StereoToMonoScalar(const float* in, float* out, int num_frames) {
+  for (int i = 0; i < num_frames; ++i) {
+    out[i] = 0.5f * (in[2 * i] + in[2 * i + 1]);
+  }
+}
+
+void Surround51ToStereoScalar(const float* in, float* out, int num_frames) {
+  for (int i = 0; i < num_frames; ++i, in += 6, out += 2) {
+    out[0] = in[0] + k3dB * (in[2] + in[4]);
+    out[1] = in[1] + k3dB * (in[2] + in[5]);
+  }
+}
+
+void Surround71ToStereoScalar(const float* in, float* out, int num_frames) {
+  for (int i = 0; i < num_frames; ++i, in += 8, out += 2) {
+    out[0] = in[0] + k3dB * (in[2] + in[4] + in[6]);
+    out[1] = in[1] + k3dB * (in[2] + in[5] + in[7]);
+  }
+}
+
+#if defined(SV_HAVE_NEON)
+
+void MonoToStereo(const float* in, float* out, int num_frames) {
+  int i = 0;
+  for (; i + 4 <= num_frames; i += 4) {
+    const float32x4_t mono = vld1q_f32(in + i);
+    float32x4x2_t stereo;
+    stereo.val[0] = mono;
+    stereo.val[1] = mono;
+    vst2q_f32(out + 2 * i, stereo);
+  }
+  MonoToStereoScalar(in + i, out + 2 * i, num_frames - i);
+}
+
+void StereoToMono(const float* in, float* out, int num_frames) {
+  int i = 0;
+  for (; i + 4 <= num_frames; i += 4) {
+    const float32x4x2_t stereo = vld2q_f32(in + 2 * i);
+    vst1q_f32(out + i, vmulq_n_f32(vaddq_f32(stereo.val[0], stereo.val[1]), 0.5f));
+  }
+  StereoToMonoScalar(in + 2 * i, out + i, num_frames - i);
+}
+
+void Surround51ToStereo(const float* in, float* out, int num_frames) {
+  for (int i = 0; i < num_frames; ++i, in += 6, out += 2) {
+    const float32x2_t front = vld1_f32(in);
+    const float32x2_t back = vld1_f32(in + 4);
+    const float32x2_t surround = vadd_f32(vdup_n_f32(in[2]), back);
+    vst1_f32(out, vmla_n_f32(front, surround, k3dB));
+  }
+}
+
+void Surround71ToStereo(const float* in, float* out, int num_frames) {
+  for (int i = 0; i < num_frames; ++i, in += 8, out += 2) {
+    const float32x2_t front = vld1_f32(in);
+    const float32x2_t surround = vadd_f32(vadd_f32(vdup_n_f32(in[2]), vld1_f32(in + 4)), vld1_f32(in + 6));
+    vst1_f32(out, vmla_n_f32(front, surround, k3dB));
+  }
+}
+
+#elif defined(SV_HAVE_SSE2)
+
+void MonoToStereo(const float* in, float* out, int num_frames) {
+  int i = 0;
+  for (; i + 4 <= num_frames; i += 4) {
+    const __m128 mono = _mm_loadu_ps(in + i);
+    _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(mono, mono));
+    _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(mono, mono));
+  }
+  MonoToStereoScalar(in + i, out + 2 * i, num_frames - i);
+}
+
+void StereoToMono(const float* in, float* out, int num_frames) {
+  const __m128 half = _mm_set1_ps(0.5f);
+  int i = 0;
+  for (; i + 4 <= num_frames; i += 4) {
+    const __m128 a = _mm_loadu_ps(in + 2 * i);
+    const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+    const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+  }
+  StereoToMonoScalar(in + 2 * i, out + i, num_frames - i);
+}
+
+// Two frames per iteration, output [L0 R0 L1 R1].
+void Surround51ToStereo(const float* in, float* out, int num_frames) {
+  const __m128 gain = _mm_set1_ps(k3dB);
+  int i = 0;
+  for (; i + 2 <= num_frames; i += 2) {
+    const float* frames = in + 6 * i;
+    const __m128 a = _mm_loadu_ps(frames);      // FL0 FR0 FC0 LFE0
+    const __m128 b = _mm_loadu_ps(frames + 4);  // BL0 BR0 FL1 FR1
+    const __m128 c = _mm_loadu_ps(frames + 8);  // FC1 LFE1 BL1 BR1
+    const __m128 front = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 2, 1, 0));
+    const __m128 center = _mm_shuffle_ps(a, c, _MM_SHUFFLE(0, 0, 2, 2));
+    const __m128 back = _mm_shuffle_ps(b, c, _MM_SHUFFLE(3, 2, 1, 0));
+    _mm_storeu_ps(out + 2 * i, _mm_add_ps(front, _mm_mul_ps(_mm_add_ps(center, back), gain)));
+  }
+  Surround51ToStereoScalar(in + 6 * i, out + 2 * i, num_frames - i);
+}
+
+void Surround71ToStereo(const float* in, float* out, int num_frames) {
+  const __m128 gain = _mm_set1_ps(k3dB);
+  int i = 0;
+  for (; i + 2 <= num_frames; i += 2) {
+    const float* frames = in + 8 * i;
+    const __m128 a0 = _mm_loadu_ps(frames);       // FL FR FC LFE of frame 0
+    const __m128 b0 = _mm_loadu_ps(frames + 4);   // BL BR SL SR of frame 0
+    const __m128 a1 = _mm_loadu_ps(frames + 8);
+    const __m128 b1 = _mm_loadu_ps(frames + 12);
+    const __m128 front = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m128 center = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 2, 2, 2));
+    const __m128 back = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m128 side = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m128 surround = _mm_add_ps(_mm_add_ps(center, back), side);
+    _mm_storeu_ps(out + 2 * i, _mm_add_ps(front, _mm_mul_ps(surround, gain)));
+  }
+  Surround71ToStereoScalar(in + 8 * i, out + 2 * i, num_frames - i);
+}
+
+#else
+
+void MonoToStereo(const float* in, float* out, int num_frames) {
+  MonoToStereoScalar(in, out, num_frames);
+}
+
+void StereoToMono(const float* in, float* out, int num_frames) {
+  StereoToMonoScalar(in, out, num_frames);
+}
+
+void Surround51ToStereo(const float* in, float* out, int num_frames) {
+  Surround51ToStereoScalar(in, out, num_frames);
+}
+
+void Surround71ToStereo(const float* in, float* out, int num_frames) {
+  Surround71ToStereoScalar(in, out, num_frames);
+}
+
+#endif
+
+} // namespace
+
+SVChannelConverter::SVChannelConverter(int input_channels, int output_channels)
+  : input_channels_(input_channels),
+  output_channels_(output_channels) {
+  BuildDefaultMatrix();
+}
+
+void SVChannelConverter::BuildDefaultMatrix() {
+  const int in = input_channels_;
+  const int out = output_channels_;
+  matrix_.assign(out * in, 0.0f);
+  auto gain = [this, in](int output, int input) -> float& { return matrix_[output * in + input]; };
+
+  if (in == out) {
+    kernel_ = Kernel::kCopy;
+    for (int ch = 0; ch < in; ++ch) gain(ch, ch) = 1.0f;
+  } else if (in == 1) {
+    // Mono feeds both fronts, or the only channel.
+    kernel_ = out == 2 ? Kernel::kMonoToStereo : Kernel::kMatrix;
+    for (int ch = 0; ch < std::min(out, 2); ++ch) gain(ch, 0) = 1.0f;
+  } else if (in == 2 && out == 1) {
+    kernel_ = Kernel::kStereoToMono;
+    gain(0, 0) = 0.5f;
+    gain(0, 1) = 0.5f;
+  } else if ((in == 6 || in == 8) && out <= 2) {
+    kernel_ = out == 2 ? (in == 6 ? Kernel::kSurround51ToStereo : Kernel::kSurround71ToStereo) : Kernel::kMatrix;
+    // Stereo downmix, folded to mono at half gain when needed.
+    const float scale = out == 1 ? 0.5f : 1.0f;
+    for (int side = 0; side < 2; ++side) {
+      const int row = out == 1 ? 0 : side;
+      gain(row, side) += scale;
+      gain(row, 2) += scale * k3dB;
+      gain(row, 4 + side) += scale * k3dB;
+      if (in == 8) gain(row, 6 + side) += scale * k3dB;
+    }
+  } else {
+    // Unknown pairing: keep the channels both layouts have.
+    kernel_ = Kernel::kMatrix;
+    for (int ch = 0; ch < std::min(in, out); ++ch) gain(ch, ch) = 1.0f;
+  }
+
+  UpdateClip();
+}
+
+void SVChannelConverter::UpdateClip() {
+  clip_ = false;
+  for (int o = 0; o < output_channels_; ++o) {
+    float sum = 0.0f;
+    for (int i = 0; i < input_channels_; ++i) sum += std::fabs(matrix_[o * input_channels_ + i]);
+    clip_ = clip_ || sum > 1.0001f;
+  }
+}
+
+void SVChannelConverter::SetMatrix(const std::vector<float>& matrix) {
+  if (matrix.size() != static_cast<size_t>(input_channels_ * output_channels_)) {
+    return;
+  }
+  matrix_ = matrix;
+  kernel_ = Kernel::kMatrix;
+  UpdateClip();
+}
+
+void SVChannelConverter::Process(const float* input, float* output, int num_frames) const {
+  switch (kernel_) {
+    case Kernel::kCopy:
+      memcpy(output, input, num_frames * input_channels_ * sizeof(float));
+      return;
+    case Kernel::kMonoToStereo:
+      MonoToStereo(input, output, num_frames);
+      return;
+    case Kernel::kStereoToMono:
+      StereoToMono(input, output, num_frames);
+      return;
+    case Kernel::kSurround51ToStereo:
+      Surround51ToStereo(input, output, num_frames);
+      break;
+    case Kernel::kSurround71ToStereo:
+      Surround71ToStereo(input, output, num_frames);
+      break;
+    case Kernel::kMatrix:
+      ProcessMatrix(input, output, num_frames);
+      return;
+  }
+  // The downmix kernels sum up to four channels.
+  SVClip(output, num_frames * output_channels_);
+}
+
+void SVChannelConverter::ProcessMatrix(const float* input, float* output, int num_frames) const {
+  const int in = input_channels_;
+  const int out = output_channels_;
+  for (int frame = 0; frame < num_frames; ++frame, input += in, output += out) {
+    for (int o = 0; o < out; ++o) {
+      const float* row = &matrix_[o * in];
+      float sum = 0.0f;
+      for (int i = 0; i < in; ++i) {
+        sum += row[i] * input[i];
+      }
+      output[o] = clip_ ? std::min(1.0f, std::max(-1.0f, sum)) : sum;
+    }
+  }
+}
+
+} // sv_render
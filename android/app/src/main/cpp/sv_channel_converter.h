@@ -0,0 +1,48 @@
+#ifndef AUDIO_PLAYOUT_SV_CHANNEL_CONVERTER_H
+#define AUDIO_PLAYOUT_SV_CHANNEL_CONVERTER_H
+
+#include <vector>
+
+namespace sv_render {
+
+// Converts interleaved float frames between channel layouts. Channel counts
+// map to the Android canonical orders: 1 mono, 2 FL FR, 6 (5.1) FL FR FC LFE
+// BL BR, 8 (7.1) FL FR FC LFE BL BR SL SR. Mono<->stereo and 5.1/7.1->stereo
+// run NEON/SSE2 kernels; anything else goes through a remap matrix.
+class SVChannelConverter {
+
+public:
+  // -3 dB, the ITU-R BS.775 weight of center and surround in a stereo downmix.
+  static constexpr float kMinus3dB = 0.70710678f;
+
+  SVChannelConverter(int input_channels, int output_channels);
+
+  // Replaces the default layout conversion with an output x input matrix,
+  // row major: out[o] = sum(matrix[o * input_channels + i] * in[i]).
+  void SetMatrix(const std::vector<float>& matrix);
+
+  void Process(const float* input, float* output, int num_frames) const;
+  // The matrix path, whatever the layouts. Reference for the benchmarks.
+  void ProcessMatrix(const float* input, float* output, int num_frames) const;
+
+  int input_channels() const { return input_channels_; }
+  int output_channels() const { return output_channels_; }
+
+private:
+  enum class Kernel { kCopy, kMonoToStereo, kStereoToMono, kSurround51ToStereo, kSurround71ToStereo, kMatrix };
+
+  void BuildDefaultMatrix();
+  void UpdateClip();
+
+private:
+  const int input_channels_;
+  const int output_channels_;
+  Kernel kernel_ = Kernel::kMatrix;
+  std::vector<float> matrix_;
+  // A matrix row with gains summing above one can clip.
+  bool clip_ = false;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_CHANNEL_CONVERTER_H
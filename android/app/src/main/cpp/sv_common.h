@@ -3,13 +3,34 @@
 
 #include <cstdint>
 #include <memory>
+#include "sv_gain_stage.h"
+#include "sv_render_stats.h"
+#include "sv_stream_control.h"
+
 namespace sv_render {
 
 enum SV_RENDER_TYPE: int16_t {
     UNDEFINED,
     OPENSL,
     AAUDIO,
-    OBOE
+    OBOE,
+    VIRTUAL_DEVICE
+};
+
+enum SV_SAMPLE_FORMAT: int16_t {
+    SV_SAMPLE_FORMAT_I16,
+    SV_SAMPLE_FORMAT_FLOAT
+};
+
+// How AAudio/Oboe streams size their buffer while they run, see SVLatencyTuner.
+enum SV_LATENCY_POLICY: int16_t {
+    // Keep the size the stream opened with, usually its whole capacity.
+    SV_LATENCY_POLICY_OFF,
+    // Start at one burst and try smaller sizes again soon after an xrun.
+    SV_LATENCY_POLICY_LOWEST,
+    SV_LATENCY_POLICY_BALANCED,
+    // Start at four bursts, grow fast and rarely shrink.
+    SV_LATENCY_POLICY_ROBUST
 };
 
 enum SV_RESULT: int16_t {
@@ -30,9 +51,28 @@ class INativeAudioRender {
 public:
     using Ptr = std::shared_ptr<INativeAudioRender>;
     virtual ~INativeAudioRender() = default;
+    // Control thread, before InitAudioRender(). Sample format the stream is opened with.
+    virtual int SetSampleFormat(SV_SAMPLE_FORMAT format) = 0;
+    // Control thread, before InitAudioRender(). Backends without an
+    // adjustable device buffer ignore it.
+    virtual int SetLatencyPolicy(SV_LATENCY_POLICY policy) { return SV_NO_ERROR; }
+    // Control calls may come from several threads, each moves the stream
+    // through SVStreamControl and fails with SV_PLAY_STATE_ERROR if another
+    // call holds it or it is in the wrong state.
     virtual int InitAudioRender(int sample_rate, int channels) = 0;
+    // The stream fades in on start, and stop returns once the fade-out was
+    // rendered, see SVGainStage.
     virtual int StartPlayout() = 0;
     virtual int StopPlayout() = 0;
+    // The stream keeps running silent and the source keeps its position.
+    // Pause returns once the fade-out was rendered, resume fades back in.
+    virtual int PausePlayout() = 0;
+    virtual int ResumePlayout() = 0;
+    // Any thread but the callback's. Stream gain, reached over ramp_ms without
+    // clicks; it holds across stop and start.
+    virtual int SetGain(float gain, int ramp_ms, SVGainCurve curve) = 0;
+    // Control thread. Snapshot of the callback counters plus what the device reports.
+    virtual int GetStats(SVRenderStatsSnapshot* stats) = 0;
 };
 
 }
@@ -0,0 +1,208 @@
+#include "sv_converting_pcm_source.h"
+#include "log.h"
+#include <algorithm>
+
+namespace sv_render {
+
+// Odr-used by std::min, C++14 still needs the definition.
+constexpr int SVConvertingPcmSource::kChunkFrames;
+
+SVConvertingPcmSource::SVConvertingPcmSource(IPcmSource::Ptr source, SVResamplerQuality quality)
+  : source_(std::move(source)),
+  quality_(quality) {
+}
+
+bool SVConvertingPcmSource::Prepare(int sample_rate, int channels) {
+  if (!source_ || sample_rate <= 0 || channels <= 0) {
+    return false;
+  }
+  const int source_rate = source_sample_rate_ > 0 ? source_sample_rate_ : sample_rate;
+  const int source_channels = source_channels_ > 0 ? source_channels_ : channels;
+  if (!source_->Prepare(source_rate, source_channels)) {
+    return false;
+  }
+  source_rate_ = source_rate;
+  stream_rate_ = sample_rate;
+  channels_ = channels;
+  flushed_ = false;
+  drained_ = false;
+  dither_.Reset(1);
+  converter_.reset();
+  if (source_channels != channels) {
+    AV_LOGI("SVConvertingPcmSource content %d channels, stream %d.", source_channels, channels);
+    converter_.reset(new SVChannelConverter(source_channels, channels));
+  }
+  input_pcm_.assign(kChunkFrames * source_channels, 0);
+  source_float_.assign(kChunkFrames * source_channels, 0.0f);
+  input_float_.assign(kChunkFrames * channels, 0.0f);
+  output_float_.assign(kChunkFrames * channels, 0.0f);
+  drift_correction_ = false;
+  device_latency_s_ = 0.0;
+  if (drift_target_ms_ > 0) {
+    if (source_->QueuedFrames() >= 0) {
+      AV_LOGI("SVConvertingPcmSource drift correction, latency %d ms.", drift_target_ms_);
+      drift_correction_ = true;
+      drift_estimator_.Reset(drift_target_ms_ / 1000.0);
+    } else {
+      AV_LOGW("SVConvertingPcmSource no drift correction, not a live source.");
+    }
+  }
+  if (source_rate == sample_rate && !drift_correction_) {
+    resampler_.reset();
+    return true;
+  }
+
+  AV_LOGI("SVConvertingPcmSource content %d Hz, stream %d Hz.", source_rate, sample_rate);
+  resampler_.reset(new SVPolyphaseResampler(channels, quality_));
+  resampler_->SetRates(source_rate, sample_rate);
+  return true;
+}
+
+bool SVConvertingPcmSource::SetStreamSampleRate(int sample_rate) {
+  if (source_rate_ <= 0 || sample_rate <= 0) {
+    return false;
+  }
+  stream_rate_ = sample_rate;
+  if (resampler_) {
+    // Even at the content rate, the buffered input stays in the filter.
+    resampler_->SetOutputRate(sample_rate);
+    return true;
+  }
+  if (sample_rate != source_rate_) {
+    AV_LOGI("SVConvertingPcmSource content %d Hz, stream now %d Hz.", source_rate_, sample_rate);
+    resampler_.reset(new SVPolyphaseResampler(channels_, quality_));
+    resampler_->SetRates(source_rate_, sample_rate);
+  }
+  return true;
+}
+
+void SVConvertingPcmSource::SkipDither(int64_t renders, int frames_per_render) {
+  // Render() dithers a chunk at a time, each from a fresh group of four.
+  uint64_t draws = 0;
+  for (int done = 0; done < frames_per_render; done += kChunkFrames) {
+    const int frames = std::min(frames_per_render - done, kChunkFrames);
+    draws += (frames * channels_ + 3) / 4;
+  }
+  dither_.Skip(draws * static_cast<uint64_t>(renders));
+}
+
+void SVConvertingPcmSource::SetDeviceLatency(double seconds) {
+  device_latency_s_ = seconds;
+  source_->SetDeviceLatency(seconds);
+}
+
+void SVConvertingPcmSource::Release() {
+  if (source_) source_->Release();
+}
+
+bool SVConvertingPcmSource::CanAcquire() const {
+  return !resampler_ && !converter_ && source_->CanAcquire();
+}
+
+int SVConvertingPcmSource::Acquire(int num_frames, const int16_t** data) {
+  return source_->Acquire(num_frames, data);
+}
+
+bool SVConvertingPcmSource::IsEnd() const {
+  return resampler_ ? drained_ : source_->IsEnd();
+}
+
+int SVConvertingPcmSource::Render(int16_t* dst, int num_frames) {
+  if (!resampler_ && !converter_ && !source_->CanRenderFloat()) {
+    return source_->Render(dst, num_frames);
+  }
+  int rendered = 0;
+  while (rendered < num_frames) {
+    const int wanted = std::min(num_frames - rendered, kChunkFrames);
+    const int frames = ProduceFloat(output_float_.data(), wanted);
+    if (dither_enabled_) {
+      SVFloatToInt16Dithered(output_float_.data(), dst + rendered * channels_, frames * channels_, &dither_);
+    } else {
+      SVFloatToInt16(output_float_.data(), dst + rendered * channels_, frames * channels_);
+    }
+    rendered += frames;
+    if (frames < wanted) break;
+  }
+  return rendered;
+}
+
+int SVConvertingPcmSource::RenderFloat(float* dst, int num_frames) {
+  return ProduceFloat(dst, num_frames);
+}
+
+int SVConvertingPcmSource::ReadSource(float* dst, int num_frames) {
+  // Source layout lands in dst directly unless it still has to be remapped.
+  float* source_dst = converter_ ? source_float_.data() : dst;
+  int frames = 0;
+  if (source_->CanRenderFloat()) {
+    frames = source_->RenderFloat(source_dst, num_frames);
+  } else {
+    frames = source_->Render(input_pcm_.data(), num_frames);
+    const int source_channels = converter_ ? converter_->input_channels() : channels_;
+    SVInt16ToFloat(input_pcm_.data(), source_dst, frames * source_channels);
+  }
+  if (converter_) {
+    converter_->Process(source_dst, dst, frames);
+  }
+  return frames;
+}
+
+int SVConvertingPcmSource::ProduceFloat(float* dst, int num_frames) {
+  int rendered = 0;
+  if (!resampler_) {
+    while (rendered < num_frames) {
+      const int wanted = std::min(num_frames - rendered, kChunkFrames);
+      const int frames = ReadSource(dst + rendered * channels_, wanted);
+      rendered += frames;
+      if (frames < wanted) break;
+    }
+    return rendered;
+  }
+  if (drift_correction_) {
+    CorrectDrift(num_frames);
+  }
+  while (rendered < num_frames) {
+    const int frames = resampler_->Pull(dst + rendered * channels_, num_frames - rendered);
+    if (frames == 0 && !FillResampler(num_frames - rendered)) break;
+    rendered += frames;
+  }
+  return rendered;
+}
+
+void SVConvertingPcmSource::CorrectDrift(int output_frames) {
+  const int64_t queued = source_->QueuedFrames();
+  if (queued < 0) {
+    return;
+  }
+  // Content waiting at the source rate, then in the device at the stream's.
+  const double latency_s = (queued + resampler_->buffered_input_frames()) / source_rate_ + device_latency_s_;
+  const double ratio = drift_estimator_.Update(static_cast<double>(output_frames) / stream_rate_, latency_s);
+  resampler_->SetStepScale(ratio);
+}
+
+bool SVConvertingPcmSource::FillResampler(int output_frames) {
+  const int needed = std::max(1, resampler_->InputFramesNeeded(output_frames));
+  const int frames = std::min(std::min(needed, kChunkFrames), resampler_->InputFramesFree());
+  if (frames <= 0) {
+    return false;
+  }
+  const int read = ReadSource(input_float_.data(), frames);
+  if (read > 0) {
+    resampler_->Push(input_float_.data(), read);
+    return true;
+  }
+  if (!source_->IsEnd()) {
+    // Source underrun, try again on the next callback.
+    return false;
+  }
+  if (!flushed_) {
+    // Push silence through the filter so the tail of the content comes out.
+    resampler_->Flush();
+    flushed_ = true;
+    return true;
+  }
+  drained_ = true;
+  return false;
+}
+
+} // sv_render
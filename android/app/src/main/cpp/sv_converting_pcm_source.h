@@ -0,0 +1,111 @@
+#ifndef AUDIO_PLAYOUT_SV_CONVERTING_PCM_SOURCE_H
+#define AUDIO_PLAYOUT_SV_CONVERTING_PCM_SOURCE_H
+
+#include "sv_channel_converter.h"
+#include "sv_drift_estimator.h"
+#include "sv_pcm_source.h"
+#include "sv_resampler.h"
+#include "sv_sample_convert.h"
+#include <memory>
+#include <vector>
+
+namespace sv_render {
+
+// Wraps the content source of a backend and serves it at the rate, channel
+// layout and sample format the stream was opened with, so backends can always
+// open the device in its native configuration. Processing runs in float32;
+// int16 content that needs no conversion passes straight through, including
+// the zero-copy Acquire() path.
+class SVConvertingPcmSource : public IPcmSource {
+
+public:
+  explicit SVConvertingPcmSource(IPcmSource::Ptr source,
+                                 SVResamplerQuality quality = SVResamplerQuality::kMedium);
+  ~SVConvertingPcmSource() override = default;
+
+  // Control thread, before Prepare(). Rate the wrapped source produces, 0
+  // means the same rate the stream runs at.
+  void SetSourceSampleRate(int sample_rate) { source_sample_rate_ = sample_rate; }
+  // Same for the channel count, the layout is remapped ahead of resampling.
+  void SetSourceChannels(int channels) { source_channels_ = channels; }
+  // Control thread. TPDF dither when float content is requantized to int16,
+  // on by default.
+  void SetDither(bool enabled) { dither_enabled_ = enabled; }
+  // Control thread, after Prepare(). Moves the dither on as if renders
+  // Render() calls of frames_per_render frames had run, so a stream rendered
+  // in pieces from seeks, see SVOfflineRender, gets the noise of the whole.
+  void SkipDither(int64_t renders, int frames_per_render);
+  // Control thread, before Prepare(). For a live source, see QueuedFrames():
+  // holds the latency from its producer to the speaker at target_ms by
+  // nudging the resampling ratio against clock drift, so the stream is
+  // resampled even at the content rate. 0, the default, plays the content
+  // at its nominal rate.
+  void SetDriftCorrection(int target_ms) { drift_target_ms_ = target_ms; }
+
+  // Stream rate and layout; the wrapped source is prepared with its own.
+  bool Prepare(int sample_rate, int channels) override;
+  // Control thread, while no callback runs. Moves a prepared stream to a new
+  // rate, when it was reopened on a device running at another one. The
+  // wrapped source and the input the resampler holds are kept, so the
+  // content goes on from the frame it got to.
+  bool SetStreamSampleRate(int sample_rate);
+  void Release() override;
+  int Render(int16_t* dst, int num_frames) override;
+  bool IsEnd() const override;
+  bool CanAcquire() const override;
+  int Acquire(int num_frames, const int16_t** data) override;
+  bool CanRenderFloat() const override { return true; }
+  int RenderFloat(float* dst, int num_frames) override;
+  // Forwarded, frame counts in the wrapped source's rate. The wrapped source
+  // crossfades, the converters just keep running across the jump.
+  bool CanSeek() const override { return source_->CanSeek(); }
+  bool Seek(int64_t frame) override { return source_->Seek(frame); }
+  void SetDeviceLatency(double seconds) override;
+
+  // Any thread. Latency and correction of a drift-corrected source.
+  const SVDriftEstimator& drift_estimator() const { return drift_estimator_; }
+
+private:
+  // Float frames of the wrapped source at its own rate.
+  int ReadSource(float* dst, int num_frames);
+  // Float frames at the stream rate.
+  int ProduceFloat(float* dst, int num_frames);
+  bool FillResampler(int output_frames);
+  // Audio thread. Measures the latency ahead of the next output_frames and
+  // sets the resampling ratio from it.
+  void CorrectDrift(int output_frames);
+
+private:
+  // Frames converted per pass through the scratch buffers.
+  static constexpr int kChunkFrames = 512;
+
+  const IPcmSource::Ptr source_;
+  const SVResamplerQuality quality_;
+  int source_sample_rate_ = 0;
+  int source_channels_ = 0;
+  // Rates the wrapped source and the stream were prepared with.
+  int source_rate_ = 0;
+  int stream_rate_ = 0;
+  int channels_ = 0;
+  std::unique_ptr<SVChannelConverter> converter_;
+  bool dither_enabled_ = true;
+  SVDither dither_;
+  std::unique_ptr<SVPolyphaseResampler> resampler_;
+  // Source layout.
+  std::vector<int16_t> input_pcm_;
+  std::vector<float> source_float_;
+  // Stream layout.
+  std::vector<float> input_float_;
+  std::vector<float> output_float_;
+  bool flushed_ = false;
+  bool drained_ = false;
+  int drift_target_ms_ = 0;
+  bool drift_correction_ = false;
+  // Audio thread, from SetDeviceLatency().
+  double device_latency_s_ = 0.0;
+  SVDriftEstimator drift_estimator_;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_CONVERTING_PCM_SOURCE_H
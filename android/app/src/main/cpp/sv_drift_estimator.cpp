@@ -0,0 +1,76 @@
+#include "sv_drift_estimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace sv_render {
+
+namespace {
+
+// Latency low-pass, seconds. Long against 10 ms producer chunks and device
+// bursts, short against the loop below.
+constexpr double kFilterTimeS = 1.0;
+// PI gains on the latency error, per second and per second squared: a loop
+// of about 0.05 rad/s, damped 0.7. A 500 ppm drift then moves the latency by
+// well under 10 ms before the integral has caught up with it.
+constexpr double kProportionalGain = 0.07;
+constexpr double kIntegralGain = 0.0025;
+
+} // namespace
+
+void SVDriftEstimator::Reset(double target_latency_s) {
+  target_latency_s_ = target_latency_s;
+  primed_ = false;
+  filtered_s_ = 0.0;
+  integral_ = 0.0;
+  latency_s_.store(-1.0, std::memory_order_relaxed);
+  correction_ppm_.store(0.0, std::memory_order_relaxed);
+  drift_ppm_.store(0.0, std::memory_order_relaxed);
+}
+
+double SVDriftEstimator::Update(double elapsed_s, double latency_s) {
+  if (!primed_) {
+    filtered_s_ = latency_s;
+    primed_ = true;
+  } else if (elapsed_s > 0.0) {
+    filtered_s_ += (latency_s - filtered_s_) * elapsed_s / (kFilterTimeS + elapsed_s);
+  }
+  const double max_correction = kMaxCorrectionPpm * 1e-6;
+  const double error = filtered_s_ - target_latency_s_;
+  // While a large error is worked off at the maximum rate the integral
+  // holds, so it doesn't wind up and overshoot once the error is gone.
+  const double integral = integral_ + kIntegralGain * error * elapsed_s;
+  if (std::fabs(kProportionalGain * error + integral) <= max_correction) {
+    integral_ = integral;
+  }
+  const double correction = std::max(-max_correction,
+                                     std::min(max_correction, kProportionalGain * error + integral_));
+
+  latency_s_.store(filtered_s_, std::memory_order_relaxed);
+  correction_ppm_.store(correction * 1e6, std::memory_order_relaxed);
+  drift_ppm_.store(integral_ * 1e6, std::memory_order_relaxed);
+  return 1.0 + correction;
+}
+
+void SVDeviceTimestamp::Update(const void* stream, int64_t now_ns, bool ok, int64_t position, int64_t time_ns) {
+  if (stream != stream_) {
+    // Frame positions of another stream mean nothing for this one.
+    stream_ = stream;
+    valid_ = false;
+  }
+  read_ns_ = now_ns;
+  if (ok) {
+    valid_ = true;
+    position_ = position;
+    time_ns_ = time_ns;
+  }
+}
+
+double SVDeviceTimestamp::Latency(int64_t frames_written, int sample_rate, int64_t now_ns) const {
+  if (!valid_ || sample_rate <= 0) {
+    return 0.0;
+  }
+  const double presentation_ns = time_ns_ + (frames_written - position_) * 1e9 / sample_rate;
+  return std::max(0.0, (presentation_ns - now_ns) / 1e9);
+}
+
+} // sv_render
@@ -0,0 +1,80 @@
+#ifndef AUDIO_PLAYOUT_SV_DRIFT_ESTIMATOR_H
+#define AUDIO_PLAYOUT_SV_DRIFT_ESTIMATOR_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace sv_render {
+
+// Holds the latency of a live source at a target while the producer's clock
+// and the device's drift apart, a few hundred ppm for cheap crystals.
+//
+// Each callback measures what is queued between the producer and the
+// speaker: the source's queue, the resampler's input and what the device
+// holds by its timestamps. The level is low-passed over about a second,
+// which hides the sawtooth of producer chunks and device bursts, and a PI
+// controller on its distance from the target nudges the rate the content is
+// consumed at. Its integral settles on the clock drift itself, so once
+// locked the latency stays at the target with no residual error. The
+// correction is bounded to kMaxCorrectionPpm, far below audible pitch.
+class SVDriftEstimator {
+
+public:
+  static constexpr double kMaxCorrectionPpm = 2000.0;
+
+  // Control thread, while no callback runs.
+  void Reset(double target_latency_s);
+
+  // Audio thread, arithmetic only. elapsed_s of stream time since the last
+  // update and the latency measured now. Returns the rate to consume the
+  // content at relative to nominal: above 1 drains a queue that grew.
+  double Update(double elapsed_s, double latency_s);
+
+  double target_latency_s() const { return target_latency_s_; }
+  // Any thread. Filtered latency, -1 before the first update, and the
+  // correction in ppm: what is applied, and the drift it converged on.
+  double latency_s() const { return latency_s_.load(std::memory_order_relaxed); }
+  double correction_ppm() const { return correction_ppm_.load(std::memory_order_relaxed); }
+  double drift_ppm() const { return drift_ppm_.load(std::memory_order_relaxed); }
+
+private:
+  double target_latency_s_ = 0.0;
+  // Audio thread.
+  bool primed_ = false;
+  double filtered_s_ = 0.0;
+  double integral_ = 0.0;
+  std::atomic<double> latency_s_ { -1.0 };
+  std::atomic<double> correction_ppm_ { 0.0 };
+  std::atomic<double> drift_ppm_ { 0.0 };
+};
+
+// Audio thread. How long a frame the stream writes now waits in the device,
+// from the device's presentation timestamps: the frame it presented at a
+// given time, extrapolated to the frames written since. Reading a timestamp
+// can reach into the audio server, so Due() asks for one at most every
+// kReadIntervalNs, and at once for a stream it hasn't seen, e.g. one a
+// recovery reopened.
+class SVDeviceTimestamp {
+
+public:
+  static constexpr int64_t kReadIntervalNs = 100000000;
+
+  bool Due(const void* stream, int64_t now_ns) const {
+    return stream != stream_ || now_ns - read_ns_ >= kReadIntervalNs;
+  }
+  // The result of a read, ok false if the device had no timestamp yet.
+  void Update(const void* stream, int64_t now_ns, bool ok, int64_t position, int64_t time_ns);
+  // Seconds, 0 until a read succeeded.
+  double Latency(int64_t frames_written, int sample_rate, int64_t now_ns) const;
+
+private:
+  const void* stream_ = nullptr;
+  int64_t read_ns_ = 0;
+  bool valid_ = false;
+  int64_t position_ = 0;
+  int64_t time_ns_ = 0;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_DRIFT_ESTIMATOR_H
@@ -0,0 +1,151 @@
+// Host test for SVDriftEstimator: a simulated live stream, a producer
+// pushing 10 ms chunks on its clock and a device pulling bursts on another,
+// both off nominal, drives Update() with the queue's fill level, and the
+// estimator has to lock onto the clock drift and hold the latency at its
+// target. Exits 1 if any check failed.
+#include "sv_drift_estimator.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace sv_render;
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr int kBurstFrames = 192;
+constexpr int kChunkFrames = 480;
+constexpr double kTargetS = 0.1;
+// What the device holds on top of the queue, counted in the latency.
+constexpr double kDeviceLatencyS = 0.02;
+
+int failures = 0;
+
+#define EXPECT_NEAR(actual, expected, tolerance)                                                         \
+  do {                                                                                                   \
+    const double actual_value = (actual);                                                                \
+    const double expected_value = (expected);                                                            \
+    if (!(std::fabs(actual_value - expected_value) <= (tolerance))) {                                    \
+      fprintf(stderr, "%s:%d: %s is %.3f, expected %.3f +- %.3f\n", __FILE__, __LINE__, #actual,         \
+              actual_value, expected_value, static_cast<double>(tolerance));                             \
+      ++failures;                                                                                        \
+    }                                                                                                    \
+  } while (0)
+
+#define EXPECT_TRUE(condition)                                                                           \
+  do {                                                                                                   \
+    if (!(condition)) {                                                                                  \
+      fprintf(stderr, "%s:%d: %s is false\n", __FILE__, __LINE__, #condition);                           \
+      ++failures;                                                                                        \
+    }                                                                                                    \
+  } while (0)
+
+constexpr double kSettleS = 5.0;
+// The producer's chunks beat against the device's bursts at the skew, every
+// 20 ms / skew, and the level a callback sees moves by a few ms with it: the
+// latency and the correction are averaged over several of those periods.
+constexpr double kAverageS = 200.0;
+
+struct Outcome {
+  // Filtered latency and the correction applied, averaged over the last
+  // kAverageS, and the drift estimate once the run ended.
+  double latency_s;
+  double correction_ppm;
+  double drift_ppm;
+  // Largest distance of the filtered latency from the target after the
+  // first kSettleS, and the fewest frames the queue held.
+  double max_error_s;
+  double min_queue_frames;
+};
+
+// Runs seconds of wall clock. The producer's clock runs producer_ppm fast,
+// the device's device_ppm; the device consumes its bursts at the rate
+// Update() returns, like SVConvertingPcmSource's resampler does.
+Outcome Simulate(double producer_ppm, double device_ppm, double seconds) {
+  SVDriftEstimator estimator;
+  estimator.Reset(kTargetS);
+  const double chunk_period_s = static_cast<double>(kChunkFrames) / kSampleRate / (1.0 + producer_ppm * 1e-6);
+  const double burst_period_s = static_cast<double>(kBurstFrames) / kSampleRate / (1.0 + device_ppm * 1e-6);
+  const double burst_stream_s = static_cast<double>(kBurstFrames) / kSampleRate;
+  // Prerolled to the target, like a live stream's jitter buffer.
+  double queue_frames = (kTargetS - kDeviceLatencyS) * kSampleRate;
+  double next_chunk_s = 0.0;
+  double ratio = 1.0;
+  Outcome outcome {};
+  outcome.min_queue_frames = queue_frames;
+  int averaged = 0;
+  for (double now_s = 0.0; now_s < seconds; now_s += burst_period_s) {
+    while (next_chunk_s <= now_s) {
+      queue_frames += kChunkFrames;
+      next_chunk_s += chunk_period_s;
+    }
+    queue_frames -= kBurstFrames * ratio;
+    outcome.min_queue_frames = std::fmin(outcome.min_queue_frames, queue_frames);
+    ratio = estimator.Update(burst_stream_s, queue_frames / kSampleRate + kDeviceLatencyS);
+    if (now_s > kSettleS) {
+      outcome.max_error_s = std::fmax(outcome.max_error_s, std::fabs(estimator.latency_s() - kTargetS));
+    }
+    if (now_s > seconds - kAverageS) {
+      outcome.latency_s += estimator.latency_s();
+      outcome.correction_ppm += estimator.correction_ppm();
+      ++averaged;
+    }
+  }
+  outcome.latency_s /= averaged;
+  outcome.correction_ppm /= averaged;
+  outcome.drift_ppm = estimator.drift_ppm();
+  return outcome;
+}
+
+// Clocks up to 500 ppm apart each way: the drift estimate converges on
+// their ratio, the latency on the target, and the queue never runs dry.
+void TestConvergence(double producer_ppm, double device_ppm) {
+  const Outcome outcome = Simulate(producer_ppm, device_ppm, 600.0);
+  const double expected_ppm = ((1.0 + producer_ppm * 1e-6) / (1.0 + device_ppm * 1e-6) - 1.0) * 1e6;
+  EXPECT_NEAR(outcome.drift_ppm, expected_ppm, 10.0);
+  EXPECT_NEAR(outcome.correction_ppm, expected_ppm, 10.0);
+  EXPECT_NEAR(outcome.latency_s, kTargetS, 0.001);
+  // Within 10 ms on the way there, also at 1000 ppm.
+  EXPECT_NEAR(outcome.max_error_s, 0.0, 0.01);
+  EXPECT_TRUE(outcome.min_queue_frames > 0.0);
+  printf("producer %+5.0f ppm, device %+5.0f ppm: drift %+7.1f ppm (expected %+7.1f), latency %.1f ms, "
+         "max error %.1f ms\n", producer_ppm, device_ppm, outcome.drift_ppm, expected_ppm,
+         outcome.latency_s * 1000.0, outcome.max_error_s * 1000.0);
+}
+
+// A drift past kMaxCorrectionPpm is corrected at the bound and the integral
+// doesn't wind up beyond it.
+void TestSaturation() {
+  const Outcome outcome = Simulate(3000.0, 0.0, 600.0);
+  EXPECT_NEAR(outcome.correction_ppm, SVDriftEstimator::kMaxCorrectionPpm, 1e-6);
+  EXPECT_TRUE(outcome.drift_ppm <= SVDriftEstimator::kMaxCorrectionPpm);
+  printf("producer +3000 ppm: correction %+.1f ppm, drift %+.1f ppm, latency %.1f ms\n", outcome.correction_ppm,
+         outcome.drift_ppm, outcome.latency_s * 1000.0);
+}
+
+void TestReset() {
+  SVDriftEstimator estimator;
+  estimator.Reset(kTargetS);
+  EXPECT_NEAR(estimator.latency_s(), -1.0, 0.0);
+  // The first update primes the filter at what it measured.
+  EXPECT_NEAR(estimator.Update(0.004, kTargetS), 1.0, 0.0);
+  EXPECT_NEAR(estimator.latency_s(), kTargetS, 1e-12);
+  // Above the target it consumes faster, below slower.
+  EXPECT_TRUE(estimator.Update(0.004, kTargetS + 0.5) > 1.0);
+  estimator.Reset(kTargetS);
+  estimator.Update(0.004, kTargetS);
+  EXPECT_TRUE(estimator.Update(0.004, kTargetS - 0.05) < 1.0);
+}
+
+} // namespace
+
+int main() {
+  TestReset();
+  const double skews[][2] = {{0.0, 0.0}, {500.0, -500.0}, {-500.0, 500.0}, {500.0, 0.0}, {0.0, -300.0},
+                             {-250.0, -500.0}};
+  for (const auto& skew : skews) {
+    TestConvergence(skew[0], skew[1]);
+  }
+  TestSaturation();
+  printf("%d failures\n", failures);
+  return failures > 0 ? 1 : 0;
+}
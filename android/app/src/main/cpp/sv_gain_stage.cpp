@@ -0,0 +1,217 @@
+#include "sv_gain_stage.h"
+#include "sv_mix_kernels.h"
+#include "sv_render_stats.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace sv_render {
+
+namespace {
+
+constexpr size_t kCommandCapacity = 64;
+// Underrun edges ramp over this long, short enough not to eat into the content.
+constexpr int kDeclickMs = 2;
+// Exponential ramps from or to silence start or end here, then cut.
+constexpr float kSilenceGain = 0.001f;
+// FadeOut() checks for the end of the fade this often, and gives up once no
+// callback ran for kCallbackStallNanos, or the fade is this late.
+constexpr std::chrono::milliseconds kFadePollInterval { 1 };
+constexpr int64_t kCallbackStallNanos = 100 * 1000000LL;
+constexpr int64_t kFadeSlackNanos = 500 * 1000000LL;
+
+int MsToFrames(int ms, int sample_rate) {
+  return static_cast<int>(static_cast<int64_t>(ms) * sample_rate / 1000);
+}
+
+void ClearBuffer(float* buffer, int samples) {
+  memset(buffer, 0, samples * sizeof(float));
+}
+
+void ClearBuffer(int16_t* buffer, int samples) {
+  memset(buffer, 0, samples * sizeof(int16_t));
+}
+
+float ApplyGainRamp(float* buffer, float gain, float ratio, float step, int num_frames, int channels) {
+  return SVApplyGainRamp(buffer, gain, ratio, step, num_frames, channels);
+}
+
+float ApplyGainRamp(int16_t* buffer, float gain, float ratio, float step, int num_frames, int channels) {
+  return SVApplyGainRampInt16(buffer, gain, ratio, step, num_frames, channels);
+}
+
+} // namespace
+
+SVGainStage::SVGainStage() : commands_(kCommandCapacity) {
+}
+
+void SVGainStage::Prepare(int sample_rate) {
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  sample_rate_ = sample_rate;
+  Command command;
+  while (commands_.Pop(&command)) {
+  }
+  current_volume_ = volume_;
+  fade_level_ = 0.0f;
+  gain_ = 0.0f;
+  target_gain_ = 0.0f;
+  ramp_frames_left_ = 0;
+  declick_frames_ = std::max(MsToFrames(kDeclickMs, sample_rate), 1);
+  silent_edge_ = false;
+  completed_id_.store(next_id_ - 1, std::memory_order_release);
+  last_process_ns_.store(0, std::memory_order_relaxed);
+}
+
+void SVGainStage::Restart(int sample_rate) {
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  sample_rate_ = sample_rate;
+  declick_frames_ = std::max(MsToFrames(kDeclickMs, sample_rate), 1);
+  silent_edge_ = true;
+}
+
+uint64_t SVGainStage::Send(Command::Kind kind, float value, int ramp_ms, SVGainCurve curve) {
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  return SendLocked(kind, value, ramp_ms, curve);
+}
+
+uint64_t SVGainStage::SendLocked(Command::Kind kind, float value, int ramp_ms, SVGainCurve curve) {
+  const Command command {kind, value, MsToFrames(ramp_ms, sample_rate_), curve, next_id_};
+  if (!commands_.Push(command)) {
+    // Only if the callbacks stopped pulling; the change applies at the next
+    // Prepare() either way, as volume_ is kept here.
+    AV_LOGW("gain change dropped, command queue full.");
+    return 0;
+  }
+  return next_id_++;
+}
+
+void SVGainStage::SetGain(float gain, int ramp_ms, SVGainCurve curve) {
+  const float volume = std::max(gain, 0.0f);
+  // Under one lock, so the volume kept is the one queued last.
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  volume_ = volume;
+  SendLocked(Command::kVolume, volume, ramp_ms, curve);
+}
+
+float SVGainStage::gain() const {
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  return volume_;
+}
+
+void SVGainStage::FadeIn() {
+  Send(Command::kFade, 1.0f, fade_ms_, SVGainCurve::kLinear);
+}
+
+bool SVGainStage::FadeOut() {
+  const uint64_t id = Send(Command::kFade, 0.0f, fade_ms_, SVGainCurve::kLinear);
+  if (id == 0) {
+    return false;
+  }
+  const int64_t deadline_ns = SVRenderStats::NowNanos() + fade_ms_ * 1000000LL + kFadeSlackNanos;
+  while (completed_id_.load(std::memory_order_acquire) < id) {
+    const int64_t now_ns = SVRenderStats::NowNanos();
+    const int64_t last_process_ns = last_process_ns_.load(std::memory_order_relaxed);
+    if (last_process_ns == 0 || now_ns - last_process_ns > kCallbackStallNanos || now_ns > deadline_ns) {
+      return false;
+    }
+    std::this_thread::sleep_for(kFadePollInterval);
+  }
+  return true;
+}
+
+void SVGainStage::PopCommands() {
+  Command command;
+  while (commands_.Pop(&command)) {
+    if (command.kind == Command::kVolume) {
+      current_volume_ = command.value;
+    } else {
+      fade_level_ = command.value;
+    }
+    // A change arriving mid-ramp ramps on from wherever the gain got to.
+    StartRamp(command.ramp_frames, command.curve, command.id);
+  }
+}
+
+void SVGainStage::StartRamp(int ramp_frames, SVGainCurve curve, uint64_t id) {
+  // A ramp replaced before it finished is never marked done on its own: ids
+  // grow, so whoever waits on it is released once this one finishes.
+  target_gain_ = current_volume_ * fade_level_;
+  ramp_id_ = id;
+  if (ramp_frames <= 0 || target_gain_ == gain_) {
+    gain_ = target_gain_;
+    ramp_frames_left_ = 0;
+    completed_id_.store(id, std::memory_order_release);
+    return;
+  }
+  ramp_frames_left_ = ramp_frames;
+  if (curve == SVGainCurve::kExponential) {
+    gain_ = std::max(gain_, kSilenceGain);
+    ratio_ = std::pow(std::max(target_gain_, kSilenceGain) / gain_, 1.0f / ramp_frames);
+    step_ = 0.0f;
+  } else {
+    ratio_ = 1.0f;
+    step_ = (target_gain_ - gain_) / ramp_frames;
+  }
+}
+
+bool SVGainStage::Active() {
+  last_process_ns_.store(SVRenderStats::NowNanos(), std::memory_order_relaxed);
+  PopCommands();
+  return ramp_frames_left_ > 0 || gain_ != 1.0f || silent_edge_;
+}
+
+template <typename Sample>
+void SVGainStage::ProcessImpl(Sample* buffer, int num_frames, int rendered_frames, int channels) {
+  last_process_ns_.store(SVRenderStats::NowNanos(), std::memory_order_relaxed);
+  PopCommands();
+
+  // Edges first, on the content as rendered.
+  if (silent_edge_ && rendered_frames > 0) {
+    const int frames = std::min(declick_frames_, rendered_frames);
+    ApplyGainRamp(buffer, 0.0f, 1.0f, 1.0f / frames, frames, channels);
+    silent_edge_ = false;
+  }
+  if (rendered_frames < num_frames && !silent_edge_) {
+    const int frames = std::min(declick_frames_, rendered_frames);
+    if (frames > 0) {
+      ApplyGainRamp(buffer + (rendered_frames - frames) * channels, 1.0f, 1.0f, -1.0f / frames, frames, channels);
+      declicks_.fetch_add(1, std::memory_order_relaxed);
+    }
+    silent_edge_ = true;
+  }
+
+  int frame = 0;
+  if (ramp_frames_left_ > 0) {
+    const int frames = std::min(ramp_frames_left_, num_frames);
+    gain_ = ApplyGainRamp(buffer, gain_, ratio_, step_, frames, channels);
+    ramp_frames_left_ -= frames;
+    frame = frames;
+    if (ramp_frames_left_ == 0) {
+      gain_ = target_gain_;
+      if (fade_level_ == 0.0f) {
+        fades_out_.fetch_add(1, std::memory_order_relaxed);
+      }
+      completed_id_.store(ramp_id_, std::memory_order_release);
+    }
+  }
+  if (frame < num_frames) {
+    if (gain_ == 0.0f) {
+      ClearBuffer(buffer + frame * channels, (num_frames - frame) * channels);
+    } else if (gain_ != 1.0f) {
+      ApplyGainRamp(buffer + frame * channels, gain_, 1.0f, 0.0f, num_frames - frame, channels);
+    }
+  }
+}
+
+void SVGainStage::Process(float* buffer, int num_frames, int rendered_frames, int channels) {
+  ProcessImpl(buffer, num_frames, rendered_frames, channels);
+}
+
+void SVGainStage::Process(int16_t* buffer, int num_frames, int rendered_frames, int channels) {
+  ProcessImpl(buffer, num_frames, rendered_frames, channels);
+}
+
+} // sv_render
@@ -0,0 +1,113 @@
+#ifndef AUDIO_PLAYOUT_SV_GAIN_STAGE_H
+#define AUDIO_PLAYOUT_SV_GAIN_STAGE_H
+
+#include "sv_spsc_queue.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace sv_render {
+
+enum class SVGainCurve {
+  kLinear,
+  // Constant dB per frame, sounds even over long fades. Ramps from or to
+  // silence run through -60 dB.
+  kExponential,
+};
+
+// Per-stream output gain, applied in place to the buffer the callback just
+// rendered, so it costs no copy and, at unity gain, no pass at all.
+//
+// The control thread queues gain changes through an SVSpscQueue, the audio
+// thread picks them up at the start of its next buffer and ramps to the new
+// gain over exactly the frames asked for, carrying the ramp across buffers.
+// The stream gain is the app's volume times a fade level the render drives:
+// FadeIn() on start, FadeOut() on stop, which returns once the callbacks
+// rendered the fade. Independently, the edges where the content runs out on
+// an underrun, and where it comes back, get a short declick ramp.
+class SVGainStage {
+
+public:
+  static constexpr int kDefaultFadeMs = 10;
+
+  SVGainStage();
+
+  // Control thread, while no callback runs. Drops queued changes; the stream
+  // starts silent until FadeIn().
+  void Prepare(int sample_rate);
+  // Control thread, while no callback runs. The stream was reopened at
+  // sample_rate after a disconnect: gain, fade and queued changes carry on,
+  // and the content ramps in from the gap like after an underrun.
+  void Restart(int sample_rate);
+  // Control thread. Start and stop fade over this long, 0 cuts.
+  void set_fade_ms(int fade_ms) { fade_ms_ = fade_ms; }
+  int fade_ms() const { return fade_ms_; }
+
+  // Control thread. App volume, reached over ramp_ms.
+  void SetGain(float gain, int ramp_ms, SVGainCurve curve = SVGainCurve::kLinear);
+  float gain() const;
+  // Control thread. Fades from the current level up to the volume.
+  void FadeIn();
+  // Control thread. Fades to silence and blocks until the callbacks rendered
+  // the fade. False if they stopped pulling buffers before it finished.
+  bool FadeOut();
+
+  // Audio thread. Picks up queued changes; false if Process() would leave
+  // the buffer as is, so zero-copy paths can skip it.
+  bool Active();
+  // Audio thread. Applies the gain to num_frames frames, of which the source
+  // filled rendered_frames and the rest is silence padding.
+  void Process(float* buffer, int num_frames, int rendered_frames, int channels);
+  void Process(int16_t* buffer, int num_frames, int rendered_frames, int channels);
+
+  // Fade-outs that finished rendering, and edges declicked on underrun.
+  uint64_t fades_out() const { return fades_out_.load(std::memory_order_relaxed); }
+  uint64_t declicks() const { return declicks_.load(std::memory_order_relaxed); }
+
+private:
+  struct Command {
+    enum Kind { kVolume, kFade } kind;
+    float value;
+    int ramp_frames;
+    SVGainCurve curve;
+    uint64_t id;
+  };
+
+  uint64_t Send(Command::Kind kind, float value, int ramp_ms, SVGainCurve curve);
+  // With send_mutex_ held.
+  uint64_t SendLocked(Command::Kind kind, float value, int ramp_ms, SVGainCurve curve);
+  void PopCommands();
+  void StartRamp(int ramp_frames, SVGainCurve curve, uint64_t id);
+  template <typename Sample>
+  void ProcessImpl(Sample* buffer, int num_frames, int rendered_frames, int channels);
+
+  // Control side.
+  mutable std::mutex send_mutex_;
+  SVSpscQueue<Command> commands_;
+  int sample_rate_ = 48000;
+  int fade_ms_ = kDefaultFadeMs;
+  float volume_ = 1.0f;
+  uint64_t next_id_ = 1;
+
+  // Audio side.
+  float current_volume_ = 1.0f;
+  float fade_level_ = 0.0f;
+  float gain_ = 0.0f;
+  float target_gain_ = 0.0f;
+  float ratio_ = 1.0f;
+  float step_ = 0.0f;
+  int ramp_frames_left_ = 0;
+  uint64_t ramp_id_ = 0;
+  int declick_frames_ = 0;
+  // The last buffer ended in underrun silence, ramp the content back in.
+  bool silent_edge_ = false;
+
+  std::atomic<uint64_t> completed_id_ { 0 };
+  std::atomic<int64_t> last_process_ns_ { 0 };
+  std::atomic<uint64_t> fades_out_ { 0 };
+  std::atomic<uint64_t> declicks_ { 0 };
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_GAIN_STAGE_H
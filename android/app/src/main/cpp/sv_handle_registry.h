@@ -0,0 +1,160 @@
+#ifndef AUDIO_PLAYOUT_SV_HANDLE_REGISTRY_H
+#define AUDIO_PLAYOUT_SV_HANDLE_REGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace sv_render {
+
+// Owns objects behind 64-bit handles, e.g. one render per handle for the JNI
+// layer. A handle is a slot index plus the slot's generation, so a handle
+// that outlived its object, or a made-up one, just finds nothing.
+//
+// Get() is lock-free: it pins the slot with one atomic increment and checks
+// the generation. Remove() unpublishes the object, then waits for the pins
+// on that one slot to go before destroying it; other handles are never
+// blocked by it.
+template <typename T, int kCapacity = 64>
+class SVHandleRegistry {
+
+  static_assert(kCapacity > 0 && kCapacity <= 0xffff, "slot index is 16 bits");
+
+  struct Slot {
+    std::atomic<bool> claimed { false };
+    // Bumped on every Remove(), starts at 1 so no handle is 0.
+    std::atomic<uint64_t> generation { 1 };
+    std::atomic<T*> object { nullptr };
+    std::atomic<int> pins { 0 };
+  };
+
+public:
+  // Keeps the object alive while held. Move-only, don't keep it across
+  // calls: a Remove() of the same handle waits for it.
+  class Ref {
+
+  public:
+    Ref() = default;
+    Ref(Ref&& other) noexcept : slot_(other.slot_), object_(other.object_) {
+      other.slot_ = nullptr;
+      other.object_ = nullptr;
+    }
+    Ref& operator=(Ref&& other) noexcept {
+      if (this != &other) {
+        Unpin();
+        slot_ = other.slot_;
+        object_ = other.object_;
+        other.slot_ = nullptr;
+        other.object_ = nullptr;
+      }
+      return *this;
+    }
+    Ref(const Ref&) = delete;
+    Ref& operator=(const Ref&) = delete;
+    ~Ref() { Unpin(); }
+
+    T* get() const { return object_; }
+    T* operator->() const { return object_; }
+    T& operator*() const { return *object_; }
+    explicit operator bool() const { return object_ != nullptr; }
+
+  private:
+    friend class SVHandleRegistry;
+    Ref(Slot* slot, T* object) : slot_(slot), object_(object) {}
+    void Unpin() {
+      if (slot_) {
+        slot_->pins.fetch_sub(1, std::memory_order_release);
+      }
+    }
+
+    Slot* slot_ = nullptr;
+    T* object_ = nullptr;
+  };
+
+  SVHandleRegistry() = default;
+  ~SVHandleRegistry() {
+    for (Slot& slot : slots_) {
+      delete slot.object.load();
+    }
+  }
+  SVHandleRegistry(const SVHandleRegistry&) = delete;
+  SVHandleRegistry& operator=(const SVHandleRegistry&) = delete;
+
+  // Takes ownership. Returns its handle, 0 when every slot is taken.
+  int64_t Add(std::unique_ptr<T> object) {
+    for (int index = 0; index < kCapacity; ++index) {
+      Slot& slot = slots_[index];
+      bool expected = false;
+      if (slot.claimed.load(std::memory_order_relaxed) ||
+          !slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        continue;
+      }
+      const uint64_t generation = slot.generation.load();
+      slot.object.store(object.release());
+      size_.fetch_add(1, std::memory_order_relaxed);
+      return static_cast<int64_t>(generation << 16 | static_cast<uint64_t>(index));
+    }
+    return 0;
+  }
+
+  // Any thread, lock-free. An empty Ref if the handle is unknown or removed.
+  Ref Get(int64_t handle) {
+    Slot* slot = Find(handle);
+    if (!slot) {
+      return Ref();
+    }
+    // Pin first, then look: Remove() clears the object first, then waits
+    // for the pins, so whatever is seen here stays alive until unpinned.
+    slot->pins.fetch_add(1);
+    T* object = slot->object.load();
+    if (!object || slot->generation.load() != Generation(handle)) {
+      slot->pins.fetch_sub(1, std::memory_order_release);
+      return Ref();
+    }
+    return Ref(slot, object);
+  }
+
+  // Destroys the object once nobody holds a Ref to it. False if the handle
+  // is unknown or already removed. Must not be called while holding a Ref
+  // to the same handle.
+  bool Remove(int64_t handle) {
+    Slot* slot = Find(handle);
+    if (!slot || slot->generation.load() != Generation(handle)) {
+      return false;
+    }
+    T* object = slot->object.load();
+    if (!object || !slot->object.compare_exchange_strong(object, nullptr)) {
+      return false;
+    }
+    slot->generation.fetch_add(1);
+    while (slot->pins.load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+    }
+    delete object;
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    slot->claimed.store(false, std::memory_order_release);
+    return true;
+  }
+
+  int size() const { return size_.load(std::memory_order_relaxed); }
+  static constexpr int capacity() { return kCapacity; }
+
+private:
+  static uint64_t Generation(int64_t handle) { return static_cast<uint64_t>(handle) >> 16; }
+
+  Slot* Find(int64_t handle) {
+    const int index = static_cast<int>(handle & 0xffff);
+    if (handle <= 0 || index >= kCapacity) {
+      return nullptr;
+    }
+    return &slots_[index];
+  }
+
+  Slot slots_[kCapacity];
+  std::atomic<int> size_ { 0 };
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_HANDLE_REGISTRY_H
@@ -0,0 +1,145 @@
+#include "sv_ima_adpcm.h"
+#include <algorithm>
+#include <cstring>
+
+namespace sv_render {
+
+namespace {
+
+constexpr int kMaxChannels = 8;
+// Header bytes per channel, and bytes per channel in each group of 8 samples.
+constexpr int kHeaderBytes = 4;
+constexpr int kGroupBytes = 4;
+constexpr int kGroupFrames = 8;
+
+const int kIndexTable[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+const int kStepTable[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+  19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+  130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+  337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+  876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+  2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+  5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+  15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+inline int Clamp(int value, int low, int high) {
+  return std::min(high, std::max(low, value));
+}
+
+inline int16_t DecodeNibble(int nibble, int* predictor, int* step_index) {
+  const int step = kStepTable[*step_index];
+  int diff = step >> 3;
+  if (nibble & 1) diff += step >> 2;
+  if (nibble & 2) diff += step >> 1;
+  if (nibble & 4) diff += step;
+  *predictor = Clamp(nibble & 8 ? *predictor - diff : *predictor + diff, -32768, 32767);
+  *step_index = Clamp(*step_index + kIndexTable[nibble], 0, 88);
+  return static_cast<int16_t>(*predictor);
+}
+
+inline int EncodeSample(int sample, int* predictor, int* step_index) {
+  const int step = kStepTable[*step_index];
+  int diff = sample - *predictor;
+  int nibble = 0;
+  if (diff < 0) {
+    nibble = 8;
+    diff = -diff;
+  }
+  // Same successive approximation the decoder undoes.
+  int threshold = step;
+  for (int bit = 4; bit > 0; bit >>= 1) {
+    if (diff >= threshold) {
+      nibble |= bit;
+      diff -= threshold;
+    }
+    threshold >>= 1;
+  }
+  DecodeNibble(nibble, predictor, step_index);
+  return nibble;
+}
+
+} // namespace
+
+int SVImaAdpcmFramesPerBlock(int block_align, int channels) {
+  if (channels <= 0 || block_align < kHeaderBytes * channels) {
+    return 0;
+  }
+  return (block_align - kHeaderBytes * channels) * 2 / channels + 1;
+}
+
+int SVImaAdpcmBlockAlign(int frames_per_block, int channels) {
+  const int groups = (frames_per_block - 1 + kGroupFrames - 1) / kGroupFrames;
+  return (kHeaderBytes + groups * kGroupBytes) * channels;
+}
+
+int SVImaAdpcmDecodeBlock(const uint8_t* block, size_t block_size, int channels, int frames_per_block,
+                          int16_t* dst) {
+  if (channels <= 0 || channels > kMaxChannels || frames_per_block <= 0 ||
+      block_size < static_cast<size_t>(kHeaderBytes * channels)) {
+    return 0;
+  }
+  int predictor[kMaxChannels];
+  int step_index[kMaxChannels];
+  for (int ch = 0; ch < channels; ++ch) {
+    const uint8_t* header = block + kHeaderBytes * ch;
+    predictor[ch] = static_cast<int16_t>(header[0] | (header[1] << 8));
+    step_index[ch] = Clamp(header[2], 0, 88);
+    dst[ch] = static_cast<int16_t>(predictor[ch]);
+  }
+
+  const size_t group_stride = static_cast<size_t>(kGroupBytes) * channels;
+  const size_t groups = (block_size - kHeaderBytes * channels) / group_stride;
+  const int frames = static_cast<int>(std::min<size_t>(frames_per_block, 1 + groups * kGroupFrames));
+  const uint8_t* data = block + kHeaderBytes * channels;
+  for (int frame = 1; frame < frames; frame += kGroupFrames, data += group_stride) {
+    const int group_frames = std::min(kGroupFrames, frames - frame);
+    for (int ch = 0; ch < channels; ++ch) {
+      const uint8_t* bytes = data + kGroupBytes * ch;
+      int16_t* out = dst + frame * channels + ch;
+      for (int i = 0; i < group_frames; ++i) {
+        const int nibble = i & 1 ? bytes[i >> 1] >> 4 : bytes[i >> 1] & 0x0f;
+        out[i * channels] = DecodeNibble(nibble, &predictor[ch], &step_index[ch]);
+      }
+    }
+  }
+  return frames;
+}
+
+void SVImaAdpcmEncodeBlock(const int16_t* src, int num_frames, int channels, int frames_per_block,
+                           SVImaAdpcmEncoder* encoder, uint8_t* block) {
+  memset(block, 0, SVImaAdpcmBlockAlign(frames_per_block, channels));
+  if (num_frames <= 0 || channels > kMaxChannels) {
+    return;
+  }
+  for (int ch = 0; ch < channels; ++ch) {
+    // The header sample restarts the predictor, so blocks decode on their own.
+    encoder->predictor[ch] = src[ch];
+    uint8_t* header = block + kHeaderBytes * ch;
+    header[0] = static_cast<uint8_t>(src[ch] & 0xff);
+    header[1] = static_cast<uint8_t>((src[ch] >> 8) & 0xff);
+    header[2] = static_cast<uint8_t>(encoder->step_index[ch]);
+  }
+
+  const int group_stride = kGroupBytes * channels;
+  uint8_t* data = block + kHeaderBytes * channels;
+  for (int frame = 1; frame < num_frames; frame += kGroupFrames, data += group_stride) {
+    const int group_frames = std::min(kGroupFrames, num_frames - frame);
+    for (int ch = 0; ch < channels; ++ch) {
+      uint8_t* bytes = data + kGroupBytes * ch;
+      for (int i = 0; i < group_frames; ++i) {
+        const int nibble = EncodeSample(src[(frame + i) * channels + ch], &encoder->predictor[ch],
+                                        &encoder->step_index[ch]);
+        bytes[i >> 1] |= static_cast<uint8_t>(i & 1 ? nibble << 4 : nibble);
+      }
+    }
+  }
+}
+
+} // sv_render
@@ -0,0 +1,39 @@
+#ifndef AUDIO_PLAYOUT_SV_IMA_ADPCM_H
+#define AUDIO_PLAYOUT_SV_IMA_ADPCM_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sv_render {
+
+// IMA-ADPCM in the Microsoft WAV block layout (format tag 0x0011): 4 bits per
+// sample, a quarter of the size of PCM16. Every block starts with a 4 byte
+// header per channel (first sample, step index, reserved) followed by groups
+// of 4 bytes per channel, 8 samples each, low nibble first.
+
+// Frames held by a full block of block_align bytes.
+int SVImaAdpcmFramesPerBlock(int block_align, int channels);
+// Bytes needed for a block holding frames_per_block frames.
+int SVImaAdpcmBlockAlign(int frames_per_block, int channels);
+
+// Decodes one block into interleaved int16 frames. A short final block
+// decodes as far as its bytes reach. Returns the number of frames written,
+// at most frames_per_block, 0 if the block is malformed.
+int SVImaAdpcmDecodeBlock(const uint8_t* block, size_t block_size, int channels, int frames_per_block,
+                          int16_t* dst);
+
+// Encoder state carried from block to block, one per channel.
+struct SVImaAdpcmEncoder {
+  int predictor[8] = {};
+  int step_index[8] = {};
+};
+
+// Encodes num_frames (<= frames_per_block) interleaved frames into one block
+// of SVImaAdpcmBlockAlign() bytes, the tail of a short block is zero filled.
+// For preparing assets, not used on the render path.
+void SVImaAdpcmEncodeBlock(const int16_t* src, int num_frames, int channels, int frames_per_block,
+                           SVImaAdpcmEncoder* encoder, uint8_t* block);
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_IMA_ADPCM_H
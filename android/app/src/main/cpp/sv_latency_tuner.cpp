@@ -0,0 +1,81 @@
+#include "sv_latency_tuner.h"
+#include <algorithm>
+
+namespace sv_render {
+
+// Odr-used by std::min, C++14 still needs the definition.
+constexpr int SVLatencyTuner::kMaxBackoff;
+
+SVLatencyTuner::Policy SVLatencyTuner::GetPolicy(SV_LATENCY_POLICY policy) {
+  switch (policy) {
+    case SV_LATENCY_POLICY_LOWEST:
+      return {1, 1, 1, 5000};
+    case SV_LATENCY_POLICY_ROBUST:
+      return {4, 3, 2, 60000};
+    case SV_LATENCY_POLICY_BALANCED:
+    case SV_LATENCY_POLICY_OFF:
+      break;
+  }
+  return {2, 2, 1, 15000};
+}
+
+int SVLatencyTuner::Reset(SV_LATENCY_POLICY policy, int frames_per_burst, int capacity_frames) {
+  policy_ = frames_per_burst > 0 && capacity_frames > 0 ? policy : SV_LATENCY_POLICY_OFF;
+  params_ = GetPolicy(policy);
+  burst_ = frames_per_burst;
+  capacity_ = capacity_frames;
+  started_ = false;
+  backoff_ = 1;
+  shrink_on_trial_ = false;
+  grow_count_.store(0, std::memory_order_relaxed);
+  shrink_count_.store(0, std::memory_order_relaxed);
+  const int size = enabled() ? std::min(params_.start_bursts * burst_, capacity_) : 0;
+  buffer_size_.store(size, std::memory_order_relaxed);
+  return size;
+}
+
+int SVLatencyTuner::Update(int64_t xrun_count, int64_t now_ns) {
+  if (!enabled()) {
+    return 0;
+  }
+  if (!started_) {
+    // Xruns from before the first callback aren't ours to answer.
+    started_ = true;
+    last_xrun_count_ = xrun_count;
+    quiet_since_ns_ = now_ns;
+    return 0;
+  }
+  const int size = buffer_size_.load(std::memory_order_relaxed);
+  if (xrun_count > last_xrun_count_) {
+    last_xrun_count_ = xrun_count;
+    quiet_since_ns_ = now_ns;
+    if (shrink_on_trial_) {
+      // The smaller size didn't hold, wait longer before trying it again.
+      backoff_ = std::min(backoff_ * 2, kMaxBackoff);
+      shrink_on_trial_ = false;
+    }
+    const int grown = std::min(size + params_.grow_bursts * burst_, capacity_);
+    if (grown == size) {
+      return 0;
+    }
+    buffer_size_.store(grown, std::memory_order_relaxed);
+    grow_count_.fetch_add(1, std::memory_order_relaxed);
+    return grown;
+  }
+  const int64_t quiet_ns = params_.quiet_ms * 1000000LL;
+  if (shrink_on_trial_ && now_ns - quiet_since_ns_ >= quiet_ns) {
+    // The last shrink held for a whole quiet period.
+    shrink_on_trial_ = false;
+    backoff_ = std::max(backoff_ / 2, 1);
+  }
+  if (now_ns - quiet_since_ns_ < quiet_ns * backoff_ || size - burst_ < params_.min_bursts * burst_) {
+    return 0;
+  }
+  quiet_since_ns_ = now_ns;
+  shrink_on_trial_ = true;
+  buffer_size_.store(size - burst_, std::memory_order_relaxed);
+  shrink_count_.fetch_add(1, std::memory_order_relaxed);
+  return size - burst_;
+}
+
+} // sv_render
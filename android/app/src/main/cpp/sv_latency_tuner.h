@@ -0,0 +1,65 @@
+#ifndef AUDIO_PLAYOUT_SV_LATENCY_TUNER_H
+#define AUDIO_PLAYOUT_SV_LATENCY_TUNER_H
+
+#include "sv_common.h"
+#include <atomic>
+#include <cstdint>
+
+namespace sv_render {
+
+// Sizes a callback stream's buffer from its xrun count. Starts at a small
+// multiple of the burst, grows as soon as the count rises and gives a burst
+// back after a quiet period. Each shrink that is followed by an xrun within
+// the quiet period doubles the next wait, so the size settles instead of
+// oscillating around the edge.
+//
+// Backend independent: the caller feeds the device's xrun count and clock
+// and applies the sizes it returns.
+class SVLatencyTuner {
+
+public:
+  struct Policy {
+    int start_bursts;
+    int min_bursts;
+    int grow_bursts;
+    int64_t quiet_ms;
+  };
+  static Policy GetPolicy(SV_LATENCY_POLICY policy);
+  // Longest wait before a shrink, in quiet periods.
+  static constexpr int kMaxBackoff = 16;
+
+  // Control thread, once the stream is open. Returns the buffer size to
+  // start with, 0 when the policy is off.
+  int Reset(SV_LATENCY_POLICY policy, int frames_per_burst, int capacity_frames);
+
+  // Audio thread, from the data callback. Returns the new buffer size in
+  // frames when it changes, 0 otherwise. Never blocks or allocates.
+  int Update(int64_t xrun_count, int64_t now_ns);
+
+  // Any thread.
+  bool enabled() const { return policy_ != SV_LATENCY_POLICY_OFF; }
+  int buffer_size() const { return buffer_size_.load(std::memory_order_relaxed); }
+  int64_t grow_count() const { return grow_count_.load(std::memory_order_relaxed); }
+  int64_t shrink_count() const { return shrink_count_.load(std::memory_order_relaxed); }
+
+private:
+  SV_LATENCY_POLICY policy_ = SV_LATENCY_POLICY_OFF;
+  Policy params_ {};
+  int burst_ = 0;
+  int capacity_ = 0;
+  std::atomic<int> buffer_size_ { 0 };
+  std::atomic<int64_t> grow_count_ { 0 };
+  std::atomic<int64_t> shrink_count_ { 0 };
+
+  // Audio thread.
+  bool started_ = false;
+  int64_t last_xrun_count_ = 0;
+  int64_t quiet_since_ns_ = 0;
+  int backoff_ = 1;
+  // The last change was a shrink that hasn't survived a quiet period yet.
+  bool shrink_on_trial_ = false;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_LATENCY_TUNER_H
@@ -0,0 +1,191 @@
+// Host test for SVLatencyTuner: drives Update() with scripted xrun counts and
+// clock readings, no device, and checks the buffer size it returns for each
+// policy. Exits 1 if any check failed.
+#include "sv_latency_tuner.h"
+#include <algorithm>
+#include <cstdio>
+
+using namespace sv_render;
+
+namespace {
+
+constexpr int kBurst = 192;
+constexpr int64_t kNanosPerMs = 1000000;
+
+int failures = 0;
+
+#define EXPECT_EQ(actual, expected)                                                                      \
+  do {                                                                                                   \
+    const long long actual_value = (actual);                                                             \
+    const long long expected_value = (expected);                                                         \
+    if (actual_value != expected_value) {                                                                \
+      fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, actual_value,   \
+              expected_value);                                                                           \
+      ++failures;                                                                                        \
+    }                                                                                                    \
+  } while (0)
+
+const char* PolicyName(SV_LATENCY_POLICY policy) {
+  switch (policy) {
+    case SV_LATENCY_POLICY_LOWEST:
+      return "lowest";
+    case SV_LATENCY_POLICY_BALANCED:
+      return "balanced";
+    case SV_LATENCY_POLICY_ROBUST:
+      return "robust";
+    case SV_LATENCY_POLICY_OFF:
+      break;
+  }
+  return "off";
+}
+
+// A stream's xrun counter and clock, in ms.
+class ScriptedStream {
+
+public:
+  explicit ScriptedStream(SVLatencyTuner* tuner) : tuner_(tuner) {}
+
+  int Callback(int64_t at_ms) {
+    now_ms_ = at_ms;
+    return tuner_->Update(xruns_, now_ms_ * kNanosPerMs);
+  }
+  int Xrun(int64_t at_ms) {
+    ++xruns_;
+    return Callback(at_ms);
+  }
+  int64_t now_ms() const { return now_ms_; }
+
+private:
+  SVLatencyTuner* const tuner_;
+  int64_t xruns_ = 5;
+  int64_t now_ms_ = 1000;
+};
+
+// Grows on every xrun, gives a burst back after a quiet period, and waits
+// twice as long after a shrink that didn't hold, half as long after one that
+// did.
+void TestGrowShrinkBackoff(SV_LATENCY_POLICY policy) {
+  const SVLatencyTuner::Policy params = SVLatencyTuner::GetPolicy(policy);
+  const int64_t quiet = params.quiet_ms;
+  const int grow = params.grow_bursts * kBurst;
+  SVLatencyTuner tuner;
+  ScriptedStream stream(&tuner);
+  int size = tuner.Reset(policy, kBurst, 64 * kBurst);
+  EXPECT_EQ(size, params.start_bursts * kBurst);
+
+  // Xruns from before the first callback are not answered.
+  EXPECT_EQ(stream.Callback(1000), 0);
+  EXPECT_EQ(stream.Callback(1010), 0);
+  EXPECT_EQ(tuner.grow_count(), 0);
+
+  // Each xrun grows at once, back to back.
+  for (int i = 0; i < 8; ++i) {
+    size += grow;
+    EXPECT_EQ(stream.Xrun(stream.now_ms() + 10), size);
+  }
+  EXPECT_EQ(tuner.grow_count(), 8);
+  EXPECT_EQ(tuner.buffer_size(), size);
+
+  // A burst comes back after exactly one quiet period.
+  int64_t last_change = stream.now_ms();
+  EXPECT_EQ(stream.Callback(last_change + quiet - 1), 0);
+  size -= kBurst;
+  EXPECT_EQ(stream.Callback(last_change + quiet), size);
+  EXPECT_EQ(tuner.shrink_count(), 1);
+
+  // An xrun while that shrink is on trial doubles the wait, up to kMaxBackoff
+  // quiet periods.
+  int backoff = 1;
+  for (int i = 0; i < 6; ++i) {
+    backoff = std::min(backoff * 2, SVLatencyTuner::kMaxBackoff);
+    size += grow;
+    EXPECT_EQ(stream.Xrun(stream.now_ms() + quiet / 2), size);
+    last_change = stream.now_ms();
+    EXPECT_EQ(stream.Callback(last_change + quiet), 0);
+    EXPECT_EQ(stream.Callback(last_change + backoff * quiet - 1), 0);
+    size -= kBurst;
+    EXPECT_EQ(stream.Callback(last_change + backoff * quiet), size);
+  }
+  EXPECT_EQ(backoff, SVLatencyTuner::kMaxBackoff);
+
+  // Each shrink that holds for a quiet period halves the wait again; with the
+  // period it held for counted, the next shrink follows after the rest of it.
+  while (backoff > 1) {
+    last_change = stream.now_ms();
+    backoff /= 2;
+    EXPECT_EQ(stream.Callback(last_change + quiet), backoff == 1 ? size - kBurst : 0);
+    if (backoff > 1) {
+      EXPECT_EQ(stream.Callback(last_change + backoff * quiet - 1), 0);
+      EXPECT_EQ(stream.Callback(last_change + backoff * quiet), size - kBurst);
+    }
+    size -= kBurst;
+  }
+  EXPECT_EQ(tuner.buffer_size(), size);
+  EXPECT_EQ(tuner.grow_count(), 14);
+  EXPECT_EQ(tuner.shrink_count(), 11);
+}
+
+// Shrinks stop at min_bursts however long it stays quiet.
+void TestMinFloor(SV_LATENCY_POLICY policy) {
+  const SVLatencyTuner::Policy params = SVLatencyTuner::GetPolicy(policy);
+  SVLatencyTuner tuner;
+  ScriptedStream stream(&tuner);
+  int size = tuner.Reset(policy, kBurst, 64 * kBurst);
+  EXPECT_EQ(stream.Callback(1000), 0);
+  for (int i = 0; i < 3; ++i) {
+    size += params.grow_bursts * kBurst;
+    EXPECT_EQ(stream.Xrun(stream.now_ms() + 10), size);
+  }
+  for (int i = 0; i < 20; ++i) {
+    const int expected = size - kBurst >= params.min_bursts * kBurst ? size - kBurst : 0;
+    EXPECT_EQ(stream.Callback(stream.now_ms() + params.quiet_ms), expected);
+    size = expected > 0 ? expected : size;
+  }
+  EXPECT_EQ(size, params.min_bursts * kBurst);
+  EXPECT_EQ(tuner.buffer_size(), params.min_bursts * kBurst);
+}
+
+// Sizes never pass the buffer's capacity, also not the one to start with.
+void TestCapacityClamp(SV_LATENCY_POLICY policy) {
+  const SVLatencyTuner::Policy params = SVLatencyTuner::GetPolicy(policy);
+  const int capacity = params.start_bursts * kBurst + kBurst / 2;
+  SVLatencyTuner tuner;
+  ScriptedStream stream(&tuner);
+  EXPECT_EQ(tuner.Reset(policy, kBurst, capacity), params.start_bursts * kBurst);
+  EXPECT_EQ(stream.Callback(1000), 0);
+  EXPECT_EQ(stream.Xrun(1010), capacity);
+  EXPECT_EQ(stream.Xrun(1020), 0);
+  EXPECT_EQ(tuner.buffer_size(), capacity);
+  EXPECT_EQ(tuner.grow_count(), 1);
+
+  SVLatencyTuner small;
+  EXPECT_EQ(small.Reset(policy, kBurst, kBurst / 2), kBurst / 2);
+}
+
+void TestOff() {
+  SVLatencyTuner tuner;
+  EXPECT_EQ(tuner.Reset(SV_LATENCY_POLICY_OFF, kBurst, 64 * kBurst), 0);
+  EXPECT_EQ(tuner.Update(0, 0), 0);
+  EXPECT_EQ(tuner.Update(10, kNanosPerMs), 0);
+  EXPECT_EQ(tuner.buffer_size(), 0);
+  // Without a burst or a buffer to size it is off whatever the policy.
+  EXPECT_EQ(tuner.Reset(SV_LATENCY_POLICY_BALANCED, 0, 64 * kBurst), 0);
+  EXPECT_EQ(tuner.enabled(), false);
+  EXPECT_EQ(tuner.Reset(SV_LATENCY_POLICY_BALANCED, kBurst, 0), 0);
+  EXPECT_EQ(tuner.enabled(), false);
+}
+
+} // namespace
+
+int main() {
+  for (SV_LATENCY_POLICY policy : {SV_LATENCY_POLICY_LOWEST, SV_LATENCY_POLICY_BALANCED, SV_LATENCY_POLICY_ROBUST}) {
+    const int before = failures;
+    TestGrowShrinkBackoff(policy);
+    TestMinFloor(policy);
+    TestCapacityClamp(policy);
+    printf("%s: %s\n", PolicyName(policy), failures == before ? "ok" : "FAILED");
+  }
+  TestOff();
+  printf("%d failures\n", failures);
+  return failures > 0 ? 1 : 0;
+}
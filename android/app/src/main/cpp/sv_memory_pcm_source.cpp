@@ -0,0 +1,49 @@
+#include "sv_memory_pcm_source.h"
+#include <algorithm>
+#include <cstring>
+
+namespace sv_render {
+
+SVMemoryPcmSource::SVMemoryPcmSource(std::vector<int16_t> samples, bool loop)
+  : samples_(std::move(samples)),
+  loop_(loop) {
+}
+
+bool SVMemoryPcmSource::Prepare(int sample_rate, int channels) {
+  if (channels <= 0) {
+    return false;
+  }
+  channels_ = channels;
+  total_frames_ = samples_.size() / channels;
+  read_frame_.store(0, std::memory_order_relaxed);
+  return total_frames_ > 0;
+}
+
+int SVMemoryPcmSource::Acquire(int num_frames, const int16_t** data) {
+  const size_t read_frame = read_frame_.load(std::memory_order_relaxed);
+  const size_t frames = std::min(static_cast<size_t>(num_frames), total_frames_ - read_frame);
+  *data = samples_.data() + read_frame * channels_;
+  read_frame_.store(read_frame + frames, std::memory_order_relaxed);
+  return static_cast<int>(frames);
+}
+
+int SVMemoryPcmSource::Render(int16_t* dst, int num_frames) {
+  int rendered = 0;
+  while (rendered < num_frames) {
+    const int16_t* src = nullptr;
+    const int frames = Acquire(num_frames - rendered, &src);
+    memcpy(dst + rendered * channels_, src, frames * channels_ * sizeof(int16_t));
+    rendered += frames;
+    if (frames == 0) {
+      if (!loop_ || total_frames_ == 0) break;
+      read_frame_.store(0, std::memory_order_relaxed);
+    }
+  }
+  return rendered;
+}
+
+bool SVMemoryPcmSource::IsEnd() const {
+  return !loop_ && read_frame_.load(std::memory_order_relaxed) >= total_frames_;
+}
+
+} // sv_render
@@ -0,0 +1,33 @@
+#ifndef AUDIO_PLAYOUT_SV_MEMORY_PCM_SOURCE_H
+#define AUDIO_PLAYOUT_SV_MEMORY_PCM_SOURCE_H
+
+#include "sv_pcm_source.h"
+#include <atomic>
+#include <vector>
+
+namespace sv_render {
+
+// Plays interleaved int16 frames already held in memory, optionally looping.
+class SVMemoryPcmSource : public IPcmSource {
+
+public:
+  SVMemoryPcmSource(std::vector<int16_t> samples, bool loop = false);
+  ~SVMemoryPcmSource() override = default;
+
+  bool Prepare(int sample_rate, int channels) override;
+  int Render(int16_t* dst, int num_frames) override;
+  bool IsEnd() const override;
+  bool CanAcquire() const override { return !loop_; }
+  int Acquire(int num_frames, const int16_t** data) override;
+
+private:
+  const std::vector<int16_t> samples_;
+  const bool loop_;
+  int channels_ = 0;
+  size_t total_frames_ = 0;
+  std::atomic<size_t> read_frame_ { 0 };
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_MEMORY_PCM_SOURCE_H
@@ -0,0 +1,280 @@
+#include "sv_mix_kernels.h"
+#include "sv_simd.h"
+#include <algorithm>
+
+namespace sv_render {
+
+void SVMixAccumulateScalar(float* dst, const float* src, float gain, int count) {
+  for (int i = 0; i < count; ++i) {
+    dst[i] += gain * src[i];
+  }
+}
+
+void SVMixAccumulateRampScalar(float* dst, const float* src, float start_gain, float end_gain, int num_frames,
+                               int channels) {
+  const float step = num_frames > 0 ? (end_gain - start_gain) / num_frames : 0.0f;
+  for (int frame = 0; frame < num_frames; ++frame) {
+    const float gain = start_gain + step * frame;
+    for (int ch = 0; ch < channels; ++ch) {
+      dst[frame * channels + ch] += gain * src[frame * channels + ch];
+    }
+  }
+}
+
+void SVClipScalar(float* buffer, int count) {
+  for (int i = 0; i < count; ++i) {
+    buffer[i] = std::min(1.0f, std::max(-1.0f, buffer[i]));
+  }
+}
+
+float SVApplyGainRampScalar(float* buffer, float gain, float ratio, float step, int num_frames, int channels) {
+  for (int frame = 0; frame < num_frames; ++frame) {
+    for (int ch = 0; ch < channels; ++ch) {
+      buffer[frame * channels + ch] *= gain;
+    }
+    gain = gain * ratio + step;
+  }
+  return gain;
+}
+
+float SVApplyGainRampInt16Scalar(int16_t* buffer, float gain, float ratio, float step, int num_frames,
+                                 int channels) {
+  for (int frame = 0; frame < num_frames; ++frame) {
+    for (int ch = 0; ch < channels; ++ch) {
+      const float sample = buffer[frame * channels + ch] * gain;
+      buffer[frame * channels + ch] = static_cast<int16_t>(std::min(32767.0f, std::max(-32768.0f, sample)));
+    }
+    gain = gain * ratio + step;
+  }
+  return gain;
+}
+
+namespace {
+
+// Gain ramp state for four samples per vector, four mono frames or two stereo
+// frames: the gain of each lane's frame, and the ratio and step that move
+// every lane ahead by frames_per_vector frames at once.
+struct GainLanes {
+  GainLanes(float gain, float ratio, float step, int channels) {
+    frames_per_vector = 4 / channels;
+    float frame_gain = gain;
+    for (int frame = 0; frame < frames_per_vector; ++frame) {
+      for (int ch = 0; ch < channels; ++ch) {
+        lanes[frame * channels + ch] = frame_gain;
+      }
+      frame_gain = frame_gain * ratio + step;
+    }
+    vector_ratio = 1.0f;
+    vector_step = 0.0f;
+    for (int frame = 0; frame < frames_per_vector; ++frame) {
+      vector_ratio *= ratio;
+      vector_step = vector_step * ratio + step;
+    }
+  }
+
+  int frames_per_vector;
+  float lanes[4] {};
+  float vector_ratio;
+  float vector_step;
+};
+
+} // namespace
+
+#if defined(SV_HAVE_NEON)
+
+void SVMixAccumulate(float* dst, const float* src, float gain, int count) {
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i), vld1q_f32(src + i), gain));
+    vst1q_f32(dst + i + 4, vmlaq_n_f32(vld1q_f32(dst + i + 4), vld1q_f32(src + i + 4), gain));
+  }
+  SVMixAccumulateScalar(dst + i, src + i, gain, count - i);
+}
+
+void SVMixAccumulateRamp(float* dst, const float* src, float start_gain, float end_gain, int num_frames,
+                         int channels) {
+  if (channels > 2 || num_frames <= 0) {
+    SVMixAccumulateRampScalar(dst, src, start_gain, end_gain, num_frames, channels);
+    return;
+  }
+  // Four samples per vector: four mono frames or two stereo frames.
+  const int frames_per_vector = 4 / channels;
+  const float step = (end_gain - start_gain) / num_frames;
+  const float offsets_mono[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+  const float offsets_stereo[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+  const float32x4_t offsets = vld1q_f32(channels == 1 ? offsets_mono : offsets_stereo);
+  int frame = 0;
+  for (; frame + frames_per_vector <= num_frames; frame += frames_per_vector) {
+    const float32x4_t frame_index = vaddq_f32(vdupq_n_f32(static_cast<float>(frame)), offsets);
+    const float32x4_t gain = vmlaq_n_f32(vdupq_n_f32(start_gain), frame_index, step);
+    float* out = dst + frame * channels;
+    vst1q_f32(out, vmlaq_f32(vld1q_f32(out), vld1q_f32(src + frame * channels), gain));
+  }
+  for (; frame < num_frames; ++frame) {
+    const float gain = start_gain + step * frame;
+    for (int ch = 0; ch < channels; ++ch) {
+      dst[frame * channels + ch] += gain * src[frame * channels + ch];
+    }
+  }
+}
+
+void SVClip(float* buffer, int count) {
+  const float32x4_t low = vdupq_n_f32(-1.0f);
+  const float32x4_t high = vdupq_n_f32(1.0f);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(buffer + i, vminq_f32(vmaxq_f32(vld1q_f32(buffer + i), low), high));
+  }
+  SVClipScalar(buffer + i, count - i);
+}
+
+float SVApplyGainRamp(float* buffer, float gain, float ratio, float step, int num_frames, int channels) {
+  if (channels > 2 || num_frames <= 0) {
+    return SVApplyGainRampScalar(buffer, gain, ratio, step, num_frames, channels);
+  }
+  GainLanes ramp(gain, ratio, step, channels);
+  float32x4_t gains = vld1q_f32(ramp.lanes);
+  const float32x4_t vector_step = vdupq_n_f32(ramp.vector_step);
+  int frame = 0;
+  for (; frame + ramp.frames_per_vector <= num_frames; frame += ramp.frames_per_vector) {
+    float* out = buffer + frame * channels;
+    vst1q_f32(out, vmulq_f32(vld1q_f32(out), gains));
+    gains = vmlaq_n_f32(vector_step, gains, ramp.vector_ratio);
+  }
+  return SVApplyGainRampScalar(buffer + frame * channels, vgetq_lane_f32(gains, 0), ratio, step, num_frames - frame,
+                               channels);
+}
+
+float SVApplyGainRampInt16(int16_t* buffer, float gain, float ratio, float step, int num_frames, int channels) {
+  if (channels > 2 || num_frames <= 0) {
+    return SVApplyGainRampInt16Scalar(buffer, gain, ratio, step, num_frames, channels);
+  }
+  GainLanes ramp(gain, ratio, step, channels);
+  float32x4_t gains = vld1q_f32(ramp.lanes);
+  const float32x4_t vector_step = vdupq_n_f32(ramp.vector_step);
+  int frame = 0;
+  for (; frame + ramp.frames_per_vector <= num_frames; frame += ramp.frames_per_vector) {
+    int16_t* out = buffer + frame * channels;
+    const float32x4_t samples = vcvtq_f32_s32(vmovl_s16(vld1_s16(out)));
+    vst1_s16(out, vqmovn_s32(vcvtq_s32_f32(vmulq_f32(samples, gains))));
+    gains = vmlaq_n_f32(vector_step, gains, ramp.vector_ratio);
+  }
+  return SVApplyGainRampInt16Scalar(buffer + frame * channels, vgetq_lane_f32(gains, 0), ratio, step,
+                                    num_frames - frame, channels);
+}
+
+#elif defined(SV_HAVE_SSE2)
+
+void SVMixAccumulate(float* dst, const float* src, float gain, int count) {
+  const __m128 g = _mm_set1_ps(gain);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_mul_ps(_mm_loadu_ps(src + i + 4), g)));
+  }
+  SVMixAccumulateScalar(dst + i, src + i, gain, count - i);
+}
+
+void SVMixAccumulateRamp(float* dst, const float* src, float start_gain, float end_gain, int num_frames,
+                         int channels) {
+  if (channels > 2 || num_frames <= 0) {
+    SVMixAccumulateRampScalar(dst, src, start_gain, end_gain, num_frames, channels);
+    return;
+  }
+  // Four samples per vector: four mono frames or two stereo frames.
+  const int frames_per_vector = 4 / channels;
+  const float step = (end_gain - start_gain) / num_frames;
+  const __m128 offsets = channels == 1 ? _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f) : _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+  const __m128 start = _mm_set1_ps(start_gain);
+  const __m128 steps = _mm_set1_ps(step);
+  int frame = 0;
+  for (; frame + frames_per_vector <= num_frames; frame += frames_per_vector) {
+    const __m128 frame_index = _mm_add_ps(_mm_set1_ps(static_cast<float>(frame)), offsets);
+    const __m128 gain = _mm_add_ps(start, _mm_mul_ps(steps, frame_index));
+    float* out = dst + frame * channels;
+    _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), _mm_mul_ps(gain, _mm_loadu_ps(src + frame * channels))));
+  }
+  for (; frame < num_frames; ++frame) {
+    const float gain = start_gain + step * frame;
+    for (int ch = 0; ch < channels; ++ch) {
+      dst[frame * channels + ch] += gain * src[frame * channels + ch];
+    }
+  }
+}
+
+void SVClip(float* buffer, int count) {
+  const __m128 low = _mm_set1_ps(-1.0f);
+  const __m128 high = _mm_set1_ps(1.0f);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(buffer + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(buffer + i), low), high));
+  }
+  SVClipScalar(buffer + i, count - i);
+}
+
+float SVApplyGainRamp(float* buffer, float gain, float ratio, float step, int num_frames, int channels) {
+  if (channels > 2 || num_frames <= 0) {
+    return SVApplyGainRampScalar(buffer, gain, ratio, step, num_frames, channels);
+  }
+  GainLanes ramp(gain, ratio, step, channels);
+  __m128 gains = _mm_loadu_ps(ramp.lanes);
+  const __m128 vector_ratio = _mm_set1_ps(ramp.vector_ratio);
+  const __m128 vector_step = _mm_set1_ps(ramp.vector_step);
+  int frame = 0;
+  for (; frame + ramp.frames_per_vector <= num_frames; frame += ramp.frames_per_vector) {
+    float* out = buffer + frame * channels;
+    _mm_storeu_ps(out, _mm_mul_ps(_mm_loadu_ps(out), gains));
+    gains = _mm_add_ps(_mm_mul_ps(gains, vector_ratio), vector_step);
+  }
+  return SVApplyGainRampScalar(buffer + frame * channels, _mm_cvtss_f32(gains), ratio, step, num_frames - frame,
+                               channels);
+}
+
+float SVApplyGainRampInt16(int16_t* buffer, float gain, float ratio, float step, int num_frames, int channels) {
+  if (channels > 2 || num_frames <= 0) {
+    return SVApplyGainRampInt16Scalar(buffer, gain, ratio, step, num_frames, channels);
+  }
+  GainLanes ramp(gain, ratio, step, channels);
+  __m128 gains = _mm_loadu_ps(ramp.lanes);
+  const __m128 vector_ratio = _mm_set1_ps(ramp.vector_ratio);
+  const __m128 vector_step = _mm_set1_ps(ramp.vector_step);
+  int frame = 0;
+  for (; frame + ramp.frames_per_vector <= num_frames; frame += ramp.frames_per_vector) {
+    int16_t* out = buffer + frame * channels;
+    const __m128i pcm = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(out));
+    // Sign-extends the four samples to 32 bits.
+    const __m128 samples = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(pcm, pcm), 16));
+    const __m128i scaled = _mm_cvttps_epi32(_mm_mul_ps(samples, gains));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packs_epi32(scaled, scaled));
+    gains = _mm_add_ps(_mm_mul_ps(gains, vector_ratio), vector_step);
+  }
+  return SVApplyGainRampInt16Scalar(buffer + frame * channels, _mm_cvtss_f32(gains), ratio, step,
+                                    num_frames - frame, channels);
+}
+
+#else
+
+void SVMixAccumulate(float* dst, const float* src, float gain, int count) {
+  SVMixAccumulateScalar(dst, src, gain, count);
+}
+
+void SVMixAccumulateRamp(float* dst, const float* src, float start_gain, float end_gain, int num_frames,
+                         int channels) {
+  SVMixAccumulateRampScalar(dst, src, start_gain, end_gain, num_frames, channels);
+}
+
+void SVClip(float* buffer, int count) {
+  SVClipScalar(buffer, count);
+}
+
+float SVApplyGainRamp(float* buffer, float gain, float ratio, float step, int num_frames, int channels) {
+  return SVApplyGainRampScalar(buffer, gain, ratio, step, num_frames, channels);
+}
+
+float SVApplyGainRampInt16(int16_t* buffer, float gain, float ratio, float step, int num_frames, int channels) {
+  return SVApplyGainRampInt16Scalar(buffer, gain, ratio, step, num_frames, channels);
+}
+
+#endif
+
+} // sv_render
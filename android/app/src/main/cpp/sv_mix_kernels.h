@@ -0,0 +1,38 @@
+#ifndef AUDIO_PLAYOUT_SV_MIX_KERNELS_H
+#define AUDIO_PLAYOUT_SV_MIX_KERNELS_H
+
+#include <cstdint>
+
+namespace sv_render {
+
+// Float32 mixing kernels over interleaved buffers, count is the number of
+// samples (frames * channels). NEON/SSE2 when available.
+
+// dst[i] += gain * src[i].
+void SVMixAccumulate(float* dst, const float* src, float gain, int count);
+// Same with the gain moving linearly from start_gain to end_gain over the
+// frames, so gain changes don't click.
+void SVMixAccumulateRamp(float* dst, const float* src, float start_gain, float end_gain, int num_frames,
+                         int channels);
+// Hard clips every sample to [-1, 1].
+void SVClip(float* buffer, int count);
+// Scales the frames in place by a gain that starts at gain and goes
+// gain = gain * ratio + step from one frame to the next: ratio 1 is a linear
+// ramp, step 0 an exponential one, both a constant gain. Returns the gain the
+// frame after the last would get, to carry the ramp into the next buffer.
+float SVApplyGainRamp(float* buffer, float gain, float ratio, float step, int num_frames, int channels);
+// Same on int16 samples, truncated and saturated.
+float SVApplyGainRampInt16(int16_t* buffer, float gain, float ratio, float step, int num_frames, int channels);
+
+// Plain C versions, used on other targets and by the benchmarks.
+void SVMixAccumulateScalar(float* dst, const float* src, float gain, int count);
+void SVMixAccumulateRampScalar(float* dst, const float* src, float start_gain, float end_gain, int num_frames,
+                               int channels);
+void SVClipScalar(float* buffer, int count);
+float SVApplyGainRampScalar(float* buffer, float gain, float ratio, float step, int num_frames, int channels);
+float SVApplyGainRampInt16Scalar(int16_t* buffer, float gain, float ratio, float step, int num_frames,
+                                 int channels);
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_MIX_KERNELS_H
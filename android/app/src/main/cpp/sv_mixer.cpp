@@ -0,0 +1,218 @@
+#include "sv_mixer.h"
+#include "sv_mix_kernels.h"
+#include "sv_sample_convert.h"
+#include "log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace sv_render {
+
+// Odr-used by std::min, C++14 still needs the definition.
+constexpr int SVMixer::kChunkFrames;
+
+SVMixer::SVMixer()
+  : commands_(kMaxVoices * 4),
+  retired_(kMaxVoices * 2) {
+  // Reserved up front so the audio thread never grows it.
+  active_.reserve(kMaxVoices);
+}
+
+SVMixer::~SVMixer() {
+  // Every voice stays in voices_ until reclaimed, wherever it is queued.
+  for (auto& entry : voices_) {
+    entry.second->source->Release();
+    delete entry.second;
+  }
+}
+
+int SVMixer::AddVoice(IPcmSource::Ptr source, float gain) {
+  ReclaimVoices();
+  if (!source) {
+    return -1;
+  }
+  if (voices_.size() >= kMaxVoices) {
+    AV_LOGW("SVMixer add voice failed, %d voices already.", kMaxVoices);
+    return -1;
+  }
+  auto* voice = new Voice();
+  voice->id = next_voice_id_++;
+  voice->source = std::move(source);
+  voice->gain.store(gain, std::memory_order_relaxed);
+  voice->applied_gain = gain;
+  if (prepared_ && !voice->source->Prepare(sample_rate_, channels_)) {
+    AV_LOGW("SVMixer prepare voice failed.");
+    delete voice;
+    return -1;
+  }
+  if (!commands_.Push({CommandType::kAdd, voice, voice->id})) {
+    AV_LOGW("SVMixer add voice failed, command queue full.");
+    delete voice;
+    return -1;
+  }
+  voices_[voice->id] = voice;
+  return voice->id;
+}
+
+bool SVMixer::RemoveVoice(int voice_id) {
+  ReclaimVoices();
+  if (voices_.find(voice_id) == voices_.end()) {
+    return false;
+  }
+  if (!commands_.Push({CommandType::kRemove, nullptr, voice_id})) {
+    AV_LOGW("SVMixer remove voice failed, command queue full.");
+    return false;
+  }
+  return true;
+}
+
+bool SVMixer::SetVoiceGain(int voice_id, float gain) {
+  auto it = voices_.find(voice_id);
+  if (it == voices_.end()) {
+    return false;
+  }
+  // The voice is only freed on this thread, so it is alive here.
+  it->second->gain.store(gain, std::memory_order_relaxed);
+  return true;
+}
+
+int SVMixer::voice_count() {
+  ReclaimVoices();
+  return static_cast<int>(voices_.size());
+}
+
+void SVMixer::ReclaimVoices() {
+  Voice* voice = nullptr;
+  while (retired_.Pop(&voice)) {
+    voices_.erase(voice->id);
+    voice->source->Release();
+    delete voice;
+  }
+}
+
+bool SVMixer::Prepare(int sample_rate, int channels) {
+  if (sample_rate <= 0 || channels <= 0) {
+    return false;
+  }
+  ReclaimVoices();
+  sample_rate_ = sample_rate;
+  channels_ = channels;
+  voice_buffer_.assign(kChunkFrames * channels, 0.0f);
+  voice_pcm_.assign(kChunkFrames * channels, 0);
+  mix_buffer_.assign(kChunkFrames * channels, 0.0f);
+  for (auto& entry : voices_) {
+    if (!entry.second->source->Prepare(sample_rate, channels)) {
+      AV_LOGW("SVMixer prepare voice %d failed.", entry.first);
+    }
+  }
+  prepared_ = true;
+  return true;
+}
+
+void SVMixer::Release() {
+  ReclaimVoices();
+  for (auto& entry : voices_) {
+    entry.second->source->Release();
+  }
+  prepared_ = false;
+  AV_LOGI("SVMixer release, voices:%d, voice underruns:%lld", static_cast<int>(voices_.size()),
+          (long long) voice_underruns());
+}
+
+void SVMixer::ApplyCommands() {
+  Command command {};
+  while (commands_.Pop(&command)) {
+    if (command.type == CommandType::kAdd) {
+      active_.push_back(command.voice);
+      continue;
+    }
+    for (size_t i = 0; i < active_.size(); ++i) {
+      if (active_[i]->id == command.voice_id) {
+        RetireVoice(static_cast<int>(i));
+        break;
+      }
+    }
+  }
+  active_count_.store(static_cast<int>(active_.size()), std::memory_order_relaxed);
+}
+
+void SVMixer::RetireVoice(int index) {
+  Voice* voice = active_[index];
+  active_[index] = active_.back();
+  active_.pop_back();
+  // Can't fail: retired_ holds more than the mixer has voices.
+  retired_.Push(voice);
+  active_count_.store(static_cast<int>(active_.size()), std::memory_order_relaxed);
+}
+
+int SVMixer::MixVoice(Voice* voice, float* dst, int num_frames) {
+  IPcmSource* source = voice->source.get();
+  int frames = 0;
+  if (source->CanRenderFloat()) {
+    frames = source->RenderFloat(voice_buffer_.data(), num_frames);
+  } else {
+    frames = source->Render(voice_pcm_.data(), num_frames);
+    SVInt16ToFloat(voice_pcm_.data(), voice_buffer_.data(), frames * channels_);
+  }
+  if (frames == 0) {
+    return 0;
+  }
+  const float gain = voice->gain.load(std::memory_order_relaxed);
+  if (gain == voice->applied_gain) {
+    SVMixAccumulate(dst, voice_buffer_.data(), gain, frames * channels_);
+  } else {
+    SVMixAccumulateRamp(dst, voice_buffer_.data(), voice->applied_gain, gain, frames, channels_);
+    voice->applied_gain = gain;
+  }
+  return frames;
+}
+
+int SVMixer::RenderFloat(float* dst, int num_frames) {
+  ApplyCommands();
+  if (active_.empty() && IsEnd()) {
+    return 0;
+  }
+  for (int offset = 0; offset < num_frames; offset += kChunkFrames) {
+    const int frames = std::min(kChunkFrames, num_frames - offset);
+    float* out = dst + offset * channels_;
+    memset(out, 0, frames * channels_ * sizeof(float));
+    size_t i = 0;
+    while (i < active_.size()) {
+      Voice* voice = active_[i];
+      if (MixVoice(voice, out, frames) < frames) {
+        if (voice->source->IsEnd()) {
+          RetireVoice(static_cast<int>(i));
+          continue;
+        }
+        voice_underruns_.fetch_add(1, std::memory_order_relaxed);
+      }
+      ++i;
+    }
+    SVClip(out, frames * channels_);
+  }
+  return num_frames;
+}
+
+void SVMixer::SetDeviceLatency(double seconds) {
+  for (Voice* voice : active_) {
+    voice->source->SetDeviceLatency(seconds);
+  }
+}
+
+int SVMixer::Render(int16_t* dst, int num_frames) {
+  int rendered = 0;
+  while (rendered < num_frames) {
+    const int wanted = std::min(num_frames - rendered, kChunkFrames);
+    const int frames = RenderFloat(mix_buffer_.data(), wanted);
+    SVFloatToInt16(mix_buffer_.data(), dst + rendered * channels_, frames * channels_);
+    rendered += frames;
+    if (frames < wanted) break;
+  }
+  return rendered;
+}
+
+bool SVMixer::IsEnd() const {
+  return end_when_idle_.load(std::memory_order_relaxed) && active_count_.load(std::memory_order_relaxed) == 0 &&
+         commands_.Empty();
+}
+
+} // sv_render
@@ -0,0 +1,103 @@
+#ifndef AUDIO_PLAYOUT_SV_MIXER_H
+#define AUDIO_PLAYOUT_SV_MIXER_H
+
+#include "sv_pcm_source.h"
+#include "sv_spsc_queue.h"
+#include <atomic>
+#include <map>
+#include <vector>
+
+namespace sv_render {
+
+// Sums any number of voices into one stream, so music, prompts and effects
+// share a single device stream. The mixer is itself a float source and sits
+// in front of a backend like any other.
+//
+// Voices are added, removed and re-gained from the control thread. Voice
+// objects are handed to the audio thread through a wait-free queue and come
+// back through a second one once the audio thread drops them, so the audio
+// thread never locks, allocates or frees.
+class SVMixer : public IPcmSource {
+
+public:
+  static constexpr int kMaxVoices = 64;
+
+  SVMixer();
+  ~SVMixer() override;
+
+  // Control thread. Mixes source, which must produce interleaved frames in
+  // the layout the mixer is prepared with, from the next callback on.
+  // Returns the voice id, -1 when the mixer is full. The voice leaves the
+  // mixer by itself once its source ends.
+  int AddVoice(IPcmSource::Ptr source, float gain = 1.0f);
+  // Control thread. False if the voice doesn't exist or already finished.
+  bool RemoveVoice(int voice_id);
+  bool SetVoiceGain(int voice_id, float gain);
+  // Control thread. Voices not yet reclaimed from the audio thread.
+  int voice_count();
+  // Control thread. End the stream once every voice has finished, instead of
+  // rendering silence until voices are added.
+  void SetEndWhenIdle(bool end_when_idle) { end_when_idle_.store(end_when_idle); }
+  // Voice callbacks that came up short without the voice ending.
+  int64_t voice_underruns() const { return voice_underruns_.load(std::memory_order_relaxed); }
+
+  bool Prepare(int sample_rate, int channels) override;
+  void Release() override;
+  int Render(int16_t* dst, int num_frames) override;
+  bool IsEnd() const override;
+  bool CanRenderFloat() const override { return true; }
+  int RenderFloat(float* dst, int num_frames) override;
+  // Passed on to every voice.
+  void SetDeviceLatency(double seconds) override;
+
+private:
+  struct Voice {
+    int id = 0;
+    IPcmSource::Ptr source;
+    std::atomic<float> gain { 1.0f };
+    // Audio thread. Gain of the last rendered frame, ramps follow from it.
+    float applied_gain = 1.0f;
+  };
+
+  enum class CommandType { kAdd, kRemove };
+  struct Command {
+    CommandType type;
+    Voice* voice;
+    int voice_id;
+  };
+
+  // Audio thread.
+  void ApplyCommands();
+  void RetireVoice(int index);
+  int MixVoice(Voice* voice, float* dst, int num_frames);
+  // Control thread. Frees voices the audio thread has dropped.
+  void ReclaimVoices();
+
+private:
+  // Frames mixed per pass through the scratch buffers.
+  static constexpr int kChunkFrames = 256;
+
+  int sample_rate_ = 0;
+  int channels_ = 0;
+  bool prepared_ = false;
+  std::atomic<bool> end_when_idle_ { false };
+  std::atomic<int64_t> voice_underruns_ { 0 };
+
+  // Control thread: every voice not yet reclaimed, by id.
+  std::map<int, Voice*> voices_;
+  int next_voice_id_ = 1;
+
+  SVSpscQueue<Command> commands_;
+  SVSpscQueue<Voice*> retired_;
+
+  // Audio thread.
+  std::vector<Voice*> active_;
+  std::atomic<int> active_count_ { 0 };
+  std::vector<float> voice_buffer_;
+  std::vector<int16_t> voice_pcm_;
+  std::vector<float> mix_buffer_;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_MIXER_H
@@ -0,0 +1,135 @@
+#include "sv_mmap_pcm_file.h"
+#include "log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sv_render {
+
+namespace {
+
+// Read ahead of a seek target, so the first callbacks there don't fault.
+constexpr int kSeekReadAheadMs = 500;
+
+} // namespace
+
+SVMmapPcmFile::SVMmapPcmFile(const std::string& file_path)
+  : data_(nullptr),
+  size_in_bytes_(0) {
+  int fd = open(file_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    AV_LOGW("SVMmapPcmFile open failed, reason:%s", strerror(errno));
+    return;
+  }
+  struct stat st {};
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    AV_LOGW("SVMmapPcmFile fstat failed or empty file.");
+    close(fd);
+    return;
+  }
+  void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  if (addr == MAP_FAILED) {
+    AV_LOGW("SVMmapPcmFile mmap failed, reason:%s", strerror(errno));
+    return;
+  }
+  data_ = static_cast<const int16_t*>(addr);
+  size_in_bytes_ = static_cast<size_t>(st.st_size);
+  AV_LOGI("SVMmapPcmFile mapped %zu bytes at %p", size_in_bytes_, data_);
+}
+
+SVMmapPcmFile::~SVMmapPcmFile() {
+  if (data_) {
+    munmap(const_cast<int16_t*>(data_), size_in_bytes_);
+    data_ = nullptr;
+  }
+}
+
+bool SVMmapPcmFile::Prepare(int sample_rate, int channels) {
+  if (!data_ || channels <= 0) {
+    return false;
+  }
+  channels_ = channels;
+  total_frames_ = size_in_bytes_ / (sizeof(int16_t) * channels);
+  sample_rate_ = sample_rate;
+  // A seek requested before preparing is where playback starts.
+  const int64_t start_frame = seek_frame_.exchange(-1);
+  read_frame_.store(std::min(static_cast<size_t>(std::max<int64_t>(start_frame, 0)), total_frames_),
+                    std::memory_order_relaxed);
+  crossfade_.Prepare(sample_rate, channels);
+
+  // Sequential access lets the kernel read ahead aggressively on faults, and
+  // WILLNEED starts pulling the file into the page cache before the first callback.
+  auto* addr = const_cast<int16_t*>(data_);
+  if (madvise(addr, size_in_bytes_, MADV_SEQUENTIAL) != 0) {
+    AV_LOGW("madvise MADV_SEQUENTIAL failed, reason:%s", strerror(errno));
+  }
+  if (madvise(addr, size_in_bytes_, MADV_WILLNEED) != 0) {
+    AV_LOGW("madvise MADV_WILLNEED failed, reason:%s", strerror(errno));
+  }
+  return true;
+}
+
+bool SVMmapPcmFile::Seek(int64_t frame) {
+  if (!data_ || frame < 0) {
+    return false;
+  }
+  if (channels_ > 0) {
+    // Page the target in here rather than faulting on the audio thread.
+    const size_t frame_bytes = sizeof(int16_t) * channels_;
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = std::min(static_cast<size_t>(frame) * frame_bytes, size_in_bytes_) / page_size * page_size;
+    const size_t length = std::min(static_cast<size_t>(sample_rate_) * kSeekReadAheadMs / 1000 * frame_bytes,
+                                   size_in_bytes_ - begin);
+    if (length > 0 && madvise(const_cast<int16_t*>(data_) + begin / sizeof(int16_t), length, MADV_WILLNEED) != 0) {
+      AV_LOGW("madvise MADV_WILLNEED failed, reason:%s", strerror(errno));
+    }
+  }
+  seek_frame_.store(frame, std::memory_order_release);
+  return true;
+}
+
+void SVMmapPcmFile::TakeSeek() {
+  const int64_t frame = seek_frame_.exchange(-1, std::memory_order_acquire);
+  if (frame >= 0) {
+    read_frame_.store(std::min(static_cast<size_t>(frame), total_frames_), std::memory_order_relaxed);
+  }
+}
+
+int SVMmapPcmFile::Acquire(int num_frames, const int16_t** data) {
+  TakeSeek();
+  return TakeFrames(num_frames, data);
+}
+
+int SVMmapPcmFile::TakeFrames(int num_frames, const int16_t** data) {
+  const size_t read_frame = read_frame_.load(std::memory_order_relaxed);
+  const size_t frames = std::min(static_cast<size_t>(num_frames), total_frames_ - read_frame);
+  *data = data_ + read_frame * channels_;
+  read_frame_.store(read_frame + frames, std::memory_order_relaxed);
+  return static_cast<int>(frames);
+}
+
+int SVMmapPcmFile::Render(int16_t* dst, int num_frames) {
+  const int16_t* src = nullptr;
+  if (seek_frame_.load(std::memory_order_relaxed) >= 0) {
+    // The frames that would have played next fade out under the new ones.
+    const int old_frames = TakeFrames(crossfade_.max_frames(), &src);
+    memcpy(crossfade_.old_frames(), src, old_frames * channels_ * sizeof(int16_t));
+    crossfade_.Start(old_frames);
+  }
+  const int frames = Acquire(num_frames, &src);
+  memcpy(dst, src, frames * channels_ * sizeof(int16_t));
+  return crossfade_.Apply(dst, frames, num_frames);
+}
+
+bool SVMmapPcmFile::IsEnd() const {
+  return seek_frame_.load(std::memory_order_relaxed) < 0 && !crossfade_.active() &&
+         read_frame_.load(std::memory_order_relaxed) >= total_frames_;
+}
+
+} // sv_render
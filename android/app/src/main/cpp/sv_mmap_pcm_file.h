@@ -0,0 +1,57 @@
+#ifndef AUDIO_PLAYOUT_SV_MMAP_PCM_FILE_H
+#define AUDIO_PLAYOUT_SV_MMAP_PCM_FILE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "sv_pcm_source.h"
+#include "sv_seek_crossfade.h"
+
+namespace sv_render {
+
+// Read-only mapping of a raw PCM file. Frames are handed out as pointers into
+// the mapping, so the callback copies once from the page cache into the device
+// buffer (or enqueues the mapped pages directly) instead of staging them in a
+// heap buffer. A seek is a pointer move; the target pages are paged in from
+// the control thread before the callback jumps there.
+class SVMmapPcmFile : public IPcmSource {
+
+public:
+  explicit SVMmapPcmFile(const std::string& file_path);
+  ~SVMmapPcmFile() override;
+
+  bool IsOpen() const { return data_ != nullptr; }
+  // Sets the frame layout and asks the kernel to read the file ahead.
+  bool Prepare(int sample_rate, int channels) override;
+  int Render(int16_t* dst, int num_frames) override;
+  bool IsEnd() const override;
+  bool CanAcquire() const override { return true; }
+  // Points *data at up to num_frames frames at the read position and advances it.
+  int Acquire(int num_frames, const int16_t** data) override;
+  // Render() crossfades the jump, Acquire() cuts over without a fade.
+  bool CanSeek() const override { return true; }
+  bool Seek(int64_t frame) override;
+  size_t total_frames() const { return total_frames_; }
+
+private:
+  // Audio thread. Moves the read position to a pending seek target.
+  void TakeSeek();
+  // Hands out frames at the read position and advances it.
+  int TakeFrames(int num_frames, const int16_t** data);
+
+private:
+  const int16_t* data_;
+  size_t size_in_bytes_;
+  size_t total_frames_ = 0;
+  int channels_ = 0;
+  int sample_rate_ = 0;
+  std::atomic<size_t> read_frame_ { 0 };
+  // Pending seek target, -1 when none.
+  std::atomic<int64_t> seek_frame_ { -1 };
+  SVSeekCrossfade<int16_t> crossfade_;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_MMAP_PCM_FILE_H
@@ -0,0 +1,93 @@
+#ifndef AUDIO_PLAYOUT_SV_MPSC_QUEUE_H
+#define AUDIO_PLAYOUT_SV_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace sv_render {
+
+// Bounded lock-free multi-producer/single-consumer queue, for messages any
+// number of audio threads hand to one background thread. Each slot carries
+// a sequence number telling whether it is free for the producer that
+// claimed it or filled for the consumer (D. Vyukov's bounded queue).
+// Storage is allocated once in the constructor; Push() never blocks or
+// allocates, it fails when the queue is full.
+template <typename T>
+class SVMpscQueue {
+
+public:
+  // capacity is rounded up to the next power of two.
+  explicit SVMpscQueue(size_t capacity)
+    : capacity_(RoundUpToPowerOfTwo(capacity)),
+    mask_(capacity_ - 1),
+    slots_(new Slot[capacity_]) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Any thread. False when the queue is full.
+  bool Push(const T& item) {
+    size_t position = write_index_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots_[position & mask_];
+      const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (write_index_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          slot.item = item;
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = write_index_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Consumer side, one thread at a time. False when the queue is empty or
+  // the oldest item is still being written.
+  bool Pop(T* item) {
+    const size_t position = read_index_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[position & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+      return false;
+    }
+    *item = slot.item;
+    slot.sequence.store(position + capacity_, std::memory_order_release);
+    read_index_.store(position + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+  }
+
+private:
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  // Counters on separate cache lines, like SVSpscQueue's.
+  std::atomic<size_t> write_index_ { 0 };
+  char write_padding_[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> read_index_ { 0 };
+  char read_padding_[64 - sizeof(std::atomic<size_t>)];
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_MPSC_QUEUE_H
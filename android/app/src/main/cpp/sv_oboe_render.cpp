@@ -1,137 +1,401 @@
 #include "sv_oboe_render.h"
 #include "log.h"
-#include <cassert>
+#include "sv_rt_audit.h"
+#include <cstring>
 
 namespace sv_render {
 
 SVOboeRender::SVOboeRender(const std::string& file_path)
-: file_(nullptr), initialized_(false), audio_buffers_(nullptr) {
+: SVOboeRender(CreateFilePcmSource(file_path)) {
+}
+
+SVOboeRender::SVOboeRender(IPcmSource::Ptr source)
+: source_(std::make_shared<SVConvertingPcmSource>(std::move(source))),
+  recovery_(&control_, &stats_, [this] { return ReopenStream(); }) {
   AV_LOGI("SVOboeRender Construct.");
-  file_ = fopen(file_path.c_str(), "rb");
-  assert(file_);
 }
 
 SVOboeRender::~SVOboeRender() {
-  if (file_) {
-    fclose(file_);
-    file_ = nullptr;
+  if (control_.state() != SVStreamState::kClosed) {
+    StopPlayout();
+  }
+  ParkStream();
+  source_->Release();
+}
+
+SVOboeRender::PooledStream::~PooledStream() {
+  // Oboe already closed a stream that was disconnected.
+  if (stream && stream->getState() != StreamState::Closed) {
+    Result result = stream->close();
+    if (result != Result::OK) {
+      AV_LOGW("Oboe stream close failed, reason:%s", convertToText(result));
+    }
+  }
+}
+
+bool SVOboeRender::PooledStream::Usable() const {
+  if (callback->dead.load(std::memory_order_acquire)) {
+    return false;
+  }
+  const StreamState state = stream->getState();
+  return state == StreamState::Open || state == StreamState::Stopped;
+}
+
+DataCallbackResult SVOboeRender::StreamCallback::onAudioReady(AudioStream *oboeStream, void *audioData,
+                                                             int32_t numFrames) {
+  SVOboeRender* owner = render.load(std::memory_order_acquire);
+  if (owner) {
+    return owner->onAudioReady(oboeStream, audioData, numFrames);
+  }
+  // Parked while it still ran, it is being stopped.
+  memset(audioData, 0, numFrames * oboeStream->getBytesPerFrame());
+  return DataCallbackResult::Continue;
+}
+
+bool SVOboeRender::StreamCallback::onError(AudioStream* audio_stream, Result error) {
+  AV_LOGE("Oboe onError: %s", convertToText(error));
+  // Whether it plays or is parked, the stream is done for; a parked one is
+  // dropped by the next Take() that comes across it.
+  dead.store(true, std::memory_order_release);
+  // Not handled here: Oboe stops and closes the stream on a thread of its
+  // own, then calls onErrorAfterClose().
+  return false;
+}
+
+void SVOboeRender::StreamCallback::onErrorAfterClose(AudioStream* audio_stream, Result error) {
+  // The render can't go away while this holds the lock, Bind(nullptr) in
+  // its ParkStream() waits for it.
+  std::lock_guard<std::mutex> lock(error_mutex);
+  SVOboeRender* owner = render.load(std::memory_order_acquire);
+  if (owner) {
+    owner->recovery_.OnDisconnect();
+  }
+}
+
+void SVOboeRender::StreamCallback::Bind(SVOboeRender* owner) {
+  std::lock_guard<std::mutex> lock(error_mutex);
+  render.store(owner, std::memory_order_release);
+}
+
+SVWarmPool<int, SVOboeRender::PooledStream>& SVOboeRender::stream_pool() {
+  static SVWarmPool<int, PooledStream> pool;
+  return pool;
+}
+
+bool SVOboeRender::Prewarm(SV_SAMPLE_FORMAT format) {
+  auto pooled = OpenStream(format);
+  if (!pooled) {
+    return false;
   }
-  Result result = stream_->close();
+  stream_pool().Put(format, std::move(pooled));
+  return true;
+}
+
+std::unique_ptr<SVOboeRender::PooledStream> SVOboeRender::OpenStream(SV_SAMPLE_FORMAT format, int channels) {
+  std::unique_ptr<PooledStream> pooled(new PooledStream());
+  pooled->callback = std::make_shared<StreamCallback>();
+  AudioStreamBuilder builder;
+  builder.setDeviceId(kUnspecified);
+  builder.setDirection(Direction::Output);
+  builder.setPerformanceMode(PerformanceMode::LowLatency);
+  builder.setSharingMode(SharingMode::Shared);
+  builder.setFormat(format == SV_SAMPLE_FORMAT_FLOAT ? AudioFormat::Float : AudioFormat::I16);
+  // Likewise the device picks its preferred layout, the content is remapped.
+  builder.setChannelCount(channels);
+  // Leave the rate unspecified so the stream opens at the native rate and
+  // stays on the fast mixer path; the content is resampled in the callback.
+  builder.setSampleRate(kUnspecified);
+  builder.setFormatConversionAllowed(false);
+  // Shared, the stream keeps its callbacks alive for as long as it lives.
+  builder.setDataCallback(pooled->callback);
+  builder.setErrorCallback(pooled->callback);
+
+  Result result = builder.openStream(pooled->stream);
   if (result != Result::OK) {
-    AV_LOGW("Oboe stream close failed, reason:%s", convertToText(result));
+    AV_LOGE("Oboe open stream failed, reason: %s", convertToText(result));
+    return nullptr;
   }
-  stream_ = nullptr;
-  initialized_ = false;
-  audio_buffers_ = nullptr;
-}
-
-bool SVOboeRender::ReadPlayoutData(int num_frames) {
-  const size_t per_size = sizeof(int16_t);
-  int channels = stream_->getChannelCount();
-  const size_t buf_size = num_frames * channels;
-  auto len = fread(audio_buffers_.get(), per_size, buf_size, file_);
-  if (len < buf_size) {
-    if (ferror(file_)) {
-      AV_LOGW("read file error.");
+  return pooled;
+}
+
+void SVOboeRender::ParkStream() {
+  std::lock_guard<std::mutex> lock(stream_mutex_);
+  if (!pooled_stream_) {
+    return;
+  }
+  // Callbacks still running may hold this render, stop() waits them out;
+  // an error callback using it is waited for here.
+  pooled_stream_->callback->Bind(nullptr);
+  StreamState state = stream_->getState();
+  if (state == StreamState::Starting || state == StreamState::Started) {
+    Result result = stream_->stop();
+    if (result != Result::OK) {
+      AV_LOGE("Oboe stop failed, reason: %s", convertToText(result));
     }
-    if (feof(file_)) {
-      AV_LOGW("read file end.");
+    state = stream_->getState();
+  }
+  if (pooled_stream_->Usable()) {
+    stream_pool().Put(pool_format_, std::move(pooled_stream_));
+  } else {
+    // Disconnected or stuck, closed instead of reused.
+    AV_LOGW("Oboe stream not parked, state: %d", static_cast<int>(state));
+    pooled_stream_.reset();
+  }
+  stream_ = nullptr;
+}
+
+bool SVOboeRender::ReopenStream() {
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    if (stream_) {
+      auto xrun_count = stream_->getXRunCount();
+      if (xrun_count) {
+        xrun_carry_ += xrun_count.value() - xrun_base_;
+      }
     }
-    fclose(file_);
+  }
+  // Oboe closed the disconnected stream, it isn't parked.
+  ParkStream();
+  auto pooled = OpenStream(pool_format_, channels_);
+  if (!pooled) {
+    return false;
+  }
+  std::shared_ptr<AudioStream> stream = pooled->stream;
+  const SV_SAMPLE_FORMAT format = stream->getFormat() == AudioFormat::Float ? SV_SAMPLE_FORMAT_FLOAT
+                                                                           : SV_SAMPLE_FORMAT_I16;
+  if (format != sample_format_ || stream->getChannelCount() != channels_) {
+    AV_LOGE("Oboe reopened stream has another format, %d channels.", stream->getChannelCount());
+    return false;
+  }
+  const int device_rate = stream->getSampleRate();
+  AV_LOGI("Oboe stream reopened at %d Hz.", device_rate);
+  if (!source_->SetStreamSampleRate(device_rate)) {
+    return false;
+  }
+  stats_.Restart(device_rate);
+  gain_.Restart(device_rate);
+  const int buffer_size = latency_tuner_.Reset(latency_policy_, stream->getFramesPerBurst(),
+                                               stream->getBufferCapacityInFrames());
+  if (buffer_size > 0) {
+    stream->setBufferSizeInFrames(buffer_size);
+  }
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    pooled_stream_ = std::move(pooled);
+    stream_ = stream;
+    auto xrun_base = stream_->getXRunCount();
+    xrun_base_ = xrun_base ? xrun_base.value() : 0;
+  }
+  // Silent until the recovery hands the stream back.
+  pooled_stream_->callback->Bind(this);
+  auto result = stream->requestStart();
+  if (result != Result::OK) {
+    AV_LOGE("Oboe restart failed, reason: %s", convertToText(result));
+    ParkStream();
     return false;
   }
   return true;
 }
 
+void SVOboeRender::UpdateDeviceLatency(AudioStream *oboeStream) {
+  const int64_t now_ns = SVRenderStats::NowNanos();
+  if (device_timestamp_.Due(oboeStream, now_ns)) {
+    auto timestamp = oboeStream->getTimestamp(CLOCK_MONOTONIC);
+    device_timestamp_.Update(oboeStream, now_ns, static_cast<bool>(timestamp),
+                             timestamp ? timestamp.value().position : 0,
+                             timestamp ? timestamp.value().timestamp : 0);
+  }
+  source_->SetDeviceLatency(device_timestamp_.Latency(oboeStream->getFramesWritten(), oboeStream->getSampleRate(),
+                                                      now_ns));
+}
+
 DataCallbackResult SVOboeRender::onAudioReady(AudioStream *oboeStream, void *audioData, int32_t numFrames) {
-  AV_LOGI("===== onAudioReady =====");
-  int channels = stream_->getChannelCount();
-  size_t num_bytes = sizeof(int16_t) * channels * numFrames;
-  memset(audioData, 0, num_bytes);
-  if (!ReadPlayoutData(numFrames)) {
+  SVRtAuditScope audit_scope;
+  SVStreamControl::CallbackScope control_scope(&control_);
+  if (!control_scope.render()) {
+    // Paused, or being stopped, the stream plays silence.
+    memset(audioData, 0, numFrames * oboeStream->getBytesPerFrame());
+    return DataCallbackResult::Continue;
+  }
+  stats_.MarkDeviceCallback();
+  UpdateDeviceLatency(oboeStream);
+  // The source renders straight into the device buffer.
+  const bool keep_going = sample_format_ == SV_SAMPLE_FORMAT_FLOAT
+          ? RenderPcmSource(source_.get(), static_cast<float*>(audioData), numFrames, channels_, &stats_, &gain_)
+          : RenderPcmSource(source_.get(), static_cast<int16_t*>(audioData), numFrames, channels_, &stats_, &gain_);
+  if (!keep_going) {
+    control_.MarkDrained();
     AV_LOGW("Read playout data failed.");
     return DataCallbackResult::Stop;
   }
-  memcpy(audioData, audio_buffers_.get(), num_bytes);
+  if (latency_tuner_.enabled()) {
+    auto xrun_count = oboeStream->getXRunCount();
+    const int buffer_size = xrun_count ? latency_tuner_.Update(xrun_count.value(), SVRenderStats::NowNanos()) : 0;
+    if (buffer_size > 0) {
+      oboeStream->setBufferSizeInFrames(buffer_size);
+    }
+  }
   return DataCallbackResult::Continue;
 }
 
-bool SVOboeRender::onError(AudioStream* audio_stream, Result error) {
-  AV_LOGE("Oboe onError: %s", convertToText(error));
-  return true; /** true if the stream has been stopped and closed, false if not **/
+int SVOboeRender::SetSampleFormat(SV_SAMPLE_FORMAT format) {
+  if (!control_.SetWhileClosed([&] { sample_format_ = format; })) {
+    AV_LOGW("Oboe set sample format failed, already initialized.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  return SV_NO_ERROR;
+}
+
+int SVOboeRender::SetLatencyPolicy(SV_LATENCY_POLICY policy) {
+  if (!control_.SetWhileClosed([&] { latency_policy_ = policy; })) {
+    AV_LOGW("Oboe set latency policy failed, already initialized.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  return SV_NO_ERROR;
 }
 
 int SVOboeRender::InitAudioRender(int sample_rate, int channels) {
   AV_LOGI("InitAudioRender start.");
-  if (initialized_) {
-    AV_LOGW("Oboe render has initialized.");
-    return SV_NO_ERROR;
-  }
-
-  builder_.setDeviceId(kUnspecified);
-  builder_.setDirection(Direction::Output);
-  builder_.setPerformanceMode(PerformanceMode::LowLatency);
-  builder_.setSharingMode(SharingMode::Shared);
-  builder_.setFormat(AudioFormat::I16);
-  builder_.setChannelCount(channels);
-  builder_.setSampleRate(sample_rate);
-  builder_.setFormatConversionAllowed(false);
-  builder_.setDataCallback(this);
-  builder_.setErrorCallback(this);
-
-  Result result = builder_.openStream(stream_);
-  if (result != Result::OK) {
-    AV_LOGE("Oboe open stream failed, reason: %s", convertToText(result));
-    return SV_PLAY_INIT_ERROR;
+  if (!control_.Transition(SVStreamState::kClosed, SVStreamState::kOpening)) {
+    AV_LOGW("Oboe init failed, stream %s.", SVStreamControl::StateName(control_.state()));
+    return SV_PLAY_STATE_ERROR;
+  }
+
+  pool_format_ = sample_format_;
+  pooled_stream_ = stream_pool().Take(pool_format_, [](const PooledStream& pooled) { return pooled.Usable(); });
+  if (pooled_stream_) {
+    AV_LOGI("Oboe reusing a parked stream.");
+  } else {
+    pooled_stream_ = OpenStream(sample_format_);
+    if (!pooled_stream_) {
+      control_.Transition(SVStreamState::kOpening, SVStreamState::kClosed);
+      return SV_PLAY_INIT_ERROR;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    stream_ = pooled_stream_->stream;
+    auto xrun_base = stream_->getXRunCount();
+    xrun_base_ = xrun_base ? xrun_base.value() : 0;
+    xrun_carry_ = 0;
   }
 
-  const size_t buffer_size_in_samples = sample_rate / 100 * channels;
-  audio_buffers_.reset(new int16_t[buffer_size_in_samples]);
+  // Untuned, the buffer stays at its whole capacity.
+  const int buffer_size = latency_tuner_.Reset(latency_policy_, stream_->getFramesPerBurst(),
+                                               stream_->getBufferCapacityInFrames());
+  if (buffer_size > 0) {
+    stream_->setBufferSizeInFrames(buffer_size);
+  }
+  AV_LOGI("Oboe buffer capacity: %d, framesPerBurst: %d, buffer size: %d", stream_->getBufferCapacityInFrames(),
+          stream_->getFramesPerBurst(), stream_->getBufferSizeInFrames());
+
+  // The callback writes whatever format the stream really got.
+  sample_format_ = stream_->getFormat() == AudioFormat::Float ? SV_SAMPLE_FORMAT_FLOAT : SV_SAMPLE_FORMAT_I16;
+  const int device_rate = stream_->getSampleRate();
+  channels_ = stream_->getChannelCount();
+  AV_LOGI("Oboe stream opened at %d Hz %d channels, content %d Hz %d channels.", device_rate, channels_,
+          sample_rate, channels);
+  stats_.Reset(device_rate);
+  gain_.Prepare(device_rate);
+  source_->SetSourceSampleRate(sample_rate);
+  source_->SetSourceChannels(channels);
+  if (!source_->Prepare(device_rate, channels_)) {
+    AV_LOGE("Oboe prepare pcm source failed.");
+    ParkStream();
+    control_.Transition(SVStreamState::kOpening, SVStreamState::kClosed);
+    return SV_PLAY_INIT_ERROR;
+  }
 
-  initialized_ = true;
+  control_.Transition(SVStreamState::kOpening, SVStreamState::kOpen);
   AV_LOGI("InitAudioRender done.");
   return SV_NO_ERROR;
 }
 
 int SVOboeRender::StartPlayout() {
   AV_LOGI("StartPlayout.");
-  if (!initialized_) {
-    AV_LOGE("Start Playout failed, state is invalid.");
+  if (!control_.Transition(SVStreamState::kOpen, SVStreamState::kStarting)) {
+    AV_LOGW("Start Playout failed, stream %s.", SVStreamControl::StateName(control_.state()));
     return SV_PLAY_STATE_ERROR;
   }
+  // A parked stream comes back stopped.
   auto state = stream_->getState();
-  if (state != StreamState::Open) {
+  if (state != StreamState::Open && state != StreamState::Stopped) {
     AV_LOGE("Start Playout failed, not open state.");
+    control_.Transition(SVStreamState::kStarting, SVStreamState::kOpen);
     return SV_PLAY_STATE_ERROR;
   }
 
+  stats_.MarkStartRequested();
+  gain_.FadeIn();
+  pooled_stream_->callback->Bind(this);
   auto result = stream_->requestStart();
   if (result != Result::OK) {
     AV_LOGE("Oboe request start failed, reason: %s", convertToText(result));
+    pooled_stream_->callback->Bind(nullptr);
+    control_.Transition(SVStreamState::kStarting, SVStreamState::kOpen);
     return SV_START_PLAY_ERROR;
   }
+  control_.FinishStart();
   AV_LOGI("Start playout end.");
   return SV_NO_ERROR;
 }
 
 int SVOboeRender::StopPlayout() {
   AV_LOGI("Stop playout start.");
-  if (!initialized_) {
-    AV_LOGW("Stop playout failed, invalid state.");
+  SVStreamState previous;
+  if (!recovery_.BeginStop(&previous)) {
+    AV_LOGW("Stop playout failed, stream %s.", SVStreamControl::StateName(control_.state()));
     return SV_PLAY_STATE_ERROR;
   }
-  auto state = stream_->getState();
-  if (state != StreamState::Started) {
-    AV_LOGW("Stop playout failed, not requestStart.");
-    return SV_PLAY_STATE_ERROR;
+  // stop() plays out what is buffered, the fade-out included.
+  if (previous == SVStreamState::kRunning && stream_->getState() == StreamState::Started && !gain_.FadeOut()) {
+    AV_LOGW("Oboe fade-out not rendered, stopping anyway.");
   }
-  auto result = stream_->requestStop();
-  if (result != Result::OK) {
-    AV_LOGE("Oboe request stop failed, reason: %s", convertToText(result));
-    return SV_STOP_PLAYER_ERROR;
+  // Callbacks go silent before the stream is stopped and parked. Also parks
+  // a stream the callback already stopped at the end of the source.
+  control_.Quiesce();
+  ParkStream();
+  source_->Release();
+  if (latency_tuner_.enabled()) {
+    AV_LOGI("Oboe buffer size: %d frames, grown %lld times, shrunk %lld times.", latency_tuner_.buffer_size(),
+            (long long) latency_tuner_.grow_count(), (long long) latency_tuner_.shrink_count());
   }
   AV_LOGI("Stop playout end.");
+  control_.FinishStop();
+  return SV_NO_ERROR;
+}
+
+int SVOboeRender::PausePlayout() {
+  AV_LOGI("Pause playout.");
+  return control_.Pause(&gain_);
+}
+
+int SVOboeRender::ResumePlayout() {
+  AV_LOGI("Resume playout.");
+  return control_.Resume(&gain_);
+}
+
+int SVOboeRender::SetGain(float gain, int ramp_ms, SVGainCurve curve) {
+  gain_.SetGain(gain, ramp_ms, curve);
+  return SV_NO_ERROR;
+}
+
+int SVOboeRender::GetStats(SVRenderStatsSnapshot* stats) {
+  std::lock_guard<std::mutex> lock(stream_mutex_);
+  if (!stream_) {
+    AV_LOGW("Oboe get stats failed, stream not open.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  *stats = stats_.Snapshot();
+  auto xrun_count = stream_->getXRunCount();
+  if (xrun_count) {
+    stats->xrun_count = xrun_carry_ + xrun_count.value() - xrun_base_;
+  }
+  auto latency = stream_->calculateLatencyMillis();
+  if (latency) {
+    stats->output_latency_ms = latency.value();
+  }
   return SV_NO_ERROR;
 }
 
-} // sv_render
\ No newline at end of file
+} // sv_render
@@ -2,32 +2,113 @@
 #define AUDIO_PLAYOUT_SV_OBOE_RENDER_H
 
 #include "sv_common.h"
+#include "sv_pcm_source.h"
+#include "sv_converting_pcm_source.h"
+#include "sv_drift_estimator.h"
+#include "sv_latency_tuner.h"
+#include "sv_stream_recovery.h"
+#include "sv_warm_pool.h"
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <oboe/Oboe.h>
 using namespace oboe;
 
 namespace sv_render {
 
-class SVOboeRender :
-        public INativeAudioRender, AudioStreamDataCallback, AudioStreamErrorCallback {
+// Streams are pooled like SVAAudioRender's: StopPlayout() parks the stopped
+// stream, the next render in the same sample format starts on it instead of
+// opening one, and Prewarm() opens one ahead of the first render. Oboe
+// closes a stream whose device went away, an SVStreamRecovery then opens one
+// on the new default device and playback carries on where it stopped.
+class SVOboeRender : public INativeAudioRender {
 
 public:
     explicit SVOboeRender(const std::string& file_path);
+    explicit SVOboeRender(IPcmSource::Ptr source);
     ~SVOboeRender() override;
+    int SetSampleFormat(SV_SAMPLE_FORMAT format) override;
+    int SetLatencyPolicy(SV_LATENCY_POLICY policy) override;
     int InitAudioRender(int sample_rate, int channels) override;
     int StartPlayout() override;
     int StopPlayout() override;
+    int PausePlayout() override;
+    int ResumePlayout() override;
+    int SetGain(float gain, int ramp_ms, SVGainCurve curve) override;
+    int GetStats(SVRenderStatsSnapshot* stats) override;
+
+    // Opens a stream in this format and parks it for the next render.
+    static bool Prewarm(SV_SAMPLE_FORMAT format);
 
 private:
-    DataCallbackResult onAudioReady(AudioStream *oboeStream, void *audioData, int32_t numFrames) override;
-    bool onError(AudioStream*, Result) override;
-    bool ReadPlayoutData(int num_frames);
+    // The callbacks of a pooled stream, forwarding to the render it currently
+    // plays for; without one it plays silence. Registered with Oboe as a
+    // shared_ptr, so Oboe's error thread, which holds the stream and through
+    // it these, can run onErrorAfterClose() after the PooledStream is gone.
+    struct StreamCallback : AudioStreamDataCallback, AudioStreamErrorCallback {
+        DataCallbackResult onAudioReady(AudioStream *oboeStream, void *audioData, int32_t numFrames) override;
+        bool onError(AudioStream*, Result) override;
+        void onErrorAfterClose(AudioStream*, Result) override;
+        // Control side. Hands the callbacks to render, nullptr takes them
+        // back; an error callback still using the old one is waited for.
+        void Bind(SVOboeRender* owner);
+
+        std::atomic<SVOboeRender*> render { nullptr };
+        // Set by onError(), the stream is never started again.
+        std::atomic<bool> dead { false };
+        // Held by Bind() and by the error callbacks while they use render.
+        std::mutex error_mutex;
+    };
+    // An open stream and its callbacks.
+    struct PooledStream {
+        ~PooledStream();
+        // Whether a render can start it: not disconnected, also not while
+        // it was parked, and open or stopped.
+        bool Usable() const;
+
+        std::shared_ptr<StreamCallback> callback;
+        std::shared_ptr<AudioStream> stream;
+    };
+    static SVWarmPool<int, PooledStream>& stream_pool();
+    // channels 0 lets the device pick its layout.
+    static std::unique_ptr<PooledStream> OpenStream(SV_SAMPLE_FORMAT format, int channels = kUnspecified);
+    // Stops the stream and parks it, no callback runs once it returns.
+    void ParkStream();
+    // SVStreamRecovery's reopen: the same format and layout on the current
+    // default device, at whatever rate it runs.
+    bool ReopenStream();
+
+    DataCallbackResult onAudioReady(AudioStream *oboeStream, void *audioData, int32_t numFrames);
+    // Audio thread. Tells the source how long a frame written now waits in
+    // the device, for live sources holding their latency against drift.
+    void UpdateDeviceLatency(AudioStream *oboeStream);
 private:
-    FILE* file_;
-    AudioStreamBuilder builder_;
+    // Converts the content to the rate the device opened at.
+    std::shared_ptr<SVConvertingPcmSource> source_;
+    SVRenderStats stats_;
+    SVGainStage gain_;
+    SVStreamControl control_;
+    std::unique_ptr<PooledStream> pooled_stream_;
+    // Format the stream was taken from the pool for, it goes back under it.
+    SV_SAMPLE_FORMAT pool_format_ = SV_SAMPLE_FORMAT_FLOAT;
+    // pooled_stream_->stream while this render holds one. Swapped by a
+    // recovery, so GetStats() reads it under stream_mutex_.
     std::shared_ptr<AudioStream> stream_;
-    bool initialized_;
-    std::unique_ptr<int16_t[]> audio_buffers_;
+    std::mutex stream_mutex_;
+    // Xruns the stream had counted before this render got it, and those of
+    // streams lost to a disconnect.
+    int64_t xrun_base_ = 0;
+    int64_t xrun_carry_ = 0;
+    int channels_ = 0;
+    // Float by default, it is what the mixer runs in.
+    SV_SAMPLE_FORMAT sample_format_ = SV_SAMPLE_FORMAT_FLOAT;
+    // Resizes the stream buffer from the callback as xruns come and go.
+    SV_LATENCY_POLICY latency_policy_ = SV_LATENCY_POLICY_BALANCED;
+    SVLatencyTuner latency_tuner_;
+    // Audio thread.
+    SVDeviceTimestamp device_timestamp_;
+    // Last, its thread reopens with everything above.
+    SVStreamRecovery recovery_;
 };
 
 } // sv_render
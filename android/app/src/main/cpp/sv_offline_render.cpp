@@ -0,0 +1,299 @@
+#include "sv_offline_render.h"
+#include "sv_converting_pcm_source.h"
+#include "sv_wav_file.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace sv_render {
+
+namespace {
+
+// An underrunning source is polled this often until it caught up.
+constexpr std::chrono::microseconds kUnderrunPollInterval { 200 };
+// Input frames each shard renders ahead of its first one, more than the
+// longest resampler filter reaches back.
+constexpr int64_t kWarmupInputFrames = 256;
+// Shards rendered but not yet written, per worker, bounding the memory.
+constexpr int64_t kShardsAheadPerThread = 2;
+
+int64_t Gcd(int64_t a, int64_t b) {
+  while (b != 0) {
+    const int64_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+int64_t RoundUp(int64_t value, int64_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+bool EndsWith(const std::string& text, const char* suffix) {
+  const size_t length = strlen(suffix);
+  return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+} // namespace
+
+bool SVBlockingPcmSource::Prepare(int sample_rate, int channels) {
+  channels_ = channels;
+  return source_->Prepare(sample_rate, channels);
+}
+
+template <typename Sample, typename RenderFunction>
+int SVBlockingPcmSource::RenderAll(Sample* dst, int num_frames, RenderFunction render) {
+  int rendered = 0;
+  while (rendered < num_frames) {
+    const int frames = render(dst + rendered * channels_, num_frames - rendered);
+    rendered += frames;
+    if (frames == 0) {
+      if (source_->IsEnd() || (give_up_ && give_up_())) break;
+      std::this_thread::sleep_for(kUnderrunPollInterval);
+    }
+  }
+  return rendered;
+}
+
+int SVBlockingPcmSource::Render(int16_t* dst, int num_frames) {
+  return RenderAll(dst, num_frames, [this](int16_t* out, int frames) { return source_->Render(out, frames); });
+}
+
+int SVBlockingPcmSource::RenderFloat(float* dst, int num_frames) {
+  return RenderAll(dst, num_frames, [this](float* out, int frames) { return source_->RenderFloat(out, frames); });
+}
+
+SVOfflineRender::SVOfflineRender(IPcmSource::Ptr source, const SVOfflineRenderConfig& config)
+  : source_(std::move(source)),
+  config_(config) {
+}
+
+SVOfflineRender::SVOfflineRender(SourceFactory factory, const SVOfflineRenderConfig& config)
+  : factory_(std::move(factory)),
+  config_(config) {
+}
+
+size_t SVOfflineRender::BytesPerFrame() const {
+  return channels_ * (config_.sample_format == SV_SAMPLE_FORMAT_FLOAT ? sizeof(float) : sizeof(int16_t));
+}
+
+int SVOfflineRender::Render(int sample_rate, int channels) {
+  AV_LOGI("SVOfflineRender render, sample_rate:%d, channels:%d, burst:%d", sample_rate, channels,
+          config_.frames_per_burst);
+  if (sample_rate <= 0 || channels <= 0 || config_.frames_per_burst <= 0) {
+    AV_LOGE("SVOfflineRender invalid configuration.");
+    return SV_PLAY_INIT_ERROR;
+  }
+  if (!source_ && factory_) {
+    source_ = factory_();
+  }
+  if (!source_) {
+    AV_LOGE("SVOfflineRender no content, or already rendered.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  content_rate_ = sample_rate;
+  content_channels_ = channels;
+  sample_rate_ = config_.sample_rate > 0 ? config_.sample_rate : sample_rate;
+  channels_ = config_.channels > 0 ? config_.channels : channels;
+
+  FILE* raw_file = nullptr;
+  std::unique_ptr<SVWavWriter> wav_writer;
+  if (EndsWith(config_.output_path, ".wav")) {
+    SVWavFormat format;
+    format.encoding = config_.sample_format == SV_SAMPLE_FORMAT_FLOAT ? SVWavEncoding::kFloat32
+                                                                       : SVWavEncoding::kPcm16;
+    format.sample_rate = sample_rate_;
+    format.channels = channels_;
+    wav_writer.reset(new SVWavWriter(config_.output_path, format));
+    if (!wav_writer->IsOpen()) {
+      return SV_PLAY_INIT_ERROR;
+    }
+  } else if (!config_.output_path.empty()) {
+    raw_file = fopen(config_.output_path.c_str(), "wb");
+    if (!raw_file) {
+      AV_LOGE("SVOfflineRender open output failed: %s", config_.output_path.c_str());
+      return SV_PLAY_INIT_ERROR;
+    }
+  }
+  const size_t frame_bytes = BytesPerFrame();
+  const bool float_samples = config_.sample_format == SV_SAMPLE_FORMAT_FLOAT;
+  const Writer write = [&](const void* data, int num_frames) {
+    frames_rendered_ += num_frames;
+    if (wav_writer) {
+      return float_samples ? wav_writer->Write(static_cast<const float*>(data), num_frames)
+                           : wav_writer->Write(static_cast<const int16_t*>(data), num_frames);
+    }
+    return !raw_file || fwrite(data, frame_bytes, num_frames, raw_file) == static_cast<size_t>(num_frames);
+  };
+
+  // Shards start where the resampler's position is on a whole input frame
+  // and on a burst boundary, so the bursts line up with the whole stream's.
+  const int64_t burst = config_.frames_per_burst;
+  const int64_t resampler_period = sample_rate_ / Gcd(content_rate_, sample_rate_);
+  const int64_t align = burst / Gcd(burst, resampler_period) * resampler_period;
+  warmup_frames_ = RoundUp(kWarmupInputFrames * sample_rate_ / content_rate_ + 1, align);
+  // Later shards play no fade-in, they start after it.
+  const int64_t fade_frames = static_cast<int64_t>(config_.fade_ms) * sample_rate_ / 1000;
+  shard_frames_ = RoundUp(std::max(static_cast<int64_t>(config_.shard_ms) * sample_rate_ / 1000,
+                                   warmup_frames_ + fade_frames), align);
+  const bool sharded = factory_ && config_.threads > 1 && source_->CanSeek();
+  if (factory_ && config_.threads > 1 && !sharded) {
+    AV_LOGW("SVOfflineRender content can't seek, rendering it on one thread.");
+  }
+
+  const auto begin = std::chrono::steady_clock::now();
+  bool ok = false;
+  if (sharded) {
+    AV_LOGI("SVOfflineRender %d threads, shards of %lld frames, warm-up %lld frames.", config_.threads,
+            (long long) shard_frames_, (long long) warmup_frames_);
+    ok = RenderSharded(write);
+  } else {
+    bool drained = false;
+    ok = RenderRange(source_, 0, 0, -1, write, &drained);
+    shard_count_ = 1;
+  }
+  wall_seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  source_.reset();
+
+  if (wav_writer && !wav_writer->Close()) {
+    ok = false;
+  }
+  if (raw_file && fclose(raw_file) != 0) {
+    ok = false;
+  }
+  AV_LOGI("SVOfflineRender %lld frames in %.3fs, realtime factor %.1f, %lld shards", (long long) frames_rendered_,
+          wall_seconds_, realtime_factor(), (long long) shard_count_);
+  return ok ? SV_NO_ERROR : SV_FILL_BUFFER_ERROR;
+}
+
+bool SVOfflineRender::RenderRange(IPcmSource::Ptr content, int64_t start, int64_t begin, int64_t end,
+                                  const Writer& write, bool* drained) {
+  // The pipeline of SVVirtualRender, with the content made to wait for.
+  SVConvertingPcmSource source(std::make_shared<SVBlockingPcmSource>(std::move(content)));
+  source.SetSourceSampleRate(content_rate_);
+  source.SetSourceChannels(content_channels_);
+  // A whole number of input frames, see the alignment in Render().
+  if (start > 0 && !source.Seek(start * content_rate_ / sample_rate_)) {
+    AV_LOGE("SVOfflineRender seek to frame %lld failed.", (long long) start);
+    return false;
+  }
+  if (!source.Prepare(sample_rate_, channels_)) {
+    AV_LOGE("SVOfflineRender prepare pcm source failed.");
+    return false;
+  }
+  const int burst = config_.frames_per_burst;
+  source.SkipDither(start / burst, burst);
+  SVGainStage gain;
+  gain.set_fade_ms(start > 0 ? 0 : config_.fade_ms);
+  gain.Prepare(sample_rate_);
+  gain.FadeIn();
+
+  const bool float_samples = config_.sample_format == SV_SAMPLE_FORMAT_FLOAT;
+  std::unique_ptr<float[]> buffer(new float[burst * channels_]);
+  bool ok = true;
+  *drained = false;
+  for (int64_t frame = start; end < 0 || frame < end; frame += burst) {
+    const bool keep_going = float_samples
+            ? RenderPcmSource(&source, buffer.get(), burst, channels_, nullptr, &gain)
+            : RenderPcmSource(&source, reinterpret_cast<int16_t*>(buffer.get()), burst, channels_, nullptr, &gain);
+    // Like the device, the burst that found the source drained is still played.
+    if (frame >= begin && !write(buffer.get(), burst)) {
+      ok = false;
+      break;
+    }
+    if (!keep_going) {
+      *drained = true;
+      break;
+    }
+  }
+  source.Release();
+  return ok;
+}
+
+bool SVOfflineRender::RenderSharded(const Writer& write) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shards_.clear();
+    next_shard_ = 0;
+    written_shards_ = 0;
+    last_shard_ = -1;
+    quit_ = false;
+  }
+  std::vector<std::thread> workers;
+  for (int i = 0; i < config_.threads; ++i) {
+    workers.emplace_back(&SVOfflineRender::WorkerLoop, this);
+  }
+  bool ok = true;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (int64_t index = 0;; ++index) {
+    cond_.wait(lock, [this, index] {
+      auto it = shards_.find(index);
+      return it != shards_.end() && it->second->done;
+    });
+    std::unique_ptr<Shard> shard = std::move(shards_[index]);
+    shards_.erase(index);
+    lock.unlock();
+    if (!shard->ok || !write(shard->data.data(), static_cast<int>(shard->data.size() / BytesPerFrame()))) {
+      ok = false;
+    }
+    lock.lock();
+    written_shards_ = index + 1;
+    shard_count_ = written_shards_;
+    cond_.notify_all();
+    if (!ok || shard->drained) {
+      break;
+    }
+  }
+  quit_ = true;
+  cond_.notify_all();
+  lock.unlock();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  shards_.clear();
+  return ok;
+}
+
+void SVOfflineRender::WorkerLoop() {
+  const int64_t max_ahead = kShardsAheadPerThread * config_.threads;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cond_.wait(lock, [this, max_ahead] { return quit_ || next_shard_ < written_shards_ + max_ahead; });
+    if (quit_ || (last_shard_ >= 0 && next_shard_ > last_shard_)) {
+      break;
+    }
+    const int64_t index = next_shard_++;
+    Shard* shard = (shards_[index] = std::unique_ptr<Shard>(new Shard())).get();
+    lock.unlock();
+
+    // The first shard plays the stream's start on the instance Render()
+    // opened, the others open their own.
+    IPcmSource::Ptr content = index == 0 ? source_ : factory_();
+    const int64_t begin = index * shard_frames_;
+    const int64_t start = index == 0 ? 0 : begin - warmup_frames_;
+    const size_t frame_bytes = BytesPerFrame();
+    shard->data.reserve(shard_frames_ * frame_bytes);
+    const Writer append = [shard, frame_bytes](const void* data, int num_frames) {
+      const auto* bytes = static_cast<const uint8_t*>(data);
+      shard->data.insert(shard->data.end(), bytes, bytes + num_frames * frame_bytes);
+      return true;
+    };
+    bool drained = false;
+    const bool ok = content && RenderRange(content, start, begin, begin + shard_frames_, append, &drained);
+
+    lock.lock();
+    shard->ok = ok;
+    shard->drained = drained;
+    shard->done = true;
+    if ((drained || !ok) && (last_shard_ < 0 || index < last_shard_)) {
+      last_shard_ = index;
+    }
+    cond_.notify_all();
+  }
+}
+
+} // sv_render
@@ -0,0 +1,163 @@
+#ifndef AUDIO_PLAYOUT_SV_OFFLINE_RENDER_H
+#define AUDIO_PLAYOUT_SV_OFFLINE_RENDER_H
+
+#include "sv_common.h"
+#include "sv_gain_stage.h"
+#include "sv_pcm_source.h"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sv_render {
+
+// Makes a source never come up short before its end: a render that finds it
+// underrunning waits for its background thread to catch up, or until
+// give_up returns true. For renders with no deadline only, offline and the
+// virtual device's fast mode, it blocks.
+class SVBlockingPcmSource : public IPcmSource {
+
+public:
+  explicit SVBlockingPcmSource(IPcmSource::Ptr source, std::function<bool()> give_up = nullptr)
+    : source_(std::move(source)),
+    give_up_(std::move(give_up)) {
+  }
+  ~SVBlockingPcmSource() override = default;
+
+  bool Prepare(int sample_rate, int channels) override;
+  void Release() override { source_->Release(); }
+  int Render(int16_t* dst, int num_frames) override;
+  bool IsEnd() const override { return source_->IsEnd(); }
+  bool CanRenderFloat() const override { return source_->CanRenderFloat(); }
+  int RenderFloat(float* dst, int num_frames) override;
+  bool CanSeek() const override { return source_->CanSeek(); }
+  bool Seek(int64_t frame) override { return source_->Seek(frame); }
+  int64_t QueuedFrames() const override { return source_->QueuedFrames(); }
+  void SetDeviceLatency(double seconds) override { source_->SetDeviceLatency(seconds); }
+
+private:
+  template <typename Sample, typename RenderFunction>
+  int RenderAll(Sample* dst, int num_frames, RenderFunction render);
+
+  const IPcmSource::Ptr source_;
+  const std::function<bool()> give_up_;
+  int channels_ = 0;
+};
+
+struct SVOfflineRenderConfig {
+  // Frames per pass through the pipeline, the callback size of the device
+  // whose output this matches bit for bit.
+  int frames_per_burst = 192;
+  // Output rate and channel count, 0 follows the content.
+  int sample_rate = 0;
+  int channels = 0;
+  SV_SAMPLE_FORMAT sample_format = SV_SAMPLE_FORMAT_I16;
+  // Fade-in at the start, like StartPlayout(); 0 cuts.
+  int fade_ms = SVGainStage::kDefaultFadeMs;
+  // Worker threads for content that can be sharded, see SVOfflineRender, and
+  // output each of them renders at a time.
+  int threads = 1;
+  int shard_ms = 10000;
+  // Raw PCM in the output format, a WAV file if the name ends in ".wav".
+  // Empty renders into a null sink, to measure the speed alone.
+  std::string output_path;
+};
+
+// Renders content through the same pipeline a device stream plays it with,
+// SVConvertingPcmSource and SVGainStage called a burst at a time exactly as
+// the backends' callbacks call them, with no device: as fast as the CPU goes,
+// into a file. The output is what SVVirtualRender writes to its sink for the
+// same content, burst size and fade, byte for byte, minus its underruns.
+//
+// Content that a factory can open again and that seeks is cut into shards of
+// about shard_ms, rendered on config.threads threads and written in order.
+// Each shard starts its own pipeline a little ahead of its first frame, so
+// the resampler's filter is full again by then, and at a frame where the
+// resampler's position falls exactly on an input frame; the dither is moved
+// on to where the whole stream would have it and the fade-in is only played
+// by the first. The shards then join without a trace: output is the same at
+// any thread count.
+class SVOfflineRender {
+
+public:
+  // A new instance of the content per call.
+  using SourceFactory = std::function<IPcmSource::Ptr()>;
+
+  // Renders source in one piece, on the calling thread.
+  SVOfflineRender(IPcmSource::Ptr source, const SVOfflineRenderConfig& config);
+  // Shards the content when the factory's sources can seek.
+  SVOfflineRender(SourceFactory factory, const SVOfflineRenderConfig& config);
+
+  // Control thread. Renders all of the content, in the given layout, and
+  // returns when it is written: SV_NO_ERROR, SV_PLAY_INIT_ERROR if the
+  // output didn't open, SV_PLAY_STATE_ERROR without content, e.g. once it
+  // was rendered, and SV_FILL_BUFFER_ERROR if the content or the output
+  // failed midway.
+  int Render(int sample_rate, int channels);
+
+  int device_sample_rate() const { return sample_rate_; }
+  int64_t frames_rendered() const { return frames_rendered_; }
+  double audio_seconds() const {
+    return sample_rate_ > 0 ? static_cast<double>(frames_rendered_) / sample_rate_ : 0.0;
+  }
+  double wall_seconds() const { return wall_seconds_; }
+  // Seconds of audio per second of wall clock.
+  double realtime_factor() const { return wall_seconds_ > 0.0 ? audio_seconds() / wall_seconds_ : 0.0; }
+  // Shards written, 1 for content rendered in one piece, and the frames each
+  // rendered ahead of its first one.
+  int64_t shard_count() const { return shard_count_; }
+  int64_t warmup_frames() const { return warmup_frames_; }
+
+private:
+  // One shard's output, filled by a worker and written by the control thread.
+  struct Shard {
+    std::vector<uint8_t> data;
+    bool done = false;
+    bool ok = true;
+    // The stream ended in this shard.
+    bool drained = false;
+  };
+  using Writer = std::function<bool(const void* data, int num_frames)>;
+
+  // Runs the pipeline from output frame start, on a fresh content instance
+  // seeked there, and writes the frames from begin up to end, -1 for all.
+  // False if it failed; drained once the stream ended.
+  bool RenderRange(IPcmSource::Ptr content, int64_t start, int64_t begin, int64_t end, const Writer& write,
+                   bool* drained);
+  // Control thread, writes shards in order as the workers finish them.
+  bool RenderSharded(const Writer& write);
+  void WorkerLoop();
+  size_t BytesPerFrame() const;
+
+private:
+  IPcmSource::Ptr source_;
+  const SourceFactory factory_;
+  const SVOfflineRenderConfig config_;
+  int content_rate_ = 0;
+  int content_channels_ = 0;
+  int sample_rate_ = 0;
+  int channels_ = 0;
+  int64_t shard_frames_ = 0;
+  int64_t warmup_frames_ = 0;
+  int64_t frames_rendered_ = 0;
+  int64_t shard_count_ = 0;
+  double wall_seconds_ = 0.0;
+
+  // Shard queue. Workers take the next index while they are few enough
+  // ahead of the writer, and none past the one the stream ended in.
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::map<int64_t, std::unique_ptr<Shard>> shards_;
+  int64_t next_shard_ = 0;
+  int64_t written_shards_ = 0;
+  int64_t last_shard_ = -1;
+  bool quit_ = false;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_OFFLINE_RENDER_H
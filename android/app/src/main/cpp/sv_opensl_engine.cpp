@@ -0,0 +1,96 @@
+#include "sv_opensl_engine.h"
+#include "sv_opensl_render.h"
+#include "log.h"
+#include <mutex>
+
+namespace sv_render {
+
+namespace {
+
+std::mutex g_engine_mutex;
+// The engine the renders share, gone once the last one released it.
+std::weak_ptr<SVOpenslEngine> g_engine;
+// Set by Prewarm(), keeps the engine alive with no render around.
+SVOpenslEngine::Ptr g_prewarmed_engine;
+
+} // namespace
+
+SVOpenslPlayer::~SVOpenslPlayer() {
+  if (object) {
+    (*object)->Destroy(object);
+  }
+}
+
+SVOpenslEngine::Ptr SVOpenslEngine::Acquire() {
+  std::lock_guard<std::mutex> lock(g_engine_mutex);
+  Ptr engine = g_engine.lock();
+  if (engine) {
+    return engine;
+  }
+  engine.reset(new SVOpenslEngine());
+  if (engine->Create() != SV_NO_ERROR) {
+    return nullptr;
+  }
+  g_engine = engine;
+  return engine;
+}
+
+bool SVOpenslEngine::Prewarm() {
+  Ptr engine = Acquire();
+  if (!engine) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(g_engine_mutex);
+  g_prewarmed_engine = engine;
+  return true;
+}
+
+SVOpenslEngine::~SVOpenslEngine() {
+  // Players first, they play into the output mix.
+  player_pool_.Clear();
+  if (sl_output_mix_) {
+    (*sl_output_mix_)->Destroy(sl_output_mix_);
+  }
+  if (sl_object_) {
+    (*sl_object_)->Destroy(sl_object_);
+  }
+  AV_LOGI("SVOpenslEngine destroyed.");
+}
+
+SV_RESULT SVOpenslEngine::Create() {
+  const SLEngineOption option[] = {
+          {SL_ENGINEOPTION_THREADSAFE, static_cast<SLuint32>(SL_BOOLEAN_TRUE)}};
+  SLresult result = slCreateEngine(&sl_object_, 1, option, 0, nullptr, nullptr);
+  if (result != SL_RESULT_SUCCESS) {
+    AV_LOGE("slCreateEngine failed, reason:%s", GetSLErrorString(result));
+    return SV_CRATE_ENGINE_ERROR;
+  }
+
+  result = (*sl_object_)->Realize(sl_object_, SL_BOOLEAN_FALSE);
+  if (result != SL_RESULT_SUCCESS) {
+    AV_LOGE("sl_object realize failed, reason:%s", GetSLErrorString(result));
+    return SV_CRATE_ENGINE_ERROR;
+  }
+
+  result = (*sl_object_)->GetInterface(sl_object_, SL_IID_ENGINE, &sl_engine_);
+  if (result != SL_RESULT_SUCCESS) {
+    AV_LOGE("sl_object GetInterface failed, reason:%s", GetSLErrorString(result));
+    return SV_CRATE_ENGINE_ERROR;
+  }
+
+  result = (*sl_engine_)->CreateOutputMix(sl_engine_, &sl_output_mix_, 0, nullptr, nullptr);
+  if (result != SL_RESULT_SUCCESS) {
+    AV_LOGW("CreateOutputMix failed, reason: %s", GetSLErrorString(result));
+    return SV_CRATE_ENGINE_ERROR;
+  }
+
+  result = (*sl_output_mix_)->Realize(sl_output_mix_, SL_BOOLEAN_FALSE);
+  if (result != SL_RESULT_SUCCESS) {
+    AV_LOGW("sl_output_mix Realize failed, reason:%s", GetSLErrorString(result));
+    return SV_CRATE_ENGINE_ERROR;
+  }
+  AV_LOGI("SVOpenslEngine created.");
+  return SV_NO_ERROR;
+}
+
+} // sv_render
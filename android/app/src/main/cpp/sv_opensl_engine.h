@@ -0,0 +1,64 @@
+#ifndef AUDIO_PLAYOUT_SV_OPENSL_ENGINE_H
+#define AUDIO_PLAYOUT_SV_OPENSL_ENGINE_H
+
+#include <SLES/OpenSLES.h>
+#include <SLES/OpenSLES_Android.h>
+#include <memory>
+#include <tuple>
+#include "sv_common.h"
+#include "sv_warm_pool.h"
+
+namespace sv_render {
+
+// A realized OpenSL player with its buffer queue, destroyed with the object.
+struct SVOpenslPlayer {
+  SVOpenslPlayer() = default;
+  ~SVOpenslPlayer();
+  SVOpenslPlayer(const SVOpenslPlayer&) = delete;
+  SVOpenslPlayer& operator=(const SVOpenslPlayer&) = delete;
+
+  SLObjectItf object = nullptr;
+  SLPlayItf play = nullptr;
+  SLAndroidSimpleBufferQueueItf buffer_queue = nullptr;
+};
+
+// Sample format and queue length a player was created with.
+using SVOpenslPlayerKey = std::tuple<int, int>;
+
+// The process's OpenSL engine and output mix. OpenSL allows one engine per
+// process, so every render shares it. Creating and realizing them, then a
+// player, is most of what a cold start costs; the engine lives while any
+// render holds it, or until the process exits once prewarmed, and keeps the
+// players of stopped renders parked for the next render in the same format.
+class SVOpenslEngine {
+
+public:
+  using Ptr = std::shared_ptr<SVOpenslEngine>;
+
+  // The shared engine, created on first use. nullptr if OpenSL failed.
+  static Ptr Acquire();
+  // Creates the engine ahead and keeps it for the process lifetime.
+  static bool Prewarm();
+
+  ~SVOpenslEngine();
+  SVOpenslEngine(const SVOpenslEngine&) = delete;
+  SVOpenslEngine& operator=(const SVOpenslEngine&) = delete;
+
+  SLEngineItf engine() const { return sl_engine_; }
+  SLObjectItf output_mix() const { return sl_output_mix_; }
+  // Stopped players, no callback registered.
+  SVWarmPool<SVOpenslPlayerKey, SVOpenslPlayer>& player_pool() { return player_pool_; }
+
+private:
+  SVOpenslEngine() = default;
+  SV_RESULT Create();
+
+  SLObjectItf sl_object_ { nullptr };
+  SLEngineItf sl_engine_ { nullptr };
+  SLObjectItf sl_output_mix_ { nullptr };
+  SVWarmPool<SVOpenslPlayerKey, SVOpenslPlayer> player_pool_;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_OPENSL_ENGINE_H
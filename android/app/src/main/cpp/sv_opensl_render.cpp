@@ -1,142 +1,274 @@
 #include "sv_opensl_render.h"
+#include "sv_rt_audit.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <memory>
+#include <thread>
 
 namespace sv_render {
 
-SVOpenslRender::SVOpenslRender(const std::string &file_path): file_(nullptr) {
+namespace {
+
+// StopPlayout() checks how far the device got this often.
+constexpr std::chrono::milliseconds kQueuePollInterval { 1 };
+
+} // namespace
+
+SVOpenslRender::SVOpenslRender(const std::string &file_path)
+  : SVOpenslRender(CreateFilePcmSource(file_path)) {
+}
+
+SVOpenslRender::SVOpenslRender(IPcmSource::Ptr source)
+  : source_(std::make_shared<SVConvertingPcmSource>(std::move(source))),
+  engine_(SVOpenslEngine::Acquire()) {
   AV_LOGI("SVOpenslRender Constructor.");
-  file_ = fopen(file_path.c_str(), "rb");
-  AV_LOGI("open file address: %p", file_);
-  CreatePlayerEngine();
 }
 
 SVOpenslRender::~SVOpenslRender() {
   AV_LOGI("SVOpenslRender Deconstruct");
+  if (control_.state() != SVStreamState::kClosed) {
+    StopPlayout();
+  }
+}
+
+int SVOpenslRender::SetSampleFormat(SV_SAMPLE_FORMAT format) {
+  if (!control_.SetWhileClosed([&] { sample_format_ = format; })) {
+    AV_LOGW("SVOpenslRender set sample format failed, already initialized.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  return SV_NO_ERROR;
 }
 
 int SVOpenslRender::InitAudioRender(int sample_rate, int channels) {
+  return InitAudioRender(sample_rate, channels, SVOpenslBufferConfig());
+}
+
+int SVOpenslRender::InitAudioRender(int sample_rate, int channels, const SVOpenslBufferConfig& config) {
 
   AV_LOGI("SVOpenslRender init.");
-  if (initialized_) {
-    AV_LOGW("SVOpenslRender not initialized.");
+  if (!control_.Transition(SVStreamState::kClosed, SVStreamState::kOpening)) {
+    AV_LOGW("SVOpenslRender init failed, stream %s.", SVStreamControl::StateName(control_.state()));
     return SV_PLAY_STATE_ERROR;
   }
 
-  if (!sl_engine_) {
-    AV_LOGW("sl_engine_ is nullptr.");
+  const bool auto_buffers = config.num_buffers == SVOpenslBufferConfig::kAutoNumBuffers;
+  const int pool_size = auto_buffers ? config.max_buffers : config.num_buffers;
+  if (pool_size < 1 || pool_size > SVOpenslBufferConfig::kMaxNumBuffers || config.buffer_ms < 1 ||
+      config.buffer_ms > 1000) {
+    AV_LOGW("Invalid buffer config, %d buffers (max %d) of %d ms.", config.num_buffers, config.max_buffers,
+            config.buffer_ms);
+    control_.Transition(SVStreamState::kOpening, SVStreamState::kClosed);
     return SV_PLAY_INIT_ERROR;
   }
 
-  // Allocate audio buffer.
-  const size_t buffer_size_in_samples = sample_rate / 100 * channels;
-  audio_buffers_.reset(new SLint16[buffer_size_in_samples]);
-
-  SLresult  result = (*sl_engine_)->CreateOutputMix(sl_engine_, &sl_output_mix_, 0, nullptr, nullptr);
-  if (result != SL_RESULT_SUCCESS) {
-    AV_LOGW("CreateOutputMix failed, reason: %s", GetSLErrorString(result));
+  if (!engine_) {
+    AV_LOGW("OpenSL engine is nullptr.");
+    control_.Transition(SVStreamState::kOpening, SVStreamState::kClosed);
     return SV_PLAY_INIT_ERROR;
   }
 
-  result = (*sl_output_mix_)->Realize(sl_output_mix_, SL_BOOLEAN_FALSE);
-  if (result != SL_RESULT_SUCCESS) {
-    AV_LOGW("sl_output_mix Realize failed, reason:%s", GetSLErrorString(result));
+  sample_rate_ = kDeviceSampleRate;
+  channels_ = kDeviceChannels;
+
+  source_->SetSourceSampleRate(sample_rate);
+  source_->SetSourceChannels(channels);
+  if (!source_->Prepare(sample_rate_, channels_)) {
+    AV_LOGW("Prepare pcm source failed.");
+    control_.Transition(SVStreamState::kOpening, SVStreamState::kClosed);
     return SV_PLAY_INIT_ERROR;
   }
+  buffer_config_ = config;
+  pool_size_ = pool_size;
+  frames_per_buffer_ = sample_rate_ * config.buffer_ms / 1000;
+  tuner_.Configure(auto_buffers ? std::min(2, pool_size) : pool_size, pool_size, config.max_underrun_rate,
+                   config.tuner_window_buffers);
+  queue_underruns_.store(0, std::memory_order_relaxed);
+  next_buffer_ = 0;
+  stats_.Reset(sample_rate_);
+  gain_.Prepare(sample_rate_);
+  const size_t pool_samples = static_cast<size_t>(pool_size_) * frames_per_buffer_ * channels_;
+  if (sample_format_ == SV_SAMPLE_FORMAT_FLOAT) {
+    float_buffers_.reset(new float[pool_samples]);
+  } else {
+    audio_buffers_.reset(new SLint16[pool_samples]);
+  }
+  AV_LOGI("SVOpenslRender queue: %s%d buffers of %d frames.", auto_buffers ? "auto, up to " : "", pool_size_,
+          frames_per_buffer_);
 
-  sample_rate_ = sample_rate;
-  channels_ = channels;
-  initialized_ = true;
+  control_.Transition(SVStreamState::kOpening, SVStreamState::kOpen);
   AV_LOGI("InitAudioRender done.");
   return SV_NO_ERROR;
 }
 
 int SVOpenslRender::StartPlayout() {
 
-  if (!initialized_ || playing_) {
-    AV_LOGW("SVOpenslRender StartPlayout state error.");
+  if (!control_.Transition(SVStreamState::kOpen, SVStreamState::kStarting)) {
+    AV_LOGW("SVOpenslRender StartPlayout failed, stream %s.", SVStreamControl::StateName(control_.state()));
     return SV_PLAY_STATE_ERROR;
   }
 
-  if (CreateAudioPlayer() != SL_RESULT_SUCCESS) {
+  stats_.MarkStartRequested();
+  // Before priming, the first buffer already fades in.
+  gain_.FadeIn();
+  if (CreateAudioPlayer() != SV_NO_ERROR) {
     AV_LOGW("Create Audio player error.");
+    control_.Transition(SVStreamState::kStarting, SVStreamState::kOpen);
     return SV_START_PLAY_ERROR;
   }
 
-  if (!FillBufferQueue(false)) {
-    return SV_FILL_BUFFER_ERROR;
+  // Prime the whole queue, a short source may end before it is full.
+  const int num_buffers = tuner_.count();
+  for (int i = 0; i < num_buffers; ++i) {
+    if (!FillBufferQueue(false)) {
+      if (i == 0) {
+        control_.Transition(SVStreamState::kStarting, SVStreamState::kOpen);
+        return SV_FILL_BUFFER_ERROR;
+      }
+      break;
+    }
   }
 
   auto result = (*sl_player_)->SetPlayState(sl_player_, SL_PLAYSTATE_PLAYING);
   if (result != SL_RESULT_SUCCESS) {
     AV_LOGW("Set playing state failed.");  // Maybe permission problem.
+    control_.Transition(SVStreamState::kStarting, SVStreamState::kOpen);
     return SV_START_PLAY_ERROR;
   }
-
-  SLuint32 play_state = SL_PLAYSTATE_STOPPED;
-  (*sl_player_)->GetPlayState(sl_player_, &play_state);
-
-  playing_ = (play_state == SL_PLAYSTATE_PLAYING);
+  control_.FinishStart();
   return SV_NO_ERROR;
 }
 
 int SVOpenslRender::StopPlayout() {
   AV_LOGI("StopPlayout start.");
-  if (!initialized_ || !playing_) {
+  SVStreamState previous;
+  if (!control_.BeginStop(&previous)) {
+    AV_LOGW("StopPlayout failed, stream %s.", SVStreamControl::StateName(control_.state()));
     return SV_PLAY_STATE_ERROR;
   }
-  if ((*sl_player_)->SetPlayState(sl_player_, SL_PLAYSTATE_STOPPED) != SL_RESULT_SUCCESS) {
-    AV_LOGW("Stop Playout setPlayState error.");
-    return SV_STOP_PLAYER_ERROR;
+  // Stopping drops the queue, so the buffers up to the end of the fade-out
+  // have to play first.
+  if (previous == SVStreamState::kRunning) {
+    if (gain_.FadeOut()) {
+      WaitForQueuedBuffers();
+    } else {
+      AV_LOGW("Fade-out not rendered, stopping anyway.");
+    }
   }
-  if ((*simple_buffer_queue_)->Clear(simple_buffer_queue_) != SL_RESULT_SUCCESS) {
-    AV_LOGW("Stop Playout clear bufferQueue error. ");
-    return SV_STOP_PLAYER_ERROR;
+  // Closing, a callback leaves the queue alone; the one in flight, if any,
+  // returns before the player is stopped and cleared under it.
+  control_.Quiesce();
+  SV_RESULT stop_result = SV_NO_ERROR;
+  if (player_) {
+    if ((*sl_player_)->SetPlayState(sl_player_, SL_PLAYSTATE_STOPPED) != SL_RESULT_SUCCESS ||
+        (*simple_buffer_queue_)->Clear(simple_buffer_queue_) != SL_RESULT_SUCCESS) {
+      // Not reusable, destroyed instead of parked.
+      AV_LOGW("Stop Playout stopping the player failed.");
+      stop_result = SV_STOP_PLAYER_ERROR;
+      player_.reset();
+    } else {
+      // Stopped, cleared and without a callback the player is as good as new.
+      (*simple_buffer_queue_)->RegisterCallback(simple_buffer_queue_, nullptr, nullptr);
+      engine_->player_pool().Put(player_key(), std::move(player_));
+    }
+    sl_player_ = nullptr;
+    simple_buffer_queue_ = nullptr;
   }
-
-  (*simple_buffer_queue_)->RegisterCallback(simple_buffer_queue_, nullptr, nullptr);
-  (*sl_player_object_)->Destroy(sl_player_object_);
-  (*sl_object_)->Destroy(sl_object_);
-  sl_player_ = nullptr;
-  sl_player_object_ = nullptr;
-  sl_engine_ = nullptr;
-  sl_object_ = nullptr;
-  playing_ = false;
-  initialized_ = false;
-  AV_LOGI("StopPlayout end.");
-  return SV_NO_ERROR;
+  source_->Release();
+  AV_LOGI("StopPlayout end, %d buffers of %d frames, queue underruns: %lld.", num_buffers(), frames_per_buffer_,
+          (long long) queue_underruns_.load(std::memory_order_relaxed));
+  control_.FinishStop();
+  return stop_result;
 }
 
-SV_RESULT SVOpenslRender::CreatePlayerEngine() {
+int SVOpenslRender::PausePlayout() {
+  AV_LOGI("PausePlayout.");
+  return control_.Pause(&gain_);
+}
 
-   const SLEngineOption option[] = {
-           {SL_ENGINEOPTION_THREADSAFE, static_cast<SLuint32>(SL_BOOLEAN_TRUE)}};
-   SLresult result = slCreateEngine(&sl_object_, 1, option, 0, nullptr, nullptr);
-   if (result != SL_RESULT_SUCCESS) {
-     AV_LOGE("slCreateEngine failed, reason:%s", GetSLErrorString(result));
-     return SV_CRATE_ENGINE_ERROR;
-   }
+int SVOpenslRender::ResumePlayout() {
+  AV_LOGI("ResumePlayout.");
+  return control_.Resume(&gain_);
+}
 
-  result = (*sl_object_)->Realize(sl_object_, SL_BOOLEAN_FALSE);
-  if (result != SL_RESULT_SUCCESS) {
-    AV_LOGE("sl_object realize failed, reason:%s", GetSLErrorString(result));
-    return SV_CRATE_ENGINE_ERROR;
+void SVOpenslRender::WaitForQueuedBuffers() {
+  SLAndroidSimpleBufferQueueState state {0, 0};
+  if ((*simple_buffer_queue_)->GetState(simple_buffer_queue_, &state) != SL_RESULT_SUCCESS) {
+    return;
   }
-
-  result = (*sl_object_)->GetInterface(sl_object_, SL_IID_ENGINE, &sl_engine_);
-  if (result != SL_RESULT_SUCCESS) {
-    AV_LOGE("sl_object GetInterface failed, reason:%s", GetSLErrorString(result));
-    return SV_CRATE_ENGINE_ERROR;
+  // index counts the buffers played, each takes buffer_ms; a stalled device
+  // gets twice that.
+  const SLuint32 target = state.index + state.count;
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(2 * buffer_config_.buffer_ms * static_cast<int>(state.count));
+  while (static_cast<int32_t>(state.index - target) < 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(kQueuePollInterval);
+    (*simple_buffer_queue_)->GetState(simple_buffer_queue_, &state);
   }
+}
+
+int SVOpenslRender::SetGain(float gain, int ramp_ms, SVGainCurve curve) {
+  gain_.SetGain(gain, ramp_ms, curve);
+  return SV_NO_ERROR;
+}
 
+int SVOpenslRender::GetStats(SVRenderStatsSnapshot* stats) {
+  if (sample_rate_ <= 0) {
+    AV_LOGW("GetStats failed, not initialized.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  *stats = stats_.Snapshot();
+  // OpenSL reports neither xruns nor a timestamp. A callback finding the
+  // queue empty is the closest thing to an xrun, the app-side queue depth is
+  // the best latency estimate available.
+  stats->xrun_count = queue_underruns_.load(std::memory_order_relaxed);
+  stats->output_latency_ms = 1000.0 * frames_per_buffer_ * num_buffers() / sample_rate_;
   return SV_NO_ERROR;
- }
+}
+
+int SVOpenslRender::num_buffers() const {
+  return tuner_.count();
+}
+
+SVOpenslPlayerKey SVOpenslRender::player_key() const {
+  return SVOpenslPlayerKey(sample_format_, pool_size_);
+}
 
 void SVOpenslRender::SimpleBufferQueueCallback(SLAndroidSimpleBufferQueueItf caller, void* context) {
+  SVRtAuditScope audit_scope;
   auto* stream = reinterpret_cast<SVOpenslRender*>(context);
-  if (stream) stream->FillBufferQueue();
+  if (stream) {
+    SVStreamControl::CallbackScope control_scope(&stream->control_);
+    // Closing, StopPlayout() owns the queue; drained, it runs dry.
+    if (control_scope.closing() || control_scope.state() == SVStreamState::kDrained) {
+      return;
+    }
+    stream->stats_.MarkDeviceCallback();
+    stream->OnBufferConsumed(control_scope.render());
+  }
 }
 
-bool SVOpenslRender::FillBufferQueue(bool check_state) {
+void SVOpenslRender::OnBufferConsumed(bool render) {
+  SLAndroidSimpleBufferQueueState state {0, 0};
+  (*simple_buffer_queue_)->GetState(simple_buffer_queue_, &state);
+  // The device just finished a buffer; if none is left it is already
+  // starving while this callback refills.
+  const bool underrun = state.count == 0;
+  if (underrun) {
+    queue_underruns_.fetch_add(1, std::memory_order_relaxed);
+  }
+  // A buffer queue has no timestamps: what is enqueued now plays after the
+  // buffers still queued.
+  source_->SetDeviceLatency(static_cast<double>(state.count) * frames_per_buffer_ / sample_rate_);
+  const bool auto_buffers = buffer_config_.num_buffers == SVOpenslBufferConfig::kAutoNumBuffers;
+  const int num_buffers = auto_buffers ? tuner_.OnBufferConsumed(underrun) : pool_size_;
+  // Usually one buffer, more when the auto mode just grew the queue.
+  for (int queued = static_cast<int>(state.count); queued < num_buffers; ++queued) {
+    if (!FillBufferQueue(true, render)) break;
+  }
+}
+
+bool SVOpenslRender::FillBufferQueue(bool check_state, bool render) {
   if (check_state) {
     SLuint32  state = SL_PLAYSTATE_STOPPED;
     (*sl_player_)->GetPlayState(sl_player_, &state);
@@ -145,12 +277,45 @@ bool SVOpenslRender::FillBufferQueue(bool check_state) {
       return false;
     }
   }
-  if (!ReadPlayoutData()) {
-    AV_LOGW("FillBufferQueue failed, read playout data error.");
-    return false;
+  // The oldest buffer of the pool; at most pool_size_ are enqueued, so the
+  // device has finished with it.
+  const size_t buffer_offset = static_cast<size_t>(next_buffer_) * frames_per_buffer_ * channels_;
+  next_buffer_ = (next_buffer_ + 1) % pool_size_;
+  const void* binary_data = nullptr;
+  size_t size = 0;
+  if (!render) {
+    // Paused, the player keeps consuming buffers so it calls back on resume.
+    const size_t sample_size = sample_format_ == SV_SAMPLE_FORMAT_FLOAT ? sizeof(float) : sizeof(SLint16);
+    void* buffer = sample_format_ == SV_SAMPLE_FORMAT_FLOAT ? static_cast<void*>(float_buffers_.get() + buffer_offset)
+                                                            : static_cast<void*>(audio_buffers_.get() + buffer_offset);
+    size = frames_per_buffer_ * channels_ * sample_size;
+    memset(buffer, 0, size);
+    binary_data = buffer;
+  } else if (sample_format_ == SV_SAMPLE_FORMAT_FLOAT) {
+    float* buffer = float_buffers_.get() + buffer_offset;
+    if (!RenderPcmSource(source_.get(), buffer, frames_per_buffer_, channels_, &stats_, &gain_)) {
+      AV_LOGW("FillBufferQueue failed, read source end.");
+      // From the callback; a source ending while priming fails the start.
+      if (check_state) control_.MarkDrained();
+      return false;
+    }
+    binary_data = buffer;
+    size = frames_per_buffer_ * channels_ * sizeof(float);
+  } else {
+    // Source memory is enqueued directly when possible, it stays valid until Release().
+    SLint16* staging = audio_buffers_.get() + buffer_offset;
+    const SLint16* pcm_data = nullptr;
+    const int frames = AcquirePcmSource(source_.get(), staging, frames_per_buffer_, channels_, &pcm_data,
+                                       &stats_, &gain_);
+    if (frames == 0) {
+      AV_LOGW("FillBufferQueue failed, read source end.");
+      // From the callback; a source ending while priming fails the start.
+      if (check_state) control_.MarkDrained();
+      return false;
+    }
+    binary_data = pcm_data;
+    size = frames * channels_ * sizeof(SLint16);
   }
-  auto * binary_data = reinterpret_cast<SLint8 *>(audio_buffers_.get());
-  size_t size =  sample_rate_ / 100 * channels_ * 2;
   auto result = (*simple_buffer_queue_)->Enqueue(simple_buffer_queue_, binary_data, size);
   if (result != SL_RESULT_SUCCESS) {
     AV_LOGE("Enqueue failed: %s", GetSLErrorString(result));
@@ -159,65 +324,58 @@ bool SVOpenslRender::FillBufferQueue(bool check_state) {
   return true;
 }
 
-bool SVOpenslRender::ReadPlayoutData() {
-  const size_t per_size = sizeof(SLint16);
-  const size_t buf_size = sample_rate_ / 100 * channels_;
-  auto len = fread(audio_buffers_.get(), per_size, buf_size, file_);
-  if (len < buf_size) {
-    if (ferror(file_)) {
-      AV_LOGW("read file error.");
-    }
-    if (feof(file_)) {
-      AV_LOGW("read file end.");
-    }
-    fclose(file_);
-    return false;
-  }
-  return true;
-}
-
-SLDataFormat_PCM SVOpenslRender::CreatePCMConfiguration() const {
+SLAndroidDataFormat_PCM_EX SVOpenslRender::CreatePCMConfiguration() const {
 
-  SLDataFormat_PCM format;
-  format.formatType = SL_DATAFORMAT_PCM;
+  // The extended format is a superset of SLDataFormat_PCM, float needs it.
+  SLAndroidDataFormat_PCM_EX format;
   format.numChannels = static_cast<SLuint32>(channels_);
   switch (sample_rate_) {
     case 8000:
-      format.samplesPerSec = SL_SAMPLINGRATE_8;
+      format.sampleRate = SL_SAMPLINGRATE_8;
       break;
     case 16000:
-      format.samplesPerSec = SL_SAMPLINGRATE_16;
+      format.sampleRate = SL_SAMPLINGRATE_16;
       break;
     case 22050:
-      format.samplesPerSec = SL_SAMPLINGRATE_22_05;
+      format.sampleRate = SL_SAMPLINGRATE_22_05;
       break;
     case 24000:
-      format.samplesPerSec = SL_SAMPLINGRATE_24;
+      format.sampleRate = SL_SAMPLINGRATE_24;
       break;
     case 32000:
-      format.samplesPerSec = SL_SAMPLINGRATE_32;
+      format.sampleRate = SL_SAMPLINGRATE_32;
       break;
     case 44100:
-      format.samplesPerSec = SL_SAMPLINGRATE_44_1;
+      format.sampleRate = SL_SAMPLINGRATE_44_1;
       break;
     case 48000:
-      format.samplesPerSec = SL_SAMPLINGRATE_48;
+      format.sampleRate = SL_SAMPLINGRATE_48;
       break;
     case 64000:
-      format.samplesPerSec = SL_SAMPLINGRATE_64;
+      format.sampleRate = SL_SAMPLINGRATE_64;
       break;
     case 88200:
-      format.samplesPerSec = SL_SAMPLINGRATE_88_2;
+      format.sampleRate = SL_SAMPLINGRATE_88_2;
       break;
     case 96000:
-      format.samplesPerSec = SL_SAMPLINGRATE_96;
+      format.sampleRate = SL_SAMPLINGRATE_96;
       break;
     default:
-      AV_LOGW("Unsupported sample rate: %d ", sample_rate_);
+      AV_LOGW("Unsupported sample rate: %d, falling back to 48000.", sample_rate_);
+      format.sampleRate = SL_SAMPLINGRATE_48;
       break;
   }
-  format.bitsPerSample = SL_PCMSAMPLEFORMAT_FIXED_16;
-  format.containerSize = SL_PCMSAMPLEFORMAT_FIXED_16;
+  if (sample_format_ == SV_SAMPLE_FORMAT_FLOAT) {
+    format.formatType = SL_ANDROID_DATAFORMAT_PCM_EX;
+    format.bitsPerSample = SL_PCMSAMPLEFORMAT_FIXED_32;
+    format.containerSize = SL_PCMSAMPLEFORMAT_FIXED_32;
+    format.representation = SL_ANDROID_PCM_REPRESENTATION_FLOAT;
+  } else {
+    format.formatType = SL_DATAFORMAT_PCM;
+    format.bitsPerSample = SL_PCMSAMPLEFORMAT_FIXED_16;
+    format.containerSize = SL_PCMSAMPLEFORMAT_FIXED_16;
+    format.representation = SL_ANDROID_PCM_REPRESENTATION_SIGNED_INT;
+  }
   format.endianness = SL_BYTEORDER_LITTLEENDIAN;
   if (format.numChannels == 1) {
     format.channelMask = SL_SPEAKER_FRONT_CENTER;
@@ -231,25 +389,45 @@ SLDataFormat_PCM SVOpenslRender::CreatePCMConfiguration() const {
 
  SV_RESULT SVOpenslRender::CreateAudioPlayer() {
    AV_LOGI("CreateAudioPlayer channels:%d, sample_rate:%d", channels_, sample_rate_);
-   if (!sl_output_mix_) {
-     AV_LOGW("sl_output_mix_ is nullptr.");
-     return SV_PLAY_INIT_ERROR;
+   if (player_) {
+     return SV_NO_ERROR;
    }
 
-   if (sl_player_object_) {
-     return SV_NO_ERROR;
+   player_ = engine_->player_pool().Take(player_key());
+   if (player_) {
+     AV_LOGI("Reusing a parked player.");
+   } else {
+     std::unique_ptr<SVOpenslPlayer> player(new SVOpenslPlayer());
+     if (CreatePlayer(player.get()) != SV_NO_ERROR) {
+       return SV_PLAY_INIT_ERROR;
+     }
+     player_ = std::move(player);
+   }
+   sl_player_ = player_->play;
+   simple_buffer_queue_ = player_->buffer_queue;
+   SLresult result = (*simple_buffer_queue_)->RegisterCallback(simple_buffer_queue_, SimpleBufferQueueCallback, this);
+   if (result != SL_RESULT_SUCCESS) {
+     AV_LOGE("SimpleBufferQueue RegisterCallback failed, reason:%s", GetSLErrorString(result));
+     return SV_PLAY_INIT_ERROR;
    }
+   AV_LOGI("CreateAudioPlayer done.");
+   return SV_NO_ERROR;
+}
+
+SV_RESULT SVOpenslRender::CreatePlayer(SVOpenslPlayer* player) const {
+   SLObjectItf output_mix = engine_->output_mix();
+   SLEngineItf engine = engine_->engine();
 
    auto pcm_format = CreatePCMConfiguration();
    //source.
    SLDataLocator_AndroidSimpleBufferQueue simple_buffer_queue = {
            SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE,
-           static_cast<SLuint32>(num_of_opensles_buffers_)};
+           static_cast<SLuint32>(pool_size_)};
    SLDataSource audio_source = {&simple_buffer_queue, &pcm_format};
 
    // sink.
    SLDataLocator_OutputMix locator_output_mix = {SL_DATALOCATOR_OUTPUTMIX,
-                                                 sl_output_mix_};
+                                                 output_mix};
    SLDataSink audio_sink = {&locator_output_mix, nullptr};
 
    const SLInterfaceID interface_ids[] = {SL_IID_ANDROIDCONFIGURATION,
@@ -257,7 +435,7 @@ SLDataFormat_PCM SVOpenslRender::CreatePCMConfiguration() const {
    const SLboolean interface_required[] = {SL_BOOLEAN_TRUE, SL_BOOLEAN_TRUE,
                                            SL_BOOLEAN_TRUE};
 
-   SLresult result = (*sl_engine_)->CreateAudioPlayer(sl_engine_, &sl_player_object_, &audio_source, &audio_sink,
+   SLresult result = (*engine)->CreateAudioPlayer(engine, &player->object, &audio_source, &audio_sink,
                                     arraysize(interface_ids), interface_ids, interface_required);
    if (result != SL_RESULT_SUCCESS) {
      AV_LOGE("CreateAudioPlayer failed, reason: %s", GetSLErrorString(result));
@@ -266,9 +444,9 @@ SLDataFormat_PCM SVOpenslRender::CreatePCMConfiguration() const {
 
    // ===  Android platform configuration. ====
    SLAndroidConfigurationItf player_config;
-   result = (*sl_player_object_)->GetInterface(sl_player_object_, SL_IID_ANDROIDCONFIGURATION, &player_config);
+   result = (*player->object)->GetInterface(player->object, SL_IID_ANDROIDCONFIGURATION, &player_config);
    if (result != SL_RESULT_SUCCESS) {
-     AV_LOGE("sl_player_object_ GetInterface failed, reason:%s", GetSLErrorString(result));
+     AV_LOGE("sl_player_object GetInterface failed, reason:%s", GetSLErrorString(result));
      return SV_PLAY_INIT_ERROR;
    }
    SLint32  stream_type = SL_ANDROID_STREAM_MEDIA;
@@ -285,32 +463,26 @@ SLDataFormat_PCM SVOpenslRender::CreatePCMConfiguration() const {
      return SV_PLAY_INIT_ERROR;
    }
 
-   result = (*sl_player_object_)->Realize(sl_player_object_, SL_BOOLEAN_FALSE);
+   result = (*player->object)->Realize(player->object, SL_BOOLEAN_FALSE);
    if (result != SL_RESULT_SUCCESS) {
      AV_LOGE("sl_player_object Realize failed, reason: %s", GetSLErrorString(result));
      return SV_PLAY_INIT_ERROR;
    }
 
    // ==== Get player. ====
-   result = (*sl_player_object_)->GetInterface(sl_player_object_, SL_IID_PLAY, &sl_player_);
+   result = (*player->object)->GetInterface(player->object, SL_IID_PLAY, &player->play);
    if (result != SL_RESULT_SUCCESS) {
      AV_LOGE("sl_player_object GetPlayer failed, reason: %s", GetSLErrorString(result));
      return SV_PLAY_INIT_ERROR;
    }
 
    // === Get BufferQueue ====
-   result = (*sl_player_object_)->GetInterface(sl_player_object_, SL_IID_BUFFERQUEUE, &simple_buffer_queue_);
+   result = (*player->object)->GetInterface(player->object, SL_IID_BUFFERQUEUE, &player->buffer_queue);
    if (result != SL_RESULT_SUCCESS) {
      AV_LOGE("sl_player_object GetBufferQueue failed, reason: %s", GetSLErrorString(result));
      return SV_PLAY_INIT_ERROR;
    }
 
-   result = (*simple_buffer_queue_)->RegisterCallback(simple_buffer_queue_, SimpleBufferQueueCallback, this);
-   if (result != SL_RESULT_SUCCESS) {
-     AV_LOGE("SimpleBufferQueue RegisterCallback failed, reason:%s", GetSLErrorString(result));
-     return SV_PLAY_INIT_ERROR;
-   }
-   AV_LOGI("CreateAudioPlayer done.");
    return SV_NO_ERROR;
 }
 
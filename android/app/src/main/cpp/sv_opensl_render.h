@@ -3,8 +3,13 @@
 
 #include <SLES/OpenSLES.h>
 #include <SLES/OpenSLES_Android.h>
+#include <atomic>
 #include <string>
+#include "sv_buffer_count_tuner.h"
+#include "sv_opensl_engine.h"
 #include "sv_common.h"
+#include "sv_pcm_source.h"
+#include "sv_converting_pcm_source.h"
 #include "log.h"
 
 namespace sv_render {
@@ -36,39 +41,104 @@ inline const char* GetSLErrorString(size_t code) {
   return sl_error_strings[code];
 }
 
+// Buffer queue layout, passed to InitAudioRender().
+struct SVOpenslBufferConfig {
+  // Marks num_buffers as chosen at run time.
+  static constexpr int kAutoNumBuffers = 0;
+  static constexpr int kMaxNumBuffers = 16;
+
+  // Buffers kept enqueued. kAutoNumBuffers starts at two and adds buffers
+  // while the queue runs dry more often than max_underrun_rate, up to
+  // max_buffers, which gives the lowest latency the device sustains.
+  int num_buffers = 2;
+  // Audio per buffer.
+  int buffer_ms = 10;
+  // Auto mode only. Underruns per consumed buffer, judged over
+  // tuner_window_buffers buffers.
+  int max_buffers = 8;
+  double max_underrun_rate = 0.001;
+  int tuner_window_buffers = 1000;
+};
+
+// The queue rotates through a pool of preallocated buffers, one per slot of
+// the OpenSL queue, so a buffer is never rewritten while the device may still
+// read it. Sources that hand out their own memory are enqueued directly.
+//
+// All renders play through the shared SVOpenslEngine. StopPlayout() parks
+// the player there, the next render in the same format starts on it instead
+// of creating and realizing a new one.
 class SVOpenslRender : public INativeAudioRender {
 
 public:
     explicit SVOpenslRender(const std::string &file_path);
+    explicit SVOpenslRender(IPcmSource::Ptr source);
     ~SVOpenslRender() override;
+    int SetSampleFormat(SV_SAMPLE_FORMAT format) override;
+    // Default SVOpenslBufferConfig.
     int InitAudioRender(int sample_rate, int channels) override;
+    int InitAudioRender(int sample_rate, int channels, const SVOpenslBufferConfig& config);
     int StartPlayout() override;
     int StopPlayout() override;
+    int PausePlayout() override;
+    int ResumePlayout() override;
+    int SetGain(float gain, int ramp_ms, SVGainCurve curve) override;
+    int GetStats(SVRenderStatsSnapshot* stats) override;
+
+    // OpenSL can't query the native rate, the player opens at the rate of
+    // nearly every current device so it gets the fast mixer path.
+    static constexpr int kDeviceSampleRate = 48000;
+    // The player is always stereo, other layouts are remapped before enqueueing.
+    static constexpr int kDeviceChannels = 2;
+
+    // Buffers kept enqueued, the auto mode's current pick.
+    int num_buffers() const;
 
 private:
-    SV_RESULT CreatePlayerEngine();
+    // Takes a parked player or creates one, then registers the callback.
     SV_RESULT CreateAudioPlayer();
-    SLDataFormat_PCM CreatePCMConfiguration() const;
+    SV_RESULT CreatePlayer(SVOpenslPlayer* player) const;
+    SVOpenslPlayerKey player_key() const;
+    SLAndroidDataFormat_PCM_EX CreatePCMConfiguration() const;
     static void SimpleBufferQueueCallback(SLAndroidSimpleBufferQueueItf caller, void* context);
-    bool ReadPlayoutData();
-    bool FillBufferQueue(bool check_state = true);
+    // Audio thread. Tops the queue back up after the device consumed a
+    // buffer, with silence while paused.
+    void OnBufferConsumed(bool render);
+    // Renders the next pool buffer, or silences it, and enqueues it.
+    bool FillBufferQueue(bool check_state = true, bool render = true);
+    // Waits until the device played the buffers enqueued so far.
+    void WaitForQueuedBuffers();
 
 private:
-    bool initialized_ = false;
-    bool playing_ = false;
+    SVStreamControl control_;
     int sample_rate_ = 0;
     int channels_ = 0;
-    int num_of_opensles_buffers_ = 2;
-    FILE* file_;
+    SVOpenslBufferConfig buffer_config_;
+    // Slots of the OpenSL queue and buffers in the pool.
+    int pool_size_ = 0;
+    int frames_per_buffer_ = 0;
+    SV_SAMPLE_FORMAT sample_format_ = SV_SAMPLE_FORMAT_I16;
+    // Sources that can't hand out their own memory render into audio_buffers_,
+    // so do the others' buffers while the gain changes them. Content at
+    // another rate is resampled, which always renders.
+    std::shared_ptr<SVConvertingPcmSource> source_;
+    SVRenderStats stats_;
+    SVGainStage gain_;
+    SVBufferCountTuner tuner_;
+    // Callbacks that found the queue empty: the device had nothing to play.
+    std::atomic<int64_t> queue_underruns_ { 0 };
+    // Audio thread. Pool buffer the next Enqueue() takes.
+    int next_buffer_ = 0;
 
 private:
-    SLObjectItf sl_object_ { nullptr };
-    SLEngineItf sl_engine_ { nullptr };
-    SLObjectItf sl_player_object_ { nullptr };
+    SVOpenslEngine::Ptr engine_;
+    // From the engine's pool or created at start, parked again at stop.
+    std::unique_ptr<SVOpenslPlayer> player_;
+    // Interfaces of player_.
     SLPlayItf sl_player_ { nullptr };
-    SLObjectItf  sl_output_mix_ { nullptr };
     SLAndroidSimpleBufferQueueItf  simple_buffer_queue_ { nullptr };
+    // pool_size_ buffers of frames_per_buffer_ frames each.
     std::unique_ptr<SLint16[]> audio_buffers_;
+    std::unique_ptr<float[]> float_buffers_;
 };
 
 } // sv_render
@@ -0,0 +1,105 @@
+#include "sv_pcm_source.h"
+#include "sv_converting_pcm_source.h"
+#include "sv_gain_stage.h"
+#include "sv_mmap_pcm_file.h"
+#include "sv_prefetch_reader.h"
+#include "sv_render_stats.h"
+#include "sv_wav_pcm_source.h"
+#include "log.h"
+#include <cstring>
+
+namespace sv_render {
+
+bool RenderPcmSource(IPcmSource* source, int16_t* dst, int num_frames, int channels, SVRenderStats* stats,
+                     SVGainStage* gain) {
+  const int64_t begin_ns = stats ? SVRenderStats::NowNanos() : 0;
+  const int len = source->Render(dst, num_frames);
+  if (stats) {
+    stats->RecordCallback(begin_ns, SVRenderStats::NowNanos() - begin_ns, num_frames, len,
+                          len < num_frames && !source->IsEnd());
+  }
+  if (len < num_frames) {
+    // Underrun or tail of the source: pad with silence, stop once drained.
+    memset(dst + len * channels, 0, (num_frames - len) * channels * sizeof(int16_t));
+  }
+  if (gain) {
+    gain->Process(dst, num_frames, len, channels);
+  }
+  if (len < num_frames) {
+    if (len == 0 && source->IsEnd()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RenderPcmSource(IPcmSource* source, float* dst, int num_frames, int channels, SVRenderStats* stats,
+                     SVGainStage* gain) {
+  const int64_t begin_ns = stats ? SVRenderStats::NowNanos() : 0;
+  const int len = source->RenderFloat(dst, num_frames);
+  if (stats) {
+    stats->RecordCallback(begin_ns, SVRenderStats::NowNanos() - begin_ns, num_frames, len,
+                          len < num_frames && !source->IsEnd());
+  }
+  if (len < num_frames) {
+    memset(dst + len * channels, 0, (num_frames - len) * channels * sizeof(float));
+  }
+  if (gain) {
+    gain->Process(dst, num_frames, len, channels);
+  }
+  if (len < num_frames) {
+    if (len == 0 && source->IsEnd()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int AcquirePcmSource(IPcmSource* source, int16_t* staging, int num_frames, int channels, const int16_t** data,
+                     SVRenderStats* stats, SVGainStage* gain) {
+  if (source->CanAcquire()) {
+    const int64_t begin_ns = stats ? SVRenderStats::NowNanos() : 0;
+    const int frames = source->Acquire(num_frames, data);
+    if (stats) {
+      // Acquired memory never underruns, a short tail is the end of the source.
+      stats->RecordCallback(begin_ns, SVRenderStats::NowNanos() - begin_ns, num_frames, frames, false);
+    }
+    if (gain && frames > 0 && gain->Active()) {
+      memcpy(staging, *data, frames * channels * sizeof(int16_t));
+      *data = staging;
+      gain->Process(staging, frames, frames, channels);
+    }
+    return frames;
+  }
+  *data = staging;
+  return RenderPcmSource(source, staging, num_frames, channels, stats, gain) ? num_frames : 0;
+}
+
+IPcmSource::Ptr CreateFilePcmSource(const std::string& file_path, bool synchronous) {
+  if (SVWavFile::IsWavFile(file_path)) {
+    auto wav_source = std::make_shared<SVWavPcmSource>(file_path);
+    if (!wav_source->IsOpen()) {
+      return nullptr;
+    }
+    wav_source->SetSynchronous(synchronous);
+    // The header knows the content layout, so the file plays in whatever
+    // layout the caller prepares it with.
+    auto source = std::make_shared<SVConvertingPcmSource>(wav_source);
+    source->SetSourceSampleRate(wav_source->format().sample_rate);
+    source->SetSourceChannels(wav_source->format().channels);
+    return source;
+  }
+  auto mapped_file = std::make_shared<SVMmapPcmFile>(file_path);
+  if (mapped_file->IsOpen()) {
+    return mapped_file;
+  }
+  AV_LOGW("mmap pcm file failed, fallback to prefetch reader.");
+  auto reader = std::make_shared<SVPrefetchReader>(file_path);
+  if (reader->IsOpen()) {
+    return reader;
+  }
+  AV_LOGE("open pcm file failed: %s", file_path.c_str());
+  return nullptr;
+}
+
+} // sv_render
@@ -0,0 +1,87 @@
+#ifndef AUDIO_PLAYOUT_SV_PCM_SOURCE_H
+#define AUDIO_PLAYOUT_SV_PCM_SOURCE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace sv_render {
+
+class SVRenderStats;
+class SVGainStage;
+
+// Pull-model PCM producer shared by all render backends. The backend hands
+// the device buffer of its callback straight to Render(), so there is no
+// intermediate staging buffer and no assumption about the callback size.
+class IPcmSource {
+public:
+  using Ptr = std::shared_ptr<IPcmSource>;
+  virtual ~IPcmSource() = default;
+
+  // Control thread. Prepares interleaved int16 output with the given layout.
+  virtual bool Prepare(int sample_rate, int channels) = 0;
+  // Control thread. Stops any background work, the source may be prepared again.
+  virtual void Release() {}
+
+  // Audio thread, must not block. Writes up to num_frames frames into dst and
+  // returns the number written, which is less than num_frames on underrun or
+  // at the end of the source.
+  virtual int Render(int16_t* dst, int num_frames) = 0;
+  // True once the source is drained and Render() will not produce more frames.
+  virtual bool IsEnd() const = 0;
+
+  // Optional float32 output, full scale at +-1.0, for sources that produce
+  // more than 16 bits or feed float streams. Same contract as Render().
+  virtual bool CanRenderFloat() const { return false; }
+  virtual int RenderFloat(float* dst, int num_frames) { return 0; }
+
+  // Optional random access. Control thread, never blocks the audio thread:
+  // moves playback to frame, in the source's own frames, from a later
+  // callback on. Frames before and after the jump are crossfaded.
+  virtual bool CanSeek() const { return false; }
+  virtual bool Seek(int64_t frame) { return false; }
+
+  // Optional zero-copy path for backends that can enqueue source memory
+  // directly. Points *data at up to num_frames frames that stay valid until
+  // Release() and returns the number of frames.
+  virtual bool CanAcquire() const { return false; }
+  virtual int Acquire(int num_frames, const int16_t** data) {
+    *data = nullptr;
+    return 0;
+  }
+
+  // Optional, for live sources a producer feeds on its own clock: frames
+  // queued ahead of the reader, in the source's own rate. -1 for sources
+  // read on demand, which can't drift.
+  virtual int64_t QueuedFrames() const { return -1; }
+  // Audio thread, before Render(). How long the stream's last written frame
+  // waits in the device before it is heard, from the device's timestamps.
+  // Sources that hold a latency against drift count it in; wrappers pass it on.
+  virtual void SetDeviceLatency(double seconds) {}
+};
+
+// Renders num_frames into dst, padding any shortfall with silence. Returns
+// false once the source is drained, so the backend can stop its stream. The
+// callback timing is recorded into stats when given, and the stream gain is
+// applied in place when gain is.
+bool RenderPcmSource(IPcmSource* source, int16_t* dst, int num_frames, int channels,
+                     SVRenderStats* stats = nullptr, SVGainStage* gain = nullptr);
+// Float32 stream variant, the source must support RenderFloat().
+bool RenderPcmSource(IPcmSource* source, float* dst, int num_frames, int channels,
+                     SVRenderStats* stats = nullptr, SVGainStage* gain = nullptr);
+// Buffer-queue variant: points *data at the next num_frames frames, taken
+// from the source memory when it supports Acquire() and rendered into staging
+// otherwise. Returns the number of frames, 0 once the source is drained.
+// Acquired frames are copied to staging only while the gain changes them.
+int AcquirePcmSource(IPcmSource* source, int16_t* staging, int num_frames, int channels, const int16_t** data,
+                     SVRenderStats* stats = nullptr, SVGainStage* gain = nullptr);
+
+// WAV files are decoded on a background thread and converted to the layout
+// the source is prepared with, or, synchronous, on the thread that renders
+// them, for offline renders. Raw PCM is mapped when possible and falls back
+// to the prefetch ring otherwise.
+IPcmSource::Ptr CreateFilePcmSource(const std::string& file_path, bool synchronous = false);
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_PCM_SOURCE_H
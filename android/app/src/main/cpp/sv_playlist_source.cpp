@@ -0,0 +1,248 @@
+#include "sv_playlist_source.h"
+#include "sv_sample_convert.h"
+#include "log.h"
+#include <algorithm>
+
+namespace sv_render {
+
+// Odr-used by std::min, C++14 still needs the definition.
+constexpr int SVPlaylistSource::kChunkFrames;
+
+SVPlaylistSource::SVPlaylistSource()
+  : ready_(kMaxItems),
+  retired_(kMaxItems) {
+}
+
+SVPlaylistSource::~SVPlaylistSource() {
+  Release();
+  for (Item* item : items_) {
+    delete item;
+  }
+}
+
+int SVPlaylistSource::Enqueue(const std::string& file_path) {
+  auto* item = new Item();
+  item->file_path = file_path;
+  return AppendItem(item);
+}
+
+int SVPlaylistSource::Enqueue(IPcmSource::Ptr source) {
+  if (!source) {
+    return -1;
+  }
+  auto* item = new Item();
+  item->source = std::move(source);
+  return AppendItem(item);
+}
+
+int SVPlaylistSource::AppendItem(Item* item) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (items_.size() >= kMaxItems) {
+      AV_LOGW("SVPlaylistSource enqueue failed, %d items already.", kMaxItems);
+      delete item;
+      return -1;
+    }
+    item->id = next_item_id_++;
+    items_.push_back(item);
+    enqueued_count_.fetch_add(1, std::memory_order_relaxed);
+    wake_ = true;
+  }
+  cond_.notify_all();
+  return item->id;
+}
+
+bool SVPlaylistSource::Prepare(int sample_rate, int channels) {
+  if (sample_rate <= 0 || channels <= 0) {
+    return false;
+  }
+  Release();
+  sample_rate_ = sample_rate;
+  channels_ = channels;
+  float_buffer_.assign(kChunkFrames * channels, 0.0f);
+  pcm_buffer_.assign(kChunkFrames * channels, 0);
+
+  // Pre-roll before the first callback can ask for data.
+  while (ready_count_.load(std::memory_order_relaxed) < kPreRollItems && LoadNext()) {}
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = true;
+  }
+  thread_ = std::thread(&SVPlaylistSource::ThreadLoop, this);
+  return true;
+}
+
+void SVPlaylistSource::Release() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cond_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  ReclaimItems();
+  // The audio thread is stopped, its ends of the queues are ours now.
+  Item* item = nullptr;
+  while (ready_.Pop(&item)) {}
+  ready_count_.store(0, std::memory_order_relaxed);
+  current_ = nullptr;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Item* queued : items_) {
+    if (queued->loaded) {
+      queued->source->Release();
+      queued->loaded = false;
+    }
+  }
+  AV_LOGI("SVPlaylistSource release, items left:%zu, transitions:%lld, underruns:%lld", items_.size(),
+          (long long) transitions(), (long long) underruns());
+}
+
+bool SVPlaylistSource::SeekCurrentItem(int64_t frame) {
+  const int current_id = current_id_.load(std::memory_order_relaxed);
+  // Holding the lock keeps the loader from reclaiming the item meanwhile.
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Item* item : items_) {
+    if (current_id == 0 || item->id == current_id) {
+      return item->loaded && item->source->CanSeek() && item->source->Seek(frame);
+    }
+  }
+  return false;
+}
+
+void SVPlaylistSource::ThreadLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (running_) {
+    wake_ = false;
+    lock.unlock();
+    ReclaimItems();
+    while (ready_count_.load(std::memory_order_acquire) < kPreRollItems && LoadNext()) {}
+    lock.lock();
+    cond_.wait_for(lock, wakeup_interval_, [this] { return !running_ || wake_; });
+  }
+  AV_LOGI("SVPlaylistSource thread exit.");
+}
+
+bool SVPlaylistSource::LoadNext() {
+  while (true) {
+    Item* item = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (Item* queued : items_) {
+        if (!queued->loaded) {
+          item = queued;
+          break;
+        }
+      }
+    }
+    if (!item) {
+      return false;
+    }
+    // Not visible to the audio thread yet, so opening and priming need no lock.
+    if (!item->source) {
+      item->source = CreateFilePcmSource(item->file_path);
+    }
+    if (item->source && item->source->Prepare(sample_rate_, channels_)) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        item->loaded = true;
+      }
+      ready_count_.fetch_add(1, std::memory_order_release);
+      // Can't fail: ready_ holds as many items as the playlist.
+      ready_.Push(item);
+      return true;
+    }
+    AV_LOGW("SVPlaylistSource drop item %d, open or prepare failed: %s", item->id, item->file_path.c_str());
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      items_.erase(std::find(items_.begin(), items_.end(), item));
+    }
+    delete item;
+    finished_count_.fetch_add(1, std::memory_order_release);
+  }
+}
+
+void SVPlaylistSource::ReclaimItems() {
+  Item* item = nullptr;
+  while (retired_.Pop(&item)) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      items_.erase(std::find(items_.begin(), items_.end(), item));
+    }
+    item->source->Release();
+    delete item;
+  }
+}
+
+int SVPlaylistSource::RenderItem(Item* item, float* dst, int num_frames) {
+  IPcmSource* source = item->source.get();
+  if (source->CanRenderFloat()) {
+    return source->RenderFloat(dst, num_frames);
+  }
+  int rendered = 0;
+  while (rendered < num_frames) {
+    const int wanted = std::min(num_frames - rendered, kChunkFrames);
+    const int frames = source->Render(pcm_buffer_.data(), wanted);
+    SVInt16ToFloat(pcm_buffer_.data(), dst + rendered * channels_, frames * channels_);
+    rendered += frames;
+    if (frames < wanted) break;
+  }
+  return rendered;
+}
+
+int SVPlaylistSource::RenderFloat(float* dst, int num_frames) {
+  int rendered = 0;
+  while (rendered < num_frames) {
+    if (!current_) {
+      Item* next = nullptr;
+      if (!ready_.Pop(&next)) {
+        if (finished_count_.load(std::memory_order_acquire) < enqueued_count_.load(std::memory_order_relaxed)) {
+          // More items are queued but the next one isn't pre-rolled yet.
+          underruns_.fetch_add(1, std::memory_order_relaxed);
+        }
+        break;
+      }
+      ready_count_.fetch_sub(1, std::memory_order_release);
+      if (current_id_.load(std::memory_order_relaxed) != 0) {
+        transitions_.fetch_add(1, std::memory_order_relaxed);
+      }
+      current_ = next;
+      current_id_.store(next->id, std::memory_order_relaxed);
+    }
+    const int wanted = num_frames - rendered;
+    const int frames = RenderItem(current_, dst + rendered * channels_, wanted);
+    rendered += frames;
+    if (frames < wanted) {
+      if (!current_->source->IsEnd()) {
+        // The item itself underran, its own counters tell.
+        break;
+      }
+      // Continue with the next item on the very next frame.
+      retired_.Push(current_);
+      current_ = nullptr;
+      finished_count_.fetch_add(1, std::memory_order_release);
+    }
+  }
+  return rendered;
+}
+
+int SVPlaylistSource::Render(int16_t* dst, int num_frames) {
+  int rendered = 0;
+  while (rendered < num_frames) {
+    const int wanted = std::min(num_frames - rendered, kChunkFrames);
+    const int frames = RenderFloat(float_buffer_.data(), wanted);
+    SVFloatToInt16(float_buffer_.data(), dst + rendered * channels_, frames * channels_);
+    rendered += frames;
+    if (frames < wanted) break;
+  }
+  return rendered;
+}
+
+bool SVPlaylistSource::IsEnd() const {
+  return end_when_empty_.load(std::memory_order_relaxed) &&
+         finished_count_.load(std::memory_order_acquire) == enqueued_count_.load(std::memory_order_relaxed);
+}
+
+} // sv_render
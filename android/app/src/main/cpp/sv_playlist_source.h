@@ -0,0 +1,127 @@
+#ifndef AUDIO_PLAYOUT_SV_PLAYLIST_SOURCE_H
+#define AUDIO_PLAYOUT_SV_PLAYLIST_SOURCE_H
+
+#include "sv_pcm_source.h"
+#include "sv_spsc_queue.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sv_render {
+
+// Plays queued sources back to back through one device stream. A loader
+// thread opens the next item and prepares it ahead of time, which primes its
+// prefetch ring or decoder, so the callback switches to it on the exact frame
+// the current item ends, mid-buffer, without a gap.
+//
+// Items are handed to the audio thread through a wait-free queue and come
+// back through a second one once they end, like SVMixer voices; opening,
+// priming and releasing all happen on the loader thread.
+class SVPlaylistSource : public IPcmSource {
+
+public:
+  static constexpr int kMaxItems = 256;
+
+  SVPlaylistSource();
+  ~SVPlaylistSource() override;
+
+  // Control thread. Appends an item, opened with CreateFilePcmSource() on
+  // the loader thread. Items must produce the layout the playlist is
+  // prepared with; WAV files are converted to it. Returns the item id, -1
+  // when the queue is full.
+  int Enqueue(const std::string& file_path);
+  int Enqueue(IPcmSource::Ptr source);
+  // Control thread. End the stream once the last item has played, instead
+  // of rendering silence until more are queued.
+  void SetEndWhenEmpty(bool end_when_empty) { end_when_empty_.store(end_when_empty); }
+  // Control thread. Seeks inside the item playing, or the first item before
+  // playback starts, in that item's own frames. False when the item isn't
+  // loaded yet or can't seek.
+  bool SeekCurrentItem(int64_t frame);
+
+  // Id of the item playing, 0 before the first one starts.
+  int current_item() const { return current_id_.load(std::memory_order_relaxed); }
+  // Switches from one item to the next inside the callback.
+  int64_t transitions() const { return transitions_.load(std::memory_order_relaxed); }
+  // Callbacks where the next item wasn't pre-rolled in time.
+  int64_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+  // Pre-rolls the first items before returning and starts the loader thread.
+  bool Prepare(int sample_rate, int channels) override;
+  // Stops the loader and releases the prepared items. Items that haven't
+  // finished stay queued and restart on the next Prepare().
+  void Release() override;
+  int Render(int16_t* dst, int num_frames) override;
+  bool IsEnd() const override;
+  bool CanRenderFloat() const override { return true; }
+  int RenderFloat(float* dst, int num_frames) override;
+  bool CanSeek() const override { return true; }
+  bool Seek(int64_t frame) override { return SeekCurrentItem(frame); }
+
+private:
+  struct Item {
+    int id = 0;
+    std::string file_path;
+    IPcmSource::Ptr source;
+    // Loader thread, under mutex_.
+    bool loaded = false;
+  };
+
+  void ThreadLoop();
+  // Loader thread or Prepare(). Opens and prepares the first item not yet
+  // handed to the audio thread; false when there is none.
+  bool LoadNext();
+  // Frees items the audio thread has finished with.
+  void ReclaimItems();
+  int AppendItem(Item* item);
+
+  // Audio thread.
+  int RenderItem(Item* item, float* dst, int num_frames);
+
+private:
+  // Frames converted per pass on the int16 paths.
+  static constexpr int kChunkFrames = 256;
+  // Items kept prepared behind the one playing. Two, so an item shorter than
+  // a callback still finds its successor ready.
+  static constexpr int kPreRollItems = 2;
+
+  int sample_rate_ = 0;
+  int channels_ = 0;
+  std::atomic<bool> end_when_empty_ { false };
+  int next_item_id_ = 1;
+
+  // Every item not yet reclaimed, in play order.
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Item*> items_;
+  bool running_ = false;
+  // Set by Enqueue() so the loader doesn't wait out its interval.
+  bool wake_ = false;
+  std::thread thread_;
+  std::chrono::milliseconds wakeup_interval_ { 10 };
+
+  SVSpscQueue<Item*> ready_;
+  SVSpscQueue<Item*> retired_;
+  // Items pre-rolled and not yet picked up by the audio thread.
+  std::atomic<int> ready_count_ { 0 };
+  // Items queued, and items that played to the end or failed to open.
+  std::atomic<int64_t> enqueued_count_ { 0 };
+  std::atomic<int64_t> finished_count_ { 0 };
+
+  // Audio thread.
+  Item* current_ = nullptr;
+  std::vector<float> float_buffer_;
+  std::vector<int16_t> pcm_buffer_;
+  std::atomic<int> current_id_ { 0 };
+  std::atomic<int64_t> transitions_ { 0 };
+  std::atomic<int64_t> underruns_ { 0 };
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_PLAYLIST_SOURCE_H
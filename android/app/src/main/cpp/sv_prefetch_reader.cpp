@@ -0,0 +1,191 @@
+#include "sv_prefetch_reader.h"
+#include "log.h"
+#include <algorithm>
+
+namespace sv_render {
+
+namespace {
+
+// How often the prefetch thread checks whether the callback has taken a seek.
+constexpr std::chrono::milliseconds kSeekPollInterval { 1 };
+// Ring space kept free for the first frames after a seek. Longer than a callback.
+constexpr int kSeekPrimeMs = 50;
+
+} // namespace
+
+SVPrefetchReader::SVPrefetchReader(const std::string& file_path, int prefetch_ms)
+  : file_(nullptr),
+  prefetch_ms_(prefetch_ms) {
+  file_ = fopen(file_path.c_str(), "rb");
+  AV_LOGI("SVPrefetchReader open file address: %p", file_);
+}
+
+SVPrefetchReader::~SVPrefetchReader() {
+  Release();
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+bool SVPrefetchReader::Prepare(int sample_rate, int channels) {
+  if (!file_) {
+    AV_LOGE("SVPrefetchReader start failed, file not open.");
+    return false;
+  }
+  // Preparing again restarts from the beginning of the file, or from a seek
+  // requested before.
+  Release();
+  const int64_t start_frame = std::max<int64_t>(seek_request_.exchange(-1), 0);
+  clearerr(file_);
+  fseeko(file_, static_cast<off_t>(start_frame * channels * sizeof(int16_t)), SEEK_SET);
+  eof_.store(false, std::memory_order_relaxed);
+  seek_ack_.store(seek_generation_.load());
+  crossfade_.Prepare(sample_rate, channels);
+  below_low_water_ = false;
+
+  const size_t prefetch_frames = static_cast<size_t>(sample_rate) * prefetch_ms_ / 1000;
+  seek_prime_frames_ = static_cast<size_t>(sample_rate) * kSeekPrimeMs / 1000;
+  ring_.reset(new SVRingBuffer<int16_t>(prefetch_frames + seek_prime_frames_, channels));
+  chunk_frames_ = static_cast<size_t>(sample_rate / 100);
+  read_chunk_.reset(new int16_t[chunk_frames_ * channels]);
+  low_water_frames_ = ring_->capacity() / 4;
+  wakeup_interval_ = std::chrono::milliseconds(std::max(prefetch_ms_ / 4, 1));
+
+  // Prime the ring before the first callback can ask for data.
+  FillRing(seek_prime_frames_);
+
+  running_ = true;
+  thread_ = std::thread(&SVPrefetchReader::ThreadLoop, this);
+  AV_LOGI("SVPrefetchReader start, ring capacity: %zu frames", ring_->capacity());
+  return true;
+}
+
+void SVPrefetchReader::Release() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cond_.notify_all();
+  if (!thread_.joinable()) {
+    return;
+  }
+  thread_.join();
+  auto stats = GetStats();
+  AV_LOGI("prefetch ring fill: %zu/%zu, low water hits: %llu, underruns: %llu", stats.fill_frames,
+          stats.capacity_frames, (unsigned long long) stats.low_water_hits, (unsigned long long) stats.underruns);
+}
+
+bool SVPrefetchReader::Seek(int64_t frame) {
+  if (!file_ || frame < 0) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    seek_request_.store(frame);
+    wake_ = true;
+  }
+  cond_.notify_all();
+  return true;
+}
+
+void SVPrefetchReader::ThreadLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Keeps running past the end of the file, a seek may bring it back.
+  while (running_) {
+    wake_ = false;
+    lock.unlock();
+    HandleSeek();
+    FillRing(seek_prime_frames_);
+    lock.lock();
+    cond_.wait_for(lock, wakeup_interval_, [this] { return !running_ || wake_; });
+  }
+  AV_LOGI("SVPrefetchReader thread exit.");
+}
+
+void SVPrefetchReader::HandleSeek() {
+  while (seek_request_.load() >= 0) {
+    eof_.store(false, std::memory_order_relaxed);
+    const int64_t frame = seek_request_.exchange(-1);
+    // Raw frames have a fixed size, the target is one fseek away.
+    clearerr(file_);
+    fseeko(file_, static_cast<off_t>(frame * ring_->channels() * sizeof(int16_t)), SEEK_SET);
+    // New frames go into the reserve behind the old ones.
+    seek_marker_.store(ring_->frames_written(), std::memory_order_relaxed);
+    FillRing(0);
+    const uint32_t generation = seek_generation_.load(std::memory_order_relaxed) + 1;
+    seek_generation_.store(generation, std::memory_order_release);
+    AV_LOGI("SVPrefetchReader seek to frame %lld.", (long long) frame);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_ && seek_ack_.load(std::memory_order_acquire) != generation) {
+      cond_.wait_for(lock, kSeekPollInterval);
+    }
+  }
+}
+
+void SVPrefetchReader::FillRing(size_t reserve_frames) {
+  const int channels = ring_->channels();
+  while (!eof_.load(std::memory_order_relaxed)) {
+    const size_t space = ring_->AvailableToWrite();
+    if (space <= reserve_frames) break;
+    const size_t want = std::min(space - reserve_frames, chunk_frames_);
+    const size_t samples = fread(read_chunk_.get(), sizeof(int16_t), want * channels, file_);
+    const size_t frames = samples / channels;
+    ring_->Write(read_chunk_.get(), frames);
+    if (frames < want) {
+      if (ferror(file_)) {
+        AV_LOGW("read file error.");
+      }
+      if (feof(file_)) {
+        AV_LOGW("read file end.");
+      }
+      eof_.store(true, std::memory_order_release);
+    }
+  }
+}
+
+int SVPrefetchReader::Render(int16_t* dst, int num_frames) {
+  const uint32_t generation = seek_generation_.load(std::memory_order_acquire);
+  if (generation != seek_ack_.load(std::memory_order_relaxed)) {
+    // Keep the first of the stale frames for the fade, drop the rest.
+    const size_t old_frames = seek_marker_.load(std::memory_order_relaxed) - ring_->frames_read();
+    const size_t kept = ring_->Read(crossfade_.old_frames(),
+                                    std::min(old_frames, static_cast<size_t>(crossfade_.max_frames())));
+    ring_->Skip(old_frames - kept);
+    crossfade_.Start(static_cast<int>(kept));
+    seek_ack_.store(generation, std::memory_order_release);
+  }
+  const int frames = static_cast<int>(ring_->Read(dst, num_frames));
+  if (eof_.load(std::memory_order_acquire)) {
+    return crossfade_.Apply(dst, frames, num_frames);
+  }
+  if (frames < num_frames) {
+    underruns_.fetch_add(1, std::memory_order_relaxed);
+  }
+  const bool below_low_water = ring_->AvailableToRead() < low_water_frames_;
+  if (below_low_water && !below_low_water_) {
+    low_water_hits_.fetch_add(1, std::memory_order_relaxed);
+  }
+  below_low_water_ = below_low_water;
+  return crossfade_.Apply(dst, frames, num_frames);
+}
+
+bool SVPrefetchReader::IsEnd() const {
+  if (!ring_) return true;
+  return seek_request_.load(std::memory_order_relaxed) < 0 &&
+         seek_generation_.load(std::memory_order_relaxed) == seek_ack_.load(std::memory_order_relaxed) &&
+         !crossfade_.active() && eof_.load(std::memory_order_acquire) && ring_->AvailableToRead() == 0;
+}
+
+SVPrefetchStats SVPrefetchReader::GetStats() const {
+  SVPrefetchStats stats;
+  if (ring_) {
+    stats.fill_frames = ring_->AvailableToRead();
+    stats.capacity_frames = ring_->capacity();
+  }
+  stats.low_water_hits = low_water_hits_.load(std::memory_order_relaxed);
+  stats.underruns = underruns_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+} // sv_render
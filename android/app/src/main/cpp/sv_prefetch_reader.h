@@ -0,0 +1,90 @@
+#ifndef AUDIO_PLAYOUT_SV_PREFETCH_READER_H
+#define AUDIO_PLAYOUT_SV_PREFETCH_READER_H
+
+#include "sv_pcm_source.h"
+#include "sv_ring_buffer.h"
+#include "sv_seek_crossfade.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace sv_render {
+
+struct SVPrefetchStats {
+  size_t fill_frames = 0;
+  size_t capacity_frames = 0;
+  uint64_t low_water_hits = 0;
+  uint64_t underruns = 0;
+};
+
+// Reads a raw PCM file on a background thread and keeps an SVRingBuffer
+// prefetch_ms ahead of the consumer, so the audio callback only pops frames
+// and never touches the file. Seeks work like SVWavPcmSource: the prefetch
+// thread repositions and refills, the callback drops the stale frames and
+// crossfades.
+class SVPrefetchReader : public IPcmSource {
+
+public:
+  static constexpr int kDefaultPrefetchMs = 200;
+
+  explicit SVPrefetchReader(const std::string& file_path, int prefetch_ms = kDefaultPrefetchMs);
+  ~SVPrefetchReader() override;
+
+  bool IsOpen() const { return file_ != nullptr; }
+  // Allocates the ring, fills it up to prefetch_ms and starts the prefetch thread.
+  bool Prepare(int sample_rate, int channels) override;
+  // Stops the prefetch thread and logs the ring counters.
+  void Release() override;
+
+  // Never blocks. Returns fewer than num_frames on underrun or at the end.
+  int Render(int16_t* dst, int num_frames) override;
+  // True once the whole file has been read and the ring is drained.
+  bool IsEnd() const override;
+  bool CanSeek() const override { return true; }
+  bool Seek(int64_t frame) override;
+  SVPrefetchStats GetStats() const;
+
+private:
+  void ThreadLoop();
+  // Prefetch thread. Repositions the file for pending seeks.
+  void HandleSeek();
+  // Reads from the file into the ring until only reserve_frames are left
+  // free or the file ends.
+  void FillRing(size_t reserve_frames);
+
+private:
+  FILE* file_;
+  const int prefetch_ms_;
+  std::unique_ptr<SVRingBuffer<int16_t>> ring_;
+  std::unique_ptr<int16_t[]> read_chunk_;
+  size_t chunk_frames_ = 0;
+  size_t low_water_frames_ = 0;
+  // Ring space FillRing() leaves for the frames after a seek.
+  size_t seek_prime_frames_ = 0;
+  std::chrono::milliseconds wakeup_interval_ { 10 };
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool running_ = false;
+  bool wake_ = false;
+  std::atomic<bool> eof_ { false };
+  // Seek handshake, see SVWavPcmSource.
+  std::atomic<int64_t> seek_request_ { -1 };
+  std::atomic<size_t> seek_marker_ { 0 };
+  std::atomic<uint32_t> seek_generation_ { 0 };
+  std::atomic<uint32_t> seek_ack_ { 0 };
+  SVSeekCrossfade<int16_t> crossfade_;
+  std::atomic<uint64_t> low_water_hits_ { 0 };
+  std::atomic<uint64_t> underruns_ { 0 };
+  // Consumer-owned, so each dip below the low-water mark is counted once.
+  bool below_low_water_ = false;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_PREFETCH_READER_H
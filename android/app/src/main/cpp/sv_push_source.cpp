@@ -0,0 +1,78 @@
+#include "sv_push_source.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace sv_render {
+
+namespace {
+
+// A blocked Write() checks for room this often. The audio callback never
+// signals the producer, it only advances the ring.
+constexpr std::chrono::milliseconds kWritePollInterval { 2 };
+
+} // namespace
+
+SVPushSource::SVPushSource(int sample_rate, int channels, int buffer_ms)
+  : sample_rate_(sample_rate),
+  channels_(channels),
+  ring_(std::max<size_t>(static_cast<size_t>(sample_rate) * buffer_ms / 1000, 1), channels) {
+}
+
+int SVPushSource::Write(const int16_t* data, int num_frames, bool blocking) {
+  if (!data || num_frames <= 0) {
+    return 0;
+  }
+  int written = 0;
+  while (!closed_.load(std::memory_order_acquire)) {
+    written += static_cast<int>(ring_.Write(data + written * channels_, num_frames - written));
+    if (written == num_frames || !blocking) {
+      break;
+    }
+    std::this_thread::sleep_for(kWritePollInterval);
+  }
+  if (!blocking && written < num_frames) {
+    rejected_frames_.fetch_add(num_frames - written, std::memory_order_relaxed);
+  }
+  return written;
+}
+
+void SVPushSource::EndOfStream() {
+  end_of_stream_.store(true, std::memory_order_release);
+}
+
+void SVPushSource::Close() {
+  closed_.store(true, std::memory_order_release);
+}
+
+bool SVPushSource::Prepare(int sample_rate, int channels) {
+  if (sample_rate != sample_rate_ || channels != channels_) {
+    AV_LOGE("SVPushSource is %d Hz %d channels, asked for %d Hz %d channels.", sample_rate_, channels_, sample_rate,
+            channels);
+    return false;
+  }
+  closed_.store(false, std::memory_order_release);
+  AV_LOGI("SVPushSource start, %d frames queued of %zu.", queued_frames(), ring_.capacity());
+  return true;
+}
+
+void SVPushSource::Release() {
+  Close();
+  AV_LOGI("SVPushSource release, underruns:%llu, rejected frames:%llu", (unsigned long long) underruns(),
+          (unsigned long long) rejected_frames());
+}
+
+int SVPushSource::Render(int16_t* dst, int num_frames) {
+  const int frames = static_cast<int>(ring_.Read(dst, num_frames));
+  if (frames < num_frames && !end_of_stream_.load(std::memory_order_acquire)) {
+    underruns_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return frames;
+}
+
+bool SVPushSource::IsEnd() const {
+  return end_of_stream_.load(std::memory_order_acquire) && ring_.AvailableToRead() == 0;
+}
+
+} // sv_render
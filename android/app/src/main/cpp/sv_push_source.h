@@ -0,0 +1,73 @@
+#ifndef AUDIO_PLAYOUT_SV_PUSH_SOURCE_H
+#define AUDIO_PLAYOUT_SV_PUSH_SOURCE_H
+
+#include "sv_pcm_source.h"
+#include "sv_ring_buffer.h"
+#include <atomic>
+#include <cstdint>
+
+namespace sv_render {
+
+// PCM16 pushed by the app, e.g. a decoder or a network stream, instead of
+// read from a file. One producer thread writes into an SVRingBuffer that the
+// audio callback drains; Write() copies straight from the caller's memory
+// into the ring.
+//
+// The ring is sized up front, so the producer can queue frames before the
+// render starts. When it is full a non-blocking Write() queues what fits and
+// reports the rest as back-pressure, a blocking one waits for the callback
+// to make room. The source plays silence while it starves and ends once
+// EndOfStream() was called and the ring drained.
+//
+// The source renders in its own rate and layout; wrap it in an
+// SVConvertingPcmSource to play it in any stream.
+class SVPushSource : public IPcmSource {
+
+public:
+  static constexpr int kDefaultBufferMs = 200;
+
+  SVPushSource(int sample_rate, int channels, int buffer_ms = kDefaultBufferMs);
+  ~SVPushSource() override = default;
+
+  int sample_rate() const { return sample_rate_; }
+  int channels() const { return channels_; }
+
+  // Producer thread. Queues up to num_frames interleaved frames and returns
+  // how many. Blocking waits until all are queued or the source is closed.
+  int Write(const int16_t* data, int num_frames, bool blocking);
+  // Producer thread. No more data, the source ends once the ring drains.
+  void EndOfStream();
+  // Any thread. Refuses further writes and wakes a blocked Write(). Release()
+  // closes the source too, a later Prepare() reopens it.
+  void Close();
+
+  // Must match the source's own layout. Keeps the frames queued so far.
+  bool Prepare(int sample_rate, int channels) override;
+  void Release() override;
+  // Never block. Return fewer than num_frames on underrun or at the end.
+  int Render(int16_t* dst, int num_frames) override;
+  bool IsEnd() const override;
+  int64_t QueuedFrames() const override { return queued_frames(); }
+
+  // Any thread. Back-pressure: room left, frames waiting to play.
+  int available_to_write() const { return static_cast<int>(ring_.AvailableToWrite()); }
+  int queued_frames() const { return static_cast<int>(ring_.AvailableToRead()); }
+  int capacity_frames() const { return static_cast<int>(ring_.capacity()); }
+  // Callbacks that found the ring short before the end of the stream.
+  uint64_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+  // Frames non-blocking writes couldn't queue.
+  uint64_t rejected_frames() const { return rejected_frames_.load(std::memory_order_relaxed); }
+
+private:
+  const int sample_rate_;
+  const int channels_;
+  SVRingBuffer<int16_t> ring_;
+  std::atomic<bool> closed_ { false };
+  std::atomic<bool> end_of_stream_ { false };
+  std::atomic<uint64_t> underruns_ { 0 };
+  std::atomic<uint64_t> rejected_frames_ { 0 };
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_PUSH_SOURCE_H
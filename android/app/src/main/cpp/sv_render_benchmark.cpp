@@ -0,0 +1,1364 @@
+// Benchmarks the render callback hot path on the host. The AAudio/Oboe data
+// callbacks and the OpenSL FillBufferQueue path are driven through shims that
+// run the same portable body as the real backends, stream control, stats,
+// gain stage and latency tuner included, swept over burst sizes, channel
+// counts and sample rates. The resampler is measured in cycles per
+// output frame for each quality preset, the sample conversion kernels
+// against their scalar versions, the mixer per voice, the channel layout
+// kernels against the generic matrix and WAV decoding per encoding. The
+// OpenSL buffer count is simulated against callback scheduling stalls, fixed
+// counts next to the auto mode. Handle lookups of the JNI render registry
+// are timed while other streams are created and destroyed, next to a
+// mutex-guarded map. Start latency, from StartPlayout() to the first
+// callback, is measured on the virtual device with and without its warm
+// pool. The cost of an AV_LOG call inside a callback, deferred to the log
+// ring or rate limited, is compared to formatting and writing the line
+// right away. Clock drift correction of a live push source is simulated over
+// hours of producer and device clocks running up to 500 ppm apart, with the
+// latency it holds next to an uncorrected stream's. Offline renders of a
+// file are timed as a realtime factor per thread count and checked byte for
+// byte against the virtual device's output. Results are written as JSON.
+#include "sv_buffer_count_tuner.h"
+#include "sv_channel_converter.h"
+#include "sv_converting_pcm_source.h"
+#include "sv_drift_estimator.h"
+#include "sv_gain_stage.h"
+#include "sv_handle_registry.h"
+#include "sv_latency_tuner.h"
+#include "sv_memory_pcm_source.h"
+#include "sv_mix_kernels.h"
+#include "sv_mixer.h"
+#include "sv_pcm_source.h"
+#include "sv_prefetch_reader.h"
+#include "sv_push_source.h"
+#include "sv_render_stats.h"
+#include "sv_mmap_pcm_file.h"
+#include "sv_offline_render.h"
+#include "sv_resampler.h"
+#include "sv_rt_log.h"
+#include "sv_sample_convert.h"
+#include "sv_stream_control.h"
+#include "sv_tone_pcm_source.h"
+#include "sv_virtual_render.h"
+#include "sv_wav_file.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace sv_render;
+
+// ==== Allocation counting. ====
+// Kept out of line: inlined into the callers GCC would pair malloc() and
+// free() with new and delete and warn about the mismatch.
+static std::atomic<uint64_t> g_allocations { 0 };
+
+__attribute__((noinline)) void* operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+__attribute__((noinline)) void* operator new[](size_t size) {
+  return operator new(size);
+}
+__attribute__((noinline)) void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return malloc(size ? size : 1);
+}
+__attribute__((noinline)) void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+  return operator new(size, tag);
+}
+__attribute__((noinline)) void operator delete(void* ptr) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+namespace {
+
+// ==== Backend shims. ====
+// Each returns the bytes it copied, so the JSON can show the zero-copy paths.
+enum class Backend { kAAudio, kOboe, kOpenSL };
+
+const char* BackendName(Backend backend) {
+  switch (backend) {
+    case Backend::kAAudio: return "aaudio";
+    case Backend::kOboe: return "oboe";
+    case Backend::kOpenSL: return "opensl";
+  }
+  return "unknown";
+}
+
+// The state the backends' callbacks run against: the content behind their
+// SVConvertingPcmSource, here at its own rate and layout, stats, gain stage,
+// stream control and, for AAudio and Oboe, latency tuner and device
+// timestamp.
+struct ShimContext {
+  std::shared_ptr<SVConvertingPcmSource> source;
+  int channels = 0;
+  int sample_rate = 0;
+  SVRenderStats stats;
+  SVGainStage gain;
+  SVStreamControl control;
+  SVLatencyTuner latency_tuner;
+  SVDeviceTimestamp device_timestamp;
+  // What the device reports, the position advancing by every callback.
+  int64_t frames_written = 0;
+  int64_t xrun_count = 0;
+  int buffer_size = 0;
+  std::vector<int16_t> device_buffer;
+  std::vector<int16_t> staging;
+  // What a real SLAndroidSimpleBufferQueueItf::Enqueue would receive, and
+  // how many buffers the queue still holds.
+  const void* enqueued_data = nullptr;
+  size_t enqueued_size = 0;
+  int queued_buffers = 2;
+};
+
+// Like InitAudioRender() and StartPlayout(): source prepared, the fade-in
+// queued and the stream running.
+void PrepareShim(ShimContext* context, IPcmSource::Ptr content, int sample_rate, int channels, int burst) {
+  context->source = std::make_shared<SVConvertingPcmSource>(std::move(content));
+  context->source->SetSourceSampleRate(sample_rate);
+  context->source->SetSourceChannels(channels);
+  context->source->Prepare(sample_rate, channels);
+  context->channels = channels;
+  context->sample_rate = sample_rate;
+  context->stats.Reset(sample_rate);
+  context->gain.Prepare(sample_rate);
+  context->latency_tuner.Reset(SV_LATENCY_POLICY_BALANCED, burst, 16 * burst);
+  context->device_timestamp.Update(context, SVRenderStats::NowNanos(), true, 0, SVRenderStats::NowNanos());
+  context->device_buffer.resize(burst * channels);
+  context->staging.resize(burst * channels);
+  context->control.Transition(SVStreamState::kClosed, SVStreamState::kOpening);
+  context->control.Transition(SVStreamState::kOpening, SVStreamState::kOpen);
+  context->control.Transition(SVStreamState::kOpen, SVStreamState::kStarting);
+  context->stats.MarkStartRequested();
+  context->gain.FadeIn();
+  context->control.FinishStart();
+}
+
+// SVAAudioRender::UpdateDeviceLatency(), the timestamp read from the context.
+void UpdateDeviceLatencyShim(ShimContext* context) {
+  const int64_t now_ns = SVRenderStats::NowNanos();
+  if (context->device_timestamp.Due(context, now_ns)) {
+    context->device_timestamp.Update(context, now_ns, true, context->frames_written, now_ns);
+  }
+  context->source->SetDeviceLatency(context->device_timestamp.Latency(context->frames_written,
+                                                                      context->sample_rate, now_ns));
+}
+
+// SVAAudioRender::DataCallback and SVOboeRender::onAudioReady, with the
+// device calls replaced by the context: the same control scope, stats,
+// device latency, render through the gain stage and latency tuner feed.
+size_t DeviceCallbackShim(ShimContext* context, void* audio_data, int32_t num_frames) {
+  SVStreamControl::CallbackScope control_scope(&context->control);
+  if (!control_scope.render()) {
+    memset(audio_data, 0, num_frames * context->channels * sizeof(int16_t));
+    return 0;
+  }
+  context->stats.MarkDeviceCallback();
+  UpdateDeviceLatencyShim(context);
+  const bool keep_going = RenderPcmSource(context->source.get(), static_cast<int16_t*>(audio_data), num_frames,
+                                          context->channels, &context->stats, &context->gain);
+  context->frames_written += num_frames;
+  if (!keep_going) {
+    context->control.MarkDrained();
+    return 0;
+  }
+  // Stands in for setBufferSizeInFrames().
+  const int buffer_size = context->latency_tuner.Update(context->xrun_count, SVRenderStats::NowNanos());
+  if (buffer_size > 0) {
+    context->buffer_size = buffer_size;
+  }
+  return num_frames * context->channels * sizeof(int16_t);
+}
+
+size_t AAudioDataCallbackShim(ShimContext* context, void* audio_data, int32_t num_frames) {
+  return DeviceCallbackShim(context, audio_data, num_frames);
+}
+
+size_t OboeOnAudioReadyShim(ShimContext* context, void* audio_data, int32_t num_frames) {
+  return DeviceCallbackShim(context, audio_data, num_frames);
+}
+
+// SVOpenslRender::SimpleBufferQueueCallback through FillBufferQueue, one
+// buffer per callback, with Enqueue recording the pointer.
+size_t OpenslFillBufferQueueShim(ShimContext* context, int num_frames) {
+  SVStreamControl::CallbackScope control_scope(&context->control);
+  if (control_scope.closing() || control_scope.state() == SVStreamState::kDrained) {
+    return 0;
+  }
+  context->stats.MarkDeviceCallback();
+  context->source->SetDeviceLatency(static_cast<double>(context->queued_buffers) * num_frames /
+                                    context->sample_rate);
+  const int16_t* data = nullptr;
+  const int frames = AcquirePcmSource(context->source.get(), context->staging.data(), num_frames,
+                                      context->channels, &data, &context->stats, &context->gain);
+  if (frames == 0) {
+    context->control.MarkDrained();
+  }
+  context->enqueued_data = data;
+  context->enqueued_size = frames * context->channels * sizeof(int16_t);
+  return data == context->staging.data() ? context->enqueued_size : 0;
+}
+
+// ==== Sources. ====
+constexpr int kSourceSeconds = 2;
+
+enum class SourceKind { kMemory, kMmap, kPrefetch };
+
+const char* SourceName(SourceKind kind) {
+  switch (kind) {
+    case SourceKind::kMemory: return "memory";
+    case SourceKind::kMmap: return "mmap";
+    case SourceKind::kPrefetch: return "prefetch";
+  }
+  return "unknown";
+}
+
+IPcmSource::Ptr CreateSource(SourceKind kind, const std::string& pcm_path, int channels, int frames) {
+  switch (kind) {
+    case SourceKind::kMemory:
+      return std::make_shared<SVMemoryPcmSource>(std::vector<int16_t>(frames * channels, 1000), true);
+    case SourceKind::kMmap:
+      return std::make_shared<SVMmapPcmFile>(pcm_path);
+    case SourceKind::kPrefetch:
+      // Prepare() primes the whole file into the ring, so the timed pops
+      // measure the ring and never race the prefetch thread into an underrun.
+      return std::make_shared<SVPrefetchReader>(pcm_path, kSourceSeconds * 1000 + 500);
+  }
+  return nullptr;
+}
+
+struct Result {
+  Backend backend;
+  SourceKind source;
+  int burst;
+  int channels;
+  int sample_rate;
+  int callbacks;
+  int64_t p50_ns;
+  int64_t p99_ns;
+  int64_t max_ns;
+  double bytes_copied_per_callback;
+  double allocations_per_callback;
+};
+
+Result RunCase(Backend backend, SourceKind kind, const std::string& pcm_path, int burst, int channels,
+               int sample_rate, int callbacks, int source_frames) {
+  using Clock = std::chrono::steady_clock;
+  ShimContext context;
+  PrepareShim(&context, CreateSource(kind, pcm_path, channels, source_frames), sample_rate, channels, burst);
+  SVConvertingPcmSource* source = context.source.get();
+
+  std::vector<int64_t> samples;
+  samples.reserve(callbacks);
+  uint64_t bytes_copied = 0;
+  uint64_t allocations = 0;
+  const int warmup = std::min(callbacks / 10, 100);
+
+  for (int i = -warmup; i < callbacks; ++i) {
+    if (source->IsEnd()) {
+      // Rewind outside of the timed region.
+      source->Prepare(sample_rate, channels);
+    }
+    const uint64_t allocations_before = g_allocations.load(std::memory_order_relaxed);
+    const auto start = Clock::now();
+    size_t copied = 0;
+    switch (backend) {
+      case Backend::kAAudio:
+        copied = AAudioDataCallbackShim(&context, context.device_buffer.data(), burst);
+        break;
+      case Backend::kOboe:
+        copied = OboeOnAudioReadyShim(&context, context.device_buffer.data(), burst);
+        break;
+      case Backend::kOpenSL:
+        copied = OpenslFillBufferQueueShim(&context, burst);
+        break;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    if (i < 0) continue;
+    allocations += g_allocations.load(std::memory_order_relaxed) - allocations_before;
+    bytes_copied += copied;
+    samples.push_back(elapsed);
+  }
+  source->Release();
+
+  std::sort(samples.begin(), samples.end());
+  Result result {};
+  result.backend = backend;
+  result.source = kind;
+  result.burst = burst;
+  result.channels = channels;
+  result.sample_rate = sample_rate;
+  result.callbacks = callbacks;
+  result.p50_ns = samples[samples.size() / 2];
+  result.p99_ns = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+  result.max_ns = samples.back();
+  result.bytes_copied_per_callback = static_cast<double>(bytes_copied) / callbacks;
+  result.allocations_per_callback = static_cast<double>(allocations) / callbacks;
+  return result;
+}
+
+// ==== Resampler. ====
+struct ResamplerResult {
+  const char* quality;
+  int input_rate;
+  int output_rate;
+  int channels;
+  int taps;
+  int64_t frames;
+  double ns_per_frame;
+  // TSC cycles, -1 where the host has no cycle counter to read.
+  double cycles_per_frame;
+};
+
+const char* QualityName(SVResamplerQuality quality) {
+  switch (quality) {
+    case SVResamplerQuality::kLow: return "low";
+    case SVResamplerQuality::kMedium: return "medium";
+    case SVResamplerQuality::kHigh: return "high";
+  }
+  return "unknown";
+}
+
+int64_t ReadCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return static_cast<int64_t>(__rdtsc());
+#else
+  return -1;
+#endif
+}
+
+ResamplerResult RunResamplerCase(SVResamplerQuality quality, int input_rate, int output_rate, int channels,
+                                 int output_frames) {
+  using Clock = std::chrono::steady_clock;
+  constexpr int kBurst = 256;
+  SVPolyphaseResampler resampler(channels, quality);
+  resampler.SetRates(input_rate, output_rate);
+
+  std::vector<float> input(SVPolyphaseResampler::kMaxInputFrames * channels);
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = 0.5f * static_cast<float>(std::sin(0.01 * i));
+  }
+  std::vector<float> output(kBurst * channels);
+
+  int64_t produced = 0;
+  const auto start = Clock::now();
+  const int64_t cycles_start = ReadCycleCounter();
+  while (produced < output_frames) {
+    const int frames = resampler.Pull(output.data(), kBurst);
+    produced += frames;
+    if (frames < kBurst) {
+      const int needed = std::min(resampler.InputFramesNeeded(kBurst - frames), resampler.InputFramesFree());
+      resampler.Push(input.data(), std::min(needed, SVPolyphaseResampler::kMaxInputFrames));
+    }
+  }
+  const int64_t cycles_end = ReadCycleCounter();
+  const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+  ResamplerResult result {};
+  result.quality = QualityName(quality);
+  result.input_rate = input_rate;
+  result.output_rate = output_rate;
+  result.channels = channels;
+  result.taps = resampler.taps();
+  result.frames = produced;
+  result.ns_per_frame = static_cast<double>(elapsed) / produced;
+  result.cycles_per_frame = cycles_start < 0 ? -1.0 : static_cast<double>(cycles_end - cycles_start) / produced;
+  return result;
+}
+
+// ==== Sample conversion. ====
+struct ConvertResult {
+  const char* kernel;
+  int samples;
+  double simd_ns_per_sample;
+  double scalar_ns_per_sample;
+  // SIMD output equals the scalar reference bit for bit. Gain ramps step
+  // their gain a vector at a time, they may differ by the gain's rounding.
+  bool matches_scalar;
+};
+
+template <typename Kernel>
+double TimeKernel(Kernel kernel, int samples, int iterations) {
+  using Clock = std::chrono::steady_clock;
+  const auto start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    kernel();
+  }
+  const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  return static_cast<double>(elapsed) / (static_cast<double>(samples) * iterations);
+}
+
+void RunConvertCases(int samples, int iterations, std::vector<ConvertResult>* results) {
+  std::vector<int16_t> pcm(samples);
+  std::vector<float> floats(samples);
+  for (int i = 0; i < samples; ++i) {
+    pcm[i] = static_cast<int16_t>((i * 7919) & 0xffff);
+    // Slightly out of range at the peaks, to exercise saturation.
+    floats[i] = 1.1f * static_cast<float>(std::sin(0.001 * i));
+  }
+  std::vector<float> float_out(samples);
+  std::vector<float> float_ref(samples);
+  std::vector<int16_t> pcm_out(samples);
+  std::vector<int16_t> pcm_ref(samples);
+
+  ConvertResult to_float {"int16_to_float", samples};
+  to_float.simd_ns_per_sample = TimeKernel([&] { SVInt16ToFloat(pcm.data(), float_out.data(), samples); },
+                                           samples, iterations);
+  to_float.scalar_ns_per_sample = TimeKernel([&] { SVInt16ToFloatScalar(pcm.data(), float_ref.data(), samples); },
+                                             samples, iterations);
+  to_float.matches_scalar = float_out == float_ref;
+  results->push_back(to_float);
+
+  ConvertResult to_int16 {"float_to_int16", samples};
+  to_int16.simd_ns_per_sample = TimeKernel([&] { SVFloatToInt16(floats.data(), pcm_out.data(), samples); },
+                                           samples, iterations);
+  to_int16.scalar_ns_per_sample = TimeKernel([&] { SVFloatToInt16Scalar(floats.data(), pcm_ref.data(), samples); },
+                                             samples, iterations);
+  to_int16.matches_scalar = pcm_out == pcm_ref;
+  results->push_back(to_int16);
+
+  ConvertResult dithered {"float_to_int16_tpdf", samples};
+  SVDither dither(1);
+  SVDither dither_ref(1);
+  dithered.simd_ns_per_sample = TimeKernel(
+          [&] { SVFloatToInt16Dithered(floats.data(), pcm_out.data(), samples, &dither); }, samples, iterations);
+  dithered.scalar_ns_per_sample = TimeKernel(
+          [&] { SVFloatToInt16DitheredScalar(floats.data(), pcm_ref.data(), samples, &dither_ref); }, samples,
+          iterations);
+  dithered.matches_scalar = pcm_out == pcm_ref;
+  results->push_back(dithered);
+
+  // In place on stereo frames. Timing runs the ramp over the same buffer
+  // again and again, so it stays close to unity to keep the samples normal.
+  const int frames = samples / 2;
+  ConvertResult ramp {"gain_ramp_float", samples};
+  ramp.simd_ns_per_sample = TimeKernel(
+          [&] { SVApplyGainRamp(float_out.data(), 1.0f, 1.0f, -1e-7f, frames, 2); }, samples, iterations);
+  ramp.scalar_ns_per_sample = TimeKernel(
+          [&] { SVApplyGainRampScalar(float_ref.data(), 1.0f, 1.0f, -1e-7f, frames, 2); }, samples, iterations);
+  float_out = floats;
+  float_ref = floats;
+  // An exponential fade-in from -60 dB, the longest recurrence the stage runs.
+  const float ratio = std::pow(1000.0f, 1.0f / frames);
+  SVApplyGainRamp(float_out.data(), 0.001f, ratio, 0.0f, frames, 2);
+  SVApplyGainRampScalar(float_ref.data(), 0.001f, ratio, 0.0f, frames, 2);
+  ramp.matches_scalar = true;
+  for (int i = 0; i < samples; ++i) {
+    ramp.matches_scalar &= std::fabs(float_out[i] - float_ref[i]) <= 1e-3f * std::fabs(float_ref[i]) + 1e-7f;
+  }
+  results->push_back(ramp);
+
+  ConvertResult ramp_int16 {"gain_ramp_int16", samples};
+  ramp_int16.simd_ns_per_sample = TimeKernel(
+          [&] { SVApplyGainRampInt16(pcm_out.data(), 1.0f, 1.0f, -1e-7f, frames, 2); }, samples, iterations);
+  ramp_int16.scalar_ns_per_sample = TimeKernel(
+          [&] { SVApplyGainRampInt16Scalar(pcm_ref.data(), 1.0f, 1.0f, -1e-7f, frames, 2); }, samples, iterations);
+  pcm_out = pcm;
+  pcm_ref = pcm;
+  SVApplyGainRampInt16(pcm_out.data(), 0.0f, 1.0f, 1.0f / frames, frames, 2);
+  SVApplyGainRampInt16Scalar(pcm_ref.data(), 0.0f, 1.0f, 1.0f / frames, frames, 2);
+  ramp_int16.matches_scalar = true;
+  for (int i = 0; i < samples; ++i) {
+    ramp_int16.matches_scalar &= std::abs(pcm_out[i] - pcm_ref[i]) <= 1;
+  }
+  results->push_back(ramp_int16);
+}
+
+// ==== Mixer. ====
+struct MixerResult {
+  int voices;
+  int burst;
+  int channels;
+  int64_t p50_ns;
+  int64_t p99_ns;
+  double ns_per_voice;
+  double allocations_per_callback;
+};
+
+MixerResult RunMixerCase(int voices, int burst, int channels, int callbacks) {
+  using Clock = std::chrono::steady_clock;
+  SVMixer mixer;
+  // Looping int16 voices, so the conversion to float is part of the cost.
+  for (int i = 0; i < voices; ++i) {
+    std::vector<int16_t> samples(4800 * channels, static_cast<int16_t>(100 * (i + 1)));
+    mixer.AddVoice(std::make_shared<SVMemoryPcmSource>(std::move(samples), true), 1.0f / voices);
+  }
+  mixer.Prepare(48000, channels);
+  std::vector<float> device_buffer(burst * channels);
+
+  std::vector<int64_t> samples;
+  samples.reserve(callbacks);
+  uint64_t allocations = 0;
+  for (int i = -10; i < callbacks; ++i) {
+    const uint64_t allocations_before = g_allocations.load(std::memory_order_relaxed);
+    const auto start = Clock::now();
+    mixer.RenderFloat(device_buffer.data(), burst);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    if (i < 0) continue;
+    allocations += g_allocations.load(std::memory_order_relaxed) - allocations_before;
+    samples.push_back(elapsed);
+  }
+  mixer.Release();
+
+  std::sort(samples.begin(), samples.end());
+  MixerResult result {};
+  result.voices = voices;
+  result.burst = burst;
+  result.channels = channels;
+  result.p50_ns = samples[samples.size() / 2];
+  result.p99_ns = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+  result.ns_per_voice = static_cast<double>(result.p50_ns) / voices;
+  result.allocations_per_callback = static_cast<double>(allocations) / callbacks;
+  return result;
+}
+
+// ==== Channel layouts. ====
+struct ChannelResult {
+  int input_channels;
+  int output_channels;
+  int frames;
+  double kernel_ns_per_frame;
+  double matrix_ns_per_frame;
+  double frames_per_second;
+  // Largest difference between the kernel and the matrix path.
+  double max_error;
+};
+
+ChannelResult RunChannelCase(int input_channels, int output_channels, int frames, int iterations) {
+  SVChannelConverter converter(input_channels, output_channels);
+  std::vector<float> input(frames * input_channels);
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = 0.4f * static_cast<float>(std::sin(0.003 * i));
+  }
+  std::vector<float> output(frames * output_channels);
+  std::vector<float> reference(frames * output_channels);
+
+  ChannelResult result {input_channels, output_channels, frames};
+  result.kernel_ns_per_frame = TimeKernel([&] { converter.Process(input.data(), output.data(), frames); },
+                                          frames, iterations);
+  result.matrix_ns_per_frame = TimeKernel([&] { converter.ProcessMatrix(input.data(), reference.data(), frames); },
+                                          frames, iterations);
+  result.frames_per_second = 1e9 / result.kernel_ns_per_frame;
+  for (size_t i = 0; i < output.size(); ++i) {
+    result.max_error = std::max(result.max_error, static_cast<double>(std::fabs(output[i] - reference[i])));
+  }
+  return result;
+}
+
+// ==== WAV decoding. ====
+struct WavResult {
+  SVWavEncoding encoding;
+  int channels;
+  int64_t frames;
+  double bytes_per_frame;
+  // Whole file through SVWavFile::ReadBlock(), page cache to float.
+  double ns_per_frame;
+};
+
+WavResult RunWavCase(SVWavEncoding encoding, int channels, int frames, int iterations) {
+  const std::string path = std::string("sv_render_benchmark_") + SVWavEncodingName(encoding) + ".wav";
+  WavResult result {encoding, channels, frames};
+  {
+    SVWavFormat format;
+    format.encoding = encoding;
+    format.sample_rate = 48000;
+    format.channels = channels;
+    SVWavWriter writer(path, format);
+    std::vector<int16_t> samples(static_cast<size_t>(frames) * channels);
+    for (size_t i = 0; i < samples.size(); ++i) {
+      samples[i] = static_cast<int16_t>(12000.0 * std::sin(0.03 * (i / channels)));
+    }
+    writer.Write(samples.data(), frames);
+    if (!writer.Close()) return result;
+  }
+  SVWavFile file(path);
+  if (file.IsOpen()) {
+    result.bytes_per_frame = static_cast<double>(file.format().block_align) / file.format().frames_per_block;
+    std::vector<float> block(static_cast<size_t>(file.frames_per_read()) * channels);
+    result.ns_per_frame = TimeKernel([&] {
+      file.Rewind();
+      while (file.ReadBlock(block.data()) > 0) {}
+    }, frames, iterations);
+  }
+  remove(path.c_str());
+  return result;
+}
+
+// ==== OpenSL buffer queue. ====
+// How late the buffer queue callback runs: a short wakeup delay, and now and
+// then a stall of the callback thread (preemption, page fault, GC pause).
+struct QueueProfile {
+  const char* name;
+  double stall_probability;
+  double stall_min_ms;
+  double stall_max_ms;
+};
+
+struct OpenslQueueResult {
+  const char* profile;
+  // 0 for the auto mode.
+  int configured_buffers;
+  int num_buffers;
+  int buffer_ms;
+  int64_t buffers;
+  // Device ticks that found the queue empty, and callbacks that saw it empty.
+  int64_t underruns;
+  int64_t detected_underruns;
+};
+
+// Event simulation of SVOpenslRender::OnBufferConsumed(): every buffer_ms
+// the device finishes a buffer and starts the next queued one, the callback
+// for the finished buffer runs after its delay, serialized behind earlier
+// ones, and tops the queue up to the configured or tuned count. Auto mode
+// uses the SVOpenslBufferConfig defaults.
+OpenslQueueResult RunOpenslQueueCase(const QueueProfile& profile, int num_buffers, int buffer_ms,
+                                     int64_t total_buffers) {
+  const bool auto_buffers = num_buffers == 0;
+  SVBufferCountTuner tuner;
+  tuner.Configure(auto_buffers ? 2 : num_buffers, auto_buffers ? 8 : num_buffers, 0.001, 1000);
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  OpenslQueueResult result {profile.name, num_buffers, 0, buffer_ms, total_buffers, 0, 0};
+  // The first buffer starts playing at once, the rest wait in the queue.
+  int queued = tuner.count() - 1;
+  bool playing = true;
+  std::deque<double> callbacks;
+  double last_callback_ms = 0.0;
+  for (int64_t tick = 1; tick <= total_buffers; ++tick) {
+    const double now_ms = static_cast<double>(tick) * buffer_ms;
+    while (!callbacks.empty() && callbacks.front() <= now_ms) {
+      callbacks.pop_front();
+      // Like SLAndroidSimpleBufferQueueState::count, the playing buffer counts.
+      const int count = queued + playing;
+      const bool underrun = count == 0;
+      result.detected_underruns += underrun;
+      const int target = auto_buffers ? tuner.OnBufferConsumed(underrun) : num_buffers;
+      queued += std::max(target - count, 0);
+    }
+    if (playing) {
+      double delay_ms = 0.1 + 0.9 * uniform(rng);
+      if (uniform(rng) < profile.stall_probability) {
+        delay_ms += profile.stall_min_ms + (profile.stall_max_ms - profile.stall_min_ms) * uniform(rng);
+      }
+      last_callback_ms = std::max(now_ms + delay_ms, last_callback_ms);
+      callbacks.push_back(last_callback_ms);
+    }
+    playing = queued > 0;
+    if (playing) {
+      --queued;
+    } else {
+      ++result.underruns;
+    }
+  }
+  result.num_buffers = tuner.count();
+  return result;
+}
+
+// ==== Render registry. ====
+// Stands in for a stream: tearing one down takes a while, like closing a
+// device stream does.
+struct RegistrySession {
+  explicit RegistrySession(int64_t value) : value(value) {}
+  ~RegistrySession() { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+  const int64_t value;
+};
+
+// What a registry without lock-free lookups looks like.
+class MutexRegistry {
+
+public:
+  int64_t Add(std::unique_ptr<RegistrySession> session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions_[++next_handle_] = std::shared_ptr<RegistrySession>(std::move(session));
+    return next_handle_;
+  }
+  std::shared_ptr<RegistrySession> Get(int64_t handle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(handle);
+    return it == sessions_.end() ? nullptr : it->second;
+  }
+  void Remove(int64_t handle) {
+    std::shared_ptr<RegistrySession> session;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = sessions_.find(handle);
+      if (it == sessions_.end()) return;
+      session = std::move(it->second);
+      sessions_.erase(it);
+    }
+  }
+
+private:
+  std::mutex mutex_;
+  std::map<int64_t, std::shared_ptr<RegistrySession>> sessions_;
+  int64_t next_handle_ = 0;
+};
+
+struct RegistryResult {
+  const char* registry;
+  int reader_threads;
+  bool churn;
+  int64_t lookups;
+  int64_t p50_ns;
+  int64_t p99_ns;
+  int64_t max_ns;
+  // Streams created and destroyed while the readers ran.
+  int64_t churn_cycles;
+};
+
+// Reader threads look up a few long-lived streams, like the voice and stats
+// JNI calls do, while one thread keeps creating and destroying others.
+template <typename Registry, typename Ref>
+RegistryResult RunRegistryCase(const char* name, int reader_threads, bool churn, int lookups_per_reader) {
+  constexpr int kStreams = 8;
+  Registry registry;
+  std::vector<int64_t> handles;
+  for (int i = 0; i < kStreams; ++i) {
+    handles.push_back(registry.Add(std::unique_ptr<RegistrySession>(new RegistrySession(i))));
+  }
+  std::atomic<bool> readers_done { false };
+  std::atomic<int64_t> churn_cycles { 0 };
+  std::thread churn_thread;
+  if (churn) {
+    churn_thread = std::thread([&] {
+      while (!readers_done.load()) {
+        const int64_t handle = registry.Add(std::unique_ptr<RegistrySession>(new RegistrySession(-1)));
+        registry.Remove(handle);
+        churn_cycles.fetch_add(1);
+      }
+    });
+  }
+  std::vector<std::vector<int64_t>> samples(reader_threads);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < reader_threads; ++t) {
+    readers.emplace_back([&, t] {
+      samples[t].reserve(lookups_per_reader);
+      int64_t checksum = 0;
+      for (int i = 0; i < lookups_per_reader; ++i) {
+        const int64_t begin_ns = SVRenderStats::NowNanos();
+        Ref session = registry.Get(handles[i % kStreams]);
+        checksum += session ? session->value : 0;
+        samples[t].push_back(SVRenderStats::NowNanos() - begin_ns);
+      }
+      if (checksum < 0) fprintf(stderr, "lookup returned a removed stream.\n");
+    });
+  }
+  for (auto& reader : readers) reader.join();
+  readers_done.store(true);
+  if (churn_thread.joinable()) churn_thread.join();
+  for (int64_t handle : handles) registry.Remove(handle);
+
+  std::vector<int64_t> all;
+  for (const auto& thread_samples : samples) all.insert(all.end(), thread_samples.begin(), thread_samples.end());
+  std::sort(all.begin(), all.end());
+  return {name, reader_threads, churn, static_cast<int64_t>(all.size()), all[all.size() / 2],
+          all[all.size() * 99 / 100], all.back(), churn_cycles.load()};
+}
+
+// ==== Start latency. ====
+struct StartupResult {
+  double cold_start_ms;
+  bool pooled;
+  int starts;
+  // StartPlayout() to the first callback.
+  int64_t p50_ns;
+  int64_t max_ns;
+  // Devices the starts found parked in the warm pool.
+  int64_t pool_hits;
+};
+
+// Starts and stops a stream repeatedly on a virtual device whose opening
+// costs cold_start_ms. Unpooled, every start finds the pool empty like a
+// process without one would.
+StartupResult RunStartupCase(double cold_start_ms, bool pooled, int starts) {
+  SVVirtualDeviceConfig config;
+  config.cold_start_ms = cold_start_ms;
+  auto& pool = SVVirtualRender::device_pool();
+  pool.Clear();
+  const int64_t hits_before = pool.hits();
+  std::vector<int64_t> samples;
+  for (int i = 0; i < starts; ++i) {
+    if (!pooled) {
+      pool.Clear();
+    }
+    SVVirtualRender render(std::make_shared<SVTonePcmSource>(440.0, 0.5, 1000), config);
+    SVRenderStatsSnapshot stats;
+    if (render.InitAudioRender(48000, 2) != SV_NO_ERROR || render.StartPlayout() != SV_NO_ERROR) {
+      continue;
+    }
+    do {
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      render.GetStats(&stats);
+    } while (stats.start_latency_ns < 0);
+    render.StopPlayout();
+    samples.push_back(stats.start_latency_ns);
+  }
+  pool.Clear();
+  std::sort(samples.begin(), samples.end());
+  return {cold_start_ms, pooled, static_cast<int>(samples.size()), samples.empty() ? 0 : samples[samples.size() / 2],
+          samples.empty() ? 0 : samples.back(), pool.hits() - hits_before};
+}
+
+// ==== Callback logging. ====
+struct RtLogResult {
+  // "direct": formatted and written by the calling thread, as AV_LOG did
+  // before; "deferred": recorded into the log ring from a callback;
+  // "rate_limited": repeated within a site's interval; "overflow": a burst
+  // larger than the ring with no drain in between.
+  const char* mode;
+  int64_t logs;
+  double ns_per_log;
+  // Lines that reached the writer and records lost to a full ring.
+  int64_t written;
+  int64_t dropped;
+};
+
+std::atomic<int64_t> g_log_lines { 0 };
+FILE* g_log_sink = nullptr;
+
+void SinkLogWriter(SV_LOG_LEVEL, const char* text) {
+  g_log_lines.fetch_add(1, std::memory_order_relaxed);
+  fputs(text, g_log_sink);
+  fputc('\n', g_log_sink);
+}
+
+RtLogResult RunRtLogCase(const char* mode, int logs) {
+  using Clock = std::chrono::steady_clock;
+  static const char* kFormat = "callback %d: %d frames, %.2f ms late, source %s";
+  const bool rate_limited = !strcmp(mode, "rate_limited");
+  const bool in_callback = strcmp(mode, "direct") != 0;
+  // Deferred records are drained between batches so the ring never fills.
+  const int batch = !strcmp(mode, "deferred") ? 64 : logs;
+  SVRtLogSite site(SV_LOG_DEBUG, kFormat, rate_limited ? SVRtLogSite::kDefaultIntervalNs : 0);
+
+  SVRtLog::SetWriter(SinkLogWriter);
+  SVRtLog::Flush();
+  g_log_lines.store(0);
+  const uint64_t dropped_before = SVRtLog::dropped_count();
+  Clock::duration elapsed {};
+  for (int done = 0; done < logs; done += batch) {
+    const int count = std::min(batch, logs - done);
+    if (in_callback) SVRtLog::EnterCallback();
+    const auto begin = Clock::now();
+    for (int i = 0; i < count; ++i) {
+      SVRtLog::Log(&site, done + i, 192, 0.25 * i, "tone");
+    }
+    elapsed += Clock::now() - begin;
+    if (in_callback) SVRtLog::LeaveCallback();
+    if (batch < logs) SVRtLog::Flush();
+  }
+  SVRtLog::Flush();
+  SVRtLog::SetWriter(nullptr);
+  const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+  // The drop report is a line of its own.
+  const int64_t dropped = static_cast<int64_t>(SVRtLog::dropped_count() - dropped_before);
+  return {mode, logs, ns / logs, g_log_lines.load() - (dropped > 0 ? 1 : 0), dropped};
+}
+
+// ==== Clock drift. ====
+struct DriftResult {
+  double producer_ppm;
+  double device_ppm;
+  bool corrected;
+  double hours;
+  int target_ms;
+  // Producer to speaker, averaged over each simulated second: the last
+  // second, and the furthest any second strayed from the target once the
+  // first kDriftSettleS had passed. Corrected streams count the resampler's
+  // input too, as their estimator does.
+  double final_latency_ms;
+  double max_error_ms;
+  int64_t underruns;
+  int64_t rejected_frames;
+  // Rate correction at the end, the estimator's drift, and the drift the
+  // two clocks really had.
+  double correction_ppm;
+  double drift_estimate_ppm;
+  double true_drift_ppm;
+  // Host time per simulated hour.
+  double cpu_s_per_hour;
+};
+
+// The correction starts from a cold integral, the first minutes lock on.
+constexpr double kDriftSettleS = 600.0;
+
+// A live producer writes 10 ms chunks into a push source on its clock, a
+// device pulls 192 frame bursts on its own, both off nominal by their ppm.
+// Time is simulated, so hours run in seconds and every run is the same. The
+// producer prerolls the target latency, like a jitter buffer filling.
+DriftResult RunDriftCase(double producer_ppm, double device_ppm, bool corrected, double hours) {
+  using Clock = std::chrono::steady_clock;
+  constexpr int kRate = 48000;
+  constexpr int kBurst = 192;
+  constexpr int kChunk = kRate / 100;
+  constexpr int kTargetMs = 100;
+  // Two bursts in the device past the callback, the last written frame's wait.
+  constexpr double kDeviceLatencyS = 2.0 * kBurst / kRate;
+
+  auto push = std::make_shared<SVPushSource>(kRate, 1, 2 * kTargetMs);
+  auto voice = std::make_shared<SVConvertingPcmSource>(push);
+  voice->SetSourceSampleRate(kRate);
+  voice->SetSourceChannels(1);
+  voice->SetDriftCorrection(corrected ? kTargetMs : 0);
+  voice->Prepare(kRate, 1);
+
+  // 1 kHz, a whole number of cycles per chunk.
+  std::vector<int16_t> chunk(kChunk);
+  for (int i = 0; i < kChunk; ++i) {
+    chunk[i] = static_cast<int16_t>(8000.0 * std::sin(2.0 * 3.14159265358979323846 * 1000.0 * i / kRate));
+  }
+  std::vector<float> burst(kBurst);
+
+  const double chunk_period = 0.01 / (1.0 + producer_ppm * 1e-6);
+  const double burst_period = static_cast<double>(kBurst) / kRate / (1.0 + device_ppm * 1e-6);
+  const double end_s = hours * 3600.0;
+  for (int i = 0; i < kTargetMs / 10; ++i) {
+    push->Write(chunk.data(), kChunk, false);
+  }
+  int64_t chunks = 0;
+  int64_t bursts = 0;
+  double window_sum = 0.0;
+  int window_samples = 0;
+  double window_end = 1.0;
+  double last_second_ms = 0.0;
+  double max_error_ms = 0.0;
+
+  const auto begin = Clock::now();
+  while (true) {
+    const double producer_time = chunks * chunk_period;
+    const double device_time = bursts * burst_period;
+    if (std::min(producer_time, device_time) >= end_s) break;
+    if (producer_time <= device_time) {
+      push->Write(chunk.data(), kChunk, false);
+      ++chunks;
+      continue;
+    }
+    voice->SetDeviceLatency(kDeviceLatencyS);
+    voice->RenderFloat(burst.data(), kBurst);
+    ++bursts;
+    window_sum += corrected ? voice->drift_estimator().latency_s()
+                            : static_cast<double>(push->queued_frames()) / kRate + kDeviceLatencyS;
+    ++window_samples;
+    if (device_time >= window_end) {
+      last_second_ms = 1000.0 * window_sum / window_samples;
+      if (device_time >= kDriftSettleS) {
+        max_error_ms = std::max(max_error_ms, std::fabs(last_second_ms - kTargetMs));
+      }
+      window_sum = 0.0;
+      window_samples = 0;
+      window_end += 1.0;
+    }
+  }
+  const double cpu_s = std::chrono::duration<double>(Clock::now() - begin).count();
+  voice->Release();
+
+  const SVDriftEstimator& drift = voice->drift_estimator();
+  return {producer_ppm, device_ppm, corrected, hours, kTargetMs, last_second_ms, max_error_ms,
+          static_cast<int64_t>(push->underruns()), static_cast<int64_t>(push->rejected_frames()),
+          drift.correction_ppm(), drift.drift_ppm(), ((1.0 + producer_ppm * 1e-6) / (1.0 + device_ppm * 1e-6) - 1.0) * 1e6,
+          cpu_s / hours};
+}
+
+// ==== Offline render. ====
+constexpr int kOfflineSeconds = 600;
+
+struct OfflineResult {
+  int input_rate;
+  int output_rate;
+  const char* format;
+  int threads;
+  double audio_s;
+  double wall_s;
+  double realtime_factor;
+  int64_t shards;
+  // Same bytes as the virtual device wrote for the content.
+  bool matches_device;
+};
+
+uint64_t HashFile(const std::string& path) {
+  // FNV-1a.
+  uint64_t hash = 1469598103934665603ull;
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) return 0;
+  std::vector<uint8_t> block(1 << 16);
+  size_t read = 0;
+  while ((read = fread(block.data(), 1, block.size(), file)) > 0) {
+    for (size_t i = 0; i < read; ++i) {
+      hash = (hash ^ block[i]) * 1099511628211ull;
+    }
+  }
+  fclose(file);
+  return hash;
+}
+
+// What the virtual device writes for pcm_path, pulled as fast as it goes.
+// The mapped file never underruns, so this is the reference output.
+uint64_t DeviceOutputHash(const std::string& pcm_path, int input_rate, int output_rate, SV_SAMPLE_FORMAT format,
+                          const std::string& out_path) {
+  SVVirtualDeviceConfig config;
+  config.sample_rate = output_rate;
+  config.realtime = false;
+  config.output_path = out_path;
+  SVVirtualRender render(std::make_shared<SVMmapPcmFile>(pcm_path), config);
+  render.SetSampleFormat(format);
+  if (render.InitAudioRender(input_rate, 2) != SV_NO_ERROR || render.StartPlayout() != SV_NO_ERROR) {
+    return 0;
+  }
+  render.WaitForCompletion();
+  render.StopPlayout();
+  const uint64_t hash = HashFile(out_path);
+  remove(out_path.c_str());
+  return hash;
+}
+
+OfflineResult RunOfflineCase(const std::string& pcm_path, int input_rate, int output_rate, SV_SAMPLE_FORMAT format,
+                             int threads, uint64_t device_hash, const std::string& out_path) {
+  SVOfflineRenderConfig config;
+  config.sample_rate = output_rate;
+  config.sample_format = format;
+  config.threads = threads;
+  config.output_path = out_path;
+  SVOfflineRender render([pcm_path] { return std::make_shared<SVMmapPcmFile>(pcm_path); }, config);
+  const bool ok = render.Render(input_rate, 2) == SV_NO_ERROR;
+  const uint64_t hash = HashFile(out_path);
+  remove(out_path.c_str());
+  return {input_rate, output_rate, format == SV_SAMPLE_FORMAT_FLOAT ? "float" : "i16", threads,
+          render.audio_seconds(), render.wall_seconds(), render.realtime_factor(), render.shard_count(),
+          ok && hash != 0 && hash == device_hash};
+}
+
+bool WritePcmFile(const std::string& path, int frames, int channels) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) return false;
+  std::vector<int16_t> samples(frames * channels);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    samples[i] = static_cast<int16_t>((i * 37) & 0x7fff);
+  }
+  const size_t written = fwrite(samples.data(), sizeof(int16_t), samples.size(), file);
+  fclose(file);
+  return written == samples.size();
+}
+
+void WriteJson(FILE* out, const std::vector<Result>& results, const std::vector<ResamplerResult>& resampler_results,
+               const std::vector<ConvertResult>& convert_results, const std::vector<MixerResult>& mixer_results,
+               const std::vector<ChannelResult>& channel_results, const std::vector<WavResult>& wav_results,
+               const std::vector<OpenslQueueResult>& queue_results,
+               const std::vector<RegistryResult>& registry_results,
+               const std::vector<StartupResult>& startup_results,
+               const std::vector<RtLogResult>& rt_log_results,
+               const std::vector<DriftResult>& drift_results,
+               const std::vector<OfflineResult>& offline_results) {
+  fprintf(out, "{\n  \"benchmark\": \"render_callback\",\n  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    fprintf(out,
+            "    {\"backend\": \"%s\", \"source\": \"%s\", \"burst\": %d, \"channels\": %d, \"sample_rate\": %d, "
+            "\"callbacks\": %d, \"p50_ns\": %lld, \"p99_ns\": %lld, \"max_ns\": %lld, "
+            "\"bytes_copied_per_callback\": %.1f, \"allocations_per_callback\": %.3f}%s\n",
+            BackendName(r.backend), SourceName(r.source), r.burst, r.channels, r.sample_rate, r.callbacks,
+            (long long) r.p50_ns, (long long) r.p99_ns, (long long) r.max_ns, r.bytes_copied_per_callback,
+            r.allocations_per_callback, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"resampler\": [\n");
+  for (size_t i = 0; i < resampler_results.size(); ++i) {
+    const ResamplerResult& r = resampler_results[i];
+    fprintf(out,
+            "    {\"quality\": \"%s\", \"input_rate\": %d, \"output_rate\": %d, \"channels\": %d, \"taps\": %d, "
+            "\"frames\": %lld, \"ns_per_frame\": %.2f, \"cycles_per_frame\": %.1f}%s\n",
+            r.quality, r.input_rate, r.output_rate, r.channels, r.taps, (long long) r.frames, r.ns_per_frame,
+            r.cycles_per_frame, i + 1 < resampler_results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"convert\": [\n");
+  for (size_t i = 0; i < convert_results.size(); ++i) {
+    const ConvertResult& r = convert_results[i];
+    fprintf(out,
+            "    {\"kernel\": \"%s\", \"samples\": %d, \"simd_ns_per_sample\": %.3f, "
+            "\"scalar_ns_per_sample\": %.3f, \"matches_scalar\": %s}%s\n",
+            r.kernel, r.samples, r.simd_ns_per_sample, r.scalar_ns_per_sample, r.matches_scalar ? "true" : "false",
+            i + 1 < convert_results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"mixer\": [\n");
+  for (size_t i = 0; i < mixer_results.size(); ++i) {
+    const MixerResult& r = mixer_results[i];
+    fprintf(out,
+            "    {\"voices\": %d, \"burst\": %d, \"channels\": %d, \"p50_ns\": %lld, \"p99_ns\": %lld, "
+            "\"ns_per_voice\": %.1f, \"allocations_per_callback\": %.3f}%s\n",
+            r.voices, r.burst, r.channels, (long long) r.p50_ns, (long long) r.p99_ns, r.ns_per_voice,
+            r.allocations_per_callback, i + 1 < mixer_results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"channels\": [\n");
+  for (size_t i = 0; i < channel_results.size(); ++i) {
+    const ChannelResult& r = channel_results[i];
+    fprintf(out,
+            "    {\"input_channels\": %d, \"output_channels\": %d, \"frames\": %d, \"kernel_ns_per_frame\": %.3f, "
+            "\"matrix_ns_per_frame\": %.3f, \"frames_per_second\": %.0f, \"max_error\": %g}%s\n",
+            r.input_channels, r.output_channels, r.frames, r.kernel_ns_per_frame, r.matrix_ns_per_frame,
+            r.frames_per_second, r.max_error, i + 1 < channel_results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"wav\": [\n");
+  for (size_t i = 0; i < wav_results.size(); ++i) {
+    const WavResult& r = wav_results[i];
+    fprintf(out,
+            "    {\"encoding\": \"%s\", \"channels\": %d, \"frames\": %lld, \"bytes_per_frame\": %.3f, "
+            "\"ns_per_frame\": %.2f}%s\n",
+            SVWavEncodingName(r.encoding), r.channels, (long long) r.frames, r.bytes_per_frame, r.ns_per_frame,
+            i + 1 < wav_results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"opensl_queue\": [\n");
+  for (size_t i = 0; i < queue_results.size(); ++i) {
+    const OpenslQueueResult& r = queue_results[i];
+    fprintf(out,
+            "    {\"profile\": \"%s\", \"mode\": \"%s\", \"num_buffers\": %d, \"latency_ms\": %d, "
+            "\"buffers\": %lld, \"underruns\": %lld, \"underrun_rate\": %.5f, \"detected_underruns\": %lld}%s\n",
+            r.profile, r.configured_buffers == 0 ? "auto" : "fixed", r.num_buffers, r.num_buffers * r.buffer_ms,
+            (long long) r.buffers, (long long) r.underruns, static_cast<double>(r.underruns) / r.buffers,
+            (long long) r.detected_underruns, i + 1 < queue_results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"registry\": [\n");
+  for (size_t i = 0; i < registry_results.size(); ++i) {
+    const RegistryResult& r = registry_results[i];
+    fprintf(out,
+            "    {\"registry\": \"%s\", \"reader_threads\": %d, \"churn\": %s, \"lookups\": %lld, "
+            "\"p50_ns\": %lld, \"p99_ns\": %lld, \"max_ns\": %lld, \"churn_cycles\": %lld}%s\n",
+            r.registry, r.reader_threads, r.churn ? "true" : "false", (long long) r.lookups, (long long) r.p50_ns,
+            (long long) r.p99_ns, (long long) r.max_ns, (long long) r.churn_cycles,
+            i + 1 < registry_results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"startup\": [\n");
+  for (size_t i = 0; i < startup_results.size(); ++i) {
+    const StartupResult& r = startup_results[i];
+    fprintf(out,
+            "    {\"cold_start_ms\": %.1f, \"pooled\": %s, \"starts\": %d, \"p50_ns\": %lld, \"max_ns\": %lld, "
+            "\"pool_hits\": %lld}%s\n",
+            r.cold_start_ms, r.pooled ? "true" : "false", r.starts, (long long) r.p50_ns, (long long) r.max_ns,
+            (long long) r.pool_hits, i + 1 < startup_results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"rt_log\": [\n");
+  for (size_t i = 0; i < rt_log_results.size(); ++i) {
+    const RtLogResult& r = rt_log_results[i];
+    fprintf(out,
+            "    {\"mode\": \"%s\", \"logs\": %lld, \"ns_per_log\": %.1f, \"written\": %lld, "
+            "\"dropped\": %lld}%s\n",
+            r.mode, (long long) r.logs, r.ns_per_log, (long long) r.written, (long long) r.dropped,
+            i + 1 < rt_log_results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"drift\": [\n");
+  for (size_t i = 0; i < drift_results.size(); ++i) {
+    const DriftResult& r = drift_results[i];
+    fprintf(out,
+            "    {\"producer_ppm\": %.0f, \"device_ppm\": %.0f, \"corrected\": %s, \"hours\": %.1f, "
+            "\"target_ms\": %d, \"final_latency_ms\": %.2f, \"max_error_ms\": %.2f, \"underruns\": %lld, "
+            "\"rejected_frames\": %lld, \"correction_ppm\": %.1f, \"drift_estimate_ppm\": %.1f, "
+            "\"true_drift_ppm\": %.1f, \"cpu_s_per_hour\": %.2f}%s\n",
+            r.producer_ppm, r.device_ppm, r.corrected ? "true" : "false", r.hours, r.target_ms, r.final_latency_ms,
+            r.max_error_ms, (long long) r.underruns, (long long) r.rejected_frames, r.correction_ppm,
+            r.drift_estimate_ppm, r.true_drift_ppm, r.cpu_s_per_hour, i + 1 < drift_results.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"offline\": [\n");
+  for (size_t i = 0; i < offline_results.size(); ++i) {
+    const OfflineResult& r = offline_results[i];
+    fprintf(out,
+            "    {\"input_rate\": %d, \"output_rate\": %d, \"format\": \"%s\", \"threads\": %d, "
+            "\"audio_s\": %.1f, \"wall_s\": %.3f, \"realtime_factor\": %.1f, \"shards\": %lld, "
+            "\"matches_device\": %s}%s\n",
+            r.input_rate, r.output_rate, r.format, r.threads, r.audio_s, r.wall_s, r.realtime_factor,
+            (long long) r.shards, r.matches_device ? "true" : "false", i + 1 < offline_results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  std::string out_path;
+  int callbacks = 2000;
+  double drift_hours = 2.0;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+      out_path = argv[++i];
+    } else if (!strcmp(argv[i], "--callbacks") && i + 1 < argc) {
+      callbacks = std::max(atoi(argv[++i]), 1);
+    } else if (!strcmp(argv[i], "--drift-hours") && i + 1 < argc) {
+      drift_hours = std::max(atof(argv[++i]), 0.01);
+    } else {
+      fprintf(stderr, "Usage: %s [--out results.json] [--callbacks n] [--drift-hours h]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  const int bursts[] = {64, 128, 256, 512, 1024, 2048, 4096};
+  const int channel_counts[] = {1, 2};
+  const int sample_rates[] = {44100, 48000};
+  const Backend backends[] = {Backend::kAAudio, Backend::kOboe, Backend::kOpenSL};
+  const SourceKind sources[] = {SourceKind::kMemory, SourceKind::kMmap, SourceKind::kPrefetch};
+
+  // A couple of seconds of audio per file, the sources rewind when they run out.
+  const int source_frames = kSourceSeconds * 48000;
+  std::vector<Result> results;
+  for (int channels : channel_counts) {
+    const std::string pcm_path = "sv_render_benchmark_" + std::to_string(channels) + "ch.pcm";
+    if (!WritePcmFile(pcm_path, source_frames, channels)) {
+      fprintf(stderr, "write %s failed.\n", pcm_path.c_str());
+      return 1;
+    }
+    for (int sample_rate : sample_rates) {
+      for (int burst : bursts) {
+        for (Backend backend : backends) {
+          for (SourceKind source : sources) {
+            results.push_back(RunCase(backend, source, pcm_path, burst, channels, sample_rate, callbacks,
+                                      source_frames));
+          }
+        }
+      }
+    }
+    remove(pcm_path.c_str());
+  }
+
+  const SVResamplerQuality qualities[] = {SVResamplerQuality::kLow, SVResamplerQuality::kMedium,
+                                          SVResamplerQuality::kHigh};
+  const int conversions[][2] = {{44100, 48000}, {48000, 44100}, {22050, 48000}, {96000, 48000}};
+  std::vector<ResamplerResult> resampler_results;
+  for (SVResamplerQuality quality : qualities) {
+    for (const auto& conversion : conversions) {
+      for (int channels : channel_counts) {
+        resampler_results.push_back(RunResamplerCase(quality, conversion[0], conversion[1], channels,
+                                                     callbacks * 256));
+      }
+    }
+  }
+
+  // One callback buffer per pass: a 192 frame stereo burst up to 4096 frames.
+  std::vector<ConvertResult> convert_results;
+  for (int samples : {384, 1024, 8192}) {
+    RunConvertCases(samples, callbacks * 10, &convert_results);
+  }
+
+  std::vector<MixerResult> mixer_results;
+  for (int voices : {1, 2, 4, 8, 16, 32, 64}) {
+    for (int channels : channel_counts) {
+      mixer_results.push_back(RunMixerCase(voices, 192, channels, callbacks));
+    }
+  }
+
+  const int layouts[][2] = {{1, 2}, {2, 1}, {6, 2}, {8, 2}, {6, 1}, {2, 6}};
+  std::vector<ChannelResult> channel_results;
+  for (const auto& layout : layouts) {
+    channel_results.push_back(RunChannelCase(layout[0], layout[1], 1024, callbacks * 10));
+  }
+
+  std::vector<WavResult> wav_results;
+  for (SVWavEncoding encoding : {SVWavEncoding::kPcm16, SVWavEncoding::kFloat32, SVWavEncoding::kImaAdpcm}) {
+    for (int channels : channel_counts) {
+      wav_results.push_back(RunWavCase(encoding, channels, kSourceSeconds * 48000, std::max(callbacks / 100, 1)));
+    }
+  }
+
+  // Ten minutes of 10 ms buffers per case.
+  const QueueProfile profiles[] = {{"idle", 0.0005, 5.0, 12.0}, {"busy", 0.005, 10.0, 25.0},
+                                   {"overloaded", 0.02, 20.0, 45.0}};
+  std::vector<OpenslQueueResult> queue_results;
+  for (const QueueProfile& profile : profiles) {
+    for (int num_buffers : {2, 3, 4, 6, 0}) {
+      queue_results.push_back(RunOpenslQueueCase(profile, num_buffers, 10, 60000));
+    }
+  }
+
+  std::vector<RegistryResult> registry_results;
+  for (int reader_threads : {1, 4}) {
+    for (bool churn : {false, true}) {
+      registry_results.push_back(RunRegistryCase<SVHandleRegistry<RegistrySession>,
+                                                 SVHandleRegistry<RegistrySession>::Ref>(
+              "lock_free", reader_threads, churn, callbacks * 100));
+      registry_results.push_back(RunRegistryCase<MutexRegistry, std::shared_ptr<RegistrySession>>(
+              "mutex", reader_threads, churn, callbacks * 100));
+    }
+  }
+
+  std::vector<StartupResult> startup_results;
+  for (double cold_start_ms : {0.0, 20.0}) {
+    for (bool pooled : {false, true}) {
+      startup_results.push_back(RunStartupCase(cold_start_ms, pooled, 20));
+    }
+  }
+
+  // Lines go to /dev/null, so the direct case pays for formatting and stdio
+  // but not for a terminal.
+  g_log_sink = fopen("/dev/null", "w");
+  std::vector<RtLogResult> rt_log_results;
+  if (g_log_sink) {
+    for (const char* mode : {"direct", "deferred", "rate_limited"}) {
+      rt_log_results.push_back(RunRtLogCase(mode, callbacks * 10));
+    }
+    rt_log_results.push_back(RunRtLogCase("overflow", 4096));
+    fclose(g_log_sink);
+  }
+
+  // Producer and device each off by up to 500 ppm, together 1000 ppm apart,
+  // and the worst single offsets left uncorrected.
+  const double drift_cases[][3] = {{0, 0, 1}, {500, 0, 1}, {-500, 0, 1}, {0, 500, 1}, {0, -500, 1},
+                                   {500, -500, 1}, {-500, 500, 1}, {500, 0, 0}, {-500, 0, 0}};
+  std::vector<DriftResult> drift_results;
+  for (const auto& drift_case : drift_cases) {
+    drift_results.push_back(RunDriftCase(drift_case[0], drift_case[1], drift_case[2] != 0, drift_hours));
+  }
+
+  // Ten minutes of stereo content, resampled and not, on up to as many
+  // threads as the host has cores, and one more.
+  std::vector<OfflineResult> offline_results;
+  const struct {
+    int input_rate;
+    int output_rate;
+    SV_SAMPLE_FORMAT format;
+  } offline_cases[] = {{44100, 48000, SV_SAMPLE_FORMAT_I16}, {48000, 48000, SV_SAMPLE_FORMAT_I16},
+                       {44100, 48000, SV_SAMPLE_FORMAT_FLOAT}};
+  const int max_threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+  std::vector<int> thread_counts = {1};
+  for (int threads = 2; threads <= max_threads; threads *= 2) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(thread_counts.back() + 1);
+  const std::string pcm_path = "sv_render_benchmark_offline.pcm";
+  const std::string render_path = "sv_render_benchmark_offline.out";
+  for (const auto& offline_case : offline_cases) {
+    if (!WritePcmFile(pcm_path, kOfflineSeconds * offline_case.input_rate, 2)) {
+      fprintf(stderr, "write %s failed.\n", pcm_path.c_str());
+      return 1;
+    }
+    const uint64_t device_hash = DeviceOutputHash(pcm_path, offline_case.input_rate, offline_case.output_rate,
+                                                  offline_case.format, render_path);
+    for (int threads : thread_counts) {
+      offline_results.push_back(RunOfflineCase(pcm_path, offline_case.input_rate, offline_case.output_rate,
+                                               offline_case.format, threads, device_hash, render_path));
+    }
+    remove(pcm_path.c_str());
+  }
+
+  FILE* out = out_path.empty() ? stdout : fopen(out_path.c_str(), "w");
+  if (!out) {
+    fprintf(stderr, "open %s failed.\n", out_path.c_str());
+    return 1;
+  }
+  WriteJson(out, results, resampler_results, convert_results, mixer_results, channel_results, wav_results,
+            queue_results, registry_results, startup_results, rt_log_results, drift_results, offline_results);
+  if (out != stdout) fclose(out);
+  return 0;
+}
@@ -0,0 +1,733 @@
+// Host driver for the virtual device backend: plays raw PCM and WAV files and
+// test tones through SVVirtualRender so the render pipeline can be exercised
+// and profiled without a phone. Several inputs are summed by the mixer, or
+// played back to back with --playlist. --seek jumps inside the first file
+// input or the current playlist item while it plays. --buffer-capacity gives
+// the device a buffer that the latency policy sizes from its xruns.
+// --cold-start-ms makes opening the device slow and --prewarm opens it
+// before the stream starts, to measure the start latency the warm pool saves.
+// --push-tone feeds a tone from a producer thread through SVPushSource, the
+// way the JNI write() path feeds PCM from Kotlin. --push-latency holds its
+// latency against --push-skew and --device-skew, producer and device clocks
+// running apart, and fails the run if it ended further than
+// --push-tolerance from the target or the queue ran dry.
+// --disconnect makes the device go away mid-playback, like an unplugged
+// headset, and reports how long the stream took to recover.
+// --stress-control races random sequences of control calls from two
+// threads against running streams and checks the state machine holds.
+// --offline renders the same pipeline with no device, as fast as it goes,
+// into --out; --threads shards a single seekable file across cores.
+// --rt-audit fails the run if the callback allocated, locked, slept or did
+// I/O, in builds configured with -DSV_RT_AUDIT=ON.
+#include "sv_converting_pcm_source.h"
+#include "sv_mixer.h"
+#include "sv_offline_render.h"
+#include "sv_pcm_source.h"
+#include "sv_playlist_source.h"
+#include "sv_push_source.h"
+#include "sv_rt_audit.h"
+#include "sv_tone_pcm_source.h"
+#include "sv_virtual_render.h"
+#include "sv_wav_file.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace sv_render;
+
+static void PrintUsage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] [input.pcm|input.wav ...]\n"
+          "  --rate <hz>          content sample rate (default 48000, or the first WAV's)\n"
+          "  --channels <n>       content channel count (default 2, or the first WAV's)\n"
+          "  --device-rate <hz>   native device rate, content is resampled to it\n"
+          "  --device-channels <n> device channel count, content is up/down-mixed to it\n"
+          "  --burst <frames>     frames per device callback (default 192)\n"
+          "  --jitter-ms <ms>     max callback lateness (default 0)\n"
+          "  --stall <p>:<ms>     with probability p a callback is ms later still\n"
+          "  --buffer-capacity <bursts> simulate a device buffer, xruns when a callback is later than it\n"
+          "  --latency-policy <p> off|lowest|balanced|robust, sizes that buffer (default balanced)\n"
+          "  --out <file>         write rendered PCM to file instead of a null sink\n"
+          "  --float              run the device in float32 instead of int16\n"
+          "  --cold-start-ms <ms> a newly opened device waits ms before its first callback\n"
+          "  --prewarm            open the device ahead into the warm pool, the stream skips the cold start\n"
+          "  --fast               don't pace callbacks to the wall clock\n"
+          "  --tone <hz>          add a sine tone input, may be repeated\n"
+          "  --duration-ms <ms>   tone duration (default 1000)\n"
+          "  --gain <g>           gain of each input when mixing several (default 1.0)\n"
+          "  --push-tone <hz>     push a tone from a producer thread, like a decoder writing PCM\n"
+          "  --push-nonblocking   pace the pushes to the wall clock and drop what doesn't fit\n"
+          "  --push-latency <ms>  hold the pushed stream's latency at ms against clock drift\n"
+          "  --push-tolerance <ms> fail if the held latency ends further than ms off target (default 20)\n"
+          "  --push-skew <ppm>    the non-blocking producer's clock runs ppm fast, slow if negative\n"
+          "  --device-skew <ppm>  the device's clock runs ppm fast, slow if negative\n"
+          "  --playlist           play the input files back to back, gapless, instead of mixing them\n"
+          "  --seek <ms>:<frame>  after ms of playback, seek the first file input to frame (its own rate)\n"
+          "  --fade-ms <ms>       fade in on start and out on stop over ms, 0 cuts (default 10)\n"
+          "  --ramp <ms>:<g>:<len>[:exp] after ms of playback, ramp the stream gain to g over len ms\n"
+          "  --stop-after-ms <ms> stop after ms of playback instead of at the end of the content\n"
+          "  --disconnect <ms>[:<hz>] each device disconnects after ms of playback, the stream recovers\n"
+          "                       onto a new one, at hz if given\n"
+          "  --reconnect-failures <n> reopens that fail after each disconnect before one succeeds\n"
+          "  --stress-control <n> race n random sequences of init/start/pause/resume/stop/gain calls\n"
+          "  --offline            render into --out (raw, or WAV if it ends in .wav) with no device, as fast as it goes\n"
+          "  --threads <n>        offline, shard a single seekable file input across n threads (default 1)\n"
+          "  --shard-ms <ms>      offline, output each shard renders (default 10000)\n"
+          "  --rt-audit           report blocking calls made in the callback, exit 3 if any (SV_RT_AUDIT builds)\n"
+          "  --encode-adpcm <wav> encode the content to an IMA-ADPCM WAV instead of playing it\n",
+          program);
+}
+
+struct PushReport {
+  int64_t frames_generated = 0;
+  int64_t frames_written = 0;
+  // Time spent inside Write(), the back-pressure the producer felt.
+  double write_ms = 0.0;
+  double max_write_ms = 0.0;
+  // Drift correction as the last chunk went out, before the ring drains.
+  double latency_ms = -1.0;
+  double correction_ppm = 0.0;
+  double drift_ppm = 0.0;
+};
+
+// Pushes duration_ms of a tone in 10 ms chunks, like a decoder would.
+// Blocking writes run ahead as far as the ring lets them, non-blocking ones
+// are paced to the wall clock, skew_ppm off it, and drop what doesn't fit.
+// The first preroll_ms go out at once, like a live stream's jitter buffer
+// filling before playback starts. drift, when given, is read at the end.
+static void RunPushProducer(SVPushSource* push, double tone_hz, int duration_ms, bool blocking, double skew_ppm,
+                            int preroll_ms, const SVDriftEstimator* drift, PushReport* report) {
+  SVTonePcmSource tone(tone_hz, 0.5, duration_ms);
+  tone.Prepare(push->sample_rate(), push->channels());
+  const int chunk_frames = push->sample_rate() / 100;
+  std::vector<int16_t> chunk(static_cast<size_t>(chunk_frames) * push->channels());
+  const auto chunk_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double, std::milli>(10.0 / (1.0 + skew_ppm * 1e-6)));
+  auto next_chunk = std::chrono::steady_clock::now();
+  int preroll_chunks = preroll_ms / 10;
+  while (true) {
+    const int frames = tone.Render(chunk.data(), chunk_frames);
+    if (frames == 0) {
+      break;
+    }
+    report->frames_generated += frames;
+    const auto write_begin = std::chrono::steady_clock::now();
+    report->frames_written += push->Write(chunk.data(), frames, blocking);
+    const double write_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - write_begin).count();
+    report->write_ms += write_ms;
+    report->max_write_ms = std::max(report->max_write_ms, write_ms);
+    if (!blocking && preroll_chunks > 0) {
+      --preroll_chunks;
+    } else if (!blocking) {
+      next_chunk += chunk_period;
+      std::this_thread::sleep_until(next_chunk);
+    }
+  }
+  if (drift) {
+    report->latency_ms = drift->latency_s() * 1000.0;
+    report->correction_ppm = drift->correction_ppm();
+    report->drift_ppm = drift->drift_ppm();
+  }
+  push->EndOfStream();
+}
+
+static bool ParseLatencyPolicy(const char* name, SV_LATENCY_POLICY* policy) {
+  static const struct {
+    const char* name;
+    SV_LATENCY_POLICY policy;
+  } kPolicies[] = {
+          {"off", SV_LATENCY_POLICY_OFF},
+          {"lowest", SV_LATENCY_POLICY_LOWEST},
+          {"balanced", SV_LATENCY_POLICY_BALANCED},
+          {"robust", SV_LATENCY_POLICY_ROBUST},
+  };
+  for (const auto& entry : kPolicies) {
+    if (!strcmp(name, entry.name)) {
+      *policy = entry.policy;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Control calls of the stress test, picked at random.
+enum class ControlOp { kInit, kStart, kPause, kResume, kStop, kSetGain, kGetStats, kCount };
+
+struct StressReport {
+  std::atomic<int64_t> calls { 0 };
+  std::atomic<int64_t> refused { 0 };
+  // Results other than success or SV_PLAY_STATE_ERROR, and stats snapshots
+  // torn between two callbacks.
+  std::atomic<int64_t> unexpected { 0 };
+  // Streams found in a transitional state once every call returned, or that
+  // would not stop.
+  int64_t stuck = 0;
+  int64_t end_states[SVStreamControl::kStateCount] = {};
+  uint64_t transitions = 0;
+  uint64_t silent_callbacks = 0;
+  double max_stop_ms = 0.0;
+};
+
+static void RunControlThread(SVVirtualRender* render, int sample_rate, int channels, int frames_per_burst,
+                             int ops, uint32_t seed, StressReport* report) {
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<int> pick_op(0, static_cast<int>(ControlOp::kCount) - 1);
+  std::uniform_int_distribution<int> pause_us(0, 500);
+  std::uniform_real_distribution<float> pick_gain(0.0f, 1.0f);
+  SVRenderStatsSnapshot stats;
+  for (int i = 0; i < ops; ++i) {
+    int result = SV_NO_ERROR;
+    switch (static_cast<ControlOp>(pick_op(random))) {
+      case ControlOp::kInit: result = render->InitAudioRender(sample_rate, channels); break;
+      case ControlOp::kStart: result = render->StartPlayout(); break;
+      case ControlOp::kPause: result = render->PausePlayout(); break;
+      case ControlOp::kResume: result = render->ResumePlayout(); break;
+      case ControlOp::kStop: result = render->StopPlayout(); break;
+      case ControlOp::kGetStats:
+        // Read against running callbacks, the counters must come from one.
+        result = render->GetStats(&stats);
+        if (result == SV_NO_ERROR && stats.frames_rendered > stats.callback_count * frames_per_burst) {
+          report->unexpected.fetch_add(1);
+        }
+        break;
+      default: result = render->SetGain(pick_gain(random), pause_us(random) / 50, SVGainCurve::kLinear); break;
+    }
+    report->calls.fetch_add(1);
+    if (result == SV_PLAY_STATE_ERROR) {
+      report->refused.fetch_add(1);
+    } else if (result != SV_NO_ERROR) {
+      report->unexpected.fetch_add(1);
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(pause_us(random)));
+  }
+}
+
+// Lines below errors are expected by the thousand here, only errors show.
+static void StressLogWriter(SV_LOG_LEVEL level, const char* text) {
+  if (level >= SV_LOG_ERROR) {
+    fprintf(stderr, "%s\n", text);
+  }
+}
+
+// Each sequence gets a new stream on a tone of random length, so some end
+// while the calls race, and two threads issuing random control calls at it.
+// Afterwards the stream must be in a stable state and stop cleanly.
+static int RunControlStress(const SVVirtualDeviceConfig& config, int sample_rate, int channels,
+                            SV_SAMPLE_FORMAT sample_format, int fade_ms, int sequences) {
+  constexpr int kThreads = 2;
+  constexpr int kOpsPerThread = 12;
+  StressReport report;
+  std::mt19937 random(config.seed);
+  std::uniform_int_distribution<int> tone_ms(20, 400);
+  SVRtLog::Flush();
+  SVRtLog::SetWriter(StressLogWriter);
+  for (int sequence = 0; sequence < sequences; ++sequence) {
+    SVVirtualRender render(std::make_shared<SVTonePcmSource>(440.0, 0.5, tone_ms(random)), config);
+    render.SetSampleFormat(sample_format);
+    render.gain_stage().set_fade_ms(fade_ms);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back(RunControlThread, &render, sample_rate, channels, config.frames_per_burst,
+                           kOpsPerThread, static_cast<uint32_t>(random()), &report);
+    }
+    for (auto& thread : threads) thread.join();
+
+    const SVStreamState state = render.stream_control().state();
+    report.end_states[static_cast<int>(state)]++;
+    const bool stable = state == SVStreamState::kClosed || state == SVStreamState::kOpen ||
+                        state == SVStreamState::kRunning || state == SVStreamState::kPaused ||
+                        state == SVStreamState::kDrained || state == SVStreamState::kDisconnected ||
+                        // A recovery after a --disconnect runs on its own thread.
+                        state == SVStreamState::kRecovering;
+    if (state != SVStreamState::kClosed) {
+      const auto stop_begin = std::chrono::steady_clock::now();
+      const int result = render.StopPlayout();
+      report.max_stop_ms = std::max(report.max_stop_ms, std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - stop_begin).count());
+      if (result != SV_NO_ERROR) {
+        report.unexpected++;
+      }
+    }
+    if (!stable || render.stream_control().state() != SVStreamState::kClosed) {
+      fprintf(stderr, "sequence %d: stream left %s\n", sequence, SVStreamControl::StateName(state));
+      report.stuck++;
+    }
+    report.transitions += render.stream_control().transitions();
+    report.silent_callbacks += render.stream_control().silent_callbacks();
+  }
+  SVRtLog::Flush();
+  SVRtLog::SetWriter(nullptr);
+
+  printf("control stress: %d sequences, %lld calls, %lld refused as out of order, %lld unexpected results, "
+         "%lld stuck streams\n", sequences, (long long) report.calls.load(), (long long) report.refused.load(),
+         (long long) report.unexpected.load(), (long long) report.stuck);
+  printf("end states:");
+  for (int i = 0; i < static_cast<int>(arraysize(report.end_states)); ++i) {
+    if (report.end_states[i] > 0) {
+      printf(" %s %lld", SVStreamControl::StateName(static_cast<SVStreamState>(i)), (long long) report.end_states[i]);
+    }
+  }
+  printf(", transitions: %llu, silent callbacks: %llu, max stop: %.1f ms\n", (unsigned long long) report.transitions,
+         (unsigned long long) report.silent_callbacks, report.max_stop_ms);
+  return report.unexpected.load() > 0 || report.stuck > 0 ? 1 : 0;
+}
+
+// Renders source as fast as it goes into an IMA-ADPCM WAV, for shrinking raw
+// PCM assets to a quarter of their size.
+static int EncodeAdpcm(IPcmSource* source, int sample_rate, int channels, const std::string& path) {
+  constexpr int kChunkFrames = 1024;
+  if (!source->Prepare(sample_rate, channels)) {
+    return 1;
+  }
+  SVWavFormat format;
+  format.encoding = SVWavEncoding::kImaAdpcm;
+  format.sample_rate = sample_rate;
+  format.channels = channels;
+  SVWavWriter writer(path, format);
+  if (!writer.IsOpen()) {
+    source->Release();
+    return 1;
+  }
+  std::vector<int16_t> chunk(kChunkFrames * channels);
+  while (true) {
+    const int frames = source->Render(chunk.data(), kChunkFrames);
+    if (frames > 0 && !writer.Write(chunk.data(), frames)) {
+      break;
+    }
+    if (frames < kChunkFrames && source->IsEnd()) {
+      break;
+    }
+  }
+  source->Release();
+  const int64_t frames = writer.frames_written();
+  if (!writer.Close()) {
+    return 1;
+  }
+  FILE* file = fopen(path.c_str(), "rb");
+  long size = 0;
+  if (file) {
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fclose(file);
+  }
+  const double pcm_bytes = static_cast<double>(frames) * channels * sizeof(int16_t);
+  printf("encoded %lld frames to %s, %ld bytes, %.2fx smaller than PCM16\n", (long long) frames, path.c_str(), size,
+         size > 0 ? pcm_bytes / size : 0.0);
+  return 0;
+}
+
+// Renders source through the device's pipeline, minus the device, into
+// config.output_path. A single file input at its own rate is handed over as
+// a factory instead, so it can be sharded across threads.
+static int RenderOffline(const SVVirtualDeviceConfig& device, SV_SAMPLE_FORMAT sample_format, int fade_ms,
+                         int threads, int shard_ms, IPcmSource::Ptr source, int sample_rate, int channels,
+                         const std::string& file_path, const SVWavFormat& wav_format) {
+  SVOfflineRenderConfig config;
+  config.frames_per_burst = device.frames_per_burst;
+  config.sample_rate = device.sample_rate;
+  config.channels = device.channels;
+  config.sample_format = sample_format;
+  config.fade_ms = fade_ms;
+  config.threads = std::max(threads, 1);
+  config.shard_ms = shard_ms;
+  config.output_path = device.output_path;
+  // A WAV resampled to another content rate would restart its own resampler
+  // in every shard.
+  const bool shardable = !file_path.empty() &&
+          (!SVWavFile::IsWavFile(file_path) || wav_format.sample_rate == sample_rate);
+  std::unique_ptr<SVOfflineRender> render;
+  if (shardable) {
+    render.reset(new SVOfflineRender([file_path] { return CreateFilePcmSource(file_path, true); }, config));
+  } else {
+    if (config.threads > 1) {
+      printf("offline: only a single file input at its own rate is sharded, rendering on one thread\n");
+    }
+    render.reset(new SVOfflineRender(source, config));
+  }
+  const int result = render->Render(sample_rate, channels);
+  if (result != SV_NO_ERROR) {
+    return 1;
+  }
+  SVRtLog::Flush();
+  printf("offline: frames: %lld, audio: %.3fs, wall: %.3fs, realtime factor: %.1f, shards: %lld on %d threads, "
+         "warm-up %lld frames each\n", (long long) render->frames_rendered(), render->audio_seconds(),
+         render->wall_seconds(), render->realtime_factor(), (long long) render->shard_count(), config.threads,
+         (long long) render->warmup_frames());
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  int sample_rate = 0;
+  int channels = 0;
+  int duration_ms = 1000;
+  float gain = 1.0f;
+  SV_SAMPLE_FORMAT sample_format = SV_SAMPLE_FORMAT_I16;
+  std::vector<double> tones;
+  std::vector<std::string> input_paths;
+  std::string adpcm_path;
+  bool playlist_mode = false;
+  bool rt_audit = false;
+  double push_hz = 0.0;
+  bool prewarm = false;
+  bool push_blocking = true;
+  int push_latency_ms = 0;
+  double push_tolerance_ms = 20.0;
+  double push_skew_ppm = 0.0;
+  int seek_at_ms = 0;
+  long long seek_frame = -1;
+  int fade_ms = SVGainStage::kDefaultFadeMs;
+  int ramp_at_ms = -1;
+  float ramp_gain = 1.0f;
+  int ramp_ms = 0;
+  char ramp_curve[8] = "";
+  int stop_after_ms = 0;
+  int stress_sequences = 0;
+  bool offline = false;
+  int offline_threads = 1;
+  int shard_ms = 10000;
+  SV_LATENCY_POLICY latency_policy = SV_LATENCY_POLICY_BALANCED;
+  SVVirtualDeviceConfig config;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (!strcmp(arg, "--rate") && has_value) {
+      sample_rate = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--channels") && has_value) {
+      channels = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--device-rate") && has_value) {
+      config.sample_rate = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--device-channels") && has_value) {
+      config.channels = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--burst") && has_value) {
+      config.frames_per_burst = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--jitter-ms") && has_value) {
+      config.jitter_ms = atof(argv[++i]);
+    } else if (!strcmp(arg, "--stall") && has_value) {
+      if (sscanf(argv[++i], "%lf:%lf", &config.stall_probability, &config.stall_ms) != 2) {
+        PrintUsage(argv[0]);
+        return 2;
+      }
+    } else if (!strcmp(arg, "--buffer-capacity") && has_value) {
+      config.buffer_capacity_bursts = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--latency-policy") && has_value) {
+      if (!ParseLatencyPolicy(argv[++i], &latency_policy)) {
+        PrintUsage(argv[0]);
+        return 2;
+      }
+    } else if (!strcmp(arg, "--out") && has_value) {
+      config.output_path = argv[++i];
+    } else if (!strcmp(arg, "--float")) {
+      sample_format = SV_SAMPLE_FORMAT_FLOAT;
+    } else if (!strcmp(arg, "--cold-start-ms") && has_value) {
+      config.cold_start_ms = atof(argv[++i]);
+    } else if (!strcmp(arg, "--disconnect") && has_value) {
+      if (sscanf(argv[++i], "%lf:%d", &config.disconnect_after_ms, &config.reconnect_sample_rate) < 1) {
+        PrintUsage(argv[0]);
+        return 2;
+      }
+    } else if (!strcmp(arg, "--reconnect-failures") && has_value) {
+      config.reconnect_failures = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--prewarm")) {
+      prewarm = true;
+    } else if (!strcmp(arg, "--fast")) {
+      config.realtime = false;
+    } else if (!strcmp(arg, "--tone") && has_value) {
+      tones.push_back(atof(argv[++i]));
+    } else if (!strcmp(arg, "--gain") && has_value) {
+      gain = static_cast<float>(atof(argv[++i]));
+    } else if (!strcmp(arg, "--duration-ms") && has_value) {
+      duration_ms = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--push-tone") && has_value) {
+      push_hz = atof(argv[++i]);
+    } else if (!strcmp(arg, "--push-nonblocking")) {
+      push_blocking = false;
+    } else if (!strcmp(arg, "--push-latency") && has_value) {
+      push_latency_ms = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--push-tolerance") && has_value) {
+      push_tolerance_ms = atof(argv[++i]);
+    } else if (!strcmp(arg, "--push-skew") && has_value) {
+      push_skew_ppm = atof(argv[++i]);
+    } else if (!strcmp(arg, "--device-skew") && has_value) {
+      config.clock_skew_ppm = atof(argv[++i]);
+    } else if (!strcmp(arg, "--playlist")) {
+      playlist_mode = true;
+    } else if (!strcmp(arg, "--seek") && has_value) {
+      if (sscanf(argv[++i], "%d:%lld", &seek_at_ms, &seek_frame) != 2 || seek_frame < 0) {
+        PrintUsage(argv[0]);
+        return 2;
+      }
+    } else if (!strcmp(arg, "--fade-ms") && has_value) {
+      fade_ms = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--ramp") && has_value) {
+      if (sscanf(argv[++i], "%d:%f:%d:%7s", &ramp_at_ms, &ramp_gain, &ramp_ms, ramp_curve) < 3 || ramp_at_ms < 0) {
+        PrintUsage(argv[0]);
+        return 2;
+      }
+    } else if (!strcmp(arg, "--stop-after-ms") && has_value) {
+      stop_after_ms = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--stress-control") && has_value) {
+      stress_sequences = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--offline")) {
+      offline = true;
+    } else if (!strcmp(arg, "--threads") && has_value) {
+      offline_threads = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--shard-ms") && has_value) {
+      shard_ms = atoi(argv[++i]);
+    } else if (!strcmp(arg, "--rt-audit")) {
+      rt_audit = true;
+    } else if (!strcmp(arg, "--encode-adpcm") && has_value) {
+      adpcm_path = argv[++i];
+    } else if (arg[0] != '-') {
+      input_paths.push_back(arg);
+    } else {
+      PrintUsage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (offline && (push_hz > 0.0 || seek_frame >= 0 || ramp_at_ms >= 0 || stop_after_ms > 0 ||
+                  stress_sequences > 0 || !adpcm_path.empty())) {
+    fprintf(stderr, "--offline renders the content start to end, without pushes, seeks, ramps or stops\n");
+    return 2;
+  }
+  if (rt_audit && !SVRtAudit::kEnabled) {
+    fprintf(stderr, "--rt-audit needs a build configured with -DSV_RT_AUDIT=ON\n");
+    return 2;
+  }
+
+  // The first WAV input sets the content layout unless given explicitly,
+  // other inputs are converted to it.
+  SVWavFormat wav_format;
+  for (const auto& path : input_paths) {
+    if (SVWavFile::IsWavFile(path) && SVWavFile::Probe(path, &wav_format)) {
+      printf("%s: %s, %d Hz, %d channels, %lld frames\n", path.c_str(), SVWavEncodingName(wav_format.encoding),
+             wav_format.sample_rate, wav_format.channels, (long long) wav_format.total_frames);
+      if (sample_rate <= 0) sample_rate = wav_format.sample_rate;
+      if (channels <= 0) channels = wav_format.channels;
+      break;
+    }
+  }
+  if (sample_rate <= 0) sample_rate = 48000;
+  if (channels <= 0) channels = 2;
+
+  if (stress_sequences > 0) {
+    const int result = RunControlStress(config, sample_rate, channels, sample_format, fade_ms, stress_sequences);
+    if (rt_audit) {
+      SVRtAudit::Report(stdout);
+      return SVRtAudit::violation_count() > 0 ? 3 : result;
+    }
+    return result;
+  }
+
+  std::vector<IPcmSource::Ptr> inputs;
+  for (double tone_hz : tones) {
+    inputs.push_back(std::make_shared<SVTonePcmSource>(tone_hz, 0.5, duration_ms));
+  }
+  std::shared_ptr<SVPlaylistSource> playlist;
+  if (playlist_mode && !input_paths.empty()) {
+    // One input, the files open one after the other on its loader thread.
+    playlist = std::make_shared<SVPlaylistSource>();
+    playlist->SetEndWhenEmpty(true);
+    for (const auto& path : input_paths) {
+      if (playlist->Enqueue(path) < 0) {
+        return 1;
+      }
+    }
+    inputs.push_back(playlist);
+  } else {
+    for (const auto& path : input_paths) {
+      // Offline, WAV files decode on the render thread rather than waiting for theirs.
+      IPcmSource::Ptr file_source = CreateFilePcmSource(path, offline);
+      if (!file_source) {
+        return 1;
+      }
+      if (!config.realtime && input_paths.size() + tones.size() > 1) {
+        // The mixer pads a voice that comes up short, the device's wait
+        // wouldn't see it; each file waits for its own decoder instead.
+        file_source = std::make_shared<SVBlockingPcmSource>(file_source);
+      }
+      inputs.push_back(file_source);
+    }
+  }
+  // In the content layout, so it plays without conversion.
+  std::shared_ptr<SVPushSource> push;
+  std::shared_ptr<SVConvertingPcmSource> push_voice;
+  if (push_hz > 0.0) {
+    push = std::make_shared<SVPushSource>(sample_rate, channels);
+    if (push_latency_ms > 0) {
+      // Like nativeCreatePushStream for a live producer.
+      push_voice = std::make_shared<SVConvertingPcmSource>(push);
+      push_voice->SetSourceSampleRate(sample_rate);
+      push_voice->SetSourceChannels(channels);
+      push_voice->SetDriftCorrection(push_latency_ms);
+      inputs.push_back(push_voice);
+    } else {
+      inputs.push_back(push);
+    }
+  }
+  if (inputs.empty()) {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  // Tones come first and can't seek, the first file or the playlist follows.
+  IPcmSource::Ptr seek_source = inputs[std::min(tones.size(), inputs.size() - 1)];
+  IPcmSource::Ptr source = inputs.front();
+  std::shared_ptr<SVMixer> mixer;
+  if (inputs.size() > 1) {
+    mixer = std::make_shared<SVMixer>();
+    mixer->SetEndWhenIdle(true);
+    for (auto& input : inputs) {
+      if (mixer->AddVoice(input, gain) < 0) {
+        return 1;
+      }
+    }
+    source = mixer;
+  }
+
+  // Runs for the whole playback, the push voice ends once it is done.
+  PushReport push_report;
+  std::thread producer;
+  if (push) {
+    producer = std::thread(RunPushProducer, push.get(), push_hz, duration_ms, push_blocking, push_skew_ppm,
+                           push_latency_ms, push_voice ? &push_voice->drift_estimator() : nullptr, &push_report);
+  }
+  if (!adpcm_path.empty()) {
+    const int result = EncodeAdpcm(source.get(), sample_rate, channels, adpcm_path);
+    if (producer.joinable()) producer.join();
+    return result;
+  }
+
+  if (offline) {
+    return RenderOffline(config, sample_format, fade_ms, offline_threads, shard_ms, source, sample_rate, channels,
+                         tones.empty() && !playlist && input_paths.size() == 1 ? input_paths.front() : std::string(),
+                         wav_format);
+  }
+
+  if (prewarm) {
+    SVVirtualRender::Prewarm(config, config.sample_rate > 0 ? config.sample_rate : sample_rate,
+                             config.channels > 0 ? config.channels : channels, sample_format);
+  }
+  SVVirtualRender render(source, config);
+  render.SetSampleFormat(sample_format);
+  render.SetLatencyPolicy(latency_policy);
+  render.gain_stage().set_fade_ms(fade_ms);
+  if (render.InitAudioRender(sample_rate, channels) != SV_NO_ERROR) {
+    return 1;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  if (render.StartPlayout() != SV_NO_ERROR) {
+    return 1;
+  }
+  if (seek_frame >= 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(seek_at_ms));
+    const auto seek_begin = std::chrono::steady_clock::now();
+    const bool seeked = seek_source->CanSeek() && seek_source->Seek(seek_frame);
+    const auto seek_us =
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - seek_begin).count();
+    printf("seek to frame %lld at %d ms: %s, call took %.1f us\n", seek_frame, seek_at_ms, seeked ? "ok" : "failed",
+           seek_us);
+  }
+  if (ramp_at_ms >= 0) {
+    std::this_thread::sleep_until(start + std::chrono::milliseconds(ramp_at_ms));
+    const bool exponential = !strcmp(ramp_curve, "exp");
+    render.SetGain(ramp_gain, ramp_ms, exponential ? SVGainCurve::kExponential : SVGainCurve::kLinear);
+    printf("ramp to gain %.3f over %d ms (%s) at %d ms\n", ramp_gain, ramp_ms, exponential ? "exponential" : "linear",
+           ramp_at_ms);
+  }
+  double stop_ms = -1.0;
+  if (stop_after_ms > 0) {
+    std::this_thread::sleep_until(start + std::chrono::milliseconds(stop_after_ms));
+    const auto stop_begin = std::chrono::steady_clock::now();
+    render.StopPlayout();
+    stop_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stop_begin).count();
+  } else {
+    render.WaitForCompletion();
+  }
+  if (producer.joinable()) producer.join();
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  SVRenderStatsSnapshot stats;
+  render.GetStats(&stats);
+  if (stop_ms < 0.0) {
+    render.StopPlayout();
+  }
+
+  const double audio_seconds = static_cast<double>(stats.frames_rendered) / render.device_sample_rate();
+  printf("callbacks: %lld, frames: %lld, underruns: %lld, audio: %.3fs, wall: %.3fs, realtime factor: %.2f\n",
+         (long long) stats.callback_count, (long long) stats.frames_rendered, (long long) stats.underrun_count,
+         audio_seconds, elapsed, elapsed > 0.0 ? audio_seconds / elapsed : 0.0);
+  if (mixer) {
+    printf("voices: %zu, voice underruns: %lld\n", inputs.size(), (long long) mixer->voice_underruns());
+  }
+  if (playlist) {
+    printf("playlist items: %zu, transitions: %lld, pre-roll underruns: %lld\n", input_paths.size(),
+           (long long) playlist->transitions(), (long long) playlist->underruns());
+  }
+  if (push) {
+    printf("push: %s, %lld of %lld frames written, %lld rejected, %llu underruns, write time total/max: %.1f/%.2f ms\n",
+           push_blocking ? "blocking" : "non-blocking", (long long) push_report.frames_written,
+           (long long) push_report.frames_generated, (long long) push->rejected_frames(),
+           (unsigned long long) push->underruns(), push_report.write_ms, push_report.max_write_ms);
+  }
+  if (push_voice) {
+    printf("drift: latency %.1f ms of %d ms target, correction %+.1f ppm, drift estimate %+.1f ppm\n",
+           push_report.latency_ms, push_latency_ms, push_report.correction_ppm, push_report.drift_ppm);
+  }
+  // Lines the callbacks logged come out before the summary.
+  SVRtLog::Flush();
+  printf("callback log records: %llu deferred, %llu rate limited, %llu dropped\n",
+         (unsigned long long) SVRtLog::deferred_count(), (unsigned long long) SVRtLog::suppressed_count(),
+         (unsigned long long) SVRtLog::dropped_count());
+  printf("fade: %d ms, underrun edges declicked: %llu", fade_ms, (unsigned long long) render.gain_stage().declicks());
+  if (stop_ms >= 0.0) {
+    printf(", stop took %.1f ms, fade-out %s", stop_ms, render.faded_out() ? "rendered" : "not rendered");
+  }
+  printf("\n");
+  printf("start to first callback: %.2f ms, %s device\n", stats.start_latency_ns / 1e6,
+         SVVirtualRender::device_pool().hits() > 0 ? "warm" : "cold");
+  printf("jitter avg/max: %.3f/%.3f ms, render avg/max: %.1f/%.1f us\n", stats.jitter_avg_ns / 1e6,
+         stats.jitter_max_ns / 1e6, stats.render_avg_ns / 1e3, stats.render_max_ns / 1e3);
+  if (config.buffer_capacity_bursts > 0) {
+    const auto& tuner = render.latency_tuner();
+    const double frames_to_ms = 1000.0 / render.device_sample_rate();
+    printf("device buffer: %d frames (%.1f ms), average %.1f ms, xruns: %lld, grown %lld, shrunk %lld times\n",
+           render.buffer_size_frames(), render.buffer_size_frames() * frames_to_ms,
+           render.average_buffer_frames() * frames_to_ms, (long long) render.xrun_count(),
+           (long long) tuner.grow_count(), (long long) tuner.shrink_count());
+  }
+  int result = 0;
+  if (config.disconnect_after_ms > 0.0) {
+    const auto& recovery = render.recovery();
+    printf("disconnects: %lld, recovered: %lld", (long long) stats.disconnect_count, (long long) stats.recovery_count);
+    if (stats.recovery_count > 0) {
+      printf(", error to audio last/max: %.1f/%.1f ms", stats.recovery_last_ns / 1e6, stats.recovery_max_ns / 1e6);
+    }
+    printf(", failed reopens: %llu, given up: %llu\n", (unsigned long long) recovery.failed_attempts(),
+           (unsigned long long) recovery.failures());
+    // Giving up is only right once every attempt was made to fail.
+    if (recovery.failures() > 0 && config.reconnect_failures < SVStreamRecovery::kMaxAttempts) {
+      result = 1;
+    }
+  }
+  // A held latency that ended off target, or ran dry on the way, didn't hold.
+  if (push_voice &&
+      (std::fabs(push_report.latency_ms - push_latency_ms) > push_tolerance_ms || push->underruns() > 0)) {
+    printf("drift: latency not held within %.1f ms of the target\n", push_tolerance_ms);
+    result = 1;
+  }
+  if (rt_audit) {
+    SVRtAudit::Report(stdout);
+    return SVRtAudit::violation_count() > 0 ? 3 : result;
+  }
+  return result;
+}
@@ -0,0 +1,146 @@
+#include "sv_render_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+namespace sv_render {
+
+int64_t SVRenderStats::NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SVRenderStats::Reset(int sample_rate) {
+  sequence_.store(0, std::memory_order_relaxed);
+  callback_count_.store(0, std::memory_order_relaxed);
+  frames_rendered_.store(0, std::memory_order_relaxed);
+  underrun_count_.store(0, std::memory_order_relaxed);
+  jitter_sum_ns_.store(0, std::memory_order_relaxed);
+  jitter_max_ns_.store(0, std::memory_order_relaxed);
+  render_sum_ns_.store(0, std::memory_order_relaxed);
+  render_max_ns_.store(0, std::memory_order_relaxed);
+  start_requested_ns_.store(0, std::memory_order_relaxed);
+  start_latency_ns_.store(-1, std::memory_order_relaxed);
+  disconnected_ns_.store(0, std::memory_order_relaxed);
+  disconnect_count_.store(0, std::memory_order_relaxed);
+  recovery_count_.store(0, std::memory_order_relaxed);
+  recovery_last_ns_.store(-1, std::memory_order_relaxed);
+  recovery_max_ns_.store(-1, std::memory_order_relaxed);
+  sample_rate_ = sample_rate;
+  last_begin_ns_ = 0;
+  last_num_frames_ = 0;
+}
+
+void SVRenderStats::Restart(int sample_rate) {
+  sample_rate_ = sample_rate;
+  last_begin_ns_ = 0;
+  last_num_frames_ = 0;
+}
+
+void SVRenderStats::MarkDisconnected() {
+  disconnect_count_.fetch_add(1, std::memory_order_relaxed);
+  int64_t expected = 0;
+  disconnected_ns_.compare_exchange_strong(expected, NowNanos(), std::memory_order_relaxed);
+}
+
+void SVRenderStats::RecordRecovery(int64_t now_ns) {
+  const int64_t disconnected_ns = disconnected_ns_.exchange(0, std::memory_order_relaxed);
+  if (disconnected_ns == 0) {
+    return;
+  }
+  const int64_t recovery_ns = now_ns - disconnected_ns;
+  recovery_count_.fetch_add(1, std::memory_order_relaxed);
+  recovery_last_ns_.store(recovery_ns, std::memory_order_relaxed);
+  if (recovery_ns > recovery_max_ns_.load(std::memory_order_relaxed)) {
+    recovery_max_ns_.store(recovery_ns, std::memory_order_relaxed);
+  }
+}
+
+void SVRenderStats::MarkStartRequested() {
+  start_latency_ns_.store(-1, std::memory_order_relaxed);
+  start_requested_ns_.store(NowNanos(), std::memory_order_relaxed);
+}
+
+void SVRenderStats::RecordStartLatency() {
+  const int64_t requested_ns = start_requested_ns_.exchange(0, std::memory_order_relaxed);
+  if (requested_ns != 0) {
+    start_latency_ns_.store(NowNanos() - requested_ns, std::memory_order_relaxed);
+  }
+}
+
+void SVRenderStats::RecordCallback(int64_t begin_ns, int64_t render_ns, int num_frames, int rendered_frames,
+                                   bool underrun) {
+  if (disconnected_ns_.load(std::memory_order_relaxed) != 0) {
+    RecordRecovery(begin_ns);
+  }
+  int64_t jitter_ns = -1;
+  if (last_begin_ns_ > 0 && sample_rate_ > 0) {
+    const int64_t expected_ns = static_cast<int64_t>(last_num_frames_) * 1000000000LL / sample_rate_;
+    jitter_ns = std::llabs((begin_ns - last_begin_ns_) - expected_ns);
+  }
+  last_begin_ns_ = begin_ns;
+  last_num_frames_ = num_frames;
+
+  // Single writer: relaxed read-modify-write is enough, the sequence makes
+  // the group visible atomically to Snapshot(). The fields are stored with
+  // release, so none moves ahead of the odd sequence: a reader that sees any
+  // of them sees that too and retries. No standalone fences, which
+  // ThreadSanitizer can't check.
+  const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+
+  callback_count_.store(callback_count_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  frames_rendered_.store(frames_rendered_.load(std::memory_order_relaxed) + rendered_frames,
+                         std::memory_order_release);
+  if (underrun) {
+    underrun_count_.store(underrun_count_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+  if (jitter_ns >= 0) {
+    jitter_sum_ns_.store(jitter_sum_ns_.load(std::memory_order_relaxed) + jitter_ns, std::memory_order_release);
+    if (jitter_ns > jitter_max_ns_.load(std::memory_order_relaxed)) {
+      jitter_max_ns_.store(jitter_ns, std::memory_order_release);
+    }
+  }
+  render_sum_ns_.store(render_sum_ns_.load(std::memory_order_relaxed) + render_ns, std::memory_order_release);
+  if (render_ns > render_max_ns_.load(std::memory_order_relaxed)) {
+    render_max_ns_.store(render_ns, std::memory_order_release);
+  }
+
+  sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+SVRenderStatsSnapshot SVRenderStats::Snapshot() const {
+  SVRenderStatsSnapshot snapshot;
+  int64_t jitter_sum_ns = 0;
+  int64_t render_sum_ns = 0;
+  uint32_t begin = 0;
+  // The fields are loaded with acquire, so the sequence is checked again only
+  // after all of them were read.
+  do {
+    begin = sequence_.load(std::memory_order_acquire);
+    if (begin & 1u) continue;
+    snapshot.callback_count = callback_count_.load(std::memory_order_acquire);
+    snapshot.frames_rendered = frames_rendered_.load(std::memory_order_acquire);
+    snapshot.underrun_count = underrun_count_.load(std::memory_order_acquire);
+    jitter_sum_ns = jitter_sum_ns_.load(std::memory_order_acquire);
+    snapshot.jitter_max_ns = jitter_max_ns_.load(std::memory_order_acquire);
+    render_sum_ns = render_sum_ns_.load(std::memory_order_acquire);
+    snapshot.render_max_ns = render_max_ns_.load(std::memory_order_acquire);
+  } while ((begin & 1u) || begin != sequence_.load(std::memory_order_relaxed));
+
+  snapshot.start_latency_ns = start_latency_ns_.load(std::memory_order_relaxed);
+  snapshot.disconnect_count = disconnect_count_.load(std::memory_order_relaxed);
+  snapshot.recovery_count = recovery_count_.load(std::memory_order_relaxed);
+  snapshot.recovery_last_ns = recovery_last_ns_.load(std::memory_order_relaxed);
+  snapshot.recovery_max_ns = recovery_max_ns_.load(std::memory_order_relaxed);
+  if (snapshot.callback_count > 1) {
+    // The first callback has no previous one to measure jitter against.
+    snapshot.jitter_avg_ns = jitter_sum_ns / (snapshot.callback_count - 1);
+  }
+  if (snapshot.callback_count > 0) {
+    snapshot.render_avg_ns = render_sum_ns / snapshot.callback_count;
+  }
+  return snapshot;
+}
+
+} // sv_render
@@ -0,0 +1,104 @@
+#ifndef AUDIO_PLAYOUT_SV_RENDER_STATS_H
+#define AUDIO_PLAYOUT_SV_RENDER_STATS_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace sv_render {
+
+// Copy of the render counters taken on a control thread.
+struct SVRenderStatsSnapshot {
+  int64_t callback_count = 0;
+  int64_t frames_rendered = 0;
+  // Callbacks where the source came up short and silence was padded in.
+  int64_t underrun_count = 0;
+  // Underruns reported by the device (AAudio/Oboe getXRunCount).
+  int64_t xrun_count = 0;
+  // Deviation of the time between callbacks from the burst duration.
+  int64_t jitter_avg_ns = 0;
+  int64_t jitter_max_ns = 0;
+  // Time spent pulling data from the source inside the callback.
+  int64_t render_avg_ns = 0;
+  int64_t render_max_ns = 0;
+  // Estimated output latency, -1 when the backend can't tell.
+  double output_latency_ms = -1.0;
+  // From the StartPlayout() request to the first device callback, -1 until
+  // that callback ran.
+  int64_t start_latency_ns = -1;
+  // Times the device went away, and times audio came back after it did.
+  int64_t disconnect_count = 0;
+  int64_t recovery_count = 0;
+  // From the disconnect to the first callback rendering the source again,
+  // -1 until the first recovery.
+  int64_t recovery_last_ns = -1;
+  int64_t recovery_max_ns = -1;
+};
+
+// Counters updated by the audio thread and snapshotted by a control thread.
+// The audio thread publishes through a sequence lock, so it never waits;
+// Snapshot() retries until it reads a consistent set of values.
+class SVRenderStats {
+
+public:
+  // Control thread, before the stream starts.
+  void Reset(int sample_rate);
+  // Control thread, while no callback runs. The stream was reopened at
+  // sample_rate after a disconnect; the counters carry on, the gap doesn't
+  // count as jitter.
+  void Restart(int sample_rate);
+
+  // Audio thread. begin_ns is the callback start, render_ns the time spent in
+  // the source, rendered_frames how many of num_frames the source delivered.
+  // A short callback counts as an underrun unless the source has ended. The
+  // first one after MarkDisconnected() ends the recovery.
+  void RecordCallback(int64_t begin_ns, int64_t render_ns, int num_frames, int rendered_frames, bool underrun);
+
+  // Control thread, when StartPlayout() is requested.
+  void MarkStartRequested();
+  // Audio thread, first thing in every device callback. The first one after
+  // MarkStartRequested() sets start_latency_ns.
+  void MarkDeviceCallback() {
+    if (start_requested_ns_.load(std::memory_order_relaxed) != 0) {
+      RecordStartLatency();
+    }
+  }
+
+  // Any thread, when the device reports it went away. A recovery runs from
+  // the first disconnect until audio comes back, however many follow.
+  void MarkDisconnected();
+
+  // Control thread. Fills everything but the device-reported fields.
+  SVRenderStatsSnapshot Snapshot() const;
+
+  static int64_t NowNanos();
+
+private:
+  void RecordStartLatency();
+  void RecordRecovery(int64_t now_ns);
+
+  std::atomic<uint32_t> sequence_ { 0 };
+  std::atomic<int64_t> callback_count_ { 0 };
+  std::atomic<int64_t> frames_rendered_ { 0 };
+  std::atomic<int64_t> underrun_count_ { 0 };
+  std::atomic<int64_t> jitter_sum_ns_ { 0 };
+  std::atomic<int64_t> jitter_max_ns_ { 0 };
+  std::atomic<int64_t> render_sum_ns_ { 0 };
+  std::atomic<int64_t> render_max_ns_ { 0 };
+  // Outside the sequence lock, each is a single value.
+  std::atomic<int64_t> start_requested_ns_ { 0 };
+  std::atomic<int64_t> start_latency_ns_ { -1 };
+  std::atomic<int64_t> disconnected_ns_ { 0 };
+  std::atomic<int64_t> disconnect_count_ { 0 };
+  std::atomic<int64_t> recovery_count_ { 0 };
+  std::atomic<int64_t> recovery_last_ns_ { -1 };
+  std::atomic<int64_t> recovery_max_ns_ { -1 };
+
+  // Audio-thread only.
+  int sample_rate_ = 0;
+  int64_t last_begin_ns_ = 0;
+  int last_num_frames_ = 0;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_RENDER_STATS_H
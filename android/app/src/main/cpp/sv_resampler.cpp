@@ -0,0 +1,288 @@
+#include "sv_resampler.h"
+#include "sv_simd.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace sv_render {
+
+// Odr-used by std::min, C++14 still needs the definition.
+constexpr int SVPolyphaseResampler::kMaxInputFrames;
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+int TapsFor(SVResamplerQuality quality) {
+  switch (quality) {
+    case SVResamplerQuality::kLow: return 16;
+    case SVResamplerQuality::kHigh: return 64;
+    default: return 32;
+  }
+}
+
+int PhasesFor(SVResamplerQuality quality) {
+  switch (quality) {
+    case SVResamplerQuality::kLow: return 64;
+    case SVResamplerQuality::kHigh: return 256;
+    default: return 128;
+  }
+}
+
+double KaiserBetaFor(SVResamplerQuality quality) {
+  switch (quality) {
+    case SVResamplerQuality::kLow: return 6.0;
+    case SVResamplerQuality::kHigh: return 10.0;
+    default: return 8.0;
+  }
+}
+
+// Passband edge relative to the lower of the two Nyquist frequencies.
+double RolloffFor(SVResamplerQuality quality) {
+  switch (quality) {
+    case SVResamplerQuality::kLow: return 0.85;
+    case SVResamplerQuality::kHigh: return 0.95;
+    default: return 0.91;
+  }
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  const double half_x = x / 2.0;
+  for (int k = 1; k < 50; ++k) {
+    term *= (half_x / k) * (half_x / k);
+    sum += term;
+    if (term < sum * 1e-12) break;
+  }
+  return sum;
+}
+
+} // namespace
+
+float SVDotProductScalar(const float* a, const float* b, int n) {
+  float sum0 = 0.0f;
+  float sum1 = 0.0f;
+  float sum2 = 0.0f;
+  float sum3 = 0.0f;
+  for (int i = 0; i < n; i += 4) {
+    sum0 += a[i] * b[i];
+    sum1 += a[i + 1] * b[i + 1];
+    sum2 += a[i + 2] * b[i + 2];
+    sum3 += a[i + 3] * b[i + 3];
+  }
+  return (sum0 + sum1) + (sum2 + sum3);
+}
+
+float SVDotProduct(const float* a, const float* b, int n) {
+#if defined(SV_HAVE_NEON)
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  for (; i < n; i += 4) {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+  const float32x4_t acc = vaddq_f32(acc0, acc1);
+  const float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+  return vget_lane_f32(vpadd_f32(pair, pair), 0);
+#elif defined(SV_HAVE_SSE2)
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+  }
+  for (; i < n; i += 4) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  __m128 acc = _mm_add_ps(acc0, acc1);
+  acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+  acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+  return _mm_cvtss_f32(acc);
+#else
+  return SVDotProductScalar(a, b, n);
+#endif
+}
+
+SVPolyphaseResampler::SVPolyphaseResampler(int channels, SVResamplerQuality quality)
+  : channels_(channels),
+  taps_(TapsFor(quality)),
+  phases_(PhasesFor(quality)),
+  kaiser_beta_(KaiserBetaFor(quality)),
+  rolloff_(RolloffFor(quality)),
+  history_(channels) {
+}
+
+void SVPolyphaseResampler::SetRates(int input_rate, int output_rate) {
+  AV_LOGI("SVPolyphaseResampler %d -> %d Hz, channels:%d, taps:%d, phases:%d", input_rate, output_rate, channels_,
+          taps_, phases_);
+  input_rate_ = input_rate;
+  output_rate_ = output_rate;
+  step_scale_ = 1.0;
+  UpdateStep();
+  // Downsampling moves the cutoff below the output Nyquist frequency.
+  DesignFilter(rolloff_ * std::min(1.0, static_cast<double>(output_rate) / input_rate));
+
+  capacity_ = taps_ + kMaxInputFrames;
+  for (auto& channel : history_) {
+    channel.assign(capacity_, 0.0f);
+  }
+  Reset();
+}
+
+void SVPolyphaseResampler::SetOutputRate(int output_rate) {
+  AV_LOGI("SVPolyphaseResampler %d -> %d Hz, was %d Hz.", input_rate_, output_rate, output_rate_);
+  // Same instant in the new units.
+  remainder_ = remainder_ * output_rate / output_rate_;
+  output_rate_ = output_rate;
+  DesignFilter(rolloff_ * std::min(1.0, static_cast<double>(output_rate) / input_rate_));
+  UpdateStep();
+}
+
+void SVPolyphaseResampler::SetStepScale(double scale) {
+  step_scale_ = scale;
+  UpdateStep();
+}
+
+void SVPolyphaseResampler::UpdateStep() {
+  step_ = static_cast<double>(input_rate_) / output_rate_ * step_scale_;
+  // A whole number of units at the nominal ratio, the position stays exact.
+  step_units_ = input_rate_ * step_scale_;
+  step_whole_ = static_cast<int>(step_units_ / output_rate_);
+  step_rest_ = step_units_ - static_cast<double>(step_whole_) * output_rate_;
+  if (step_rest_ < 0.0) {
+    // A scaled step just under a whole frame, rounded up by the division.
+    --step_whole_;
+    step_rest_ += output_rate_;
+  }
+  phase_scale_ = static_cast<double>(phases_) / output_rate_;
+}
+
+void SVPolyphaseResampler::DesignFilter(double cutoff) {
+  // One extra phase so interpolation at the end of the table doesn't wrap.
+  coefficients_.assign((phases_ + 1) * taps_, 0.0f);
+  const double half = taps_ / 2.0;
+  const double i0_beta = BesselI0(kaiser_beta_);
+  for (int phase = 0; phase <= phases_; ++phase) {
+    const double fraction = static_cast<double>(phase) / phases_;
+    float* taps = &coefficients_[phase * taps_];
+    double sum = 0.0;
+    for (int k = 0; k < taps_; ++k) {
+      // Distance from the output instant to input sample k of the window.
+      const double t = (k - half + 1.0) - fraction;
+      const double x = cutoff * t;
+      const double sinc = std::fabs(x) < 1e-9 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+      const double r = t / half;
+      const double window = std::fabs(r) >= 1.0 ? 0.0 : BesselI0(kaiser_beta_ * std::sqrt(1.0 - r * r)) / i0_beta;
+      const double value = cutoff * sinc * window;
+      taps[k] = static_cast<float>(value);
+      sum += value;
+    }
+    // Unity gain at DC for every phase, so interpolation adds no ripple.
+    for (int k = 0; k < taps_; ++k) {
+      taps[k] = static_cast<float>(taps[k] / sum);
+    }
+  }
+}
+
+void SVPolyphaseResampler::Reset() {
+  // The first output lines up with the first input frame; the history before
+  // it is silence.
+  const int lead = taps_ / 2 - 1;
+  for (auto& channel : history_) {
+    std::fill(channel.begin(), channel.end(), 0.0f);
+  }
+  filled_ = lead;
+  index_ = lead;
+  remainder_ = 0.0;
+}
+
+double SVPolyphaseResampler::latency_frames() const {
+  return (taps_ / 2.0) / step_;
+}
+
+int SVPolyphaseResampler::InputFramesNeeded(int output_frames) const {
+  if (output_frames <= 0) return 0;
+  // Last history index the filter touches for the final output frame.
+  const int last = index_ + static_cast<int>((remainder_ + (output_frames - 1) * step_units_) / output_rate_) +
+                   taps_ / 2;
+  return std::max(0, last + 1 - filled_);
+}
+
+int SVPolyphaseResampler::InputFramesFree() const {
+  return capacity_ - filled_;
+}
+
+int SVPolyphaseResampler::Push(const float* input, int num_frames) {
+  const int frames = std::min(num_frames, InputFramesFree());
+  for (int ch = 0; ch < channels_; ++ch) {
+    float* dst = history_[ch].data() + filled_;
+    const float* src = input + ch;
+    for (int i = 0; i < frames; ++i) {
+      dst[i] = src[i * channels_];
+    }
+  }
+  filled_ += frames;
+  return frames;
+}
+
+void SVPolyphaseResampler::Flush() {
+  const int frames = std::min(taps_, InputFramesFree());
+  for (auto& channel : history_) {
+    std::fill(channel.begin() + filled_, channel.begin() + filled_ + frames, 0.0f);
+  }
+  filled_ += frames;
+}
+
+int SVPolyphaseResampler::Pull(float* output, int num_frames) {
+  const int lead = taps_ / 2 - 1;
+  const int reach = taps_ / 2;
+  int produced = 0;
+  while (produced < num_frames) {
+    const int index = index_;
+    if (index + reach >= filled_) break;
+
+    const double phase = remainder_ * phase_scale_;
+    const int phase_index = static_cast<int>(phase);
+    const float blend = static_cast<float>(phase - phase_index);
+    const float* taps0 = &coefficients_[phase_index * taps_];
+    const float* taps1 = taps0 + taps_;
+    float* out = output + produced * channels_;
+    for (int ch = 0; ch < channels_; ++ch) {
+      const float* window = history_[ch].data() + index - lead;
+      const float y0 = SVDotProduct(window, taps0, taps_);
+      const float y1 = SVDotProduct(window, taps1, taps_);
+      out[ch] = y0 + blend * (y1 - y0);
+    }
+    index_ += step_whole_;
+    remainder_ += step_rest_;
+    if (remainder_ >= output_rate_) {
+      remainder_ -= output_rate_;
+      ++index_;
+    }
+    ++produced;
+  }
+  Discard();
+  return produced;
+}
+
+void SVPolyphaseResampler::Discard() {
+  // Keep the filter history in front of the next output, drop the rest.
+  const int consumed = std::min(index_ - (taps_ / 2 - 1), filled_);
+  if (consumed <= 0) return;
+  const int remaining = filled_ - consumed;
+  for (auto& channel : history_) {
+    memmove(channel.data(), channel.data() + consumed, remaining * sizeof(float));
+  }
+  filled_ = remaining;
+  index_ -= consumed;
+}
+
+} // sv_render
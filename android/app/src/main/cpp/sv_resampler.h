@@ -0,0 +1,110 @@
+#ifndef AUDIO_PLAYOUT_SV_RESAMPLER_H
+#define AUDIO_PLAYOUT_SV_RESAMPLER_H
+
+#include <vector>
+
+namespace sv_render {
+
+enum class SVResamplerQuality : int {
+  kLow,     // 16 taps, 64 phases.
+  kMedium,  // 32 taps, 128 phases.
+  kHigh     // 64 taps, 256 phases.
+};
+
+// Streaming windowed-sinc polyphase sample-rate converter on interleaved
+// float frames. The filter bank holds a fixed number of phases and output
+// samples interpolate between the two nearest ones, so any rate ratio works
+// with the same kernels. All buffers are allocated in SetRates(); Push() and
+// Pull() never allocate and are safe to call from the audio thread.
+//
+// The position between input frames is kept as a whole frame plus a
+// remainder counted in 1/output_rate frames. At the nominal ratio the step is
+// then a whole number of those units and the position after n output frames
+// is exact, whatever the history: output frame n comes out the same whether
+// the stream started at frame 0 or at any multiple of
+// output_rate / gcd(input_rate, output_rate), which lets SVOfflineRender
+// render a file in pieces that join seamlessly.
+class SVPolyphaseResampler {
+
+public:
+  // Input frames Push() can hold on top of the filter history.
+  static constexpr int kMaxInputFrames = 4096;
+
+  SVPolyphaseResampler(int channels, SVResamplerQuality quality);
+  ~SVPolyphaseResampler() = default;
+
+  // Control thread. Designs the filter for the ratio and resets the state.
+  void SetRates(int input_rate, int output_rate);
+  // Control thread, between Pull() calls. Changes the output rate mid-stream:
+  // designs the filter for the new ratio and keeps the buffered input and the
+  // position in it, so the output carries on from the same input instant.
+  void SetOutputRate(int output_rate);
+  // Audio thread, between Pull() calls. Consumes input scale times faster
+  // than the rates say, for drift correction within a fraction of a percent.
+  // The filter stays designed for the nominal ratio.
+  void SetStepScale(double scale);
+  // Drops all buffered input and restarts at position zero.
+  void Reset();
+
+  // Input frames still missing before output_frames can be pulled.
+  int InputFramesNeeded(int output_frames) const;
+  // Free space for Push(), in frames.
+  int InputFramesFree() const;
+  // Appends up to num_frames interleaved frames, returns how many were taken.
+  int Push(const float* input, int num_frames);
+  // Appends filter-length worth of silence so the last input frames come out.
+  void Flush();
+  // Produces up to num_frames interleaved frames from the buffered input,
+  // returns how many were produced.
+  int Pull(float* output, int num_frames);
+
+  int channels() const { return channels_; }
+  int taps() const { return taps_; }
+  // Output frames that the filter delays the signal by.
+  double latency_frames() const;
+  // Input frames pushed but not yet passed by the output position.
+  double buffered_input_frames() const { return filled_ - index_ - remainder_ / output_rate_; }
+
+private:
+  void DesignFilter(double cutoff);
+  // The step for the current rates and scale.
+  void UpdateStep();
+  void Discard();
+
+private:
+  const int channels_;
+  const int taps_;
+  const int phases_;
+  const double kaiser_beta_;
+  const double rolloff_;
+  int input_rate_ = 0;
+  int output_rate_ = 0;
+  double step_scale_ = 1.0;
+  // Input frames per output frame, and the same step in remainder units
+  // split into whole frames and the rest.
+  double step_ = 1.0;
+  double step_units_ = 0.0;
+  int step_whole_ = 0;
+  double step_rest_ = 0.0;
+  // Filter phases per remainder unit.
+  double phase_scale_ = 0.0;
+  // phases_ + 1 rows of taps_ coefficients, laid out in input order so each
+  // output sample is a straight dot product over the history window.
+  std::vector<float> coefficients_;
+  // Planar per-channel input history.
+  std::vector<std::vector<float>> history_;
+  int capacity_ = 0;
+  int filled_ = 0;
+  // Output position: history index_ plus remainder_ / output_rate_.
+  int index_ = 0;
+  double remainder_ = 0.0;
+};
+
+// Dot product of two float vectors whose length is a multiple of 4, NEON/SSE
+// when available. Exposed for the benchmarks.
+float SVDotProduct(const float* a, const float* b, int n);
+float SVDotProductScalar(const float* a, const float* b, int n);
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_RESAMPLER_H
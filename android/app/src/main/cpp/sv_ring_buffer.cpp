@@ -0,0 +1,90 @@
+#include "sv_ring_buffer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace sv_render {
+
+static size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) result <<= 1;
+  return result;
+}
+
+template <typename Sample>
+SVRingBuffer<Sample>::SVRingBuffer(size_t capacity_in_frames, int channels)
+  : capacity_(RoundUpToPowerOfTwo(std::max<size_t>(capacity_in_frames, 1))),
+  mask_(capacity_ - 1),
+  channels_(channels),
+  buffer_(new Sample[capacity_ * channels]) {
+}
+
+template <typename Sample>
+size_t SVRingBuffer<Sample>::AvailableToRead() const {
+  // Read index first: it never passes the write index, so a thread that is
+  // neither side can't see it ahead of an older write index. The write index
+  // may have moved on by a whole ring meanwhile, hence the clamp.
+  const size_t read_index = read_index_.load(std::memory_order_acquire);
+  const size_t write_index = write_index_.load(std::memory_order_acquire);
+  return std::min(write_index - read_index, capacity_);
+}
+
+template <typename Sample>
+size_t SVRingBuffer<Sample>::AvailableToWrite() const {
+  return capacity_ - AvailableToRead();
+}
+
+template <typename Sample>
+size_t SVRingBuffer<Sample>::Write(const Sample* data, size_t num_frames) {
+  const size_t write_index = write_index_.load(std::memory_order_relaxed);
+  const size_t read_index = read_index_.load(std::memory_order_acquire);
+  const size_t to_write = std::min(num_frames, capacity_ - (write_index - read_index));
+  if (to_write == 0) return 0;
+  CopyIn(write_index, data, to_write);
+  write_index_.store(write_index + to_write, std::memory_order_release);
+  return to_write;
+}
+
+template <typename Sample>
+size_t SVRingBuffer<Sample>::Read(Sample* data, size_t num_frames) {
+  const size_t read_index = read_index_.load(std::memory_order_relaxed);
+  const size_t write_index = write_index_.load(std::memory_order_acquire);
+  const size_t to_read = std::min(num_frames, write_index - read_index);
+  if (to_read == 0) return 0;
+  CopyOut(read_index, data, to_read);
+  read_index_.store(read_index + to_read, std::memory_order_release);
+  return to_read;
+}
+
+template <typename Sample>
+size_t SVRingBuffer<Sample>::Skip(size_t num_frames) {
+  const size_t read_index = read_index_.load(std::memory_order_relaxed);
+  const size_t write_index = write_index_.load(std::memory_order_acquire);
+  const size_t to_skip = std::min(num_frames, write_index - read_index);
+  read_index_.store(read_index + to_skip, std::memory_order_release);
+  return to_skip;
+}
+
+template <typename Sample>
+void SVRingBuffer<Sample>::CopyIn(size_t index, const Sample* data, size_t num_frames) {
+  const size_t offset = index & mask_;
+  const size_t first = std::min(num_frames, capacity_ - offset);
+  memcpy(buffer_.get() + offset * channels_, data, first * channels_ * sizeof(Sample));
+  if (first < num_frames) {
+    memcpy(buffer_.get(), data + first * channels_, (num_frames - first) * channels_ * sizeof(Sample));
+  }
+}
+
+template <typename Sample>
+void SVRingBuffer<Sample>::CopyOut(size_t index, Sample* data, size_t num_frames) const {
+  const size_t offset = index & mask_;
+  const size_t first = std::min(num_frames, capacity_ - offset);
+  memcpy(data, buffer_.get() + offset * channels_, first * channels_ * sizeof(Sample));
+  if (first < num_frames) {
+    memcpy(data + first * channels_, buffer_.get(), (num_frames - first) * channels_ * sizeof(Sample));
+  }
+}
+
+template class SVRingBuffer<int16_t>;
+template class SVRingBuffer<float>;
+
+} // sv_render
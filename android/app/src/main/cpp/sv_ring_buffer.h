@@ -0,0 +1,60 @@
+#ifndef AUDIO_PLAYOUT_SV_RING_BUFFER_H
+#define AUDIO_PLAYOUT_SV_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace sv_render {
+
+// Wait-free single-producer/single-consumer ring of interleaved frames, of
+// int16 or float samples. Write() may only be called from one thread and
+// Read() from one other thread, neither call blocks or allocates.
+template <typename Sample>
+class SVRingBuffer {
+
+public:
+  // capacity_in_frames is rounded up to the next power of two.
+  SVRingBuffer(size_t capacity_in_frames, int channels);
+  ~SVRingBuffer() = default;
+
+  // Producer side. Returns the number of frames actually written.
+  size_t Write(const Sample* data, size_t num_frames);
+  // Consumer side. Returns the number of frames actually read.
+  size_t Read(Sample* data, size_t num_frames);
+  // Consumer side. Drops up to num_frames frames unread, returns how many.
+  size_t Skip(size_t num_frames);
+
+  // Any thread, a snapshot between 0 and capacity().
+  size_t AvailableToRead() const;
+  size_t AvailableToWrite() const;
+  // Frames ever written and read, for marking a position in the stream.
+  size_t frames_written() const { return write_index_.load(std::memory_order_acquire); }
+  size_t frames_read() const { return read_index_.load(std::memory_order_acquire); }
+  size_t capacity() const { return capacity_; }
+  int channels() const { return channels_; }
+
+private:
+  void CopyIn(size_t index, const Sample* data, size_t num_frames);
+  void CopyOut(size_t index, Sample* data, size_t num_frames) const;
+
+private:
+  const size_t capacity_;
+  const size_t mask_;
+  const int channels_;
+  std::unique_ptr<Sample[]> buffer_;
+  // Monotonic frame counters, padded onto separate cache lines so the producer
+  // and consumer don't false-share (alignas would need C++17 aligned new).
+  std::atomic<size_t> write_index_ { 0 };
+  char write_padding_[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> read_index_ { 0 };
+  char read_padding_[64 - sizeof(std::atomic<size_t>)];
+};
+
+extern template class SVRingBuffer<int16_t>;
+extern template class SVRingBuffer<float>;
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_RING_BUFFER_H
@@ -0,0 +1,512 @@
+// Only built with -DSV_RT_AUDIT=ON, on glibc hosts. The definitions below
+// take the place of the libc ones for the whole process: each records the
+// call when the thread is inside an SVRtAuditScope, then forwards to libc.
+#include "sv_rt_audit.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace sv_render {
+
+namespace {
+
+enum class Violation {
+  kAlloc,
+  kLock,
+  kSleep,
+  kFileIo,
+  // stdout/stderr, where AV_LOG writes on the host outside of callbacks.
+  kLog,
+};
+
+const char* ViolationName(Violation kind) {
+  switch (kind) {
+    case Violation::kAlloc:
+      return "alloc";
+    case Violation::kLock:
+      return "lock";
+    case Violation::kSleep:
+      return "sleep";
+    case Violation::kFileIo:
+      return "file-io";
+    case Violation::kLog:
+      return "log";
+  }
+  return "unknown";
+}
+
+constexpr int kMaxSites = 256;
+constexpr int kMaxFrames = 24;
+// Record() and the guard, left out of the reported stack. Optimized builds
+// inline the guard into the hook, then the stack starts at its caller.
+constexpr int kSkipFrames = 2;
+
+struct Site {
+  Violation kind;
+  const char* call;
+  uint64_t hash;
+  int64_t count;
+  int depth;
+  void* frames[kMaxFrames];
+};
+
+// Call sites, deduplicated by call and stack. A spinlock guards them, a
+// mutex would report itself.
+Site g_sites[kMaxSites];
+int g_site_count = 0;
+std::atomic_flag g_sites_lock = ATOMIC_FLAG_INIT;
+std::atomic<int64_t> g_violations { 0 };
+
+// Open SVRtAuditScopes on this thread.
+thread_local int t_scope_depth = 0;
+// Set while a hook runs, so what it calls itself isn't recorded again.
+thread_local bool t_in_hook = false;
+
+__attribute__((noinline)) void Record(Violation kind, const char* call) {
+  void* frames[kMaxFrames + kSkipFrames];
+  const int depth = std::max(backtrace(frames, kMaxFrames + kSkipFrames) - kSkipFrames, 0);
+  uint64_t hash = 1469598103934665603ULL;
+  for (int i = 0; i < depth; ++i) {
+    hash = (hash ^ reinterpret_cast<uintptr_t>(frames[kSkipFrames + i])) * 1099511628211ULL;
+  }
+  g_violations.fetch_add(1, std::memory_order_relaxed);
+
+  while (g_sites_lock.test_and_set(std::memory_order_acquire)) {
+  }
+  Site* site = nullptr;
+  for (int i = 0; i < g_site_count && !site; ++i) {
+    if (g_sites[i].hash == hash && g_sites[i].kind == kind && g_sites[i].call == call) {
+      site = &g_sites[i];
+    }
+  }
+  if (!site && g_site_count < kMaxSites) {
+    site = &g_sites[g_site_count++];
+    site->kind = kind;
+    site->call = call;
+    site->hash = hash;
+    site->count = 0;
+    site->depth = depth;
+    memcpy(site->frames, frames + kSkipFrames, depth * sizeof(void*));
+  }
+  if (site) {
+    ++site->count;
+  }
+  g_sites_lock.clear(std::memory_order_release);
+}
+
+// Entered by every hook. Records the call if the thread is in a scope and
+// the hook isn't nested in another one.
+class HookGuard {
+
+public:
+  HookGuard(Violation kind, const char* call) : outer_(!t_in_hook) {
+    if (outer_) {
+      t_in_hook = true;
+      if (t_scope_depth > 0) {
+        Record(kind, call);
+      }
+    }
+  }
+  ~HookGuard() {
+    if (outer_) {
+      t_in_hook = false;
+    }
+  }
+
+private:
+  const bool outer_;
+};
+
+Violation StreamKind(FILE* stream) {
+  return stream == stdout || stream == stderr ? Violation::kLog : Violation::kFileIo;
+}
+
+Violation FdKind(int fd) {
+  return fd == STDOUT_FILENO || fd == STDERR_FILENO ? Violation::kLog : Violation::kFileIo;
+}
+
+// The libc function a hook stands in for, looked up once.
+template <typename Fn>
+Fn Real(std::atomic<Fn>* slot, const char* name) {
+  Fn fn = slot->load(std::memory_order_relaxed);
+  if (!fn) {
+    fn = reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+    slot->store(fn, std::memory_order_relaxed);
+  }
+  return fn;
+}
+
+std::atomic<int (*)(pthread_mutex_t*)> g_mutex_lock { nullptr };
+std::atomic<int (*)(pthread_mutex_t*)> g_mutex_trylock { nullptr };
+std::atomic<int (*)(pthread_mutex_t*, const timespec*)> g_mutex_timedlock { nullptr };
+std::atomic<int (*)(pthread_mutex_t*, clockid_t, const timespec*)> g_mutex_clocklock { nullptr };
+std::atomic<int (*)(pthread_rwlock_t*)> g_rwlock_rdlock { nullptr };
+std::atomic<int (*)(pthread_rwlock_t*)> g_rwlock_wrlock { nullptr };
+std::atomic<int (*)(pthread_cond_t*, pthread_mutex_t*)> g_cond_wait { nullptr };
+std::atomic<int (*)(pthread_cond_t*, pthread_mutex_t*, const timespec*)> g_cond_timedwait { nullptr };
+std::atomic<int (*)(pthread_cond_t*, pthread_mutex_t*, clockid_t, const timespec*)> g_cond_clockwait { nullptr };
+std::atomic<int (*)(sem_t*)> g_sem_wait { nullptr };
+std::atomic<int (*)(sem_t*, const timespec*)> g_sem_timedwait { nullptr };
+std::atomic<int (*)(sem_t*, clockid_t, const timespec*)> g_sem_clockwait { nullptr };
+std::atomic<int (*)(const timespec*, timespec*)> g_nanosleep { nullptr };
+std::atomic<int (*)(clockid_t, int, const timespec*, timespec*)> g_clock_nanosleep { nullptr };
+std::atomic<int (*)(useconds_t)> g_usleep { nullptr };
+std::atomic<int (*)(const char*, int, ...)> g_open { nullptr };
+std::atomic<int (*)(int)> g_close { nullptr };
+std::atomic<ssize_t (*)(int, void*, size_t)> g_read { nullptr };
+std::atomic<ssize_t (*)(int, const void*, size_t)> g_write { nullptr };
+std::atomic<FILE* (*)(const char*, const char*)> g_fopen { nullptr };
+std::atomic<int (*)(FILE*)> g_fclose { nullptr };
+std::atomic<size_t (*)(void*, size_t, size_t, FILE*)> g_fread { nullptr };
+std::atomic<size_t (*)(void*, size_t, size_t, size_t, FILE*)> g_fread_chk { nullptr };
+std::atomic<size_t (*)(const void*, size_t, size_t, FILE*)> g_fwrite { nullptr };
+std::atomic<int (*)(FILE*)> g_fflush { nullptr };
+std::atomic<int (*)(int, FILE*)> g_fputc { nullptr };
+std::atomic<int (*)(const char*, FILE*)> g_fputs { nullptr };
+std::atomic<int (*)(FILE*, const char*, va_list)> g_vfprintf { nullptr };
+std::atomic<int (*)(FILE*, int, const char*, va_list)> g_vfprintf_chk { nullptr };
+
+// Resolves the hooks up front, and loads the unwinder backtrace() needs,
+// so neither happens on the audio thread first.
+__attribute__((constructor)) void InitRtAudit() {
+  t_in_hook = true;
+  void* frames[1];
+  backtrace(frames, 1);
+  Real(&g_mutex_lock, "pthread_mutex_lock");
+  Real(&g_mutex_trylock, "pthread_mutex_trylock");
+  Real(&g_mutex_timedlock, "pthread_mutex_timedlock");
+  Real(&g_mutex_clocklock, "pthread_mutex_clocklock");
+  Real(&g_rwlock_rdlock, "pthread_rwlock_rdlock");
+  Real(&g_rwlock_wrlock, "pthread_rwlock_wrlock");
+  Real(&g_cond_wait, "pthread_cond_wait");
+  Real(&g_cond_timedwait, "pthread_cond_timedwait");
+  Real(&g_cond_clockwait, "pthread_cond_clockwait");
+  Real(&g_sem_wait, "sem_wait");
+  Real(&g_sem_timedwait, "sem_timedwait");
+  Real(&g_sem_clockwait, "sem_clockwait");
+  Real(&g_nanosleep, "nanosleep");
+  Real(&g_clock_nanosleep, "clock_nanosleep");
+  Real(&g_usleep, "usleep");
+  Real(&g_open, "open");
+  Real(&g_close, "close");
+  Real(&g_read, "read");
+  Real(&g_write, "write");
+  Real(&g_fopen, "fopen");
+  Real(&g_fclose, "fclose");
+  Real(&g_fread, "fread");
+  Real(&g_fread_chk, "__fread_chk");
+  Real(&g_fwrite, "fwrite");
+  Real(&g_fflush, "fflush");
+  Real(&g_fputc, "fputc");
+  Real(&g_fputs, "fputs");
+  Real(&g_vfprintf, "vfprintf");
+  Real(&g_vfprintf_chk, "__vfprintf_chk");
+  t_in_hook = false;
+}
+
+// "binary(mangled+0x1f) [0x...]" becomes "demangled+0x1f".
+void PrintFrame(FILE* out, int index, const char* symbol) {
+  const char* begin = strchr(symbol, '(');
+  const char* end = begin ? strchr(begin, '+') : nullptr;
+  if (begin && end && end > begin + 1) {
+    std::string mangled(begin + 1, end);
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    const char* offset_end = strchr(end, ')');
+    fprintf(out, "    #%-2d %s%.*s\n", index, status == 0 ? demangled : mangled.c_str(),
+            offset_end ? static_cast<int>(offset_end - end) : 0, end);
+    free(demangled);
+    return;
+  }
+  fprintf(out, "    #%-2d %s\n", index, symbol);
+}
+
+} // namespace
+
+SVRtAuditScope::SVRtAuditScope() {
+  ++t_scope_depth;
+  SVRtLog::EnterCallback();
+}
+
+SVRtAuditScope::~SVRtAuditScope() {
+  SVRtLog::LeaveCallback();
+  --t_scope_depth;
+}
+
+int64_t SVRtAudit::violation_count() {
+  return g_violations.load(std::memory_order_relaxed);
+}
+
+void SVRtAudit::Reset() {
+  while (g_sites_lock.test_and_set(std::memory_order_acquire)) {
+  }
+  g_site_count = 0;
+  g_violations.store(0, std::memory_order_relaxed);
+  g_sites_lock.clear(std::memory_order_release);
+}
+
+void SVRtAudit::Report(FILE* out) {
+  while (g_sites_lock.test_and_set(std::memory_order_acquire)) {
+  }
+  std::vector<const Site*> sites;
+  for (int i = 0; i < g_site_count; ++i) {
+    sites.push_back(&g_sites[i]);
+  }
+  std::sort(sites.begin(), sites.end(), [](const Site* a, const Site* b) { return a->count > b->count; });
+  fprintf(out, "rt-audit: %lld violations on the audio thread, %zu call sites\n",
+          (long long) violation_count(), sites.size());
+  for (const Site* site : sites) {
+    fprintf(out, "rt-audit: [%s] %s x%lld\n", ViolationName(site->kind), site->call, (long long) site->count);
+    char** symbols = backtrace_symbols(site->frames, site->depth);
+    for (int i = 0; i < site->depth; ++i) {
+      PrintFrame(out, i, symbols ? symbols[i] : "?");
+    }
+    free(symbols);
+  }
+  g_sites_lock.clear(std::memory_order_release);
+}
+
+} // sv_render
+
+using sv_render::HookGuard;
+using sv_render::Real;
+using sv_render::Violation;
+
+extern "C" {
+
+void* malloc(size_t size) {
+  HookGuard guard(Violation::kAlloc, "malloc");
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  HookGuard guard(Violation::kAlloc, "calloc");
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  HookGuard guard(Violation::kAlloc, "realloc");
+  return __libc_realloc(ptr, size);
+}
+
+// Over-aligned operator new and allocators of alignas types land here.
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+  HookGuard guard(Violation::kAlloc, "posix_memalign");
+  if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+  void* memory = __libc_memalign(alignment, size);
+  if (!memory) {
+    return ENOMEM;
+  }
+  *ptr = memory;
+  return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  HookGuard guard(Violation::kAlloc, "aligned_alloc");
+  return __libc_memalign(alignment, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+  HookGuard guard(Violation::kAlloc, "memalign");
+  return __libc_memalign(alignment, size);
+}
+
+void free(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  HookGuard guard(Violation::kAlloc, "free");
+  __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+  HookGuard guard(Violation::kLock, "pthread_mutex_lock");
+  return Real(&sv_render::g_mutex_lock, "pthread_mutex_lock")(mutex);
+}
+
+// A trylock doesn't block, but fails on the lock the callback needed; it
+// is reported like the lock it stands in for.
+int pthread_mutex_trylock(pthread_mutex_t* mutex) {
+  HookGuard guard(Violation::kLock, "pthread_mutex_trylock");
+  return Real(&sv_render::g_mutex_trylock, "pthread_mutex_trylock")(mutex);
+}
+
+int pthread_mutex_timedlock(pthread_mutex_t* mutex, const timespec* abstime) {
+  HookGuard guard(Violation::kLock, "pthread_mutex_timedlock");
+  return Real(&sv_render::g_mutex_timedlock, "pthread_mutex_timedlock")(mutex, abstime);
+}
+
+int pthread_mutex_clocklock(pthread_mutex_t* mutex, clockid_t clock, const timespec* abstime) {
+  HookGuard guard(Violation::kLock, "pthread_mutex_clocklock");
+  return Real(&sv_render::g_mutex_clocklock, "pthread_mutex_clocklock")(mutex, clock, abstime);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock) {
+  HookGuard guard(Violation::kLock, "pthread_rwlock_rdlock");
+  return Real(&sv_render::g_rwlock_rdlock, "pthread_rwlock_rdlock")(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock) {
+  HookGuard guard(Violation::kLock, "pthread_rwlock_wrlock");
+  return Real(&sv_render::g_rwlock_wrlock, "pthread_rwlock_wrlock")(lock);
+}
+
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+  HookGuard guard(Violation::kLock, "pthread_cond_wait");
+  return Real(&sv_render::g_cond_wait, "pthread_cond_wait")(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const timespec* abstime) {
+  HookGuard guard(Violation::kLock, "pthread_cond_timedwait");
+  return Real(&sv_render::g_cond_timedwait, "pthread_cond_timedwait")(cond, mutex, abstime);
+}
+
+int pthread_cond_clockwait(pthread_cond_t* cond, pthread_mutex_t* mutex, clockid_t clock, const timespec* abstime) {
+  HookGuard guard(Violation::kLock, "pthread_cond_clockwait");
+  return Real(&sv_render::g_cond_clockwait, "pthread_cond_clockwait")(cond, mutex, clock, abstime);
+}
+
+int sem_wait(sem_t* sem) {
+  HookGuard guard(Violation::kLock, "sem_wait");
+  return Real(&sv_render::g_sem_wait, "sem_wait")(sem);
+}
+
+int sem_timedwait(sem_t* sem, const timespec* abstime) {
+  HookGuard guard(Violation::kLock, "sem_timedwait");
+  return Real(&sv_render::g_sem_timedwait, "sem_timedwait")(sem, abstime);
+}
+
+int sem_clockwait(sem_t* sem, clockid_t clock, const timespec* abstime) {
+  HookGuard guard(Violation::kLock, "sem_clockwait");
+  return Real(&sv_render::g_sem_clockwait, "sem_clockwait")(sem, clock, abstime);
+}
+
+int nanosleep(const timespec* duration, timespec* remaining) {
+  HookGuard guard(Violation::kSleep, "nanosleep");
+  return Real(&sv_render::g_nanosleep, "nanosleep")(duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const timespec* time, timespec* remaining) {
+  HookGuard guard(Violation::kSleep, "clock_nanosleep");
+  return Real(&sv_render::g_clock_nanosleep, "clock_nanosleep")(clock, flags, time, remaining);
+}
+
+int usleep(useconds_t usec) {
+  HookGuard guard(Violation::kSleep, "usleep");
+  return Real(&sv_render::g_usleep, "usleep")(usec);
+}
+
+int open(const char* path, int flags, ...) {
+  HookGuard guard(Violation::kFileIo, "open");
+  mode_t mode = 0;
+  if (flags & (O_CREAT | O_TMPFILE)) {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, mode_t);
+    va_end(args);
+  }
+  return Real(&sv_render::g_open, "open")(path, flags, mode);
+}
+
+int close(int fd) {
+  HookGuard guard(Violation::kFileIo, "close");
+  return Real(&sv_render::g_close, "close")(fd);
+}
+
+ssize_t read(int fd, void* buffer, size_t size) {
+  HookGuard guard(sv_render::FdKind(fd), "read");
+  return Real(&sv_render::g_read, "read")(fd, buffer, size);
+}
+
+ssize_t write(int fd, const void* buffer, size_t size) {
+  HookGuard guard(sv_render::FdKind(fd), "write");
+  return Real(&sv_render::g_write, "write")(fd, buffer, size);
+}
+
+FILE* fopen(const char* path, const char* mode) {
+  HookGuard guard(Violation::kFileIo, "fopen");
+  return Real(&sv_render::g_fopen, "fopen")(path, mode);
+}
+
+int fclose(FILE* stream) {
+  HookGuard guard(sv_render::StreamKind(stream), "fclose");
+  return Real(&sv_render::g_fclose, "fclose")(stream);
+}
+
+size_t fread(void* buffer, size_t size, size_t count, FILE* stream) {
+  HookGuard guard(sv_render::StreamKind(stream), "fread");
+  return Real(&sv_render::g_fread, "fread")(buffer, size, count, stream);
+}
+
+size_t __fread_chk(void* buffer, size_t buffer_size, size_t size, size_t count, FILE* stream) {
+  HookGuard guard(sv_render::StreamKind(stream), "fread");
+  return Real(&sv_render::g_fread_chk, "__fread_chk")(buffer, buffer_size, size, count, stream);
+}
+
+size_t fwrite(const void* buffer, size_t size, size_t count, FILE* stream) {
+  HookGuard guard(sv_render::StreamKind(stream), "fwrite");
+  return Real(&sv_render::g_fwrite, "fwrite")(buffer, size, count, stream);
+}
+
+int fflush(FILE* stream) {
+  HookGuard guard(sv_render::StreamKind(stream), "fflush");
+  return Real(&sv_render::g_fflush, "fflush")(stream);
+}
+
+int fputc(int c, FILE* stream) {
+  HookGuard guard(sv_render::StreamKind(stream), "fputc");
+  return Real(&sv_render::g_fputc, "fputc")(c, stream);
+}
+
+int fputs(const char* text, FILE* stream) {
+  HookGuard guard(sv_render::StreamKind(stream), "fputs");
+  return Real(&sv_render::g_fputs, "fputs")(text, stream);
+}
+
+int vfprintf(FILE* stream, const char* format, va_list args) {
+  HookGuard guard(sv_render::StreamKind(stream), "fprintf");
+  return Real(&sv_render::g_vfprintf, "vfprintf")(stream, format, args);
+}
+
+int fprintf(FILE* stream, const char* format, ...) {
+  HookGuard guard(sv_render::StreamKind(stream), "fprintf");
+  va_list args;
+  va_start(args, format);
+  const int result = Real(&sv_render::g_vfprintf, "vfprintf")(stream, format, args);
+  va_end(args);
+  return result;
+}
+
+int __fprintf_chk(FILE* stream, int flag, const char* format, ...) {
+  HookGuard guard(sv_render::StreamKind(stream), "fprintf");
+  va_list args;
+  va_start(args, format);
+  const int result = Real(&sv_render::g_vfprintf_chk, "__vfprintf_chk")(stream, flag, format, args);
+  va_end(args);
+  return result;
+}
+
+} // extern "C"
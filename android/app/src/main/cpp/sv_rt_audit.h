@@ -0,0 +1,69 @@
+#ifndef AUDIO_PLAYOUT_SV_RT_AUDIT_H
+#define AUDIO_PLAYOUT_SV_RT_AUDIT_H
+
+#include <cstdint>
+#include <cstdio>
+#include "sv_rt_log.h"
+
+namespace sv_render {
+
+// Real-time safety audit. A host build configured with -DSV_RT_AUDIT=ON
+// interposes malloc/free and the aligned allocators, mutex locks (try and
+// timed ones too), condition and semaphore waits, sleeps, and file and stdio
+// calls; each of them made on a thread inside an SVRtAuditScope is
+// recorded with its call stack. Every backend opens a scope around its
+// render callback, so anything that may block there shows up in Report().
+//
+// In other builds the audit reports no violations, the scope only tells
+// SVRtLog to defer what the callback logs.
+#ifdef SV_RT_AUDIT
+
+// Marks the current thread as running a render callback until destroyed.
+// Scopes nest.
+class SVRtAuditScope {
+
+public:
+  SVRtAuditScope();
+  ~SVRtAuditScope();
+  SVRtAuditScope(const SVRtAuditScope&) = delete;
+  SVRtAuditScope& operator=(const SVRtAuditScope&) = delete;
+};
+
+class SVRtAudit {
+
+public:
+  static constexpr bool kEnabled = true;
+  // Any thread. Violations recorded since start or the last Reset().
+  static int64_t violation_count();
+  // Control thread, while no callback runs.
+  static void Reset();
+  // Control thread, while no callback runs. One entry per call site, most
+  // frequent first, with its count and stack.
+  static void Report(FILE* out);
+};
+
+#else
+
+class SVRtAuditScope {
+
+public:
+  SVRtAuditScope() { SVRtLog::EnterCallback(); }
+  ~SVRtAuditScope() { SVRtLog::LeaveCallback(); }
+  SVRtAuditScope(const SVRtAuditScope&) = delete;
+  SVRtAuditScope& operator=(const SVRtAuditScope&) = delete;
+};
+
+class SVRtAudit {
+
+public:
+  static constexpr bool kEnabled = false;
+  static int64_t violation_count() { return 0; }
+  static void Reset() {}
+  static void Report(FILE* out) {}
+};
+
+#endif
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_RT_AUDIT_H
@@ -0,0 +1,332 @@
+#include "sv_rt_log.h"
+#include "sv_mpsc_queue.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace sv_render {
+
+namespace {
+
+// Records the ring holds. With the per-site rate limit, only many distinct
+// sites logging within one drain interval fill it.
+constexpr size_t kRingCapacity = 256;
+// The drain thread wakes this often while a stream is started, and runs
+// below normal priority.
+constexpr std::chrono::milliseconds kDrainInterval { 10 };
+constexpr int kDrainNice = 10;
+
+struct Record {
+  const SVRtLogSite* site;
+  int64_t timestamp_ns;
+  uint32_t suppressed;
+  int num_args;
+  SVRtLogArg args[SVRtLog::kMaxArgs];
+  char strings[SVRtLog::kRecordStringBytes];
+};
+
+int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void DefaultWriter(SV_LOG_LEVEL level, const char* text) {
+#ifdef __ANDROID__
+  static const int priorities[] = {ANDROID_LOG_DEBUG, ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR,
+                                   ANDROID_LOG_FATAL};
+  __android_log_write(priorities[level], TAG, text);
+#else
+  static const char* levels[] = {"D", "I", "W", "E", "F"};
+  fprintf(stderr, "%s/%s: %s\n", levels[level], TAG, text);
+#endif
+}
+
+thread_local int t_callback_depth = 0;
+
+std::atomic<SVRtLog::Writer> g_writer { DefaultWriter };
+std::atomic<uint64_t> g_deferred { 0 };
+std::atomic<uint64_t> g_suppressed { 0 };
+std::atomic<uint64_t> g_dropped { 0 };
+
+// The ring and the thread draining it, for the whole process. Nothing runs
+// until the first stream starts, and the thread sleeps while none is.
+class LogDrain {
+
+public:
+  LogDrain() : ring_(kRingCapacity) {
+  }
+
+  ~LogDrain() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+    cond_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    Drain();
+  }
+
+  void StreamStarted() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++started_streams_;
+      if (!thread_.joinable() && !quit_) {
+        thread_ = std::thread([this] { ThreadLoop(); });
+      }
+    }
+    cond_.notify_all();
+  }
+
+  // Wakes the thread once more for what the last callbacks left.
+  void StreamStopped() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --started_streams_;
+    }
+    cond_.notify_all();
+  }
+
+  bool Push(const Record& record) { return ring_.Push(record); }
+
+  // Any thread but a callback's.
+  void Drain() {
+    std::lock_guard<std::mutex> lock(drain_mutex_);
+    Record record;
+    char line[SVRtLog::kMaxLineBytes];
+    while (ring_.Pop(&record)) {
+      // Strings were copied into the record, point at the copy.
+      for (int i = 0; i < record.num_args; ++i) {
+        if (record.args[i].type == SVRtLogArg::kRecordString) {
+          record.args[i].type = SVRtLogArg::kString;
+          record.args[i].s = record.strings + record.args[i].i;
+        }
+      }
+      size_t length = SVRtLog::Format(record.site->format, record.args, record.num_args, line, sizeof(line));
+      auto append = [&](int written) {
+        if (written > 0) length = std::min(length + written, sizeof(line) - 1);
+      };
+      const double delay_ms = (NowNanos() - record.timestamp_ns) / 1e6;
+      append(snprintf(line + length, sizeof(line) - length, " [audio thread, %.1f ms ago", delay_ms));
+      if (record.suppressed > 0) {
+        append(snprintf(line + length, sizeof(line) - length, ", %u similar suppressed", record.suppressed));
+      }
+      append(snprintf(line + length, sizeof(line) - length, "]"));
+      g_writer.load(std::memory_order_acquire)(record.site->level, line);
+    }
+    const uint64_t dropped = g_dropped.load(std::memory_order_relaxed);
+    if (dropped > reported_drops_) {
+      snprintf(line, sizeof(line), "%llu audio thread log records dropped, the log ring was full.",
+               (unsigned long long) (dropped - reported_drops_));
+      g_writer.load(std::memory_order_acquire)(SV_LOG_WARN, line);
+      reported_drops_ = dropped;
+    }
+  }
+
+private:
+  void ThreadLoop() {
+#ifdef __linux__
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), kDrainNice);
+#endif
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!quit_) {
+      if (started_streams_ > 0) {
+        cond_.wait_for(lock, kDrainInterval);
+      } else {
+        cond_.wait(lock);
+      }
+      lock.unlock();
+      Drain();
+      lock.lock();
+    }
+  }
+
+  SVMpscQueue<Record> ring_;
+  std::mutex drain_mutex_;
+  uint64_t reported_drops_ = 0;
+  // Guard the thread, the started stream count and quit_.
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  int started_streams_ = 0;
+  bool quit_ = false;
+  std::thread thread_;
+};
+
+LogDrain g_drain;
+
+} // namespace
+
+void SVRtLog::EnterCallback() {
+  ++t_callback_depth;
+}
+
+void SVRtLog::LeaveCallback() {
+  --t_callback_depth;
+}
+
+bool SVRtLog::InCallback() {
+  return t_callback_depth > 0;
+}
+
+void SVRtLog::Flush() {
+  g_drain.Drain();
+}
+
+void SVRtLog::StreamStarted() {
+  g_drain.StreamStarted();
+}
+
+void SVRtLog::StreamStopped() {
+  g_drain.StreamStopped();
+}
+
+void SVRtLog::SetWriter(Writer writer) {
+  g_writer.store(writer ? writer : DefaultWriter, std::memory_order_release);
+}
+
+uint64_t SVRtLog::deferred_count() {
+  return g_deferred.load(std::memory_order_relaxed);
+}
+
+uint64_t SVRtLog::suppressed_count() {
+  return g_suppressed.load(std::memory_order_relaxed);
+}
+
+uint64_t SVRtLog::dropped_count() {
+  return g_dropped.load(std::memory_order_relaxed);
+}
+
+void SVRtLog::Defer(SVRtLogSite* site, const SVRtLogArg* args, int num_args) {
+  const int64_t now_ns = NowNanos();
+  int64_t last_ns = site->last_ns.load(std::memory_order_relaxed);
+  // Rate limit, and one winner when several threads log the site at once.
+  if ((last_ns != SVRtLogSite::kNever && now_ns - last_ns < site->min_interval_ns) ||
+      !site->last_ns.compare_exchange_strong(last_ns, now_ns, std::memory_order_relaxed)) {
+    site->suppressed.fetch_add(1, std::memory_order_relaxed);
+    g_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  Record record;
+  record.site = site;
+  record.timestamp_ns = now_ns;
+  record.suppressed = site->suppressed.exchange(0, std::memory_order_relaxed);
+  record.num_args = num_args;
+  int string_bytes = 0;
+  for (int i = 0; i < num_args; ++i) {
+    record.args[i] = args[i];
+    if (args[i].type == SVRtLogArg::kString && args[i].s) {
+      // The caller's string may be gone by the time the record is written.
+      const int room = kRecordStringBytes - string_bytes;
+      const int length = std::min(static_cast<int>(strnlen(args[i].s, room)), room - 1);
+      if (length < 0) {
+        record.args[i].s = "";
+        continue;
+      }
+      memcpy(record.strings + string_bytes, args[i].s, length);
+      record.strings[string_bytes + length] = '\0';
+      record.args[i].type = SVRtLogArg::kRecordString;
+      record.args[i].i = string_bytes;
+      string_bytes += length + 1;
+    }
+  }
+  if (!g_drain.Push(record)) {
+    g_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  g_deferred.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SVRtLog::Write(SV_LOG_LEVEL level, const char* format, const SVRtLogArg* args, int num_args) {
+  char line[kMaxLineBytes];
+  Format(format, args, num_args, line, sizeof(line));
+  g_writer.load(std::memory_order_acquire)(level, line);
+}
+
+int SVRtLog::Format(const char* format, const SVRtLogArg* args, int num_args, char* out, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  size_t length = 0;
+  int next_arg = 0;
+  const char* p = format;
+  while (*p && length + 1 < size) {
+    if (*p != '%') {
+      out[length++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[length++] = '%';
+      p += 2;
+      continue;
+    }
+    // Keeps flags, width and precision; the length modifier is replaced by
+    // the width the argument was recorded with.
+    char spec[32] = "%";
+    size_t spec_length = 1;
+    const char* q = p + 1;
+    while (*q && strchr("-+ #0123456789.", *q) && spec_length + 4 < sizeof(spec)) {
+      spec[spec_length++] = *q++;
+    }
+    while (*q && strchr("hlLqjzt", *q)) {
+      ++q;
+    }
+    const char conversion = *q;
+    if (!conversion) {
+      break;
+    }
+    p = q + 1;
+    const SVRtLogArg* arg = next_arg < num_args ? &args[next_arg++] : nullptr;
+    int written = 0;
+    if (!arg) {
+      written = snprintf(out + length, size - length, "?");
+    } else if (strchr("di", conversion)) {
+      spec[spec_length++] = 'l';
+      spec[spec_length++] = 'l';
+      spec[spec_length++] = conversion;
+      const long long value = arg->type == SVRtLogArg::kDouble ? static_cast<long long>(arg->d) : arg->i;
+      written = snprintf(out + length, size - length, spec, value);
+    } else if (strchr("ouxX", conversion)) {
+      spec[spec_length++] = 'l';
+      spec[spec_length++] = 'l';
+      spec[spec_length++] = conversion;
+      const unsigned long long value = arg->type == SVRtLogArg::kDouble ? static_cast<unsigned long long>(arg->d)
+                                                                        : static_cast<unsigned long long>(arg->i);
+      written = snprintf(out + length, size - length, spec, value);
+    } else if (conversion == 'c') {
+      spec[spec_length++] = 'c';
+      written = snprintf(out + length, size - length, spec, static_cast<int>(arg->i));
+    } else if (strchr("fFeEgGaA", conversion)) {
+      spec[spec_length++] = conversion;
+      const double value = arg->type == SVRtLogArg::kDouble ? arg->d : static_cast<double>(arg->i);
+      written = snprintf(out + length, size - length, spec, value);
+    } else if (conversion == 's') {
+      spec[spec_length++] = 's';
+      const char* value = arg->type == SVRtLogArg::kString && arg->s ? arg->s : "(null)";
+      written = snprintf(out + length, size - length, spec, value);
+    } else if (conversion == 'p') {
+      spec[spec_length++] = 'p';
+      written = snprintf(out + length, size - length, spec, arg->p);
+    } else {
+      written = snprintf(out + length, size - length, "?");
+    }
+    if (written > 0) {
+      length = std::min(length + written, size - 1);
+    }
+  }
+  out[length] = '\0';
+  return static_cast<int>(length);
+}
+
+} // sv_render
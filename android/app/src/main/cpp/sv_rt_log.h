@@ -0,0 +1,149 @@
+#ifndef AUDIO_PLAYOUT_SV_RT_LOG_H
+#define AUDIO_PLAYOUT_SV_RT_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace sv_render {
+
+enum SV_LOG_LEVEL : int {
+    SV_LOG_DEBUG,
+    SV_LOG_INFO,
+    SV_LOG_WARN,
+    SV_LOG_ERROR,
+    SV_LOG_FATAL
+};
+
+// One AV_LOG call site. A static with a constexpr constructor, so it is
+// initialized at load time and the first call from a callback takes no
+// guard lock. Callbacks log a site at most once per min_interval_ns and
+// count the calls in between.
+struct SVRtLogSite {
+  static constexpr int64_t kDefaultIntervalNs = 1000000000LL;
+  static constexpr int64_t kNever = INT64_MIN;
+
+  constexpr SVRtLogSite(SV_LOG_LEVEL level, const char* format, int64_t min_interval_ns = kDefaultIntervalNs)
+    : level(level),
+    format(format),
+    min_interval_ns(min_interval_ns),
+    last_ns(kNever),
+    suppressed(0) {
+  }
+
+  const SV_LOG_LEVEL level;
+  const char* const format;
+  const int64_t min_interval_ns;
+  std::atomic<int64_t> last_ns;
+  std::atomic<uint32_t> suppressed;
+};
+
+// A log argument as recorded: integers widened to 64 bits, floats to double,
+// strings by pointer, or copied into the record when it is deferred.
+struct SVRtLogArg {
+  enum Type : uint8_t { kInt, kDouble, kString, kPointer, kRecordString } type;
+  union {
+    int64_t i;
+    double d;
+    const char* s;
+    const void* p;
+  };
+};
+
+template <typename T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, int>::type = 0>
+inline SVRtLogArg SVMakeLogArg(T value) {
+  SVRtLogArg arg {SVRtLogArg::kInt, {}};
+  arg.i = static_cast<int64_t>(value);
+  return arg;
+}
+
+inline SVRtLogArg SVMakeLogArg(double value) {
+  SVRtLogArg arg {SVRtLogArg::kDouble, {}};
+  arg.d = value;
+  return arg;
+}
+
+inline SVRtLogArg SVMakeLogArg(const char* value) {
+  SVRtLogArg arg {SVRtLogArg::kString, {}};
+  arg.s = value;
+  return arg;
+}
+
+inline SVRtLogArg SVMakeLogArg(const void* value) {
+  SVRtLogArg arg {SVRtLogArg::kPointer, {}};
+  arg.p = value;
+  return arg;
+}
+
+// Lets the compiler check AV_LOG formats against their arguments, never called.
+inline void SVCheckLogFormat(const char* format, ...) __attribute__((format(printf, 1, 2)));
+inline void SVCheckLogFormat(const char* format, ...) {}
+
+// Backend of the AV_LOG macros. Off the audio thread a call formats and
+// writes its line right away, as AV_LOG always did. Inside a render
+// callback, marked by SVRtAuditScope, it only copies a fixed-size record
+// (site, arguments, timestamp) into a lock-free SVMpscQueue; a low-priority
+// thread formats and writes the records every few milliseconds while a
+// stream is started, and sleeps otherwise. A full ring drops the record and
+// counts it, the drain thread reports the drops.
+class SVRtLog {
+
+public:
+  static constexpr int kMaxArgs = 8;
+  // Room for the strings of a deferred record, longer ones are truncated.
+  static constexpr int kRecordStringBytes = 64;
+  // Lines longer than this are truncated.
+  static constexpr int kMaxLineBytes = 512;
+
+  template <typename... Args>
+  static void Log(SVRtLogSite* site, Args... args) {
+    static_assert(sizeof...(Args) <= kMaxArgs, "too many log arguments");
+    // The trailing entry keeps the array valid without arguments.
+    const SVRtLogArg arg_list[] = {SVMakeLogArg(args)..., SVMakeLogArg(0)};
+    if (InCallback()) {
+      Defer(site, arg_list, sizeof...(Args));
+    } else {
+      Write(site->level, site->format, arg_list, sizeof...(Args));
+    }
+  }
+
+  // Any thread. Marks the calling thread as running a render callback while
+  // at least one enter is not yet left. SVRtAuditScope calls these.
+  static void EnterCallback();
+  static void LeaveCallback();
+  static bool InCallback();
+
+  // Any thread but a callback's. Writes what was deferred so far.
+  static void Flush();
+
+  // Control thread, SVStreamControl calls these as a stream starts and
+  // stops. The drain thread is created on the first start and polls only
+  // while a stream is started; records deferred with none started are
+  // written by Flush() or the next start.
+  static void StreamStarted();
+  static void StreamStopped();
+
+  // Where formatted lines go, logcat or stderr by default; nullptr restores
+  // the default. Set while nothing logs.
+  using Writer = void (*)(SV_LOG_LEVEL level, const char* text);
+  static void SetWriter(Writer writer);
+
+  // Records queued by callbacks, calls the rate limit skipped, and records
+  // lost to a full ring.
+  static uint64_t deferred_count();
+  static uint64_t suppressed_count();
+  static uint64_t dropped_count();
+
+  // printf-style formatting from recorded arguments, whatever length
+  // modifiers the format uses. Returns the length written to out.
+  static int Format(const char* format, const SVRtLogArg* args, int num_args, char* out, size_t size);
+
+private:
+  static void Defer(SVRtLogSite* site, const SVRtLogArg* args, int num_args);
+  static void Write(SV_LOG_LEVEL level, const char* format, const SVRtLogArg* args, int num_args);
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_RT_LOG_H
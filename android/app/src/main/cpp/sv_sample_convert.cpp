@@ -0,0 +1,272 @@
+#include "sv_sample_convert.h"
+#include "sv_simd.h"
+#include <algorithm>
+#include <cmath>
+
+namespace sv_render {
+
+namespace {
+
+constexpr float kInt16ToFloat = 1.0f / 32768.0f;
+constexpr float kFloatToInt16 = 32768.0f;
+constexpr float kInt16Min = -32768.0f;
+constexpr float kInt16Max = 32767.0f;
+// Maps the top 24 bits of a xorshift lane to [0, 1).
+constexpr float kUniformScale = 1.0f / 16777216.0f;
+
+inline uint32_t XorShift(uint32_t x) {
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+inline int16_t Quantize(float scaled) {
+  scaled = std::min(std::max(scaled, kInt16Min), kInt16Max);
+  return static_cast<int16_t>(std::lrintf(scaled));
+}
+
+// Advances all eight lanes and writes the triangular noise of the next four
+// samples, in LSBs.
+inline void NextNoise(SVDither* dither, float* noise) {
+  for (int lane = 0; lane < 8; ++lane) {
+    dither->state[lane] = XorShift(dither->state[lane]);
+  }
+  for (int lane = 0; lane < 4; ++lane) {
+    noise[lane] = static_cast<float>(dither->state[lane] >> 8) * kUniformScale -
+                  static_cast<float>(dither->state[lane + 4] >> 8) * kUniformScale;
+  }
+}
+
+// XorShift() is linear over GF(2), so a number of steps is a 32x32 bit
+// matrix, here as the images of the 32 unit vectors.
+struct XorShiftMatrix {
+  uint32_t column[32];
+};
+
+inline uint32_t Apply(const XorShiftMatrix& matrix, uint32_t x) {
+  uint32_t result = 0;
+  for (int bit = 0; bit < 32; ++bit) {
+    if (x & (1u << bit)) result ^= matrix.column[bit];
+  }
+  return result;
+}
+
+// The map that applies first, then second.
+XorShiftMatrix Compose(const XorShiftMatrix& first, const XorShiftMatrix& second) {
+  XorShiftMatrix result;
+  for (int bit = 0; bit < 32; ++bit) {
+    result.column[bit] = Apply(second, first.column[bit]);
+  }
+  return result;
+}
+
+} // namespace
+
+SVDither::SVDither(uint32_t seed) {
+  Reset(seed);
+}
+
+void SVDither::Reset(uint32_t seed) {
+  for (uint32_t lane = 0; lane < 8; ++lane) {
+    uint32_t x = seed * 0x9E3779B9u + (lane + 1) * 0x85EBCA6Bu;
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    state[lane] = x ? x : 0x6D2B79F5u;
+  }
+}
+
+void SVDither::Skip(uint64_t draws) {
+  XorShiftMatrix power;
+  for (int bit = 0; bit < 32; ++bit) {
+    power.column[bit] = XorShift(1u << bit);
+  }
+  for (; draws > 0; draws >>= 1) {
+    if (draws & 1) {
+      for (auto& lane : state) {
+        lane = Apply(power, lane);
+      }
+    }
+    power = Compose(power, power);
+  }
+}
+
+void SVInt16ToFloatScalar(const int16_t* src, float* dst, int count) {
+  for (int i = 0; i < count; ++i) {
+    dst[i] = src[i] * kInt16ToFloat;
+  }
+}
+
+void SVFloatToInt16Scalar(const float* src, int16_t* dst, int count) {
+  for (int i = 0; i < count; ++i) {
+    dst[i] = Quantize(src[i] * kFloatToInt16);
+  }
+}
+
+void SVFloatToInt16DitheredScalar(const float* src, int16_t* dst, int count, SVDither* dither) {
+  float noise[4];
+  for (int i = 0; i < count; i += 4) {
+    NextNoise(dither, noise);
+    const int n = std::min(4, count - i);
+    for (int j = 0; j < n; ++j) {
+      dst[i + j] = Quantize(src[i + j] * kFloatToInt16 + noise[j]);
+    }
+  }
+}
+
+#if defined(SV_HAVE_NEON)
+
+namespace {
+
+inline int32x4_t RoundToInt(float32x4_t value) {
+#if defined(__aarch64__)
+  return vcvtnq_s32_f32(value);
+#else
+  // ARMv7 NEON only truncates; round half away from zero instead.
+  const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(value), vdupq_n_u32(0x80000000u));
+  const float32x4_t half = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(vdupq_n_f32(0.5f)), sign));
+  return vcvtq_s32_f32(vaddq_f32(value, half));
+#endif
+}
+
+inline int16x4_t QuantizeVector(float32x4_t scaled) {
+  scaled = vminq_f32(vmaxq_f32(scaled, vdupq_n_f32(kInt16Min)), vdupq_n_f32(kInt16Max));
+  return vqmovn_s32(RoundToInt(scaled));
+}
+
+inline float32x4_t UniformVector(uint32x4_t state) {
+  return vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(state, 8)), kUniformScale);
+}
+
+inline uint32x4_t XorShiftVector(uint32x4_t x) {
+  x = veorq_u32(x, vshlq_n_u32(x, 13));
+  x = veorq_u32(x, vshrq_n_u32(x, 17));
+  return veorq_u32(x, vshlq_n_u32(x, 5));
+}
+
+} // namespace
+
+void SVInt16ToFloat(const int16_t* src, float* dst, int count) {
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const int16x8_t samples = vld1q_s16(src + i);
+    vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))), kInt16ToFloat));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), kInt16ToFloat));
+  }
+  SVInt16ToFloatScalar(src + i, dst + i, count - i);
+}
+
+void SVFloatToInt16(const float* src, int16_t* dst, int count) {
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const int16x4_t low = QuantizeVector(vmulq_n_f32(vld1q_f32(src + i), kFloatToInt16));
+    const int16x4_t high = QuantizeVector(vmulq_n_f32(vld1q_f32(src + i + 4), kFloatToInt16));
+    vst1q_s16(dst + i, vcombine_s16(low, high));
+  }
+  SVFloatToInt16Scalar(src + i, dst + i, count - i);
+}
+
+void SVFloatToInt16Dithered(const float* src, int16_t* dst, int count, SVDither* dither) {
+  uint32x4_t state_a = vld1q_u32(dither->state);
+  uint32x4_t state_b = vld1q_u32(dither->state + 4);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    state_a = XorShiftVector(state_a);
+    state_b = XorShiftVector(state_b);
+    const float32x4_t noise = vsubq_f32(UniformVector(state_a), UniformVector(state_b));
+    const float32x4_t scaled = vmlaq_n_f32(noise, vld1q_f32(src + i), kFloatToInt16);
+    vst1_s16(dst + i, QuantizeVector(scaled));
+  }
+  vst1q_u32(dither->state, state_a);
+  vst1q_u32(dither->state + 4, state_b);
+  SVFloatToInt16DitheredScalar(src + i, dst + i, count - i, dither);
+}
+
+#elif defined(SV_HAVE_SSE2)
+
+namespace {
+
+inline __m128i QuantizePair(__m128 low, __m128 high) {
+  const __m128 min = _mm_set1_ps(kInt16Min);
+  const __m128 max = _mm_set1_ps(kInt16Max);
+  low = _mm_min_ps(_mm_max_ps(low, min), max);
+  high = _mm_min_ps(_mm_max_ps(high, min), max);
+  return _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high));
+}
+
+inline __m128 UniformVector(__m128i state) {
+  return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(state, 8)), _mm_set1_ps(kUniformScale));
+}
+
+inline __m128i XorShiftVector(__m128i x) {
+  x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+  return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+} // namespace
+
+void SVInt16ToFloat(const int16_t* src, float* dst, int count) {
+  const __m128 scale = _mm_set1_ps(kInt16ToFloat);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    // Sign-extend by placing each sample in the top half of a lane.
+    const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+    const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+  }
+  SVInt16ToFloatScalar(src + i, dst + i, count - i);
+}
+
+void SVFloatToInt16(const float* src, int16_t* dst, int count) {
+  const __m128 scale = _mm_set1_ps(kFloatToInt16);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128 low = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+    const __m128 high = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), QuantizePair(low, high));
+  }
+  SVFloatToInt16Scalar(src + i, dst + i, count - i);
+}
+
+void SVFloatToInt16Dithered(const float* src, int16_t* dst, int count, SVDither* dither) {
+  const __m128 scale = _mm_set1_ps(kFloatToInt16);
+  __m128i state_a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->state));
+  __m128i state_b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->state + 4));
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    state_a = XorShiftVector(state_a);
+    state_b = XorShiftVector(state_b);
+    const __m128 noise_low = _mm_sub_ps(UniformVector(state_a), UniformVector(state_b));
+    state_a = XorShiftVector(state_a);
+    state_b = XorShiftVector(state_b);
+    const __m128 noise_high = _mm_sub_ps(UniformVector(state_a), UniformVector(state_b));
+    const __m128 low = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), noise_low);
+    const __m128 high = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), noise_high);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), QuantizePair(low, high));
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dither->state), state_a);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dither->state + 4), state_b);
+  SVFloatToInt16DitheredScalar(src + i, dst + i, count - i, dither);
+}
+
+#else
+
+void SVInt16ToFloat(const int16_t* src, float* dst, int count) {
+  SVInt16ToFloatScalar(src, dst, count);
+}
+
+void SVFloatToInt16(const float* src, int16_t* dst, int count) {
+  SVFloatToInt16Scalar(src, dst, count);
+}
+
+void SVFloatToInt16Dithered(const float* src, int16_t* dst, int count, SVDither* dither) {
+  SVFloatToInt16DitheredScalar(src, dst, count, dither);
+}
+
+#endif
+
+} // sv_render
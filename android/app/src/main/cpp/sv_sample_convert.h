@@ -0,0 +1,38 @@
+#ifndef AUDIO_PLAYOUT_SV_SAMPLE_CONVERT_H
+#define AUDIO_PLAYOUT_SV_SAMPLE_CONVERT_H
+
+#include <cstdint>
+
+namespace sv_render {
+
+// State of the TPDF dither generator: four xorshift lanes per uniform
+// variate, so the vector kernels and the scalar reference produce the same
+// noise sequence.
+struct SVDither {
+  explicit SVDither(uint32_t seed = 1);
+  void Reset(uint32_t seed);
+  // Advances the generator as if draws groups of four samples had been
+  // dithered, in time logarithmic in draws. A group is started per four
+  // samples of each conversion call, a short tail included.
+  void Skip(uint64_t draws);
+  uint32_t state[8];
+};
+
+// Sample format conversion over whole buffers, count is the number of
+// samples (frames * channels). Float samples are full scale at +-1.0; int16
+// maps to float exactly as sample / 32768 and back, values outside the range
+// saturate. The kernels use NEON/SSE2 when available.
+void SVInt16ToFloat(const int16_t* src, float* dst, int count);
+void SVFloatToInt16(const float* src, int16_t* dst, int count);
+// Adds +-1 LSB triangular noise before rounding, for requantizing processed
+// signals without correlated truncation distortion.
+void SVFloatToInt16Dithered(const float* src, int16_t* dst, int count, SVDither* dither);
+
+// Plain C versions, used on other targets and by the benchmarks.
+void SVInt16ToFloatScalar(const int16_t* src, float* dst, int count);
+void SVFloatToInt16Scalar(const float* src, int16_t* dst, int count);
+void SVFloatToInt16DitheredScalar(const float* src, int16_t* dst, int count, SVDither* dither);
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_SAMPLE_CONVERT_H
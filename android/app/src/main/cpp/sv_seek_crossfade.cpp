@@ -0,0 +1,62 @@
+#include "sv_seek_crossfade.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace sv_render {
+
+namespace {
+
+// A convex blend of two int16 samples stays in range.
+inline int16_t Blend(int16_t from, int16_t to, float gain) {
+  return static_cast<int16_t>(lrintf(from + (to - from) * gain));
+}
+
+inline float Blend(float from, float to, float gain) {
+  return from + (to - from) * gain;
+}
+
+} // namespace
+
+template <typename Sample>
+void SVSeekCrossfade<Sample>::Prepare(int sample_rate, int channels) {
+  channels_ = channels;
+  max_frames_ = std::max(sample_rate * kFadeMs / 1000, 1);
+  old_.reset(new Sample[static_cast<size_t>(max_frames_) * channels]());
+  length_ = 0;
+  position_ = 0;
+}
+
+template <typename Sample>
+void SVSeekCrossfade<Sample>::Start(int num_old_frames) {
+  length_ = std::min(num_old_frames, max_frames_);
+  position_ = 0;
+}
+
+// Linear fade, rare and a few milliseconds long, so it stays scalar.
+template <typename Sample>
+int SVSeekCrossfade<Sample>::Apply(Sample* dst, int frames, int num_frames) {
+  if (!active()) {
+    return frames;
+  }
+  const int fade = std::min(num_frames, length_ - position_);
+  if (frames < fade) {
+    memset(dst + frames * channels_, 0, (fade - frames) * channels_ * sizeof(Sample));
+  }
+  const Sample* old = old_.get() + position_ * channels_;
+  const float step = 1.0f / (length_ + 1);
+  for (int i = 0; i < fade; ++i) {
+    const float gain = (position_ + i + 1) * step;
+    for (int ch = 0; ch < channels_; ++ch) {
+      const int index = i * channels_ + ch;
+      dst[index] = Blend(old[index], dst[index], gain);
+    }
+  }
+  position_ += fade;
+  return std::max(frames, fade);
+}
+
+template class SVSeekCrossfade<int16_t>;
+template class SVSeekCrossfade<float>;
+
+} // sv_render
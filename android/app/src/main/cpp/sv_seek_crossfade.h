@@ -0,0 +1,49 @@
+#ifndef AUDIO_PLAYOUT_SV_SEEK_CROSSFADE_H
+#define AUDIO_PLAYOUT_SV_SEEK_CROSSFADE_H
+
+#include <cstdint>
+#include <memory>
+
+namespace sv_render {
+
+// Audio-thread half of a seek: holds the frames that would have played next
+// at the old position and fades them out under the first frames of the new
+// position, so a jump doesn't click. Int16 or float interleaved frames.
+template <typename Sample>
+class SVSeekCrossfade {
+
+public:
+  // Fade length of a seek.
+  static constexpr int kFadeMs = 5;
+
+  // Control thread. Allocates the fade buffer for the stream layout.
+  void Prepare(int sample_rate, int channels);
+  int max_frames() const { return max_frames_; }
+
+  // Audio thread. Starts a fade: the caller copies up to max_frames() frames
+  // of the old position into the returned buffer, then calls Start() with
+  // the number copied. A seek during a fade starts over from the new frames.
+  Sample* old_frames() { return old_.get(); }
+  void Start(int num_old_frames);
+  bool active() const { return position_ < length_; }
+
+  // Audio thread. dst holds `frames` frames of the new position out of the
+  // num_frames asked for. Blends the fade into them; new frames still
+  // missing inside the fade count as silence while the old ones fade out.
+  // Returns the number of valid frames in dst.
+  int Apply(Sample* dst, int frames, int num_frames);
+
+private:
+  int channels_ = 0;
+  int max_frames_ = 0;
+  std::unique_ptr<Sample[]> old_;
+  int length_ = 0;
+  int position_ = 0;
+};
+
+extern template class SVSeekCrossfade<int16_t>;
+extern template class SVSeekCrossfade<float>;
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_SEEK_CROSSFADE_H
@@ -0,0 +1,15 @@
+#ifndef AUDIO_PLAYOUT_SV_SIMD_H
+#define AUDIO_PLAYOUT_SV_SIMD_H
+
+// Picks the vector instruction set the DSP kernels compile for. Every kernel
+// keeps a scalar version, used on other targets and as the reference the
+// benchmarks compare against.
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SV_HAVE_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SV_HAVE_SSE2 1
+#endif
+
+#endif //AUDIO_PLAYOUT_SV_SIMD_H
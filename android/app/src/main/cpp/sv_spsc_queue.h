@@ -0,0 +1,72 @@
+#ifndef AUDIO_PLAYOUT_SV_SPSC_QUEUE_H
+#define AUDIO_PLAYOUT_SV_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace sv_render {
+
+// Wait-free single-producer/single-consumer queue of small trivially copyable
+// messages, for handing commands and objects between the control and audio
+// threads. Storage is allocated once in the constructor; Push() and Pop()
+// never block or allocate.
+template <typename T>
+class SVSpscQueue {
+
+public:
+  // capacity is rounded up to the next power of two.
+  explicit SVSpscQueue(size_t capacity)
+    : capacity_(RoundUpToPowerOfTwo(capacity)),
+    mask_(capacity_ - 1),
+    items_(new T[capacity_]) {
+  }
+
+  // Producer side. False when the queue is full.
+  bool Push(const T& item) {
+    const size_t write_index = write_index_.load(std::memory_order_relaxed);
+    if (write_index - read_index_.load(std::memory_order_acquire) >= capacity_) {
+      return false;
+    }
+    items_[write_index & mask_] = item;
+    write_index_.store(write_index + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. False when the queue is empty.
+  bool Pop(T* item) {
+    const size_t read_index = read_index_.load(std::memory_order_relaxed);
+    if (read_index == write_index_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *item = items_[read_index & mask_];
+    read_index_.store(read_index + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Empty() const {
+    return read_index_.load(std::memory_order_acquire) == write_index_.load(std::memory_order_acquire);
+  }
+  size_t capacity() const { return capacity_; }
+
+private:
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+  }
+
+private:
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<T[]> items_;
+  // Same layout as SVRingBuffer: counters on separate cache lines.
+  std::atomic<size_t> write_index_ { 0 };
+  char write_padding_[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> read_index_ { 0 };
+  char read_padding_[64 - sizeof(std::atomic<size_t>)];
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_SPSC_QUEUE_H
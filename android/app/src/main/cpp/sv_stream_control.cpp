@@ -0,0 +1,195 @@
+#include "sv_stream_control.h"
+#include "sv_common.h"
+#include "sv_rt_log.h"
+#include "log.h"
+#include <chrono>
+#include <thread>
+
+namespace sv_render {
+
+namespace {
+
+constexpr uint32_t Bit(SVStreamState state) {
+  return 1u << static_cast<int>(state);
+}
+
+// Legal moves, indexed by the state they start from.
+constexpr uint32_t kLegalTransitions[] = {
+    // kClosed
+    Bit(SVStreamState::kOpening),
+    // kOpening
+    Bit(SVStreamState::kOpen) | Bit(SVStreamState::kClosed),
+    // kOpen
+    Bit(SVStreamState::kStarting) | Bit(SVStreamState::kClosing),
+    // kStarting
+    Bit(SVStreamState::kRunning) | Bit(SVStreamState::kOpen) | Bit(SVStreamState::kDrained),
+    // kRunning
+    Bit(SVStreamState::kPausing) | Bit(SVStreamState::kStopping) | Bit(SVStreamState::kDrained) |
+    Bit(SVStreamState::kRecovering),
+    // kPausing
+    Bit(SVStreamState::kPaused) | Bit(SVStreamState::kDrained),
+    // kPaused
+    Bit(SVStreamState::kStarting) | Bit(SVStreamState::kClosing) | Bit(SVStreamState::kRecovering),
+    // kDrained
+    Bit(SVStreamState::kClosing),
+    // kStopping
+    Bit(SVStreamState::kClosing),
+    // kClosing
+    Bit(SVStreamState::kClosed),
+    // kRecovering
+    Bit(SVStreamState::kRunning) | Bit(SVStreamState::kPaused) | Bit(SVStreamState::kDisconnected),
+    // kDisconnected
+    Bit(SVStreamState::kClosing),
+};
+static_assert(arraysize(kLegalTransitions) == SVStreamControl::kStateCount, "a row for every state");
+
+// Quiesce() checks for callbacks still inside this often.
+constexpr std::chrono::microseconds kQuiescePollInterval { 100 };
+
+} // namespace
+
+SVStreamControl::~SVStreamControl() {
+  if (started_.load()) {
+    SVRtLog::StreamStopped();
+  }
+}
+
+const char* SVStreamControl::StateName(SVStreamState state) {
+  static const char* names[] = {"closed", "opening", "open", "starting", "running", "pausing", "paused", "drained",
+                                "stopping", "closing", "recovering", "disconnected"};
+  const int index = static_cast<int>(state);
+  return index >= 0 && index < static_cast<int>(arraysize(names)) ? names[index] : "unknown";
+}
+
+bool SVStreamControl::IsLegal(SVStreamState from, SVStreamState to) {
+  const int index = static_cast<int>(from);
+  return index >= 0 && index < static_cast<int>(arraysize(kLegalTransitions)) &&
+         (kLegalTransitions[index] & Bit(to)) != 0;
+}
+
+bool SVStreamControl::Transition(SVStreamState from, SVStreamState to) {
+  if (!IsLegal(from, to)) {
+    AV_LOGE("SVStreamControl illegal transition %s -> %s.", StateName(from), StateName(to));
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  SVStreamState expected = from;
+  if (!state_.compare_exchange_strong(expected, to, std::memory_order_seq_cst)) {
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  transitions_.fetch_add(1, std::memory_order_relaxed);
+  // Callbacks may defer log records from the first start on, until the
+  // start failed or the stream was stopped.
+  if (to == SVStreamState::kStarting && !started_.exchange(true)) {
+    SVRtLog::StreamStarted();
+  } else if ((to == SVStreamState::kOpen || to == SVStreamState::kClosed) && started_.exchange(false)) {
+    SVRtLog::StreamStopped();
+  }
+  return true;
+}
+
+bool SVStreamControl::BeginStop(SVStreamState* previous) {
+  SVStreamState state = state_.load(std::memory_order_seq_cst);
+  while (true) {
+    SVStreamState target;
+    if (state == SVStreamState::kRunning) {
+      target = SVStreamState::kStopping;
+    } else if (state == SVStreamState::kOpen || state == SVStreamState::kPaused ||
+               state == SVStreamState::kDrained || state == SVStreamState::kDisconnected) {
+      target = SVStreamState::kClosing;
+    } else {
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    // On failure state holds what the stream moved to meanwhile.
+    if (state_.compare_exchange_weak(state, target, std::memory_order_seq_cst)) {
+      transitions_.fetch_add(1, std::memory_order_relaxed);
+      *previous = state;
+      return true;
+    }
+  }
+}
+
+bool SVStreamControl::Quiesce(int64_t timeout_ns) {
+  if (state_.load(std::memory_order_seq_cst) == SVStreamState::kStopping) {
+    Transition(SVStreamState::kStopping, SVStreamState::kClosing);
+  }
+  // A callback that got in before kClosing was stored is counted here; one
+  // that got in after reads kClosing. Both are sequentially consistent.
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeout_ns);
+  while (active_callbacks_.load(std::memory_order_seq_cst) > 0) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      AV_LOGW("SVStreamControl %d callbacks still running after %lld ms.",
+              active_callbacks_.load(std::memory_order_relaxed), (long long) (timeout_ns / 1000000));
+      return false;
+    }
+    std::this_thread::sleep_for(kQuiescePollInterval);
+  }
+  return true;
+}
+
+bool SVStreamControl::FinishStart() {
+  return Transition(SVStreamState::kStarting, SVStreamState::kRunning);
+}
+
+void SVStreamControl::FinishStop() {
+  Transition(SVStreamState::kClosing, SVStreamState::kClosed);
+}
+
+int SVStreamControl::Pause(SVGainStage* gain) {
+  if (!Transition(SVStreamState::kRunning, SVStreamState::kPausing)) {
+    AV_LOGW("Pause failed, stream %s.", StateName(state()));
+    return SV_PLAY_STATE_ERROR;
+  }
+  if (!gain->FadeOut()) {
+    AV_LOGW("Pause fade-out not rendered, pausing anyway.");
+  }
+  if (!Transition(SVStreamState::kPausing, SVStreamState::kPaused)) {
+    // The source ended during the fade.
+    AV_LOGW("Pause failed, stream %s.", StateName(state()));
+    return SV_PLAY_STATE_ERROR;
+  }
+  return SV_NO_ERROR;
+}
+
+int SVStreamControl::Resume(SVGainStage* gain) {
+  if (!Transition(SVStreamState::kPaused, SVStreamState::kStarting)) {
+    AV_LOGW("Resume failed, stream %s.", StateName(state()));
+    return SV_PLAY_STATE_ERROR;
+  }
+  gain->FadeIn();
+  FinishStart();
+  return SV_NO_ERROR;
+}
+
+void SVStreamControl::MarkDrained() {
+  SVStreamState state = state_.load(std::memory_order_seq_cst);
+  while (state == SVStreamState::kStarting || state == SVStreamState::kRunning ||
+         state == SVStreamState::kPausing) {
+    if (state_.compare_exchange_weak(state, SVStreamState::kDrained, std::memory_order_seq_cst)) {
+      transitions_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+}
+
+SVStreamControl::CallbackScope::CallbackScope(SVStreamControl* control)
+  : control_(control) {
+  control_->active_callbacks_.fetch_add(1, std::memory_order_seq_cst);
+  state_ = control_->state_.load(std::memory_order_seq_cst);
+  if (!render()) {
+    control_->silent_callbacks_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+SVStreamControl::CallbackScope::~CallbackScope() {
+  control_->active_callbacks_.fetch_sub(1, std::memory_order_release);
+}
+
+bool SVStreamControl::CallbackScope::render() const {
+  return state_ == SVStreamState::kStarting || state_ == SVStreamState::kRunning ||
+         state_ == SVStreamState::kPausing || state_ == SVStreamState::kStopping;
+}
+
+} // sv_render
@@ -0,0 +1,152 @@
+#ifndef AUDIO_PLAYOUT_SV_STREAM_CONTROL_H
+#define AUDIO_PLAYOUT_SV_STREAM_CONTROL_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace sv_render {
+
+class SVGainStage;
+
+// Lifecycle of a render stream, the same for every backend.
+enum class SVStreamState : int {
+  // Nothing open. InitAudioRender() comes next, StopPlayout() ends here.
+  kClosed,
+  // InitAudioRender() running.
+  kOpening,
+  // Initialized, StartPlayout() comes next.
+  kOpen,
+  // StartPlayout() or ResumePlayout() running, callbacks may already come.
+  kStarting,
+  kRunning,
+  // PausePlayout() fading out.
+  kPausing,
+  // Callbacks render silence and leave the source where it is.
+  kPaused,
+  // The source ended and the callback stopped the stream.
+  kDrained,
+  // StopPlayout() fading out.
+  kStopping,
+  // StopPlayout() tearing the stream down. Callbacks touch nothing but the
+  // control and render silence.
+  kClosing,
+  // The device went away, SVStreamRecovery is reopening the stream. Back
+  // to kRunning or kPaused once it did.
+  kRecovering,
+  // Recovery gave up. StopPlayout() comes next.
+  kDisconnected,
+};
+
+// Stream state shared by the control calls and the audio thread, and the
+// shutdown handshake between them.
+//
+// Each control call claims the stream with one compare-and-swap into a
+// transitional state (kOpening, kStarting, kPausing, kStopping) and leaves it
+// with another, so calls racing from several threads are ordered: the one
+// that loses finds the stream in a state it can't start from and fails
+// with SV_PLAY_STATE_ERROR. Callbacks read the state once, at their start,
+// in a CallbackScope, and never wait for the control side. StopPlayout()
+// moves to kClosing, after which new callbacks render silence, and
+// Quiesce() waits for the ones already inside before anything is torn down.
+class SVStreamControl {
+
+public:
+  // Bounds Quiesce() when a device stops calling back mid-callback.
+  static constexpr int64_t kQuiesceTimeoutNs = 500000000;
+  static constexpr int kStateCount = static_cast<int>(SVStreamState::kDisconnected) + 1;
+
+  ~SVStreamControl();
+
+  SVStreamState state() const { return state_.load(std::memory_order_seq_cst); }
+  static const char* StateName(SVStreamState state);
+  static bool IsLegal(SVStreamState from, SVStreamState to);
+
+  // Control side. Moves from -> to if the stream is in from; false if it
+  // is not, or the move is not a legal one.
+  bool Transition(SVStreamState from, SVStreamState to);
+
+  // Control side. Runs apply(), a setter of what the next InitAudioRender()
+  // reads, with the stream claimed like an init (kClosed -> kOpening and
+  // back), so an init racing it can't read the field half set. False, and
+  // apply() isn't run, once the stream is initialized or another call holds
+  // it.
+  template <typename Apply>
+  bool SetWhileClosed(Apply&& apply) {
+    if (!Transition(SVStreamState::kClosed, SVStreamState::kOpening)) {
+      return false;
+    }
+    apply();
+    Transition(SVStreamState::kOpening, SVStreamState::kClosed);
+    return true;
+  }
+
+  // Control side, the last move of a start or resume: kStarting ->
+  // kRunning. False if a short source drained while it ran, the stream is
+  // kDrained then and stays so.
+  bool FinishStart();
+
+  // Control side. Claims the stream for StopPlayout(): a running one moves
+  // to kStopping, so callbacks go on rendering its fade-out, any other open
+  // or disconnected one straight to kClosing. *previous is the state it left. False while
+  // another control call holds the stream, or nothing is open.
+  bool BeginStop(SVStreamState* previous);
+  // Control side, after BeginStop(). Moves to kClosing if still stopping
+  // and waits until no callback is inside the stream any more. False if
+  // one still was after timeout_ns.
+  bool Quiesce(int64_t timeout_ns = kQuiesceTimeoutNs);
+  // Control side. The stream is torn down, kClosing -> kClosed.
+  void FinishStop();
+
+  // Control side. Fade out over the gain stage's fade length, then hold
+  // the stream silent; ResumePlayout() fades back in. SV_RESULT codes.
+  int Pause(SVGainStage* gain);
+  int Resume(SVGainStage* gain);
+
+  // Audio thread. The source ended: kStarting, kRunning or kPausing ->
+  // kDrained. A start or pause still running then fails its last move.
+  void MarkDrained();
+
+  // Audio thread, around each callback. Marks the callback as inside the
+  // stream and takes the state it runs under.
+  class CallbackScope {
+
+  public:
+    explicit CallbackScope(SVStreamControl* control);
+    ~CallbackScope();
+    CallbackScope(const CallbackScope&) = delete;
+    CallbackScope& operator=(const CallbackScope&) = delete;
+
+    SVStreamState state() const { return state_; }
+    // Started and neither paused, stopped nor recovering: the callback may
+    // pull the source and run the gain stage. Otherwise it writes silence.
+    bool render() const;
+    // StopPlayout() is tearing the stream down, the callback must not touch
+    // anything but the buffer it was handed.
+    bool closing() const { return state_ == SVStreamState::kClosing; }
+
+  private:
+    SVStreamControl* const control_;
+    SVStreamState state_;
+  };
+
+  // Moves made, and control calls refused because the stream was in a
+  // state they can't start from.
+  uint64_t transitions() const { return transitions_.load(std::memory_order_relaxed); }
+  uint64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+  // Callbacks that found the stream paused or closing and rendered silence.
+  uint64_t silent_callbacks() const { return silent_callbacks_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<SVStreamState> state_ { SVStreamState::kClosed };
+  std::atomic<int> active_callbacks_ { 0 };
+  std::atomic<uint64_t> transitions_ { 0 };
+  std::atomic<uint64_t> rejected_ { 0 };
+  std::atomic<uint64_t> silent_callbacks_ { 0 };
+  // Between a start and the stream returning to kOpen or kClosed, while
+  // SVRtLog's drain polls for this stream.
+  std::atomic<bool> started_ { false };
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_STREAM_CONTROL_H
@@ -0,0 +1,138 @@
+#include "sv_stream_recovery.h"
+#include "sv_render_stats.h"
+#include "log.h"
+#include <chrono>
+
+namespace sv_render {
+
+namespace {
+
+// Delay before each retry of a failed reopen, the device may need a moment
+// to settle after a route change.
+constexpr int kRetryDelayMs[SVStreamRecovery::kMaxAttempts - 1] = {20, 50, 100, 200};
+// Claim() checks this often for a start or pause in flight to finish.
+constexpr std::chrono::milliseconds kClaimPollInterval { 1 };
+
+} // namespace
+
+SVStreamRecovery::SVStreamRecovery(SVStreamControl* control, SVRenderStats* stats, ReopenFunction reopen)
+  : control_(control),
+  stats_(stats),
+  reopen_(std::move(reopen)) {
+}
+
+SVStreamRecovery::~SVStreamRecovery() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+    cancel_.store(true);
+  }
+  cond_.notify_all();
+  // No thread if the stream never disconnected.
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void SVStreamRecovery::OnDisconnect() {
+  stats_->MarkDisconnected();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = true;
+    // Disconnects are rare, the thread starts with the first one and then
+    // stays for the render's lifetime.
+    if (!thread_.joinable() && !quit_) {
+      thread_ = std::thread(&SVStreamRecovery::ThreadLoop, this);
+    }
+  }
+  cond_.notify_all();
+}
+
+bool SVStreamRecovery::BeginStop(SVStreamState* previous) {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // A disconnect of the stream being stopped needs no recovery.
+      pending_ = false;
+      cancel_.store(busy_);
+      cond_.notify_all();
+      cond_.wait(lock, [this] { return !busy_; });
+      cancel_.store(false);
+    }
+    if (control_->BeginStop(previous)) {
+      return true;
+    }
+    // Only a recovery that claimed the stream meanwhile is worth waiting for.
+    if (control_->state() != SVStreamState::kRecovering) {
+      return false;
+    }
+  }
+}
+
+void SVStreamRecovery::ThreadLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cond_.wait(lock, [this] { return pending_ || quit_; });
+    if (quit_) {
+      break;
+    }
+    pending_ = false;
+    busy_ = true;
+    Recover(&lock);
+    busy_ = false;
+    cond_.notify_all();
+  }
+}
+
+void SVStreamRecovery::Recover(std::unique_lock<std::mutex>* lock) {
+  lock->unlock();
+  SVStreamState previous;
+  const bool claimed = Claim(&previous);
+  lock->lock();
+  if (!claimed) {
+    return;
+  }
+  AV_LOGW("SVStreamRecovery device disconnected, reopening the %s stream.", SVStreamControl::StateName(previous));
+  for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+    if (attempt > 0) {
+      cond_.wait_for(*lock, std::chrono::milliseconds(kRetryDelayMs[attempt - 1]),
+                     [this] { return cancel_.load() || quit_; });
+    }
+    if (cancel_.load() || quit_) {
+      break;
+    }
+    lock->unlock();
+    const bool reopened = reopen_();
+    lock->lock();
+    if (reopened) {
+      control_->Transition(SVStreamState::kRecovering, previous);
+      recoveries_.fetch_add(1, std::memory_order_relaxed);
+      AV_LOGI("SVStreamRecovery stream back after %d attempts.", attempt + 1);
+      return;
+    }
+    failed_attempts_.fetch_add(1, std::memory_order_relaxed);
+  }
+  AV_LOGE("SVStreamRecovery gave up, the stream stays disconnected.");
+  control_->Transition(SVStreamState::kRecovering, SVStreamState::kDisconnected);
+  failures_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SVStreamRecovery::Claim(SVStreamState* previous) {
+  while (!cancel_.load()) {
+    const SVStreamState state = control_->state();
+    if (state == SVStreamState::kRunning || state == SVStreamState::kPaused) {
+      if (control_->Transition(state, SVStreamState::kRecovering)) {
+        *previous = state;
+        return true;
+      }
+    } else if (state == SVStreamState::kStarting || state == SVStreamState::kPausing) {
+      std::this_thread::sleep_for(kClaimPollInterval);
+    } else {
+      AV_LOGI("SVStreamRecovery stream %s, nothing to recover.", SVStreamControl::StateName(state));
+      return false;
+    }
+  }
+  return false;
+}
+
+} // sv_render
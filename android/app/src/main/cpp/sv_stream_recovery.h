@@ -0,0 +1,85 @@
+#ifndef AUDIO_PLAYOUT_SV_STREAM_RECOVERY_H
+#define AUDIO_PLAYOUT_SV_STREAM_RECOVERY_H
+
+#include "sv_stream_control.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace sv_render {
+
+class SVRenderStats;
+
+// Brings a stream back after its device went away: a headset unplugged, a
+// route change, the audio server restarting.
+//
+// The device's error callback only calls OnDisconnect(). A thread of the
+// recovery's own, started by the first disconnect so that renders which
+// never lose their device hold none, then claims the stream, running or
+// paused, into kRecovering like any control call would, and has the backend
+// close the dead stream and open one on the current default device. The
+// source is not touched, so playback resumes at the frame it stopped at
+// with everything it had buffered; the backend only moves the source and
+// the gain stage to the new device's rate. A failed reopen is retried a few
+// times with a growing delay before the stream is left kDisconnected.
+class SVStreamRecovery {
+
+public:
+  // Backend, on the recovery thread while the stream is kRecovering: closes
+  // the dead stream, opens and starts a new one. Its callbacks render
+  // silence until the recovery hands the stream back. False if it failed.
+  using ReopenFunction = std::function<bool()>;
+
+  // Reopens tried per disconnect.
+  static constexpr int kMaxAttempts = 5;
+
+  SVStreamRecovery(SVStreamControl* control, SVRenderStats* stats, ReopenFunction reopen);
+  ~SVStreamRecovery();
+  SVStreamRecovery(const SVStreamRecovery&) = delete;
+  SVStreamRecovery& operator=(const SVStreamRecovery&) = delete;
+
+  // Any thread but a data callback, typically the device's error callback.
+  // Returns at once, the recovery runs on its own thread.
+  void OnDisconnect();
+
+  // Control side, in place of SVStreamControl::BeginStop(). A recovery in
+  // progress is cut short and waited for first, retries included.
+  bool BeginStop(SVStreamState* previous);
+
+  // Streams brought back, and disconnects given up on.
+  uint64_t recoveries() const { return recoveries_.load(std::memory_order_relaxed); }
+  uint64_t failures() const { return failures_.load(std::memory_order_relaxed); }
+  // Reopens that failed and were retried or given up on.
+  uint64_t failed_attempts() const { return failed_attempts_.load(std::memory_order_relaxed); }
+
+private:
+  void ThreadLoop();
+  void Recover(std::unique_lock<std::mutex>* lock);
+  // Claims a running or paused stream, waiting out a start or pause in
+  // flight. False if there is nothing to recover.
+  bool Claim(SVStreamState* previous);
+
+  SVStreamControl* const control_;
+  SVRenderStats* const stats_;
+  const ReopenFunction reopen_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool pending_ = false;
+  bool busy_ = false;
+  bool quit_ = false;
+  // Read by the recovery thread between the steps it takes unlocked.
+  std::atomic<bool> cancel_ { false };
+
+  std::atomic<uint64_t> recoveries_ { 0 };
+  std::atomic<uint64_t> failures_ { 0 };
+  std::atomic<uint64_t> failed_attempts_ { 0 };
+  // Started under mutex_ by the first OnDisconnect().
+  std::thread thread_;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_STREAM_RECOVERY_H
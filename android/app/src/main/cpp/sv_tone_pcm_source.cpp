@@ -0,0 +1,69 @@
+#include "sv_tone_pcm_source.h"
+#include <algorithm>
+#include <cmath>
+
+namespace sv_render {
+
+static constexpr double kTwoPi = 2.0 * M_PI;
+
+SVTonePcmSource::SVTonePcmSource(double frequency, double amplitude, int duration_ms)
+  : frequency_(frequency),
+  amplitude_(std::min(std::max(amplitude, 0.0), 1.0)),
+  duration_ms_(duration_ms) {
+}
+
+bool SVTonePcmSource::Prepare(int sample_rate, int channels) {
+  if (sample_rate <= 0 || channels <= 0) {
+    return false;
+  }
+  channels_ = channels;
+  phase_ = 0.0;
+  phase_increment_ = kTwoPi * frequency_ / sample_rate;
+  total_frames_ = duration_ms_ > 0 ? static_cast<int64_t>(sample_rate) * duration_ms_ / 1000 : -1;
+  rendered_frames_ = 0;
+  return true;
+}
+
+int SVTonePcmSource::FramesToRender(int num_frames) const {
+  if (total_frames_ < 0) {
+    return num_frames;
+  }
+  return static_cast<int>(std::min<int64_t>(num_frames, total_frames_ - rendered_frames_));
+}
+
+double SVTonePcmSource::NextSample() {
+  const double sample = std::sin(phase_) * amplitude_;
+  phase_ += phase_increment_;
+  if (phase_ >= kTwoPi) phase_ -= kTwoPi;
+  return sample;
+}
+
+int SVTonePcmSource::Render(int16_t* dst, int num_frames) {
+  const int frames = FramesToRender(num_frames);
+  for (int i = 0; i < frames; ++i) {
+    const auto sample = static_cast<int16_t>(std::lround(NextSample() * INT16_MAX));
+    for (int ch = 0; ch < channels_; ++ch) {
+      *dst++ = sample;
+    }
+  }
+  rendered_frames_ += frames;
+  return frames;
+}
+
+int SVTonePcmSource::RenderFloat(float* dst, int num_frames) {
+  const int frames = FramesToRender(num_frames);
+  for (int i = 0; i < frames; ++i) {
+    const auto sample = static_cast<float>(NextSample());
+    for (int ch = 0; ch < channels_; ++ch) {
+      *dst++ = sample;
+    }
+  }
+  rendered_frames_ += frames;
+  return frames;
+}
+
+bool SVTonePcmSource::IsEnd() const {
+  return total_frames_ >= 0 && rendered_frames_ >= total_frames_;
+}
+
+} // sv_render
@@ -0,0 +1,39 @@
+#ifndef AUDIO_PLAYOUT_SV_TONE_PCM_SOURCE_H
+#define AUDIO_PLAYOUT_SV_TONE_PCM_SOURCE_H
+
+#include "sv_pcm_source.h"
+
+namespace sv_render {
+
+// Generates a sine tone on every channel, for test signals and device checks.
+// duration_ms <= 0 plays forever.
+class SVTonePcmSource : public IPcmSource {
+
+public:
+  SVTonePcmSource(double frequency, double amplitude = 0.5, int duration_ms = 0);
+  ~SVTonePcmSource() override = default;
+
+  bool Prepare(int sample_rate, int channels) override;
+  int Render(int16_t* dst, int num_frames) override;
+  bool IsEnd() const override;
+  bool CanRenderFloat() const override { return true; }
+  int RenderFloat(float* dst, int num_frames) override;
+
+private:
+  int FramesToRender(int num_frames) const;
+  double NextSample();
+
+private:
+  const double frequency_;
+  const double amplitude_;
+  const int duration_ms_;
+  int channels_ = 0;
+  double phase_ = 0.0;
+  double phase_increment_ = 0.0;
+  int64_t total_frames_ = -1;
+  int64_t rendered_frames_ = 0;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_TONE_PCM_SOURCE_H
@@ -0,0 +1,402 @@
+#include "sv_virtual_render.h"
+#include "log.h"
+#include "sv_offline_render.h"
+#include "sv_rt_audit.h"
+#include <chrono>
+#include <cstring>
+#include <random>
+
+namespace sv_render {
+
+namespace {
+
+// WaitForCompletion() checks this often whether a recovery gave up.
+constexpr std::chrono::milliseconds kCompletionPollInterval { 10 };
+
+} // namespace
+
+SVVirtualDevice::SVVirtualDevice(double cold_start_ms)
+  : cold_start_ms_(cold_start_ms),
+  thread_(&SVVirtualDevice::ThreadLoop, this) {
+}
+
+SVVirtualDevice::~SVVirtualDevice() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  cond_.notify_all();
+  thread_.join();
+}
+
+void SVVirtualDevice::Run(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = std::move(job);
+    busy_ = true;
+  }
+  cond_.notify_all();
+}
+
+void SVVirtualDevice::Join() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this] { return !busy_; });
+}
+
+void SVVirtualDevice::ThreadLoop() {
+  bool cold = cold_start_ms_ > 0.0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cond_.wait(lock, [this] { return busy_ || quit_; });
+    if (quit_) {
+      break;
+    }
+    auto job = std::move(job_);
+    lock.unlock();
+    if (cold) {
+      std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(cold_start_ms_));
+      cold = false;
+    }
+    job();
+    lock.lock();
+    busy_ = false;
+    cond_.notify_all();
+  }
+}
+
+SVWarmPool<SVVirtualRender::DeviceKey, SVVirtualDevice>& SVVirtualRender::device_pool() {
+  static SVWarmPool<DeviceKey, SVVirtualDevice> pool;
+  return pool;
+}
+
+void SVVirtualRender::Prewarm(const SVVirtualDeviceConfig& config, int sample_rate, int channels,
+                              SV_SAMPLE_FORMAT format) {
+  std::unique_ptr<SVVirtualDevice> device(new SVVirtualDevice(config.cold_start_ms));
+  // An empty first job pays the cold start.
+  device->Run([] {});
+  device->Join();
+  device_pool().Put(DeviceKey(sample_rate, channels, format), std::move(device));
+}
+
+SVVirtualRender::SVVirtualRender(const std::string& file_path)
+  : SVVirtualRender(CreateFilePcmSource(file_path)) {
+}
+
+SVVirtualRender::SVVirtualRender(IPcmSource::Ptr source, const SVVirtualDeviceConfig& config)
+  : source_(std::make_shared<SVConvertingPcmSource>(config.realtime ? std::move(source)
+                                                                     : WaitingSource(std::move(source)))),
+  config_(config),
+  recovery_(&control_, &stats_, [this] { return ReopenDevice(); }) {
+  AV_LOGI("SVVirtualRender Construct.");
+}
+
+IPcmSource::Ptr SVVirtualRender::WaitingSource(IPcmSource::Ptr source) {
+  // With no clock to keep, an underrun would only write silence the content
+  // doesn't have. Gives up once StopPlayout() closes the stream.
+  return std::make_shared<SVBlockingPcmSource>(std::move(source), [this] {
+    return control_.state() == SVStreamState::kClosing;
+  });
+}
+
+SVVirtualRender::~SVVirtualRender() {
+  AV_LOGI("SVVirtualRender Destruct.");
+  if (control_.state() != SVStreamState::kClosed) {
+    StopPlayout();
+  }
+  source_->Release();
+}
+
+int SVVirtualRender::SetSampleFormat(SV_SAMPLE_FORMAT format) {
+  if (!control_.SetWhileClosed([&] { sample_format_ = format; })) {
+    AV_LOGW("SVVirtualRender set sample format failed, already initialized.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  return SV_NO_ERROR;
+}
+
+int SVVirtualRender::SetLatencyPolicy(SV_LATENCY_POLICY policy) {
+  if (!control_.SetWhileClosed([&] { latency_policy_ = policy; })) {
+    AV_LOGW("SVVirtualRender set latency policy failed, already initialized.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  return SV_NO_ERROR;
+}
+
+int SVVirtualRender::InitAudioRender(int sample_rate, int channels) {
+  AV_LOGI("SVVirtualRender init, sample_rate:%d, channels:%d, burst:%d", sample_rate, channels,
+          config_.frames_per_burst);
+  if (!control_.Transition(SVStreamState::kClosed, SVStreamState::kOpening)) {
+    AV_LOGW("SVVirtualRender init failed, stream %s.", SVStreamControl::StateName(control_.state()));
+    return SV_PLAY_STATE_ERROR;
+  }
+  if (sample_rate <= 0 || channels <= 0 || config_.frames_per_burst <= 0) {
+    AV_LOGE("SVVirtualRender invalid configuration.");
+    control_.Transition(SVStreamState::kOpening, SVStreamState::kClosed);
+    return SV_PLAY_INIT_ERROR;
+  }
+  if (!config_.output_path.empty()) {
+    sink_ = fopen(config_.output_path.c_str(), "wb");
+    if (!sink_) {
+      AV_LOGE("SVVirtualRender open sink failed: %s", config_.output_path.c_str());
+      control_.Transition(SVStreamState::kOpening, SVStreamState::kClosed);
+      return SV_PLAY_INIT_ERROR;
+    }
+  }
+  // Like a real device, the stream runs at the native rate and the content is
+  // converted to it.
+  const int device_rate = config_.sample_rate > 0 ? config_.sample_rate : sample_rate;
+  const int device_channels = config_.channels > 0 ? config_.channels : channels;
+  source_->SetSourceSampleRate(sample_rate);
+  source_->SetSourceChannels(channels);
+  if (!source_->Prepare(device_rate, device_channels)) {
+    AV_LOGE("SVVirtualRender prepare pcm source failed.");
+    if (sink_) {
+      fclose(sink_);
+      sink_ = nullptr;
+    }
+    control_.Transition(SVStreamState::kOpening, SVStreamState::kClosed);
+    return SV_PLAY_INIT_ERROR;
+  }
+
+  sample_rate_ = device_rate;
+  channels_ = device_channels;
+  stats_.Reset(device_rate);
+  gain_.Prepare(device_rate);
+  // Sized for float, int16 bursts use the front half.
+  device_buffer_.reset(new float[config_.frames_per_burst * device_channels]);
+  // Like AAudio, an untuned buffer stays at its full capacity.
+  const int capacity = config_.buffer_capacity_bursts * config_.frames_per_burst;
+  const int buffer_size = latency_tuner_.Reset(latency_policy_, config_.frames_per_burst, capacity);
+  buffer_size_frames_.store(buffer_size > 0 ? buffer_size : capacity, std::memory_order_relaxed);
+  xrun_count_.store(0, std::memory_order_relaxed);
+  buffer_frames_sum_.store(0, std::memory_order_relaxed);
+  if (capacity > 0) {
+    AV_LOGI("SVVirtualRender buffer capacity: %d frames, size: %d frames.", capacity, buffer_size_frames());
+  }
+  device_ = device_pool().Take(DeviceKey(sample_rate_, channels_, sample_format_));
+  if (!device_) {
+    device_.reset(new SVVirtualDevice(config_.cold_start_ms));
+  }
+  control_.Transition(SVStreamState::kOpening, SVStreamState::kOpen);
+  return SV_NO_ERROR;
+}
+
+int SVVirtualRender::StartPlayout() {
+  AV_LOGI("SVVirtualRender start playout.");
+  if (!control_.Transition(SVStreamState::kOpen, SVStreamState::kStarting)) {
+    AV_LOGW("SVVirtualRender start failed, stream %s.", SVStreamControl::StateName(control_.state()));
+    return SV_PLAY_STATE_ERROR;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = false;
+  }
+  stats_.MarkStartRequested();
+  gain_.FadeIn();
+  device_->Run([this] { DeviceThreadLoop(); });
+  control_.FinishStart();
+  return SV_NO_ERROR;
+}
+
+int SVVirtualRender::StopPlayout() {
+  AV_LOGI("SVVirtualRender stop playout.");
+  SVStreamState previous;
+  if (!recovery_.BeginStop(&previous)) {
+    AV_LOGW("SVVirtualRender stop failed, stream %s.", SVStreamControl::StateName(control_.state()));
+    return SV_PLAY_STATE_ERROR;
+  }
+  // The device keeps pulling until the fade-out is in the sink.
+  faded_out_ = previous == SVStreamState::kRunning && gain_.FadeOut();
+  // Closing ends the device loop after the callback in flight.
+  control_.Quiesce();
+  // None after a recovery that gave up.
+  if (device_) {
+    device_->Join();
+    device_pool().Put(DeviceKey(sample_rate_, channels_, sample_format_), std::move(device_));
+  }
+  source_->Release();
+  if (sink_) {
+    fclose(sink_);
+    sink_ = nullptr;
+  }
+  auto stats = stats_.Snapshot();
+  AV_LOGI("SVVirtualRender stop playout end, callbacks:%lld, frames:%lld, underruns:%lld, xruns:%lld",
+          (long long) stats.callback_count, (long long) stats.frames_rendered, (long long) stats.underrun_count,
+          (long long) xrun_count());
+  control_.FinishStop();
+  return SV_NO_ERROR;
+}
+
+int SVVirtualRender::PausePlayout() {
+  AV_LOGI("SVVirtualRender pause playout.");
+  return control_.Pause(&gain_);
+}
+
+int SVVirtualRender::ResumePlayout() {
+  AV_LOGI("SVVirtualRender resume playout.");
+  return control_.Resume(&gain_);
+}
+
+int SVVirtualRender::SetGain(float gain, int ramp_ms, SVGainCurve curve) {
+  gain_.SetGain(gain, ramp_ms, curve);
+  return SV_NO_ERROR;
+}
+
+int SVVirtualRender::GetStats(SVRenderStatsSnapshot* stats) {
+  if (sample_rate_ <= 0) {
+    AV_LOGW("SVVirtualRender get stats failed, not initialized.");
+    return SV_PLAY_STATE_ERROR;
+  }
+  *stats = stats_.Snapshot();
+  stats->xrun_count = xrun_count();
+  stats->output_latency_ms = 1000.0 * device_queued_frames() / sample_rate_;
+  return SV_NO_ERROR;
+}
+
+int SVVirtualRender::device_queued_frames() const {
+  // Without a simulated buffer each burst plays as soon as the callback returns it.
+  return config_.buffer_capacity_bursts > 0 ? buffer_size_frames() : config_.frames_per_burst;
+}
+
+double SVVirtualRender::average_buffer_frames() const {
+  const int64_t callbacks = stats_.Snapshot().callback_count;
+  return callbacks > 0 ? static_cast<double>(buffer_frames_sum_.load(std::memory_order_relaxed)) / callbacks : 0.0;
+}
+
+void SVVirtualRender::WaitForCompletion() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Nothing signals a recovery that gave up, it is polled for.
+  while (!cond_.wait_for(lock, kCompletionPollInterval, [this] {
+    return finished_ || control_.state() == SVStreamState::kDisconnected;
+  })) {
+  }
+}
+
+bool SVVirtualRender::ReopenDevice() {
+  // The dead device's loop has returned. It isn't parked: a device that
+  // went away must not be handed to the next stream.
+  if (device_) {
+    device_->Join();
+    device_.reset();
+  }
+  if (reopen_failures_left_ > 0) {
+    --reopen_failures_left_;
+    AV_LOGW("SVVirtualRender reopen failed, no device yet.");
+    return false;
+  }
+  const int device_rate = config_.reconnect_sample_rate > 0 ? config_.reconnect_sample_rate : sample_rate_.load();
+  if (device_rate != sample_rate_) {
+    AV_LOGI("SVVirtualRender device back at %d Hz, was %d Hz.", device_rate, sample_rate_.load());
+    if (!source_->SetStreamSampleRate(device_rate)) {
+      return false;
+    }
+    sample_rate_ = device_rate;
+  }
+  stats_.Restart(device_rate);
+  gain_.Restart(device_rate);
+  // A new device, so it starts cold.
+  device_.reset(new SVVirtualDevice(config_.cold_start_ms));
+  device_->Run([this] { DeviceThreadLoop(); });
+  return true;
+}
+
+bool SVVirtualRender::DataCallback(void* audio_data, int num_frames) {
+  SVRtAuditScope audit_scope;
+  SVStreamControl::CallbackScope control_scope(&control_);
+  if (!control_scope.render()) {
+    // Paused the device keeps pulling silence, closing it stops after this.
+    if (!control_scope.closing()) {
+      stats_.MarkDeviceCallback();
+    }
+    memset(audio_data, 0, num_frames * BytesPerFrame());
+    return true;
+  }
+  stats_.MarkDeviceCallback();
+  // What a real device's timestamps would tell, known exactly here.
+  source_->SetDeviceLatency(static_cast<double>(device_queued_frames()) / sample_rate_);
+  const bool keep_going = sample_format_ == SV_SAMPLE_FORMAT_FLOAT
+          ? RenderPcmSource(source_.get(), static_cast<float*>(audio_data), num_frames, channels_, &stats_, &gain_)
+          : RenderPcmSource(source_.get(), static_cast<int16_t*>(audio_data), num_frames, channels_, &stats_,
+                            &gain_);
+  if (!keep_going) {
+    control_.MarkDrained();
+    // Deferred like any log from a callback, see SVRtLog.
+    AV_LOGI("SVVirtualRender source drained after %lld frames, stopping the stream.",
+            (long long) stats_.Snapshot().frames_rendered);
+  }
+  return keep_going;
+}
+
+size_t SVVirtualRender::BytesPerFrame() const {
+  return channels_ * (sample_format_ == SV_SAMPLE_FORMAT_FLOAT ? sizeof(float) : sizeof(int16_t));
+}
+
+void SVVirtualRender::DeviceThreadLoop() {
+  using Clock = std::chrono::steady_clock;
+  const int burst = config_.frames_per_burst;
+  // Wall-clock period, the device's own clock ticks at its nominal rate.
+  const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+          static_cast<double>(burst) / sample_rate_ / (1.0 + config_.clock_skew_ppm * 1e-6)));
+  std::mt19937 random(config_.seed);
+  std::uniform_real_distribution<double> jitter(0.0, config_.jitter_ms);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const int64_t period_ns = static_cast<int64_t>(burst) * 1000000000LL / sample_rate_;
+  const int64_t disconnect_ns = static_cast<int64_t>(config_.disconnect_after_ms * 1e6);
+  // Device clock: when each callback is due. Runs ahead of the wall clock in
+  // fast mode, so the simulated buffer behaves the same either way.
+  int64_t device_time_ns = 0;
+
+  auto next_callback = Clock::now();
+  while (control_.state() != SVStreamState::kClosing) {
+    double lateness_ms = jitter(random);
+    if (config_.stall_probability > 0.0 && uniform(random) < config_.stall_probability) {
+      lateness_ms += config_.stall_ms;
+    }
+    device_time_ns += period_ns;
+    if (config_.realtime) {
+      next_callback += period;
+      const auto lateness = std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<double, std::milli>(lateness_ms));
+      std::this_thread::sleep_until(next_callback + lateness);
+    }
+    if (config_.buffer_capacity_bursts > 0) {
+      // The device plays the buffered frames while the callback is late,
+      // once they run out it underruns.
+      const int64_t lateness_ns = static_cast<int64_t>(lateness_ms * 1e6);
+      const int buffer_size = buffer_size_frames();
+      if (lateness_ns > static_cast<int64_t>(buffer_size) * 1000000000LL / sample_rate_) {
+        xrun_count_.fetch_add(1, std::memory_order_relaxed);
+      }
+      buffer_frames_sum_.fetch_add(buffer_size, std::memory_order_relaxed);
+      const int new_size = latency_tuner_.Update(xrun_count(), device_time_ns + lateness_ns);
+      if (new_size > 0) {
+        buffer_size_frames_.store(new_size, std::memory_order_relaxed);
+      }
+    }
+
+    const bool keep_going = DataCallback(device_buffer_.get(), burst);
+    // The "device" consumes the burst outside of the callback.
+    if (sink_) {
+      fwrite(device_buffer_.get(), BytesPerFrame(), burst, sink_);
+    }
+    if (!keep_going) {
+      break;
+    }
+    if (disconnect_ns > 0 && device_time_ns >= disconnect_ns) {
+      // Gone like an unplugged headset: no more callbacks, and the stream
+      // isn't finished, the recovery reopens it on a new device.
+      AV_LOGW("SVVirtualRender device disconnected after %lld ms.", (long long) (device_time_ns / 1000000));
+      reopen_failures_left_ = config_.reconnect_failures;
+      recovery_.OnDisconnect();
+      return;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+  }
+  cond_.notify_all();
+}
+
+} // sv_render
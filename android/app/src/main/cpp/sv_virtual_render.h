@@ -0,0 +1,176 @@
+#ifndef AUDIO_PLAYOUT_SV_VIRTUAL_RENDER_H
+#define AUDIO_PLAYOUT_SV_VIRTUAL_RENDER_H
+
+#include "sv_common.h"
+#include "sv_pcm_source.h"
+#include "sv_converting_pcm_source.h"
+#include "sv_latency_tuner.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include "sv_stream_recovery.h"
+#include "sv_warm_pool.h"
+
+namespace sv_render {
+
+struct SVVirtualDeviceConfig {
+  // Frames handed to each data callback.
+  int frames_per_burst = 192;
+  // Native rate and channel count of the simulated device, 0 follows the content.
+  int sample_rate = 0;
+  int channels = 0;
+  // Each callback fires up to this much later than its ideal time.
+  double jitter_ms = 0.0;
+  // Now and then the callback thread stalls this much longer, like an app
+  // thread that got preempted.
+  double stall_probability = 0.0;
+  double stall_ms = 0.0;
+  // Simulated device buffer, in bursts, sized by the latency policy like an
+  // AAudio stream's. A callback later than the buffered audio counts as an
+  // xrun. 0 plays each burst as soon as the callback returns it.
+  int buffer_capacity_bursts = 0;
+  // A newly opened device waits this long before its first callback, like a
+  // HAL bringing up its output path. Devices reused from the warm pool don't.
+  double cold_start_ms = 0.0;
+  // Each device disconnects after this much of its playback, like a headset
+  // being unplugged, 0 never. The stream recovers onto a new device, at
+  // reconnect_sample_rate if set, after reconnect_failures failed reopens.
+  double disconnect_after_ms = 0.0;
+  int reconnect_sample_rate = 0;
+  int reconnect_failures = 0;
+  // The device's clock runs this many ppm fast, or slow if negative, against
+  // the wall clock, like a crystal off its nominal rate.
+  double clock_skew_ppm = 0.0;
+  // Pace callbacks to the wall clock. When false the device pulls bursts as
+  // fast as the callback returns, for load tests and profiling; a callback
+  // then waits for content decoding in the background rather than writing
+  // silence, like an offline render.
+  bool realtime = true;
+  // Raw PCM sink in the stream's sample format, empty renders into a null sink.
+  std::string output_path;
+  uint32_t seed = 1;
+};
+
+// Callback thread of a simulated device. Opening one costs the config's
+// cold_start_ms before its first job runs; once a stream stops, the device
+// is parked in SVVirtualRender's warm pool and the next stream with the same
+// layout starts on it right away.
+class SVVirtualDevice {
+
+public:
+  explicit SVVirtualDevice(double cold_start_ms);
+  ~SVVirtualDevice();
+  SVVirtualDevice(const SVVirtualDevice&) = delete;
+  SVVirtualDevice& operator=(const SVVirtualDevice&) = delete;
+
+  // Runs job on the device thread and returns at once, one job at a time.
+  void Run(std::function<void()> job);
+  // Blocks until the job passed to Run() returned.
+  void Join();
+
+private:
+  void ThreadLoop();
+
+  const double cold_start_ms_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::function<void()> job_;
+  bool busy_ = false;
+  bool quit_ = false;
+  std::thread thread_;
+};
+
+// Render backend against a simulated output device: a thread that fires the
+// data callback every burst on a jittery clock and writes what it gets to a
+// file or a null sink. Builds on any POSIX host, so the source and buffering
+// logic can run without a phone.
+class SVVirtualRender : public INativeAudioRender {
+
+public:
+  explicit SVVirtualRender(const std::string& file_path);
+  explicit SVVirtualRender(IPcmSource::Ptr source, const SVVirtualDeviceConfig& config = SVVirtualDeviceConfig());
+  ~SVVirtualRender() override;
+  int SetSampleFormat(SV_SAMPLE_FORMAT format) override;
+  int SetLatencyPolicy(SV_LATENCY_POLICY policy) override;
+  int InitAudioRender(int sample_rate, int channels) override;
+  int StartPlayout() override;
+  int StopPlayout() override;
+  int PausePlayout() override;
+  int ResumePlayout() override;
+  int SetGain(float gain, int ramp_ms, SVGainCurve curve) override;
+  int GetStats(SVRenderStatsSnapshot* stats) override;
+
+  // Blocks until the callback stops the stream or StopPlayout() is called.
+  void WaitForCompletion();
+  // Rate the device runs at once initialized.
+  int device_sample_rate() const { return sample_rate_; }
+  // Simulated device buffer, see SVVirtualDeviceConfig::buffer_capacity_bursts.
+  int64_t xrun_count() const { return xrun_count_.load(std::memory_order_relaxed); }
+  int buffer_size_frames() const { return buffer_size_frames_.load(std::memory_order_relaxed); }
+  // Buffer size averaged over the callbacks so far.
+  double average_buffer_frames() const;
+  const SVLatencyTuner& latency_tuner() const { return latency_tuner_; }
+  // Fade length and counters. Whether the last stop rendered its fade-out.
+  SVGainStage& gain_stage() { return gain_; }
+  bool faded_out() const { return faded_out_; }
+  const SVStreamControl& stream_control() const { return control_; }
+  const SVStreamRecovery& recovery() const { return recovery_; }
+
+  // Opens a device for streams of this layout and parks it warm, so the next
+  // such stream skips the cold start. Layout as the device runs it.
+  static void Prewarm(const SVVirtualDeviceConfig& config, int sample_rate, int channels, SV_SAMPLE_FORMAT format);
+  // Devices parked by stopped streams or Prewarm().
+  using DeviceKey = std::tuple<int, int, int>;
+  static SVWarmPool<DeviceKey, SVVirtualDevice>& device_pool();
+
+private:
+  void DeviceThreadLoop();
+  bool DataCallback(void* audio_data, int num_frames);
+  // SVStreamRecovery's reopen, the disconnected device is replaced by a new one.
+  bool ReopenDevice();
+  size_t BytesPerFrame() const;
+  // Fast mode, the content wrapped to wait out its underruns.
+  IPcmSource::Ptr WaitingSource(IPcmSource::Ptr source);
+  // Frames a burst waits in the device once the callback returned it.
+  int device_queued_frames() const;
+
+private:
+  // Converts the content to the device rate.
+  std::shared_ptr<SVConvertingPcmSource> source_;
+  SVRenderStats stats_;
+  SVGainStage gain_;
+  SVStreamControl control_;
+  bool faded_out_ = false;
+  const SVVirtualDeviceConfig config_;
+  // Changes when a recovery reopens at another rate.
+  std::atomic<int> sample_rate_ { 0 };
+  int channels_ = 0;
+  SV_SAMPLE_FORMAT sample_format_ = SV_SAMPLE_FORMAT_I16;
+  SV_LATENCY_POLICY latency_policy_ = SV_LATENCY_POLICY_BALANCED;
+  SVLatencyTuner latency_tuner_;
+  std::atomic<int> buffer_size_frames_ { 0 };
+  std::atomic<int64_t> xrun_count_ { 0 };
+  std::atomic<int64_t> buffer_frames_sum_ { 0 };
+  FILE* sink_ = nullptr;
+  // Device-owned buffer, like the one AAudio/Oboe pass to their callbacks.
+  std::unique_ptr<float[]> device_buffer_;
+
+  // From the warm pool or newly opened at init, back to the pool at stop.
+  std::unique_ptr<SVVirtualDevice> device_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool finished_ = true;
+  // Reopens still to fail for the current disconnect.
+  int reopen_failures_left_ = 0;
+  // Last, its thread reopens with everything above.
+  SVStreamRecovery recovery_;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_VIRTUAL_RENDER_H
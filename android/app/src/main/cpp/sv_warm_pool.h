@@ -0,0 +1,109 @@
+#ifndef AUDIO_PLAYOUT_SV_WARM_POOL_H
+#define AUDIO_PLAYOUT_SV_WARM_POOL_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sv_render {
+
+// Keeps expensive-to-open objects, e.g. device streams or players, parked
+// for reuse instead of destroyed, so the next render with the same
+// configuration skips the setup. Objects are grouped by Key; at most
+// max_per_key of each are kept, the rest are destroyed on Put().
+//
+// Control threads only, it takes a lock.
+template <typename Key, typename T>
+class SVWarmPool {
+
+public:
+  explicit SVWarmPool(int max_per_key = 1) : max_per_key_(max_per_key) {}
+  SVWarmPool(const SVWarmPool&) = delete;
+  SVWarmPool& operator=(const SVWarmPool&) = delete;
+
+  // A parked object for key, nullptr if there is none.
+  std::unique_ptr<T> Take(const Key& key) {
+    return Take(key, [](const T&) { return true; });
+  }
+
+  // A parked object for key that usable() accepts. The ones it turns down on
+  // the way, e.g. streams whose device went away while they were parked, are
+  // destroyed.
+  template <typename Usable>
+  std::unique_ptr<T> Take(const Key& key, Usable usable) {
+    // Destroyed once the lock is released.
+    std::vector<std::unique_ptr<T>> rejected;
+    std::unique_ptr<T> object;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto range = parked_.equal_range(key);
+    for (auto it = range.first; it != range.second && !object;) {
+      if (usable(*it->second)) {
+        object = std::move(it->second);
+      } else {
+        rejected.push_back(std::move(it->second));
+      }
+      it = parked_.erase(it);
+    }
+    object ? ++hits_ : ++misses_;
+    evicted_ += static_cast<int64_t>(rejected.size());
+    return object;
+  }
+
+  // Parks the object, or destroys it if key already has max_per_key parked.
+  // Returns whether it was kept.
+  bool Put(const Key& key, std::unique_ptr<T> object) {
+    if (!object) {
+      return false;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (static_cast<int>(parked_.count(key)) >= max_per_key_) {
+      lock.unlock();
+      object.reset();
+      return false;
+    }
+    parked_.emplace(key, std::move(object));
+    return true;
+  }
+
+  // Destroys everything parked.
+  void Clear() {
+    std::multimap<Key, std::unique_ptr<T>> parked;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      parked.swap(parked_);
+    }
+  }
+
+  int size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(parked_.size());
+  }
+  // Take() calls that found, or didn't find, a parked object.
+  int64_t hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+  }
+  int64_t misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+  }
+  // Parked objects Take() turned down as no longer usable.
+  int64_t evicted() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return evicted_;
+  }
+
+private:
+  const int max_per_key_;
+  mutable std::mutex mutex_;
+  std::multimap<Key, std::unique_ptr<T>> parked_;
+  int64_t hits_ = 0;
+  int64_t misses_ = 0;
+  int64_t evicted_ = 0;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_WARM_POOL_H
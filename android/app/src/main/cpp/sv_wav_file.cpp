@@ -0,0 +1,426 @@
+#include "sv_wav_file.h"
+#include "sv_sample_convert.h"
+#include "log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace sv_render {
+
+namespace {
+
+constexpr uint16_t kFormatPcm = 0x0001;
+constexpr uint16_t kFormatFloat = 0x0003;
+constexpr uint16_t kFormatImaAdpcm = 0x0011;
+constexpr uint16_t kFormatExtensible = 0xfffe;
+constexpr int kMaxChannels = 8;
+// Frames per ReadBlock() for the PCM encodings.
+constexpr int kPcmReadFrames = 1024;
+// Default IMA-ADPCM block, 256 bytes per channel as most encoders write.
+constexpr int kAdpcmBlockBytesPerChannel = 256;
+
+uint16_t ReadLE16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLE32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void AppendTag(std::vector<uint8_t>* out, const char* tag) {
+  out->insert(out->end(), tag, tag + 4);
+}
+
+void AppendLE16(std::vector<uint8_t>* out, uint32_t value) {
+  out->push_back(static_cast<uint8_t>(value & 0xff));
+  out->push_back(static_cast<uint8_t>((value >> 8) & 0xff));
+}
+
+void AppendLE32(std::vector<uint8_t>* out, uint32_t value) {
+  AppendLE16(out, value & 0xffff);
+  AppendLE16(out, value >> 16);
+}
+
+bool WriteLE32At(FILE* file, long offset, uint32_t value) {
+  std::vector<uint8_t> bytes;
+  AppendLE32(&bytes, value);
+  return fseek(file, offset, SEEK_SET) == 0 && fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+}
+
+} // namespace
+
+const char* SVWavEncodingName(SVWavEncoding encoding) {
+  switch (encoding) {
+    case SVWavEncoding::kPcm16: return "pcm16";
+    case SVWavEncoding::kFloat32: return "float32";
+    case SVWavEncoding::kImaAdpcm: return "ima_adpcm";
+  }
+  return "unknown";
+}
+
+// ==== SVWavFile. ====
+
+SVWavFile::SVWavFile(const std::string& file_path) {
+  file_ = fopen(file_path.c_str(), "rb");
+  if (!file_) {
+    AV_LOGE("SVWavFile open failed: %s", file_path.c_str());
+    return;
+  }
+  if (!ParseHeader()) {
+    AV_LOGE("SVWavFile unsupported file: %s", file_path.c_str());
+    fclose(file_);
+    file_ = nullptr;
+    return;
+  }
+  frames_per_read_ = format_.encoding == SVWavEncoding::kImaAdpcm ? format_.frames_per_block : kPcmReadFrames;
+  block_.resize(format_.block_align);
+  pcm_.resize(static_cast<size_t>(frames_per_read_) * format_.channels);
+  AV_LOGI("SVWavFile %s, %d Hz, %d channels, %lld frames.", SVWavEncodingName(format_.encoding),
+          format_.sample_rate, format_.channels, (long long) format_.total_frames);
+}
+
+SVWavFile::~SVWavFile() {
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+bool SVWavFile::ParseHeader() {
+  uint8_t riff[12];
+  if (fread(riff, 1, sizeof(riff), file_) != sizeof(riff) || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+    return false;
+  }
+  std::vector<uint8_t> fmt;
+  int64_t fact_frames = -1;
+  while (true) {
+    uint8_t chunk[8];
+    if (fread(chunk, 1, sizeof(chunk), file_) != sizeof(chunk)) {
+      return false;
+    }
+    const uint32_t size = ReadLE32(chunk + 4);
+    if (!memcmp(chunk, "data", 4)) {
+      data_offset_ = ftell(file_);
+      data_size_ = size;
+      break;
+    }
+    // Chunks are padded to an even size.
+    long skip = static_cast<long>(size) + (size & 1);
+    if (!memcmp(chunk, "fmt ", 4) || !memcmp(chunk, "fact", 4)) {
+      std::vector<uint8_t> body(std::min<uint32_t>(size, 64));
+      if (fread(body.data(), 1, body.size(), file_) != body.size()) {
+        return false;
+      }
+      skip -= static_cast<long>(body.size());
+      if (chunk[0] == 'f' && chunk[1] == 'm') {
+        fmt = std::move(body);
+      } else if (body.size() >= 4) {
+        fact_frames = ReadLE32(body.data());
+      }
+    }
+    if (fseek(file_, skip, SEEK_CUR) != 0) {
+      return false;
+    }
+  }
+  if (fmt.size() < 16) {
+    AV_LOGE("SVWavFile missing fmt chunk.");
+    return false;
+  }
+
+  uint16_t tag = ReadLE16(fmt.data());
+  format_.channels = ReadLE16(fmt.data() + 2);
+  format_.sample_rate = static_cast<int>(ReadLE32(fmt.data() + 4));
+  format_.block_align = ReadLE16(fmt.data() + 12);
+  const int bits = ReadLE16(fmt.data() + 14);
+  const int extra_size = fmt.size() >= 18 ? ReadLE16(fmt.data() + 16) : 0;
+  if (tag == kFormatExtensible && fmt.size() >= 26) {
+    // The sub-format GUID starts with the plain format tag.
+    tag = ReadLE16(fmt.data() + 24);
+  }
+  if (format_.channels <= 0 || format_.channels > kMaxChannels || format_.sample_rate <= 0 ||
+      format_.block_align <= 0) {
+    return false;
+  }
+
+  if (tag == kFormatPcm && bits == 16 && format_.block_align == 2 * format_.channels) {
+    format_.encoding = SVWavEncoding::kPcm16;
+  } else if (tag == kFormatFloat && bits == 32 && format_.block_align == 4 * format_.channels) {
+    format_.encoding = SVWavEncoding::kFloat32;
+  } else if (tag == kFormatImaAdpcm && bits == 4) {
+    format_.encoding = SVWavEncoding::kImaAdpcm;
+    const int max_frames = SVImaAdpcmFramesPerBlock(format_.block_align, format_.channels);
+    format_.frames_per_block = extra_size >= 2 && fmt.size() >= 20 ? ReadLE16(fmt.data() + 18) : max_frames;
+    if (format_.frames_per_block <= 0 || format_.frames_per_block > max_frames) {
+      return false;
+    }
+  } else {
+    AV_LOGE("SVWavFile format tag 0x%04x with %d bits not supported.", tag, bits);
+    return false;
+  }
+
+  // Streamed writers leave the data size at 0 or ~0, the data runs to the end.
+  long file_size = 0;
+  if (fseek(file_, 0, SEEK_END) == 0) file_size = ftell(file_);
+  if (data_size_ == 0 || data_offset_ + data_size_ > file_size) {
+    data_size_ = std::max<int64_t>(file_size - data_offset_, 0);
+  }
+  const int64_t blocks = data_size_ / format_.block_align;
+  format_.total_frames = blocks * format_.frames_per_block;
+  if (format_.encoding == SVWavEncoding::kImaAdpcm) {
+    const int64_t tail = data_size_ % format_.block_align;
+    if (tail >= 4 * format_.channels) {
+      format_.total_frames += 1 + (tail - 4 * format_.channels) / (4 * format_.channels) * 8;
+    }
+    // The fact chunk trims the padding of the last block.
+    if (fact_frames >= 0) format_.total_frames = std::min(format_.total_frames, fact_frames);
+  }
+  return fseek(file_, static_cast<long>(data_offset_), SEEK_SET) == 0;
+}
+
+int SVWavFile::ReadBlock(float* dst) {
+  const int64_t remaining = format_.total_frames - read_frames_;
+  if (!file_ || remaining <= 0) {
+    return 0;
+  }
+  const int channels = format_.channels;
+  int wanted = static_cast<int>(std::min<int64_t>(frames_per_read_, remaining));
+  int frames = 0;
+  switch (format_.encoding) {
+    case SVWavEncoding::kPcm16:
+      frames = static_cast<int>(fread(pcm_.data(), format_.block_align, wanted, file_));
+      SVInt16ToFloat(pcm_.data(), dst, frames * channels);
+      break;
+    case SVWavEncoding::kFloat32:
+      frames = static_cast<int>(fread(dst, format_.block_align, wanted, file_));
+      break;
+    case SVWavEncoding::kImaAdpcm: {
+      const size_t bytes = fread(block_.data(), 1, block_.size(), file_);
+      frames = std::min(wanted, SVImaAdpcmDecodeBlock(block_.data(), bytes, channels, format_.frames_per_block,
+                                                      pcm_.data()));
+      // Only ADPCM blocks hold more than one frame, so only they start early.
+      const int skip = std::min(skip_frames_, frames);
+      SVInt16ToFloat(pcm_.data() + skip * channels, dst, (frames - skip) * channels);
+      skip_frames_ = 0;
+      read_frames_ += skip;
+      frames -= skip;
+      wanted -= skip;
+      break;
+    }
+  }
+  if (frames < wanted) {
+    AV_LOGW("SVWavFile data truncated at frame %lld.", (long long) (read_frames_ + frames));
+    read_frames_ = format_.total_frames;
+    return frames;
+  }
+  read_frames_ += frames;
+  return frames;
+}
+
+bool SVWavFile::Rewind() {
+  return Seek(0);
+}
+
+bool SVWavFile::Seek(int64_t frame) {
+  if (!file_) {
+    return false;
+  }
+  frame = std::max<int64_t>(0, std::min(frame, format_.total_frames));
+  const int64_t block = frame / format_.frames_per_block;
+  read_frames_ = block * format_.frames_per_block;
+  skip_frames_ = static_cast<int>(frame - read_frames_);
+  return fseek(file_, static_cast<long>(data_offset_ + block * format_.block_align), SEEK_SET) == 0;
+}
+
+bool SVWavFile::IsWavFile(const std::string& file_path) {
+  FILE* file = fopen(file_path.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  uint8_t header[12];
+  const bool is_wav = fread(header, 1, sizeof(header), file) == sizeof(header) && !memcmp(header, "RIFF", 4) &&
+                      !memcmp(header + 8, "WAVE", 4);
+  fclose(file);
+  return is_wav;
+}
+
+bool SVWavFile::Probe(const std::string& file_path, SVWavFormat* format) {
+  SVWavFile file(file_path);
+  if (!file.IsOpen()) {
+    return false;
+  }
+  *format = file.format();
+  return true;
+}
+
+// ==== SVWavWriter. ====
+
+SVWavWriter::SVWavWriter(const std::string& file_path, const SVWavFormat& format)
+  : format_(format) {
+  const int channels = format_.channels;
+  if (channels <= 0 || channels > kMaxChannels || format_.sample_rate <= 0) {
+    AV_LOGE("SVWavWriter invalid format, %d Hz, %d channels.", format_.sample_rate, channels);
+    return;
+  }
+  format_.total_frames = 0;
+  switch (format_.encoding) {
+    case SVWavEncoding::kPcm16:
+      format_.block_align = 2 * channels;
+      format_.frames_per_block = 1;
+      break;
+    case SVWavEncoding::kFloat32:
+      format_.block_align = 4 * channels;
+      format_.frames_per_block = 1;
+      break;
+    case SVWavEncoding::kImaAdpcm: {
+      int frames = format_.frames_per_block > 1
+              ? format_.frames_per_block
+              : SVImaAdpcmFramesPerBlock(kAdpcmBlockBytesPerChannel * channels, channels);
+      frames = (frames - 1 + 7) / 8 * 8 + 1;
+      format_.frames_per_block = frames;
+      format_.block_align = SVImaAdpcmBlockAlign(frames, channels);
+      pending_.resize(static_cast<size_t>(frames) * channels);
+      block_.resize(format_.block_align);
+      break;
+    }
+  }
+  file_ = fopen(file_path.c_str(), "wb");
+  if (!file_) {
+    AV_LOGE("SVWavWriter open failed: %s", file_path.c_str());
+    return;
+  }
+  if (!WriteHeader()) {
+    AV_LOGE("SVWavWriter write header failed: %s", file_path.c_str());
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+SVWavWriter::~SVWavWriter() {
+  Close();
+}
+
+bool SVWavWriter::WriteHeader() {
+  const bool compressed = format_.encoding == SVWavEncoding::kImaAdpcm;
+  uint16_t tag = kFormatPcm;
+  int bits = 16;
+  if (format_.encoding == SVWavEncoding::kFloat32) {
+    tag = kFormatFloat;
+    bits = 32;
+  } else if (compressed) {
+    tag = kFormatImaAdpcm;
+    bits = 4;
+  }
+  const uint32_t byte_rate = static_cast<uint32_t>(static_cast<int64_t>(format_.sample_rate) *
+                                                   format_.block_align / format_.frames_per_block);
+  std::vector<uint8_t> header;
+  AppendTag(&header, "RIFF");
+  AppendLE32(&header, 0);
+  AppendTag(&header, "WAVE");
+  AppendTag(&header, "fmt ");
+  AppendLE32(&header, compressed ? 20 : (tag == kFormatPcm ? 16 : 18));
+  AppendLE16(&header, tag);
+  AppendLE16(&header, format_.channels);
+  AppendLE32(&header, format_.sample_rate);
+  AppendLE32(&header, byte_rate);
+  AppendLE16(&header, format_.block_align);
+  AppendLE16(&header, bits);
+  if (compressed) {
+    AppendLE16(&header, 2);
+    AppendLE16(&header, format_.frames_per_block);
+  } else if (tag != kFormatPcm) {
+    AppendLE16(&header, 0);
+  }
+  if (tag != kFormatPcm) {
+    // Required for every non-PCM format, holds the frame count.
+    AppendTag(&header, "fact");
+    AppendLE32(&header, 4);
+    AppendLE32(&header, 0);
+  }
+  AppendTag(&header, "data");
+  AppendLE32(&header, 0);
+  return fwrite(header.data(), 1, header.size(), file_) == header.size();
+}
+
+bool SVWavWriter::Write(const int16_t* data, int num_frames) {
+  if (!file_ || failed_) {
+    return false;
+  }
+  const int channels = format_.channels;
+  switch (format_.encoding) {
+    case SVWavEncoding::kPcm16:
+      failed_ = fwrite(data, format_.block_align, num_frames, file_) != static_cast<size_t>(num_frames);
+      data_bytes_ += static_cast<int64_t>(num_frames) * format_.block_align;
+      break;
+    case SVWavEncoding::kFloat32:
+      float_.resize(static_cast<size_t>(num_frames) * channels);
+      SVInt16ToFloat(data, float_.data(), num_frames * channels);
+      failed_ = fwrite(float_.data(), format_.block_align, num_frames, file_) != static_cast<size_t>(num_frames);
+      data_bytes_ += static_cast<int64_t>(num_frames) * format_.block_align;
+      break;
+    case SVWavEncoding::kImaAdpcm:
+      for (int done = 0; done < num_frames && !failed_;) {
+        const int frames = std::min(num_frames - done, format_.frames_per_block - pending_frames_);
+        memcpy(pending_.data() + pending_frames_ * channels, data + done * channels,
+               frames * channels * sizeof(int16_t));
+        pending_frames_ += frames;
+        done += frames;
+        if (pending_frames_ == format_.frames_per_block) FlushBlock();
+      }
+      break;
+  }
+  format_.total_frames += num_frames;
+  return !failed_;
+}
+
+bool SVWavWriter::Write(const float* data, int num_frames) {
+  if (!file_ || failed_) {
+    return false;
+  }
+  if (format_.encoding != SVWavEncoding::kFloat32) {
+    AV_LOGE("SVWavWriter float frames need a float32 file, this is %s.", SVWavEncodingName(format_.encoding));
+    failed_ = true;
+    return false;
+  }
+  failed_ = fwrite(data, format_.block_align, num_frames, file_) != static_cast<size_t>(num_frames);
+  data_bytes_ += static_cast<int64_t>(num_frames) * format_.block_align;
+  format_.total_frames += num_frames;
+  return !failed_;
+}
+
+bool SVWavWriter::FlushBlock() {
+  SVImaAdpcmEncodeBlock(pending_.data(), pending_frames_, format_.channels, format_.frames_per_block, &encoder_,
+                        block_.data());
+  failed_ = failed_ || fwrite(block_.data(), 1, block_.size(), file_) != block_.size();
+  data_bytes_ += static_cast<int64_t>(block_.size());
+  pending_frames_ = 0;
+  return !failed_;
+}
+
+bool SVWavWriter::Close() {
+  if (!file_) {
+    return false;
+  }
+  if (pending_frames_ > 0) {
+    FlushBlock();
+  }
+  if (data_bytes_ & 1) {
+    failed_ = failed_ || fputc(0, file_) == EOF;
+  }
+  const long file_size = ftell(file_);
+  const bool has_fact = format_.encoding != SVWavEncoding::kPcm16;
+  // Offsets follow the layout of WriteHeader().
+  const long data_size_offset = file_size - static_cast<long>(data_bytes_ + (data_bytes_ & 1)) - 4;
+  bool ok = !failed_ && WriteLE32At(file_, 4, static_cast<uint32_t>(file_size - 8)) &&
+            WriteLE32At(file_, data_size_offset, static_cast<uint32_t>(data_bytes_));
+  if (has_fact) {
+    ok = ok && WriteLE32At(file_, data_size_offset - 8, static_cast<uint32_t>(format_.total_frames));
+  }
+  ok = fclose(file_) == 0 && ok;
+  file_ = nullptr;
+  if (!ok) {
+    AV_LOGE("SVWavWriter close failed.");
+  }
+  return ok;
+}
+
+} // sv_render
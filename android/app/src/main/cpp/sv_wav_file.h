@@ -0,0 +1,108 @@
+#ifndef AUDIO_PLAYOUT_SV_WAV_FILE_H
+#define AUDIO_PLAYOUT_SV_WAV_FILE_H
+
+#include "sv_ima_adpcm.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace sv_render {
+
+enum class SVWavEncoding { kPcm16, kFloat32, kImaAdpcm };
+
+struct SVWavFormat {
+  SVWavEncoding encoding = SVWavEncoding::kPcm16;
+  int sample_rate = 0;
+  int channels = 0;
+  // Bytes per block, a block is one frame for PCM and one ADPCM block.
+  int block_align = 0;
+  int frames_per_block = 1;
+  int64_t total_frames = 0;
+};
+
+const char* SVWavEncodingName(SVWavEncoding encoding);
+
+// Streaming reader of RIFF/WAVE files holding PCM16, float32 or IMA-ADPCM,
+// including WAVE_FORMAT_EXTENSIBLE. Decodes a block at a time into float, so
+// compressed assets are never expanded in memory. Samples are read as little
+// endian, like every target this builds for.
+class SVWavFile {
+
+public:
+  explicit SVWavFile(const std::string& file_path);
+  ~SVWavFile();
+
+  // True when the header parsed and the encoding is supported.
+  bool IsOpen() const { return file_ != nullptr; }
+  const SVWavFormat& format() const { return format_; }
+  // Most frames a ReadBlock() call produces.
+  int frames_per_read() const { return frames_per_read_; }
+
+  // Decodes the next block into dst, which holds frames_per_read() frames.
+  // Returns the number of frames, 0 at the end of the data.
+  int ReadBlock(float* dst);
+  bool Rewind();
+  // Moves the read position to frame, sample-accurately. Every encoding here
+  // has fixed-size blocks, so the block holding frame sits at a computed
+  // offset: one seek and at most one block decode, wherever frame is.
+  bool Seek(int64_t frame);
+
+  // True if the file starts with a RIFF/WAVE header.
+  static bool IsWavFile(const std::string& file_path);
+  // Parses the header only.
+  static bool Probe(const std::string& file_path, SVWavFormat* format);
+
+private:
+  bool ParseHeader();
+
+private:
+  FILE* file_ = nullptr;
+  SVWavFormat format_;
+  int64_t data_offset_ = 0;
+  int64_t data_size_ = 0;
+  int64_t read_frames_ = 0;
+  // Frames at the start of the next block that precede the seek target.
+  int skip_frames_ = 0;
+  int frames_per_read_ = 0;
+  std::vector<uint8_t> block_;
+  std::vector<int16_t> pcm_;
+};
+
+// Writes a RIFF/WAVE file in any SVWavEncoding, for preparing assets and for
+// offline renders. The sizes in the header are patched in by Close().
+class SVWavWriter {
+
+public:
+  // format.block_align and total_frames are filled in by the writer; for
+  // IMA-ADPCM frames_per_block picks the block size, 8n + 1 frames.
+  SVWavWriter(const std::string& file_path, const SVWavFormat& format);
+  ~SVWavWriter();
+
+  bool IsOpen() const { return file_ != nullptr; }
+  bool Write(const int16_t* data, int num_frames);
+  // Float frames, for float32 files only.
+  bool Write(const float* data, int num_frames);
+  bool Close();
+  int64_t frames_written() const { return format_.total_frames; }
+
+private:
+  bool WriteHeader();
+  bool FlushBlock();
+
+private:
+  FILE* file_ = nullptr;
+  SVWavFormat format_;
+  int64_t data_bytes_ = 0;
+  bool failed_ = false;
+  // IMA-ADPCM: frames waiting for a full block, and the encoder state.
+  std::vector<int16_t> pending_;
+  int pending_frames_ = 0;
+  std::vector<uint8_t> block_;
+  SVImaAdpcmEncoder encoder_;
+  std::vector<float> float_;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_WAV_FILE_H
@@ -0,0 +1,213 @@
+#include "sv_wav_pcm_source.h"
+#include "sv_render_stats.h"
+#include "sv_sample_convert.h"
+#include "log.h"
+#include <algorithm>
+
+namespace sv_render {
+
+namespace {
+
+// Frames converted per pass on the int16 path.
+constexpr int kScratchFrames = 512;
+// How often the decode thread checks whether the audio thread has taken a seek.
+constexpr std::chrono::milliseconds kSeekPollInterval { 1 };
+// Ring space kept free for the first frames after a seek, so the callback
+// fades straight into them. Longer than a callback.
+constexpr int kSeekPrimeMs = 50;
+
+} // namespace
+
+SVWavPcmSource::SVWavPcmSource(const std::string& file_path, int prefetch_ms)
+  : file_(file_path),
+  prefetch_ms_(prefetch_ms) {
+}
+
+SVWavPcmSource::~SVWavPcmSource() {
+  Release();
+}
+
+bool SVWavPcmSource::Prepare(int sample_rate, int channels) {
+  if (!file_.IsOpen()) {
+    AV_LOGE("SVWavPcmSource start failed, file not open.");
+    return false;
+  }
+  const SVWavFormat& format = file_.format();
+  if (sample_rate != format.sample_rate || channels != format.channels) {
+    AV_LOGE("SVWavPcmSource file is %d Hz %d channels, asked for %d Hz %d channels.", format.sample_rate,
+            format.channels, sample_rate, channels);
+    return false;
+  }
+  // Preparing again restarts from the beginning of the file, or from a seek
+  // requested before.
+  Release();
+  file_.Seek(std::max<int64_t>(seek_request_.exchange(-1), 0));
+  eof_.store(false, std::memory_order_relaxed);
+  seek_ack_.store(seek_generation_.load());
+  crossfade_.Prepare(sample_rate, channels);
+  decoded_frames_ = 0;
+  decode_ns_ = 0;
+
+  // The ring takes whole blocks, so it holds at least two of them, plus the
+  // seek reserve.
+  const size_t block_frames = static_cast<size_t>(file_.frames_per_read());
+  const size_t prefetch_frames = static_cast<size_t>(sample_rate) * prefetch_ms_ / 1000;
+  seek_prime_frames_ = (static_cast<size_t>(sample_rate) * kSeekPrimeMs / 1000 + block_frames - 1) /
+                       block_frames * block_frames;
+  ring_.reset(new SVRingBuffer<float>(std::max(prefetch_frames, 2 * block_frames) + seek_prime_frames_, channels));
+  block_.assign(static_cast<size_t>(file_.frames_per_read()) * channels, 0.0f);
+  scratch_.assign(static_cast<size_t>(kScratchFrames) * channels, 0.0f);
+  wakeup_interval_ = std::chrono::milliseconds(std::max(prefetch_ms_ / 4, 1));
+
+  // Prime the ring before the first callback can ask for data.
+  FillRing(seek_prime_frames_);
+  if (synchronous_) {
+    AV_LOGI("SVWavPcmSource start, %s, decoding on render.", SVWavEncodingName(format.encoding));
+    return true;
+  }
+
+  running_ = true;
+  thread_ = std::thread(&SVWavPcmSource::ThreadLoop, this);
+  AV_LOGI("SVWavPcmSource start, %s, ring capacity: %zu frames", SVWavEncodingName(format.encoding),
+          ring_->capacity());
+  return true;
+}
+
+void SVWavPcmSource::Release() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cond_.notify_all();
+  if (!thread_.joinable()) {
+    return;
+  }
+  thread_.join();
+  AV_LOGI("SVWavPcmSource decoded %lld frames, %.1f ns/frame, underruns: %llu", (long long) decoded_frames_,
+          decoded_frames_ > 0 ? static_cast<double>(decode_ns_) / decoded_frames_ : 0.0,
+          (unsigned long long) underruns());
+}
+
+bool SVWavPcmSource::Seek(int64_t frame) {
+  if (!file_.IsOpen() || frame < 0) {
+    return false;
+  }
+  if (synchronous_ && ring_) {
+    AV_LOGW("SVWavPcmSource synchronous source seeks before Prepare() only.");
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    seek_request_.store(frame);
+    wake_ = true;
+  }
+  cond_.notify_all();
+  return true;
+}
+
+void SVWavPcmSource::ThreadLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Keeps running past the end of the file, a seek may bring it back.
+  while (running_) {
+    wake_ = false;
+    lock.unlock();
+    HandleSeek();
+    FillRing(seek_prime_frames_);
+    lock.lock();
+    cond_.wait_for(lock, wakeup_interval_, [this] { return !running_ || wake_; });
+  }
+  AV_LOGI("SVWavPcmSource thread exit.");
+}
+
+void SVWavPcmSource::HandleSeek() {
+  while (seek_request_.load() >= 0) {
+    // Not at the end any more; cleared first so IsEnd() never sees the gap.
+    eof_.store(false, std::memory_order_relaxed);
+    const int64_t frame = seek_request_.exchange(-1);
+    file_.Seek(frame);
+    // The new frames go into the reserve behind the old ones, so they are
+    // there as soon as the callback takes the seek.
+    seek_marker_.store(ring_->frames_written(), std::memory_order_relaxed);
+    FillRing(0);
+    const uint32_t generation = seek_generation_.load(std::memory_order_relaxed) + 1;
+    seek_generation_.store(generation, std::memory_order_release);
+    AV_LOGI("SVWavPcmSource seek to frame %lld.", (long long) frame);
+    // Wait for the callback to drop the old frames, then refill the ring
+    // and its reserve right away rather than after the wakeup interval.
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_ && seek_ack_.load(std::memory_order_acquire) != generation) {
+      cond_.wait_for(lock, kSeekPollInterval);
+    }
+  }
+}
+
+void SVWavPcmSource::FillRing(size_t reserve_frames) {
+  while (!eof_.load(std::memory_order_relaxed) &&
+         ring_->AvailableToWrite() >= static_cast<size_t>(file_.frames_per_read()) + reserve_frames) {
+    const int64_t begin_ns = SVRenderStats::NowNanos();
+    const int frames = file_.ReadBlock(block_.data());
+    decode_ns_ += SVRenderStats::NowNanos() - begin_ns;
+    decoded_frames_ += frames;
+    ring_->Write(block_.data(), frames);
+    if (frames == 0) {
+      AV_LOGW("read file end.");
+      eof_.store(true, std::memory_order_release);
+    }
+  }
+}
+
+int SVWavPcmSource::ReadRing(float* dst, int num_frames) {
+  int frames = static_cast<int>(ring_->Read(dst, num_frames));
+  while (synchronous_ && frames < num_frames && !eof_.load(std::memory_order_relaxed)) {
+    FillRing(0);
+    frames += static_cast<int>(ring_->Read(dst + frames * ring_->channels(), num_frames - frames));
+  }
+  if (frames < num_frames && !eof_.load(std::memory_order_acquire)) {
+    underruns_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return frames;
+}
+
+int SVWavPcmSource::ReadFrames(float* dst, int num_frames) {
+  const uint32_t generation = seek_generation_.load(std::memory_order_acquire);
+  if (generation != seek_ack_.load(std::memory_order_relaxed)) {
+    // Keep the first of the old frames for the fade, drop the rest.
+    const size_t old_frames = seek_marker_.load(std::memory_order_relaxed) - ring_->frames_read();
+    const size_t kept = ring_->Read(crossfade_.old_frames(),
+                                    std::min(old_frames, static_cast<size_t>(crossfade_.max_frames())));
+    ring_->Skip(old_frames - kept);
+    crossfade_.Start(static_cast<int>(kept));
+    seek_ack_.store(generation, std::memory_order_release);
+  }
+  const int frames = ReadRing(dst, num_frames);
+  return crossfade_.Apply(dst, frames, num_frames);
+}
+
+int SVWavPcmSource::RenderFloat(float* dst, int num_frames) {
+  return ring_ ? ReadFrames(dst, num_frames) : 0;
+}
+
+int SVWavPcmSource::Render(int16_t* dst, int num_frames) {
+  if (!ring_) {
+    return 0;
+  }
+  const int channels = ring_->channels();
+  int rendered = 0;
+  while (rendered < num_frames) {
+    const int wanted = std::min(num_frames - rendered, kScratchFrames);
+    const int frames = ReadFrames(scratch_.data(), wanted);
+    SVFloatToInt16(scratch_.data(), dst + rendered * channels, frames * channels);
+    rendered += frames;
+    if (frames < wanted) break;
+  }
+  return rendered;
+}
+
+bool SVWavPcmSource::IsEnd() const {
+  if (!ring_) return true;
+  return seek_request_.load(std::memory_order_relaxed) < 0 &&
+         seek_generation_.load(std::memory_order_relaxed) == seek_ack_.load(std::memory_order_relaxed) &&
+         !crossfade_.active() && eof_.load(std::memory_order_acquire) && ring_->AvailableToRead() == 0;
+}
+
+} // sv_render
@@ -0,0 +1,107 @@
+#ifndef AUDIO_PLAYOUT_SV_WAV_PCM_SOURCE_H
+#define AUDIO_PLAYOUT_SV_WAV_PCM_SOURCE_H
+
+#include "sv_pcm_source.h"
+#include "sv_ring_buffer.h"
+#include "sv_seek_crossfade.h"
+#include "sv_wav_file.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sv_render {
+
+// Plays a WAV file: a background thread decodes it block by block into a
+// float ring kept prefetch_ms ahead of the consumer, so the audio callback
+// only pops frames and never parses, decodes or touches the file.
+//
+// Seek() hands the target to the decode thread, which repositions the file
+// and decodes the first frames there into space the ring keeps free, behind
+// a marker; the next callback drops the frames queued before the marker and
+// crossfades from the first of them into the new ones.
+//
+// The source renders in the file's own rate and layout; CreateFilePcmSource()
+// wraps it in an SVConvertingPcmSource so it plays in any stream.
+class SVWavPcmSource : public IPcmSource {
+
+public:
+  static constexpr int kDefaultPrefetchMs = 200;
+
+  explicit SVWavPcmSource(const std::string& file_path, int prefetch_ms = kDefaultPrefetchMs);
+  ~SVWavPcmSource() override;
+
+  bool IsOpen() const { return file_.IsOpen(); }
+  const SVWavFormat& format() const { return file_.format(); }
+  // Control thread, before Prepare(). Decodes on the thread that renders
+  // instead of a background one, for offline renders that would otherwise
+  // wait on its wakeups: Render() then reads the file itself and only
+  // underruns at the end. Seeks apply only when requested before Prepare().
+  void SetSynchronous(bool synchronous) { synchronous_ = synchronous; }
+
+  // Must match format(). Rewinds, primes the ring and starts the decode thread.
+  bool Prepare(int sample_rate, int channels) override;
+  // Stops the decode thread and logs the decode cost.
+  void Release() override;
+
+  // Never block. Return fewer than num_frames on underrun or at the end.
+  int Render(int16_t* dst, int num_frames) override;
+  bool IsEnd() const override;
+  bool CanRenderFloat() const override { return true; }
+  int RenderFloat(float* dst, int num_frames) override;
+  bool CanSeek() const override { return true; }
+  bool Seek(int64_t frame) override;
+
+  // Frames the callback found missing while the file had more.
+  uint64_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+private:
+  void ThreadLoop();
+  // Decode thread. Repositions the file for pending seeks.
+  void HandleSeek();
+  // Decodes blocks into the ring until only reserve_frames are left free
+  // or the file ends.
+  void FillRing(size_t reserve_frames);
+  // Audio thread. Ring frames with any pending seek applied.
+  int ReadFrames(float* dst, int num_frames);
+  int ReadRing(float* dst, int num_frames);
+
+private:
+  SVWavFile file_;
+  const int prefetch_ms_;
+  bool synchronous_ = false;
+  std::unique_ptr<SVRingBuffer<float>> ring_;
+  // Decode thread: one decoded block.
+  std::vector<float> block_;
+  // Audio thread: float frames on their way to an int16 stream.
+  std::vector<float> scratch_;
+  // Ring space FillRing() leaves for the frames after a seek, whole blocks.
+  size_t seek_prime_frames_ = 0;
+  std::chrono::milliseconds wakeup_interval_ { 10 };
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool running_ = false;
+  bool wake_ = false;
+  std::atomic<bool> eof_ { false };
+  // Seek handshake: the control thread posts a request, the decode thread
+  // marks where the new frames start and bumps the generation, the audio
+  // thread acknowledges once it dropped the old ones.
+  std::atomic<int64_t> seek_request_ { -1 };
+  std::atomic<size_t> seek_marker_ { 0 };
+  std::atomic<uint32_t> seek_generation_ { 0 };
+  std::atomic<uint32_t> seek_ack_ { 0 };
+  SVSeekCrossfade<float> crossfade_;
+  std::atomic<uint64_t> underruns_ { 0 };
+  // Decode thread, reported on Release().
+  int64_t decoded_frames_ = 0;
+  int64_t decode_ns_ = 0;
+};
+
+} // sv_render
+
+#endif //AUDIO_PLAYOUT_SV_WAV_PCM_SOURCE_H
@@ -5,19 +5,87 @@ import java.io.File
 import java.io.FileOutputStream
 import java.io.InputStream
 import java.io.OutputStream
+import java.nio.ByteBuffer
 
-class SVNativeAudioRender private constructor(): IAudioRender{
+/**
+ * One native stream. Instances are independent: each owns its own native render, behind a handle
+ * created by initPlayout and released by stopPlayout, so several can play at the same time.
+ */
+class SVNativeAudioRender : IAudioRender {
+
+    /** Counters of the running native render, see NativeGetStats in native-lib.cpp. */
+    data class RenderStats(
+        val callbackCount: Long,
+        val framesRendered: Long,
+        val underrunCount: Long,
+        val xrunCount: Long,
+        val jitterAvgNs: Long,
+        val jitterMaxNs: Long,
+        val renderAvgNs: Long,
+        val renderMaxNs: Long,
+        /** Estimated output latency, negative when the backend can't tell. */
+        val outputLatencyUs: Long,
+        /** From startPlayout to the first device callback, -1 until that callback ran. */
+        val startLatencyNs: Long,
+        /** Times the output device went away, e.g. a headset was unplugged. */
+        val disconnectCount: Long,
+        /** Times playback came back on the new device, where it stopped. */
+        val recoveryCount: Long,
+        /** From the disconnect to audio playing again, -1 until the first recovery. */
+        val recoveryLastNs: Long,
+        val recoveryMaxNs: Long,
+    )
+
+    /** Latency held by a live push stream, see NativeGetPushDrift in native-lib.cpp. */
+    data class PushDrift(
+        /** Producer to speaker, filtered over about a second; negative until the voice played. */
+        val latencyMs: Double,
+        /** Rate correction applied right now, and the clock drift it converged on. */
+        val correctionPpm: Double,
+        val driftPpm: Double,
+    )
 
     companion object {
+        /** Values of SV_RENDER_TYPE in sv_common.h. */
+        const val RENDER_TYPE_OPENSL = 1
+        const val RENDER_TYPE_AAUDIO = 2
+        const val RENDER_TYPE_OBOE = 3
+
+        /** Values of SV_LATENCY_POLICY in sv_common.h. */
+        const val LATENCY_POLICY_OFF = 0
+        const val LATENCY_POLICY_LOWEST = 1
+        const val LATENCY_POLICY_BALANCED = 2
+        const val LATENCY_POLICY_ROBUST = 3
+
         val instance: SVNativeAudioRender by lazy {
             SVNativeAudioRender()
         }
-    }
 
-    init {
-        System.loadLibrary("audio_playout")
+        init {
+            System.loadLibrary("audio_playout")
+        }
+
+        /**
+         * Opens what the backend's first start would otherwise wait for, e.g. at app launch: the
+         * OpenSL engine, or an AAudio/Oboe stream parked for the first initPlayout. Stopped
+         * streams are parked the same way, so later starts are warm too.
+         */
+        @JvmStatic
+        fun prewarm(renderType: Int = RENDER_TYPE_OBOE): Boolean {
+            return nativePrewarm(renderType)
+        }
+
+        @JvmStatic
+        private external fun nativePrewarm(type: Int): Boolean
     }
 
+    /** Native stream of this instance, 0 when there is none. */
+    private var handle: Long = 0
+    // Applied to the next stream initPlayout creates.
+    private var openslNumBuffers = 2
+    private var openslBufferMs = 10
+    private var latencyPolicy = LATENCY_POLICY_BALANCED
+
     override fun initPlayout(sampleRate: Int, channels: Int, streamType: Int): Int {
         val dir = context?.filesDir
         assert(dir != null) { "Please set context." }
@@ -43,21 +111,171 @@ class SVNativeAudioRender private constructor(): IAudioRender{
         inputStream?.close()
         outputStream?.close()
 
-        nativeSetRenderType(3,  file.absolutePath)
-        return nativeInitRender(sampleRate, channels)
+        if (handle != 0L) nativeRelease(handle)
+        handle = nativeCreate(RENDER_TYPE_OBOE, file.absolutePath)
+        if (handle == 0L) return ErrorCode.INIT_ERROR.ordinal
+        nativeSetOpenslBuffers(handle, openslNumBuffers, openslBufferMs)
+        nativeSetLatencyPolicy(handle, latencyPolicy)
+        return nativeInitRender(handle, sampleRate, channels)
+    }
+
+    /**
+     * Buffer queue of the OpenSL backend, call before initPlayout. numBuffers = 0 starts at two
+     * buffers and adds more while the queue runs dry, for the lowest latency the device sustains.
+     */
+    fun setOpenslBuffers(numBuffers: Int, bufferMs: Int) {
+        openslNumBuffers = numBuffers
+        openslBufferMs = bufferMs
+    }
+
+    /**
+     * How the AAudio and Oboe backends size their buffer, call before initPlayout: one of the
+     * LATENCY_POLICY_* constants. The buffer starts a few bursts long, grows on underruns and
+     * shrinks back after quiet periods; the lower the policy, the sooner it tries a smaller size.
+     */
+    fun setLatencyPolicy(policy: Int) {
+        latencyPolicy = policy
     }
 
     override fun startPlayout(): Int {
-        return nativeStartPlayout()
+        return nativeStartPlayout(handle)
     }
 
+    /** Stops and releases the native stream, initPlayout creates a new one. */
     override fun stopPlayout(): Int {
-        return nativeStopPlayout()
+        if (handle == 0L) return ErrorCode.STOP_ERROR.ordinal
+        val result = nativeStopPlayout(handle)
+        nativeRelease(handle)
+        handle = 0
+        return result
+    }
+
+    /** Fades out and holds the stream silent, the source keeps its position. */
+    fun pausePlayout(): Int {
+        return nativePausePlayout(handle)
+    }
+
+    /** Fades back in where pausePlayout left off. */
+    fun resumePlayout(): Int {
+        return nativeResumePlayout(handle)
+    }
+
+    fun getStats(): RenderStats? {
+        val values = nativeGetStats(handle) ?: return null
+        return RenderStats(values[0], values[1], values[2], values[3], values[4],
+            values[5], values[6], values[7], values[8], values[9], values[10], values[11], values[12],
+            values[13])
+    }
+
+    /**
+     * Output gain of the stream, reached over rampMs without clicks, exponential for an even
+     * change in loudness. startPlayout fades in to it, and stopPlayout returns once the stream
+     * faded out.
+     */
+    fun setGain(gain: Float, rampMs: Int = 0, exponential: Boolean = false): Boolean {
+        return nativeSetGain(handle, gain, rampMs, exponential)
+    }
+
+    /**
+     * Mixes another file into the running stream: raw PCM in the layout passed to initPlayout,
+     * or a WAV file (PCM16, float or IMA-ADPCM) in any layout. Returns the voice id, or -1 on failure.
+     */
+    fun addVoice(filePath: String, gain: Float = 1.0f): Int {
+        return nativeAddVoice(handle, filePath, gain)
+    }
+
+    fun removeVoice(voiceId: Int): Boolean {
+        return nativeRemoveVoice(handle, voiceId)
+    }
+
+    fun setVoiceGain(voiceId: Int, gain: Float): Boolean {
+        return nativeSetVoiceGain(handle, voiceId, gain)
+    }
+
+    /**
+     * Queues a file to play right after the current one, gapless, on the same stream.
+     * Same formats as addVoice. Returns the item id, or -1 on failure.
+     */
+    fun enqueue(filePath: String): Int {
+        return nativeEnqueue(handle, filePath)
+    }
+
+    /** Id of the playlist item playing, 0 before the first one starts. */
+    fun currentItem(): Int {
+        return nativeGetCurrentItem(handle)
+    }
+
+    /**
+     * Jumps to a frame of the current playlist item, counted at the file's own rate.
+     * Returns at once; playback crossfades to the new position a few milliseconds later.
+     */
+    fun seek(frame: Long): Boolean {
+        return nativeSeek(handle, frame)
+    }
+
+    /**
+     * Adds a voice fed with PCM16 written from Kotlin, e.g. by a decoder, in its own rate and
+     * channel count. bufferMs sizes its queue, 0 for the default of 200 ms. A live producer, one
+     * paced by its own clock like a network stream, passes latencyMs: the stream then holds the
+     * latency from write to speaker there, resampling by up to 0.2% as the producer's and the
+     * device's clocks drift apart. Producers that just keep the queue full pass 0. Returns the
+     * push stream's handle for write, or 0 on failure; frames can be written before startPlayout.
+     */
+    fun createPushStream(sampleRate: Int, channels: Int, bufferMs: Int = 0, gain: Float = 1.0f,
+                         latencyMs: Int = 0): Long {
+        return nativeCreatePushStream(handle, sampleRate, channels, bufferMs, gain, latencyMs)
+    }
+
+    /**
+     * Queues frames of interleaved PCM16 from a direct buffer in native byte order
+     * (ByteBuffer.allocateDirect(..).order(ByteOrder.nativeOrder())), from position 0. The
+     * native side reads the buffer in place, nothing is copied on the Java side. Blocking waits
+     * until all frames are queued; otherwise only what fits is, and the caller retries the rest
+     * later. Returns the frames queued, or -1 on error.
+     */
+    fun write(pushStream: Long, buffer: ByteBuffer, frames: Int, blocking: Boolean = true): Int {
+        require(buffer.isDirect) { "write needs a direct ByteBuffer." }
+        return nativeWrite(pushStream, buffer, frames, blocking)
+    }
+
+    /** Frames write can queue right now without blocking, -1 for an unknown push stream. */
+    fun pushAvailable(pushStream: Long): Int {
+        return nativeGetPushAvailable(pushStream)
+    }
+
+    /** Latency and drift correction of a push stream created with a latencyMs. */
+    fun pushDrift(pushStream: Long): PushDrift? {
+        val values = nativeGetPushDrift(pushStream) ?: return null
+        return PushDrift(values[0], values[1], values[2])
+    }
+
+    /** No more writes: what is queued still plays, then the voice ends. */
+    fun endPushStream(pushStream: Long) {
+        nativeEndPushStream(pushStream)
     }
 
-    private external fun nativeSetRenderType(type: Int, filePath: String)
-    private external fun nativeInitRender(sampleRate: Int, channels: Int): Int
-    private external fun nativeStartPlayout(): Int
-    private external fun nativeStopPlayout(): Int
+    private external fun nativeCreate(type: Int, filePath: String): Long
+    private external fun nativeRelease(handle: Long)
+    private external fun nativeInitRender(handle: Long, sampleRate: Int, channels: Int): Int
+    private external fun nativeSetOpenslBuffers(handle: Long, numBuffers: Int, bufferMs: Int)
+    private external fun nativeSetLatencyPolicy(handle: Long, policy: Int)
+    private external fun nativeStartPlayout(handle: Long): Int
+    private external fun nativeStopPlayout(handle: Long): Int
+    private external fun nativePausePlayout(handle: Long): Int
+    private external fun nativeResumePlayout(handle: Long): Int
+    private external fun nativeGetStats(handle: Long): LongArray?
+    private external fun nativeSetGain(handle: Long, gain: Float, rampMs: Int, exponential: Boolean): Boolean
+    private external fun nativeAddVoice(handle: Long, filePath: String, gain: Float): Int
+    private external fun nativeRemoveVoice(handle: Long, voiceId: Int): Boolean
+    private external fun nativeSetVoiceGain(handle: Long, voiceId: Int, gain: Float): Boolean
+    private external fun nativeEnqueue(handle: Long, filePath: String): Int
+    private external fun nativeGetCurrentItem(handle: Long): Int
+    private external fun nativeSeek(handle: Long, frame: Long): Boolean
+    private external fun nativeCreatePushStream(handle: Long, sampleRate: Int, channels: Int, bufferMs: Int,
+                                                gain: Float, latencyMs: Int): Long
+    private external fun nativeWrite(pushStream: Long, buffer: ByteBuffer, frames: Int, blocking: Boolean): Int
+    private external fun nativeGetPushAvailable(pushStream: Long): Int
+    private external fun nativeEndPushStream(pushStream: Long)
+    private external fun nativeGetPushDrift(pushStream: Long): DoubleArray?
 
 }
\ No newline at end of file